@@ -0,0 +1,143 @@
+//
+//  FrameRecorder.h
+//
+//  Frames written off the draw loop on worker threads, from a fixed pool, into a sink.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! Pixels top row first, red, green, blue and optionally alpha per pixel.
+struct RecorderFrame {
+	enum Format { UINT8, FLOAT32 };
+
+	RecorderFrame() : mWidth( 0 ), mHeight( 0 ), mChannels( 0 ), mFormat( UINT8 ), mRowBytes( 0 ), mIndex( 0 ), mTime( 0.0 ) {}
+
+	//! Sizes the pixels, reusing the storage when it is already large enough.
+	void			allocate( int width, int height, int channels, Format format );
+	uint8_t*		getRow( int y )			{ return &mData[y * mRowBytes]; }
+	const uint8_t*	getRow( int y ) const	{ return &mData[y * mRowBytes]; }
+	size_t			getBytesPerPixel() const	{ return mChannels * ( mFormat == FLOAT32 ? sizeof( float ) : 1 ); }
+
+	std::vector<uint8_t>	mData;
+	int						mWidth, mHeight, mChannels;
+	Format					mFormat;
+	size_t					mRowBytes;
+	uint64_t				mIndex;			// position in the recording, set when a worker takes the frame
+	double					mTime;			// seconds, as the caller stamps it
+	std::string				mName;			// a file name for sinks that write one per frame; empty numbers it by mIndex
+	std::vector<uint8_t>	mEncoded;		// a sink's own scratch, kept with the frame so it is reused too
+};
+
+class FrameSink {
+  public:
+	virtual ~FrameSink() {}
+
+	//! Whether write() must see frames one at a time in the order they were submitted.
+	virtual bool	isOrdered() const	{ return true; }
+	//! On each worker, before its first frame and after its last.
+	virtual void	beginThread()	{}
+	virtual void	endThread()		{}
+	//! Any worker, any order, several frames at once.
+	virtual bool	encode( RecorderFrame & /*frame*/ )	{ return true; }
+	virtual bool	write( RecorderFrame &frame ) = 0;
+	//! After the last write.
+	virtual void	close()	{}
+};
+
+//! Frames back to back, pixels exactly as they were submitted.
+class RawSink : public FrameSink {
+  public:
+	explicit RawSink( const std::string &path );
+
+	bool	write( RecorderFrame &frame );
+	void	close();
+
+  private:
+	std::ofstream	mFile;
+};
+
+//! YUV4MPEG2 at 4:2:0 with full range BT.601 colour, as C420jpeg specifies, which ffmpeg and
+//! most players read directly. Float frames are clamped to 0 to 1 and alpha is dropped.
+class Y4mSink : public FrameSink {
+  public:
+	Y4mSink( const std::string &path, int frameRate );
+
+	bool	encode( RecorderFrame &frame );
+	bool	write( RecorderFrame &frame );
+	void	close();
+
+  private:
+	std::ofstream	mFile;
+	int				mFrameRate;
+	int				mWidth, mHeight;	// from the first frame; later frames must match
+};
+
+class FrameRecorder {
+  public:
+	enum Policy {
+		BLOCK,			// acquire() waits for a frame to come free
+		DROP_NEWEST,	// acquire() returns null and the frame is not recorded
+		DROP_OLDEST		// acquire() takes back the oldest frame that is still waiting
+	};
+
+	struct Stats {
+		Stats() : mSubmitted( 0 ), mDropped( 0 ), mWritten( 0 ), mFailed( 0 ), mBytes( 0 ), mPeakQueued( 0 ) {}
+
+		uint64_t	mSubmitted, mDropped, mWritten, mFailed;
+		uint64_t	mBytes;			// pixel bytes written
+		size_t		mPeakQueued;
+	};
+
+	//! \a numFrames frames are allocated as they are first used. \a numThreads 0 uses every hardware thread.
+	FrameRecorder( const std::shared_ptr<FrameSink> &sink, size_t numFrames = 6, Policy policy = DROP_OLDEST, size_t numThreads = 0 );
+	//! Writes what is queued and closes the sink.
+	~FrameRecorder();
+
+	//! A frame of the given size to fill, or null when the policy drops it.
+	RecorderFrame*	acquire( int width, int height, int channels, RecorderFrame::Format format );
+	//! Queues \a frame for writing; it belongs to the recorder again.
+	void			submit( RecorderFrame *frame );
+	//! Gives back an acquired frame without recording it.
+	void			release( RecorderFrame *frame );
+	//! acquire(), a row by row copy and submit() in one; \a flipped reads \a data bottom row first,
+	//! as glReadPixels() leaves it. False when the frame was dropped.
+	bool			record( const void *data, int width, int height, ptrdiff_t rowBytes, int channels, RecorderFrame::Format format,
+							bool flipped = false, double time = 0.0, const std::string &name = "" );
+
+	//! Waits until everything submitted is written. The recorder takes frames again afterwards.
+	void			flush();
+	//! Flushes and closes the sink; further frames are dropped.
+	void			finish();
+
+	Stats			getStats();
+	size_t			getNumThreads() const	{ return mWorkers.size(); }
+
+  private:
+	void			run();
+
+	std::shared_ptr<FrameSink>		mSink;
+	Policy							mPolicy;
+	size_t							mNumFrames;
+	std::vector<std::unique_ptr<RecorderFrame>>	mFrames;
+	std::vector<RecorderFrame*>		mFree;
+	std::deque<RecorderFrame*>		mQueue;
+
+	std::vector<std::thread>		mWorkers;
+	std::mutex						mMutex;
+	std::condition_variable			mWake, mFreed, mWritten;
+	uint64_t						mNextIndex, mNextWrite;
+	size_t							mNumBusy;
+	bool							mClosed, mQuit;
+	Stats							mStats;
+};
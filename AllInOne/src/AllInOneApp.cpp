@@ -7,6 +7,7 @@
 #include "cinder/Utilities.h"
 
 #include "Avf.h"
+#include "FrameCapture.h"
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/format.hpp>
@@ -61,6 +62,10 @@ private:
     fs::path mMovieDirectory, mSnapshotPath;
     void saveFrame(fs::path, bool);
     
+    // PNGs are written on worker threads; a disk that falls behind
+    // drops the oldest movie frames rather than slowing the capture
+    std::shared_ptr<FrameRecorder> mMovieRecorder, mSnapshotRecorder;
+    
     
     std::vector<SwipeGestureRecognizerInfo *> swipeRecognizerInfos;
     std::vector<TapGestureRecognizerInfo*> tapRecognizerInfos;
@@ -186,6 +191,12 @@ void AllInOneApp::setup() {
     mMovieDirectory = getFolderPath();
     
     mSnapshotPath = getHomeDirectory();// / (directory+timestamp.str()+".png")
+    
+#if defined ( CINDER_MAC )
+    // a movie's frames are all kept: a backed up queue holds the draw loop rather than dropping one
+    mMovieRecorder = std::shared_ptr<FrameRecorder>( new FrameRecorder( std::shared_ptr<FrameSink>( new ImageSequenceSink( mMovieDirectory ) ), 8, FrameRecorder::BLOCK ) );
+    mSnapshotRecorder = std::shared_ptr<FrameRecorder>( new FrameRecorder( std::shared_ptr<FrameSink>( new ImageSequenceSink( mSnapshotPath ) ), 2, FrameRecorder::BLOCK, 1 ) );
+#endif
 
 }
 
@@ -223,7 +234,12 @@ void AllInOneApp::saveFrame(fs::path directory, bool frames){
         timestamp << now;
         writePath = directory / (timestamp.str() +".png");
     }
-    writeImage( writePath, mCumulativeSurface32f );
+    
+    // the float pixels go as they are; the worker converts and compresses them
+    FrameRecorder &recorder = frames ? *mMovieRecorder : *mSnapshotRecorder;
+    recorder.record( mCumulativeSurface32f.getData(), mCumulativeSurface32f.getWidth(), mCumulativeSurface32f.getHeight(),
+                     mCumulativeSurface32f.getRowBytes(), mCumulativeSurface32f.getPixelInc(), RecorderFrame::FLOAT32,
+                     false, getElapsedSeconds(), writePath.filename().string() );
 #elif defined (CINDER_COCOA_TOUCH)
     cocoa::writeToSavedPhotosAlbum( mCumulativeSurface32f );
 #endif
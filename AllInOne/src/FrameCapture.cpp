@@ -0,0 +1,110 @@
+//
+//  FrameCapture.cpp
+//
+
+#include "FrameCapture.h"
+
+#include "cinder/ImageIo.h"
+#include "cinder/Surface.h"
+
+#include <algorithm>
+#include <cstdio>
+
+using namespace ci;
+using namespace std;
+
+ImageSequenceSink::ImageSequenceSink( const fs::path &directory, const string &prefix, const string &extension, bool alpha )
+	: mDirectory( directory ), mPrefix( prefix ), mExtension( extension ), mAlpha( alpha )
+{
+}
+
+bool ImageSequenceSink::write( RecorderFrame &frame )
+{
+	fs::path path;
+	if( frame.mName.empty() ) {
+		char number[24];
+		sprintf( number, "%06llu", (unsigned long long)frame.mIndex );
+		path = mDirectory / ( mPrefix + number + "." + mExtension );
+	}
+	else {
+		path = mDirectory / frame.mName;
+	}
+
+	// the frame's pixels as a Surface, without a copy; RGBX has writeImage() leave alpha out
+	SurfaceChannelOrder order = frame.mChannels == 3 ? SurfaceChannelOrder::RGB : ( mAlpha ? SurfaceChannelOrder::RGBA : SurfaceChannelOrder::RGBX );
+	try {
+		if( frame.mFormat == RecorderFrame::FLOAT32 )
+			writeImage( path, Surface32f( (float *)&frame.mData[0], frame.mWidth, frame.mHeight, (int32_t)frame.mRowBytes, order ) );
+		else
+			writeImage( path, Surface8u( &frame.mData[0], frame.mWidth, frame.mHeight, (int32_t)frame.mRowBytes, order ) );
+	}
+	catch( ... ) {
+		return false;
+	}
+	return true;
+}
+
+#if ! defined( CINDER_GLES )
+
+WindowReader::WindowReader( size_t numBuffers )
+	: mReads( max( numBuffers, (size_t)1 ) ), mNext( 0 )
+{
+	for( size_t i = 0; i < mReads.size(); ++i ) {
+		Read &read = mReads[i];
+		glGenBuffers( 1, &read.mBuffer );
+		read.mWidth = read.mHeight = 0;
+		read.mTime = 0.0;
+		read.mPending = false;
+	}
+}
+
+WindowReader::~WindowReader()
+{
+	for( size_t i = 0; i < mReads.size(); ++i )
+		glDeleteBuffers( 1, &mReads[i].mBuffer );
+}
+
+void WindowReader::read( FrameRecorder &recorder, int width, int height, double time, const string &name )
+{
+	// the oldest read is the one this call reuses
+	Read &read = mReads[mNext];
+	if( read.mPending )
+		deliver( read, recorder );
+
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, read.mBuffer );
+	if( read.mWidth != width || read.mHeight != height ) {
+		glBufferData( GL_PIXEL_PACK_BUFFER, width * height * 4, 0, GL_STREAM_READ );
+		read.mWidth = width;
+		read.mHeight = height;
+	}
+	glReadPixels( 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0 );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+	read.mTime = time;
+	read.mName = name;
+	read.mPending = true;
+
+	mNext = ( mNext + 1 ) % mReads.size();
+}
+
+void WindowReader::flush( FrameRecorder &recorder )
+{
+	for( size_t i = 0; i < mReads.size(); ++i ) {
+		Read &read = mReads[( mNext + i ) % mReads.size()];
+		if( read.mPending )
+			deliver( read, recorder );
+	}
+}
+
+void WindowReader::deliver( Read &read, FrameRecorder &recorder )
+{
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, read.mBuffer );
+	const void *pixels = glMapBuffer( GL_PIXEL_PACK_BUFFER, GL_READ_ONLY );
+	if( pixels ) {
+		recorder.record( pixels, read.mWidth, read.mHeight, read.mWidth * 4, 4, RecorderFrame::UINT8, true, read.mTime, read.mName );
+		glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+	}
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+	read.mPending = false;
+}
+
+#endif
@@ -0,0 +1,309 @@
+//
+//  FrameRecorder.cpp
+//
+
+#include "FrameRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+	// JFIF's full range BT.601 in 16.16 fixed point
+	const int32_t	Y_R = 19595, Y_G = 38470, Y_B = 7471;
+	const int32_t	CB_R = -11059, CB_G = -21709, CB_B = 32768;
+	const int32_t	CR_R = 32768, CR_G = -27439, CR_B = -5329;
+
+	// one row as 8-bit RGB; uint8 rows with three channels are used as they are
+	const uint8_t* rgbRow( const RecorderFrame &frame, int y, uint8_t *scratch )
+	{
+		const int w = frame.mWidth, n = frame.mChannels;
+		if( frame.mFormat == RecorderFrame::UINT8 ) {
+			const uint8_t *src = frame.getRow( y );
+			if( n == 3 )
+				return src;
+			for( int x = 0; x < w; ++x ) {
+				scratch[x * 3] = src[x * n];
+				scratch[x * 3 + 1] = src[x * n + 1];
+				scratch[x * 3 + 2] = src[x * n + 2];
+			}
+		}
+		else {
+			const float *src = (const float *)frame.getRow( y );
+			for( int x = 0; x < w; ++x )
+				for( int c = 0; c < 3; ++c )
+					scratch[x * 3 + c] = (uint8_t)( min( max( src[x * n + c], 0.0f ), 1.0f ) * 255.0f + 0.5f );
+		}
+		return scratch;
+	}
+}
+
+void RecorderFrame::allocate( int width, int height, int channels, Format format )
+{
+	mWidth = width;
+	mHeight = height;
+	mChannels = channels;
+	mFormat = format;
+	mRowBytes = width * getBytesPerPixel();
+	mData.resize( mRowBytes * height );
+}
+
+RawSink::RawSink( const string &path )
+	: mFile( path.c_str(), ios::binary | ios::trunc )
+{
+}
+
+bool RawSink::write( RecorderFrame &frame )
+{
+	size_t rowBytes = frame.mWidth * frame.getBytesPerPixel();
+	for( int y = 0; y < frame.mHeight; ++y )
+		mFile.write( (const char *)frame.getRow( y ), rowBytes );
+	return mFile.good();
+}
+
+void RawSink::close()
+{
+	mFile.close();
+}
+
+Y4mSink::Y4mSink( const string &path, int frameRate )
+	: mFile( path.c_str(), ios::binary | ios::trunc ), mFrameRate( frameRate ), mWidth( 0 ), mHeight( 0 )
+{
+}
+
+bool Y4mSink::encode( RecorderFrame &frame )
+{
+	const int w = frame.mWidth, h = frame.mHeight;
+	const int cw = ( w + 1 ) / 2, ch = ( h + 1 ) / 2;
+	const size_t planeBytes = (size_t)w * h + 2 * (size_t)cw * ch;
+
+	// the planes, then room for two 8-bit RGB rows
+	frame.mEncoded.resize( planeBytes + 6 * (size_t)w );
+	uint8_t *luma = &frame.mEncoded[0];
+	uint8_t *cb = luma + (size_t)w * h, *cr = cb + (size_t)cw * ch;
+	uint8_t *scratch = &frame.mEncoded[planeBytes];
+
+	for( int y = 0; y < h; y += 2 ) {
+		// an odd last row pairs with itself, as an odd last column does below
+		const uint8_t *r0 = rgbRow( frame, y, scratch );
+		const uint8_t *r1 = y + 1 < h ? rgbRow( frame, y + 1, scratch + 3 * w ) : r0;
+		uint8_t *l0 = luma + (size_t)y * w, *l1 = y + 1 < h ? l0 + w : 0;
+		uint8_t *cbRow = cb + (size_t)( y / 2 ) * cw, *crRow = cr + (size_t)( y / 2 ) * cw;
+
+		for( int x = 0; x < w; ++x ) {
+			const uint8_t *p = r0 + x * 3;
+			l0[x] = (uint8_t)( ( Y_R * p[0] + Y_G * p[1] + Y_B * p[2] + 32768 ) >> 16 );
+		}
+		if( l1 )
+			for( int x = 0; x < w; ++x ) {
+				const uint8_t *p = r1 + x * 3;
+				l1[x] = (uint8_t)( ( Y_R * p[0] + Y_G * p[1] + Y_B * p[2] + 32768 ) >> 16 );
+			}
+
+		// chroma of the 2 x 2 average, with the average's divide folded into the shift
+		for( int x = 0; x < cw; ++x ) {
+			int x0 = x * 6, x1 = min( 2 * x + 1, w - 1 ) * 3;
+			int32_t r = r0[x0] + r0[x1] + r1[x0] + r1[x1];
+			int32_t g = r0[x0 + 1] + r0[x1 + 1] + r1[x0 + 1] + r1[x1 + 1];
+			int32_t b = r0[x0 + 2] + r0[x1 + 2] + r1[x0 + 2] + r1[x1 + 2];
+			cbRow[x] = (uint8_t)min( ( CB_R * r + CB_G * g + CB_B * b + ( 128 << 18 ) + ( 1 << 17 ) ) >> 18, 255 );
+			crRow[x] = (uint8_t)min( ( CR_R * r + CR_G * g + CR_B * b + ( 128 << 18 ) + ( 1 << 17 ) ) >> 18, 255 );
+		}
+	}
+	frame.mEncoded.resize( planeBytes );
+	return true;
+}
+
+bool Y4mSink::write( RecorderFrame &frame )
+{
+	if( mWidth == 0 ) {
+		mWidth = frame.mWidth;
+		mHeight = frame.mHeight;
+		mFile << "YUV4MPEG2 W" << mWidth << " H" << mHeight << " F" << mFrameRate << ":1 Ip A1:1 C420jpeg\n";
+	}
+	else if( frame.mWidth != mWidth || frame.mHeight != mHeight ) {
+		return false;
+	}
+	mFile << "FRAME\n";
+	mFile.write( (const char *)&frame.mEncoded[0], frame.mEncoded.size() );
+	return mFile.good();
+}
+
+void Y4mSink::close()
+{
+	mFile.close();
+}
+
+FrameRecorder::FrameRecorder( const shared_ptr<FrameSink> &sink, size_t numFrames, Policy policy, size_t numThreads )
+	: mSink( sink ), mPolicy( policy ), mNumFrames( max( numFrames, (size_t)1 ) ),
+	mNextIndex( 0 ), mNextWrite( 0 ), mNumBusy( 0 ), mClosed( false ), mQuit( false )
+{
+	if( numThreads == 0 )
+		numThreads = max( thread::hardware_concurrency(), 1u );
+	for( size_t i = 0; i < numThreads; ++i )
+		mWorkers.push_back( thread( &FrameRecorder::run, this ) );
+}
+
+FrameRecorder::~FrameRecorder()
+{
+	finish();
+	{
+		lock_guard<mutex> lock( mMutex );
+		mQuit = true;
+	}
+	mWake.notify_all();
+	for( size_t i = 0; i < mWorkers.size(); ++i )
+		mWorkers[i].join();
+}
+
+RecorderFrame* FrameRecorder::acquire( int width, int height, int channels, RecorderFrame::Format format )
+{
+	RecorderFrame *frame = 0;
+	{
+		unique_lock<mutex> lock( mMutex );
+		while( ! frame ) {
+			if( mClosed ) {
+				++mStats.mDropped;
+				return 0;
+			}
+			if( ! mFree.empty() ) {
+				frame = mFree.back();
+				mFree.pop_back();
+			}
+			else if( mFrames.size() < mNumFrames ) {
+				mFrames.push_back( unique_ptr<RecorderFrame>( new RecorderFrame() ) );
+				frame = mFrames.back().get();
+			}
+			else if( mPolicy == DROP_NEWEST ) {
+				++mStats.mDropped;
+				return 0;
+			}
+			else if( mPolicy == DROP_OLDEST && ! mQueue.empty() ) {
+				frame = mQueue.front();
+				mQueue.pop_front();
+				++mStats.mDropped;
+			}
+			else {
+				// every frame is being written; even DROP_OLDEST has to wait for one
+				mFreed.wait( lock );
+			}
+		}
+	}
+	frame->allocate( width, height, channels, format );
+	return frame;
+}
+
+void FrameRecorder::submit( RecorderFrame *frame )
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		if( mClosed ) {
+			++mStats.mDropped;
+			mFree.push_back( frame );
+			return;
+		}
+		mQueue.push_back( frame );
+		++mStats.mSubmitted;
+		mStats.mPeakQueued = max( mStats.mPeakQueued, mQueue.size() );
+	}
+	mWake.notify_one();
+}
+
+void FrameRecorder::release( RecorderFrame *frame )
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		mFree.push_back( frame );
+	}
+	mFreed.notify_all();
+}
+
+bool FrameRecorder::record( const void *data, int width, int height, ptrdiff_t rowBytes, int channels, RecorderFrame::Format format,
+							bool flipped, double time, const string &name )
+{
+	RecorderFrame *frame = acquire( width, height, channels, format );
+	if( ! frame )
+		return false;
+	const uint8_t *src = (const uint8_t *)data;
+	for( int y = 0; y < height; ++y )
+		memcpy( frame->getRow( flipped ? height - 1 - y : y ), src + y * rowBytes, frame->mRowBytes );
+	frame->mTime = time;
+	frame->mName = name;
+	submit( frame );
+	return true;
+}
+
+void FrameRecorder::flush()
+{
+	unique_lock<mutex> lock( mMutex );
+	while( ! mQueue.empty() || mNumBusy > 0 )
+		mFreed.wait( lock );
+}
+
+void FrameRecorder::finish()
+{
+	flush();
+	{
+		lock_guard<mutex> lock( mMutex );
+		if( mClosed )
+			return;
+		mClosed = true;
+	}
+	mSink->close();
+}
+
+FrameRecorder::Stats FrameRecorder::getStats()
+{
+	lock_guard<mutex> lock( mMutex );
+	return mStats;
+}
+
+void FrameRecorder::run()
+{
+	const bool ordered = mSink->isOrdered();
+	mSink->beginThread();
+	for(;;) {
+		RecorderFrame *frame;
+		{
+			unique_lock<mutex> lock( mMutex );
+			while( mQueue.empty() && ! mQuit )
+				mWake.wait( lock );
+			if( mQueue.empty() )
+				break;
+			frame = mQueue.front();
+			mQueue.pop_front();
+			frame->mIndex = mNextIndex++;
+			++mNumBusy;
+		}
+
+		bool written = mSink->encode( *frame );
+
+		// frames are numbered as they leave the queue, so the one due next is always held by some worker
+		if( ordered ) {
+			unique_lock<mutex> lock( mMutex );
+			while( mNextWrite != frame->mIndex )
+				mWritten.wait( lock );
+		}
+		written = written && mSink->write( *frame );
+
+		{
+			lock_guard<mutex> lock( mMutex );
+			if( written ) {
+				++mStats.mWritten;
+				mStats.mBytes += (uint64_t)frame->mWidth * frame->mHeight * frame->getBytesPerPixel();
+			}
+			else {
+				++mStats.mFailed;
+			}
+			if( ordered )
+				++mNextWrite;
+			mFree.push_back( frame );
+			--mNumBusy;
+		}
+		if( ordered )
+			mWritten.notify_all();
+		mFreed.notify_all();
+	}
+	mSink->endThread();
+}
@@ -3,6 +3,7 @@
 #include "cinder/app/AppBasic.h"
 #include "FMOD.hpp"
 #include "AudioEngine/SoundItem.h"
+#include "AudioEngine/SpatialAudioState.h"
 #include "Events/Events.h"
 
 class AudioDevice;
@@ -30,6 +31,8 @@ class AudioDevice
 		ci::Vec3f	getListenerPos(){
 			return listenerPos;
 		}
+		//! How many frames apart update() asks FMOD whether sounds are still playing.
+		void			setStatusPollInterval(int pFrames){ mSpatial.setStatusPollInterval(pFrames); }
 		SoundItemRef	getSoundItem(SoundItemRef pSoundItem);
 		int				shutDown();
 
@@ -40,7 +43,19 @@ class AudioDevice
         }
 		
     private:
-		void	updateListenerPos();
+		// forwards the batched changes to the channels of mSounds
+		class FmodBackend : public SpatialAudioBackend
+		{
+			public:
+				FmodBackend(AudioDevice* pDevice) : mDevice(pDevice) {}
+				void	setSoundAttributes( size_t pSound, const ci::Vec3f &pPos, const ci::Vec3f &pVel );
+				void	setListenerAttributes( const ci::Vec3f &pPos, const ci::Vec3f &pVel, const ci::Vec3f &pForward, const ci::Vec3f &pUp );
+				void	setPaused( size_t pSound, bool pPaused );
+				bool	isPlaying( size_t pSound );
+			private:
+				AudioDevice*	mDevice;
+		};
+
 		FMOD_VECTOR pos;
 		FMOD_VECTOR vel;
 
@@ -59,6 +74,9 @@ class AudioDevice
 
         FMOD::System*				mSystem;
 		std::vector<SoundItemRef>		mSounds;
+		SpatialAudioState			mSpatial;		// indexed like mSounds
+		FmodBackend					mFmodBackend;
+		std::vector<size_t>			mStoppedSounds;
 		int							mDeviceID;
 		void						createDsp( FMOD_DSP_TYPE type, FMOD::DSP** dsp );
 		float						mSoundLevel;
@@ -0,0 +1,45 @@
+#pragma once
+
+// Keeps the distance between a record cursor and a play cursor on two devices
+// whose clocks disagree close to a target. Each update() takes the measured
+// distance, smooths out the jitter of the record driver's block steps and runs
+// a PI controller on it; the result is the ratio to play back at, which stays
+// within a fraction of a percent of 1 so the correction cannot be heard. The
+// integral term settles on the clock skew itself, after which the proportional
+// term only has to hold the latency in place.
+//
+// Nothing here talks to a device, so two virtual clocks are enough to try it.
+class DriftEstimator
+{
+	public:
+		DriftEstimator();
+
+		//! Starts over at \a pTargetLatency samples, with the cursors assumed to be on target.
+		void	reset( float pTargetLatency, float pSampleRate );
+		void	setTargetLatency( float pTargetLatency ){ mTargetLatency = pTargetLatency; }
+		//! Gains per second of latency error; the defaults give a critically damped loop of about 20 seconds.
+		void	setGains( float pProportional, float pIntegral ){ mProportional = pProportional; mIntegral = pIntegral; }
+		//! Time constant of the latency smoothing, in seconds.
+		void	setSmoothing( float pSeconds ){ mSmoothing = pSeconds; }
+		//! Largest departure of the ratio from 1.
+		void	setMaxCorrection( float pRatio ){ mMaxCorrection = pRatio; }
+
+		//! Feeds the cursor distance measured \a pElapsed samples after the previous one and returns the new ratio.
+		float	update( float pLatency, float pElapsed );
+
+		float	getRatio(){ return mRatio; }
+		float	getSmoothedLatency(){ return mSmoothedLatency; }
+		float	getTargetLatency(){ return mTargetLatency; }
+
+	private:
+		float	mSampleRate;
+		float	mTargetLatency;
+		float	mProportional;
+		float	mIntegral;
+		float	mSmoothing;
+		float	mMaxCorrection;
+
+		float	mSmoothedLatency;
+		float	mErrorIntegral;		// seconds of error times seconds
+		float	mRatio;
+};
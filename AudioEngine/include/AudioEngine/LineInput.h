@@ -2,6 +2,7 @@
 
 #include "cinder/app/AppBasic.h"
 #include "AudioEngine/AudioDevice.h"
+#include "AudioEngine/DriftEstimator.h"
 
 #include "FMOD.hpp"
 
@@ -29,7 +30,21 @@ class LineInput
 		float	getVolume(){return mSoundLevel;}
 
     private:
-        FMOD::Channel*				mChannelSound;
+		// the record and each playback device run on their own clocks, so every
+		// playback channel is steered separately
+		struct PlaybackChannel
+		{
+			PlaybackChannel() : channel( 0 ) {}
+			FMOD::Channel*	channel;
+			DriftEstimator	drift;
+		};
+
+		void	startPlayback();
+
+		std::map<int, PlaybackChannel>			mPlaybackChannels;
+		bool									mPlaying;
+		unsigned int							mSamplesRecorded;
+		unsigned int							mMinRecordDelta;
 		FMOD_CREATESOUNDEXINFO		exinfo;
 		unsigned int				adjustedlatency;
 		unsigned int				datalength, soundlength;
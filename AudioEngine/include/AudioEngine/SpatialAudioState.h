@@ -0,0 +1,85 @@
+#pragma once
+
+#include "cinder/Vector.h"
+
+#include <cstdint>
+#include <vector>
+
+// What SpatialAudioState needs from the audio system, addressed by sound index.
+// AudioDevice forwards these to its FMOD channels; RecordingBackend only counts
+// them, so the batching can be exercised without FMOD or a sound card.
+class SpatialAudioBackend
+{
+	public:
+		virtual ~SpatialAudioBackend() {}
+		virtual void	setSoundAttributes( size_t pSound, const ci::Vec3f &pPos, const ci::Vec3f &pVel ) = 0;
+		virtual void	setListenerAttributes( const ci::Vec3f &pPos, const ci::Vec3f &pVel, const ci::Vec3f &pForward, const ci::Vec3f &pUp ) = 0;
+		virtual void	setPaused( size_t pSound, bool pPaused ) = 0;
+		virtual bool	isPlaying( size_t pSound ) = 0;
+};
+
+// Listener and sound transforms of one playback device, kept as arrays with a
+// dirty flag per sound. Setting a value that did not change costs nothing;
+// update() pushes only what changed since the last frame, the listener at most
+// once, and asks the backend whether sounds are still playing only every
+// getStatusPollInterval() frames.
+class SpatialAudioState
+{
+	public:
+		class RecordingBackend : public SpatialAudioBackend
+		{
+			public:
+				RecordingBackend() : numSoundAttributes( 0 ), numListenerAttributes( 0 ), numSetPaused( 0 ), numIsPlaying( 0 ) {}
+
+				void	setSoundAttributes( size_t pSound, const ci::Vec3f &pPos, const ci::Vec3f &pVel ) { numSoundAttributes++; }
+				void	setListenerAttributes( const ci::Vec3f &pPos, const ci::Vec3f &pVel, const ci::Vec3f &pForward, const ci::Vec3f &pUp ) { numListenerAttributes++; }
+				void	setPaused( size_t pSound, bool pPaused ) { numSetPaused++; }
+				bool	isPlaying( size_t pSound ) { numIsPlaying++; return pSound < playing.size() && playing[pSound]; }
+
+				std::vector<bool>	playing;
+				int					numSoundAttributes;
+				int					numListenerAttributes;
+				int					numSetPaused;
+				int					numIsPlaying;
+		};
+
+		SpatialAudioState();
+
+		void		setBackend( SpatialAudioBackend *pBackend ){ mBackend = pBackend; }
+		//! Polls playback status every \a pFrames calls to update(); 1 polls every frame.
+		void		setStatusPollInterval( int pFrames );
+		int			getStatusPollInterval(){ return mStatusPollInterval; }
+
+		//! Adds a sound at the origin and returns its index.
+		size_t		addSound();
+		size_t		getNumSounds(){ return mPlaying.size(); }
+		void		setSoundAttributes( size_t pSound, const ci::Vec3f &pPos, const ci::Vec3f &pVel );
+		ci::Vec3f	getSoundPos( size_t pSound ){ return ci::Vec3f( mPosX[pSound], mPosY[pSound], mPosZ[pSound] ); }
+		//! A channel was just started paused for \a pSound; the next update() places and unpauses it.
+		void		startSound( size_t pSound );
+		bool		isPlaying( size_t pSound ){ return mPlaying[pSound] != 0; }
+
+		void		setListener( const ci::Vec3f &pPos, const ci::Vec3f &pForward );
+
+		//! Pushes the changes to the backend and appends the sounds that stopped playing to \a pStopped.
+		void		update( std::vector<size_t> *pStopped );
+
+	private:
+		SpatialAudioBackend*	mBackend;
+		int						mStatusPollInterval;
+		int						mFrame;
+
+		// per sound
+		std::vector<float>		mPosX, mPosY, mPosZ;
+		std::vector<float>		mVelX, mVelY, mVelZ;
+		std::vector<uint8_t>	mDirty;
+		std::vector<uint8_t>	mStarting;
+		std::vector<uint8_t>	mPlaying;
+		std::vector<size_t>		mDirtyList;		// indices with mDirty set, so update() does not scan every sound
+
+		ci::Vec3f				mListenerPos;
+		ci::Vec3f				mListenerVel;
+		ci::Vec3f				mListenerForward;
+		bool					mListenerDirty;
+		bool					mHasListener;
+};
@@ -7,8 +7,9 @@ using namespace std;
 const float DISTANCEFACTOR = 1.0f;          // Units per meter.  I.e feet would = 3.28.  centimeters would = 100.
 
 
-AudioDevice::AudioDevice(int pDeviceID){
+AudioDevice::AudioDevice(int pDeviceID) : mFmodBackend(this) {
 	mDeviceID = pDeviceID;
+	mSpatial.setBackend(&mFmodBackend);
 	console()<<"AudioDevice::AudioDevice(int pDeviceID)" << pDeviceID << endl;
 	//setListenerPos(Vec3f(0,0,0),Vec3f(0,1,0));
 }
@@ -28,6 +29,13 @@ int AudioDevice::setup()
 	console() <<"mDeviceID " << mDeviceID << " output type " << type << endl;
 	if(mDeviceID != -1)
 		mSystem->setDriver(mDeviceID);
+	// LineInput nudges its playback rate by fractions of a percent to follow the record clock;
+	// the default linear resampler turns that into audible aliasing, the spline one does not
+	int samplerate, numoutputchannels, maxinputchannels, bits;
+	FMOD_SOUND_FORMAT format;
+	FMOD_DSP_RESAMPLER resampler;
+	if ( mSystem->getSoftwareFormat(&samplerate, &format, &numoutputchannels, &maxinputchannels, &resampler, &bits) == FMOD_OK )
+		mSystem->setSoftwareFormat(samplerate, format, numoutputchannels, maxinputchannels, FMOD_DSP_RESAMPLER_SPLINE);
 	if ( mSystem->init( 32, FMOD_INIT_NORMAL, 0 ) != FMOD_OK ) {
 		console() << "Unable to initialize system. deviceid " << mDeviceID << endl;
 		return -1;
@@ -44,22 +52,13 @@ int AudioDevice::playSound(SoundItemRef pSoundItem ){
 			break;
 		}
 	}
-	FMOD_VECTOR  sPos;
-	sPos.x = mSounds[soundindex]->soundPos().x;
-	sPos.y = mSounds[soundindex]->soundPos().y;
-	sPos.z = mSounds[soundindex]->soundPos().z;
-	FMOD_VECTOR  sVel;
-	sVel.x = mSounds[soundindex]->soundVel.x;
-	sVel.y = mSounds[soundindex]->soundVel.y;
-	sVel.z = mSounds[soundindex]->soundVel.z;
-	mSounds[soundindex]->channel->set3DAttributes(&sPos,&sVel);
-	FMOD::Channel         *channel = 0;
 	int result = mSystem->playSound(FMOD_CHANNEL_FREE, mSounds[soundindex]->sound, true, &mSounds[soundindex]->channel);
 	//ERRCHECK((FMOD_RESULT)result);
 	//console()<<"playSound id " << mSounds[soundindex].id << " result " << result << endl;
 	if(result == 0){
 		mSounds[soundindex]->playing = true;
-		
+		// the channel starts paused; the next update() places it and lets it go
+		mSpatial.startSound(soundindex);
 	}
 	return result;
 
@@ -86,31 +85,36 @@ void AudioDevice::setSoundPos(std::string soundID, Vec3f pPos){
 		}
 	}
 }
-void AudioDevice::updateListenerPos(){
-
-	listenerVel = listenerPos - lastListenerPos;
-	lastListenerPos = listenerPos;
-
-	FMOD_VECTOR  lPos;
-	FMOD_VECTOR	 lVel;
-
-	lPos.x = listenerPos.x;
-	lPos.y = listenerPos.y;
-	lPos.z = listenerPos.z;
-
-	lVel.x = listenerVel.x;
-	lVel.y = listenerVel.y;
-	lVel.z = listenerVel.z;
-
-	
-	FMOD_VECTOR forward;
-	forward.x = forwardVec.x;
-	forward.y = forwardVec.y;
-	forward.z = forwardVec.z;
-	
-    FMOD_VECTOR up             = { 0.0f, 1.0f, 0.0f };
-
-	mSystem->set3DListenerAttributes(0, &lPos, &lVel, &forward, &up); 
+void AudioDevice::FmodBackend::setSoundAttributes( size_t pSound, const ci::Vec3f &pPos, const ci::Vec3f &pVel )
+{
+	FMOD::Channel* channel = mDevice->mSounds[pSound]->channel;
+	if(channel){
+		FMOD_VECTOR sPos = { pPos.x, pPos.y, pPos.z };
+		FMOD_VECTOR sVel = { pVel.x, pVel.y, pVel.z };
+		channel->set3DAttributes(&sPos,&sVel);
+	}
+}
+void AudioDevice::FmodBackend::setListenerAttributes( const ci::Vec3f &pPos, const ci::Vec3f &pVel, const ci::Vec3f &pForward, const ci::Vec3f &pUp )
+{
+	FMOD_VECTOR lPos = { pPos.x, pPos.y, pPos.z };
+	FMOD_VECTOR lVel = { pVel.x, pVel.y, pVel.z };
+	FMOD_VECTOR forward = { pForward.x, pForward.y, pForward.z };
+	FMOD_VECTOR up = { pUp.x, pUp.y, pUp.z };
+	mDevice->mSystem->set3DListenerAttributes(0, &lPos, &lVel, &forward, &up);
+}
+void AudioDevice::FmodBackend::setPaused( size_t pSound, bool pPaused )
+{
+	FMOD::Channel* channel = mDevice->mSounds[pSound]->channel;
+	if(channel)
+		channel->setPaused(pPaused);
+}
+bool AudioDevice::FmodBackend::isPlaying( size_t pSound )
+{
+	FMOD::Channel* channel = mDevice->mSounds[pSound]->channel;
+	bool playing = false;
+	if(channel)
+		channel->isPlaying(&playing);
+	return playing;
 }
 void AudioDevice::setListenerPos(ci::Vec3f pPos, ci::Vec3f pLookAt)
 { 
@@ -119,12 +123,13 @@ void AudioDevice::setListenerPos(ci::Vec3f pPos, ci::Vec3f pLookAt)
 	listenerPos = pPos;
 	listenerVel = listenerPos - lastListenerPos;
 	forwardVec = (listenerLookAt - listenerPos).normalized(); 
-	
+	mSpatial.setListener(listenerPos, forwardVec);
 }
 int AudioDevice::createSound(SoundItemRef pSoundItem){
 	SoundItemRef sound = SoundItem::create();
 	mSounds.push_back(sound);
 	SoundItemRef snd = mSounds[mSounds.size()-1];
+	mSpatial.addSound();
 	mSounds[mSounds.size()-1]->filename = pSoundItem->filename;
 	mSounds[mSounds.size()-1]->id = pSoundItem->id;
 	mSounds[mSounds.size()-1]->sound = 0;
@@ -154,38 +159,21 @@ int AudioDevice::shutDown()
 }
 void AudioDevice::update()
 {
+	// soundPos can be animated, so pick up whatever it is now; only changes reach FMOD
 	for ( int i = 0; i< mSounds.size(); i++ ){
-		bool prevPlay = mSounds[i]->playing;
-		int result = mSounds[i]->channel->isPlaying(&mSounds[i]->playing);
-		//update position of sound
-		//if(mSounds[i]->channel){
-			//source is fixed so velocity is zero
-			FMOD_VECTOR  sPos;
-			sPos.x = mSounds[i]->soundPos().x;
-			sPos.y = mSounds[i]->soundPos().y;
-			sPos.z = mSounds[i]->soundPos().z;
-			FMOD_VECTOR  sVel;
-			sVel.x = mSounds[i]->soundVel.x;
-			sVel.y = mSounds[i]->soundVel.y;
-			sVel.z = mSounds[i]->soundVel.z;
-			mSounds[i]->channel->set3DAttributes(&sPos,&sVel);
-			mSounds[i]->channel->setPaused(false);
-			updateListenerPos();
-		//}
-		if(prevPlay != mSounds[i]->playing){
-			if(mSounds[i]->playing == false){
-				AudioEngineEvent event;
-				event.sigType = SOUND_STOPPED_PLAYING;
-				event.soundID = mSounds[i]->id;
-				event.deviceID = mDeviceID;
-				mAudioEngineEventCallbackMgr.call( event );
-			}
-			else {
-				mSounds[i]->channel->setPaused(false);
-			}
-		}
-		
+		mSpatial.setSoundAttributes(i, mSounds[i]->soundPos(), mSounds[i]->soundVel);
+	}
+
+	mStoppedSounds.clear();
+	mSpatial.update(&mStoppedSounds);
+	for ( size_t i = 0; i < mStoppedSounds.size(); i++ ){
+		SoundItemRef snd = mSounds[mStoppedSounds[i]];
+		snd->playing = false;
+		AudioEngineEvent event;
+		event.sigType = SOUND_STOPPED_PLAYING;
+		event.soundID = snd->id;
+		event.deviceID = mDeviceID;
+		mAudioEngineEventCallbackMgr.call( event );
 	}
 	mSystem->update();
 }
- 
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "AudioEngine/DriftEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+DriftEstimator::DriftEstimator()
+	: mSampleRate( 44100.f ), mTargetLatency( 0.f ), mProportional( 0.1f ), mIntegral( 0.0025f ), mSmoothing( 1.f ), mMaxCorrection( 0.005f ),
+	mSmoothedLatency( 0.f ), mErrorIntegral( 0.f ), mRatio( 1.f )
+{
+}
+
+void DriftEstimator::reset( float pTargetLatency, float pSampleRate )
+{
+	mTargetLatency = pTargetLatency;
+	mSampleRate = pSampleRate;
+	mSmoothedLatency = pTargetLatency;
+	mErrorIntegral = 0.f;
+	mRatio = 1.f;
+}
+
+float DriftEstimator::update( float pLatency, float pElapsed )
+{
+	if( pElapsed <= 0.f )
+		return mRatio;
+
+	float dt = pElapsed / mSampleRate;
+	mSmoothedLatency += ( pLatency - mSmoothedLatency ) * ( 1.f - expf( -dt / mSmoothing ) );
+
+	// positive when playback lags too far behind and has to speed up
+	float error = ( mSmoothedLatency - mTargetLatency ) / mSampleRate;
+
+	// the integral alone may not ask for more than the limit, or it would wind up while saturated
+	if( mIntegral > 0.f ){
+		float limit = mMaxCorrection / mIntegral;
+		mErrorIntegral = min( max( mErrorIntegral + error * dt, -limit ), limit );
+	}
+
+	float correction = mProportional * error + mIntegral * mErrorIntegral;
+	mRatio = 1.f + min( max( correction, -mMaxCorrection ), mMaxCorrection );
+	return mRatio;
+}
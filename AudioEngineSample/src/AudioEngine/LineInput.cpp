@@ -9,10 +9,8 @@ using namespace std;
 
 #ifdef LOWLATENCY
     #define LATENCY         ((RECORDRATE * 20) / 1000)   /* 20 = 20ms */
-    #define DRIFTTHRESHOLD  ((RECORDRATE * 10) / 1000)   /* 10 = 10ms */
 #else
     #define LATENCY         ((RECORDRATE * 50) / 1000)   /* 50 = 50ms */
-    #define DRIFTTHRESHOLD  ((RECORDRATE * 25) / 1000)   /* 25 = 25ms */
 #endif
 
 LineInput::LineInput(AudioDeviceRef pDevice){
@@ -28,6 +26,9 @@ int LineInput::setup()
 	mSoundSpeed = 1.f;
 	lastrecordpos = 0.f;
 	mLastRecording = 0;
+	mPlaying = false;
+	mSamplesRecorded = 0;
+	mMinRecordDelta = (unsigned int)-1;
 	return 0;
 }
 int	LineInput::addDevicePlayback(AudioDeviceRef pDevice)
@@ -46,7 +47,7 @@ int	LineInput::addDevicePlayback(AudioDeviceRef pDevice)
     exinfo.defaultfrequency = RECORDRATE;
     exinfo.length           = exinfo.defaultfrequency * sizeof(short) * exinfo.numchannels * 5; /* 5 second buffer, doesnt really matter how big this is, but not too small of course. */
     
-   mChannelSound			= 0;
+   mPlaybackChannels[pDevice->getDeviceID()] = PlaybackChannel();
    if ( pDevice->getSystem()->createSound(0, FMOD_2D | FMOD_SOFTWARE | FMOD_LOOP_NORMAL | FMOD_OPENUSER, &exinfo, &mSoundBufferMap[pDevice->getDeviceID()]) != FMOD_OK ) {
 		console() << "Unable to load sound" << endl;
 		return 1;
@@ -58,6 +59,15 @@ int	LineInput::addDevicePlayback(AudioDeviceRef pDevice)
 void	LineInput::setDeviceRecording(AudioDeviceRef pDevice){
 	mRecordDevice = pDevice;
 }
+void LineInput::startPlayback()
+{
+	for(auto playbackdevice : mPlayBackDeviceMap){
+		PlaybackChannel &playback = mPlaybackChannels[playbackdevice.first];
+		playbackdevice.second->getSystem()->playSound(FMOD_CHANNEL_FREE, mSoundBufferMap[playbackdevice.first], 0, &playback.channel);
+		playback.drift.reset((float)adjustedlatency, (float)RECORDRATE);
+	}
+	mPlaying = true;
+}
 void LineInput::update()
 {
 	auto mSystem = mRecordDevice->getSystem();
@@ -67,75 +77,61 @@ void LineInput::update()
 			mRecordDevice->getSystem()->recordStart(mRecordDevice->getDeviceID(), buf.second, true);
 		}
 	}
-	unsigned int samplesrecorded = 0;
 	unsigned int recordpos = 0, recorddelta;
 	mSystem->getRecordPosition(mRecordDevice->getDeviceID(), &recordpos);   
 
-	recorddelta = recordpos >= lastrecordpos ? recordpos - lastrecordpos : recordpos + recordLength - lastrecordpos;
-	samplesrecorded += recorddelta;
-	if (samplesrecorded >= adjustedlatency && !mChannelSound)
-	{
-		for(auto playbackdevice : mPlayBackDeviceMap){
-			auto mSys = playbackdevice.second->getSystem();
-			FMOD_RESULT result = mSys->playSound(FMOD_CHANNEL_FREE, mSoundBufferMap[playbackdevice.first], 0, &mChannelSound);
-		}
-	}
+	recorddelta = recordpos >= lastrecordpos ? recordpos - lastrecordpos : recordpos + soundlength - lastrecordpos;
+	mSamplesRecorded += recorddelta;
+	if (mSamplesRecorded >= adjustedlatency && !mPlaying)
+		startPlayback();
 
-	if (mChannelSound && recorddelta)
+	if (mPlaying && recorddelta)
 	{
-		unsigned int playrecorddelta;
-		unsigned int playpos = 0;
-		int adjusting = 0;
-		float smootheddelta;
-		float dampratio = 0.97f;
-		static unsigned int minrecorddelta = (unsigned int)-1;
-            
 		/*
 			If the record driver steps the position of the record cursor in larger increments than the user defined latency value, then we should
 			increase our latency value to match.
 		*/
-		if (recorddelta < minrecorddelta)
+		if (recorddelta < mMinRecordDelta)
 		{
-			minrecorddelta = recorddelta;
+			mMinRecordDelta = recorddelta;
 			if (adjustedlatency < recorddelta)
 			{
 				adjustedlatency = recorddelta;
 			}
 		}
 
-		mChannelSound->getPosition(&playpos, FMOD_TIMEUNIT_PCM);
-		playrecorddelta = recordpos >= playpos ? recordpos - playpos : recordpos + soundlength - playpos;
-            
-		/*
-			Smooth total
-		*/
-		{
-			static float total = 0;
-                
-			total = total * dampratio;
-			total += playrecorddelta;
-			smootheddelta = total * (1.0f - dampratio);
-		}
-           
-		if (smootheddelta < adjustedlatency - DRIFTTHRESHOLD || playrecorddelta > soundlength / 2)   /* if play cursor is catching up to record (or passed it), slow playback down */
-		{
-			mChannelSound->setFrequency(RECORDRATE - (RECORDRATE / 50)); /* Decrease speed by 2% */
-			adjusting = 1;
-			//console()<<"adjusting speed down " << endl;
-		}
-		else if (playrecorddelta > adjustedlatency + DRIFTTHRESHOLD)   /* if play cursor is falling too far behind record, speed playback up */
-		{
-			mChannelSound->setFrequency(RECORDRATE + (RECORDRATE / 50)); /* Increase speed by 2% */
-			adjusting = 2;
-			//console()<<"adjusting speed up " << endl;
-		}
-		else
-		{
-			mChannelSound->setFrequency(RECORDRATE);          /* Otherwise set to normal rate */
-			adjusting = 0;
+		for(auto &entry : mPlaybackChannels){
+			PlaybackChannel &playback = entry.second;
+			if (!playback.channel)
+				continue;
+
+			unsigned int playrecorddelta;
+			unsigned int playpos = 0;
+			playback.channel->getPosition(&playpos, FMOD_TIMEUNIT_PCM);
+			playrecorddelta = recordpos >= playpos ? recordpos - playpos : recordpos + soundlength - playpos;
+
+			/*
+				A play cursor that passed the record cursor reads as almost a whole buffer behind; no rate change
+				small enough to be inaudible gets out of that, so jump back to the target and start steering over.
+			*/
+			if (playrecorddelta > soundlength / 2)
+			{
+				playback.channel->setPosition((recordpos + soundlength - adjustedlatency) % soundlength, FMOD_TIMEUNIT_PCM);
+				playback.drift.reset((float)adjustedlatency, (float)RECORDRATE);
+				playback.channel->setFrequency(RECORDRATE);
+				continue;
+			}
+
+			/*
+				The estimator settles on the clock skew between the devices and plays back that much faster or
+				slower, by a fraction of a percent, instead of jumping 2% either side of a threshold.
+			*/
+			playback.drift.setTargetLatency((float)adjustedlatency);
+			float ratio = playback.drift.update((float)playrecorddelta, (float)recorddelta);
+			playback.channel->setFrequency(RECORDRATE * ratio);
+
+			//console()<<"REC "<<recordpos<<" (REC delta " << recorddelta<<") : PLAY "<<playpos<< ", PLAY/REC diff "<< (int)playback.drift.getSmoothedLatency() << " ratio " << ratio << endl;
 		}
-       
-		//console()<<"REC "<<recordpos<<" (REC delta " << recorddelta<<") : PLAY "<<playpos<< ", PLAY/REC diff "<< (int)smootheddelta << " adjusting " << adjusting << endl;
 	}
 	lastrecordpos = recordpos;
 	// Sample playback
@@ -0,0 +1,109 @@
+#include "AudioEngine/SpatialAudioState.h"
+
+#include <algorithm>
+
+using namespace ci;
+using namespace std;
+
+SpatialAudioState::SpatialAudioState()
+	: mBackend( 0 ), mStatusPollInterval( 6 ), mFrame( 0 ), mListenerDirty( false ), mHasListener( false )
+{
+}
+
+void SpatialAudioState::setStatusPollInterval( int pFrames )
+{
+	mStatusPollInterval = max( pFrames, 1 );
+}
+
+size_t SpatialAudioState::addSound()
+{
+	mPosX.push_back( 0.f );
+	mPosY.push_back( 0.f );
+	mPosZ.push_back( 0.f );
+	mVelX.push_back( 0.f );
+	mVelY.push_back( 0.f );
+	mVelZ.push_back( 0.f );
+	mDirty.push_back( 0 );
+	mStarting.push_back( 0 );
+	mPlaying.push_back( 0 );
+	return mPlaying.size() - 1;
+}
+
+void SpatialAudioState::setSoundAttributes( size_t pSound, const Vec3f &pPos, const Vec3f &pVel )
+{
+	if( mPosX[pSound] == pPos.x && mPosY[pSound] == pPos.y && mPosZ[pSound] == pPos.z
+		&& mVelX[pSound] == pVel.x && mVelY[pSound] == pVel.y && mVelZ[pSound] == pVel.z )
+		return;
+
+	mPosX[pSound] = pPos.x;
+	mPosY[pSound] = pPos.y;
+	mPosZ[pSound] = pPos.z;
+	mVelX[pSound] = pVel.x;
+	mVelY[pSound] = pVel.y;
+	mVelZ[pSound] = pVel.z;
+	if( ! mDirty[pSound] ){
+		mDirty[pSound] = 1;
+		mDirtyList.push_back( pSound );
+	}
+}
+
+void SpatialAudioState::startSound( size_t pSound )
+{
+	mStarting[pSound] = 1;
+	mPlaying[pSound] = 1;
+	// a new channel knows nothing of where the sound is
+	if( ! mDirty[pSound] ){
+		mDirty[pSound] = 1;
+		mDirtyList.push_back( pSound );
+	}
+}
+
+void SpatialAudioState::setListener( const Vec3f &pPos, const Vec3f &pForward )
+{
+	Vec3f vel = mHasListener ? pPos - mListenerPos : Vec3f::zero();
+	if( mHasListener && pPos == mListenerPos && vel == mListenerVel && pForward == mListenerForward )
+		return;
+
+	mListenerPos = pPos;
+	mListenerVel = vel;
+	mListenerForward = pForward;
+	mListenerDirty = true;
+	mHasListener = true;
+}
+
+void SpatialAudioState::update( vector<size_t> *pStopped )
+{
+	if( ! mBackend )
+		return;
+
+	if( mListenerDirty ){
+		mBackend->setListenerAttributes( mListenerPos, mListenerVel, mListenerForward, Vec3f( 0.f, 1.f, 0.f ) );
+		mListenerDirty = false;
+	}
+
+	// sounds that are not playing have no channel to move; startSound() dirties them again
+	for( size_t i = 0; i < mDirtyList.size(); i++ ){
+		size_t snd = mDirtyList[i];
+		if( mPlaying[snd] ){
+			mBackend->setSoundAttributes( snd, Vec3f( mPosX[snd], mPosY[snd], mPosZ[snd] ), Vec3f( mVelX[snd], mVelY[snd], mVelZ[snd] ) );
+			if( mStarting[snd] ){
+				mBackend->setPaused( snd, false );
+				mStarting[snd] = 0;
+			}
+		}
+		mDirty[snd] = 0;
+	}
+	mDirtyList.clear();
+
+	if( ++mFrame < mStatusPollInterval )
+		return;
+	mFrame = 0;
+
+	for( size_t snd = 0; snd < mPlaying.size(); snd++ ){
+		if( mPlaying[snd] && ! mBackend->isPlaying( snd ) ){
+			mPlaying[snd] = 0;
+			if( pStopped )
+				pStopped->push_back( snd );
+		}
+	}
+}
@@ -0,0 +1,53 @@
+//
+//  AnalyzerNode.h
+//
+//  Feeds whatever flows into it to an AudioAnalyzer, mixed down to mono.
+//  Auto-pulled like audio::MonitorNode, so it doesn't need an output.
+//
+
+#pragma once
+
+#include "cinder/audio/Node.h"
+#include "AudioAnalyzer.h"
+
+typedef std::shared_ptr<class AnalyzerNode> AnalyzerNodeRef;
+
+class AnalyzerNode : public ci::audio::NodeAutoPullable {
+  public:
+	AnalyzerNode( const AudioAnalyzerRef &analyzer, const Format &format = Format() )
+		: NodeAutoPullable( format ), mAnalyzer( analyzer )
+	{}
+
+	const AudioAnalyzerRef&	getAnalyzer() const	{ return mAnalyzer; }
+
+  protected:
+	void initialize() override
+	{
+		mMono.resize( getFramesPerBlock() );
+	}
+
+	// runs on the audio thread: no locks, no allocation
+	void process( ci::audio::Buffer *buffer ) override
+	{
+		size_t numFrames	= buffer->getNumFrames();
+		size_t numChannels	= buffer->getNumChannels();
+		if( numChannels == 1 || mMono.size() < numFrames ) {
+			mAnalyzer->write( buffer->getChannel( 0 ), numFrames );
+			return;
+		}
+
+		float scale = 1.0f / (float)numChannels;
+		const float *first = buffer->getChannel( 0 );
+		for( size_t i = 0; i < numFrames; i++ )
+			mMono[i] = first[i] * scale;
+		for( size_t ch = 1; ch < numChannels; ch++ ) {
+			const float *channel = buffer->getChannel( ch );
+			for( size_t i = 0; i < numFrames; i++ )
+				mMono[i] += channel[i] * scale;
+		}
+		mAnalyzer->write( &mMono[0], numFrames );
+	}
+
+	AudioAnalyzerRef	mAnalyzer;
+	std::vector<float>	mMono;
+};
@@ -0,0 +1,360 @@
+//
+//  AudioAnalyzer.cpp
+//
+
+#include "AudioAnalyzer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+const float kPi = 3.14159265358979f;
+
+size_t nextPowerOfTwo( size_t n )
+{
+	size_t p = 1;
+	while( p < n )
+		p <<= 1;
+	return p;
+}
+
+float hzToMel( float hz )	{ return 2595.0f * log10f( 1.0f + hz / 700.0f ); }
+float melToHz( float mel )	{ return 700.0f * ( powf( 10.0f, mel / 2595.0f ) - 1.0f ); }
+
+// same as audio::linearToDecibel(), so the spectrum can be swapped in directly
+float linearToDecibel( float gain )
+{
+	return gain < 1e-5f ? 0.0f : 20.0f * log10f( gain ) + 100.0f;
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - PcmRing
+// ----------------------------------------------------------------------------------------------------
+
+PcmRing::PcmRing( size_t capacity )
+	: mMask( 0 ), mWritePos( 0 ), mReadPos( 0 ), mNumDropped( 0 )
+{
+	setCapacity( capacity );
+}
+
+void PcmRing::setCapacity( size_t capacity )
+{
+	mBuffer.assign( capacity ? nextPowerOfTwo( capacity ) : 0, 0.0f );
+	mMask = mBuffer.empty() ? 0 : mBuffer.size() - 1;
+	mWritePos	= 0;
+	mReadPos	= 0;
+	mNumDropped	= 0;
+}
+
+size_t PcmRing::write( const float *samples, size_t count )
+{
+	uint64_t w = mWritePos.load( memory_order_relaxed );
+	uint64_t r = mReadPos.load( memory_order_acquire );
+	size_t n = min( count, mBuffer.size() - (size_t)( w - r ) );
+	if( n < count )
+		mNumDropped.fetch_add( count - n, memory_order_relaxed );
+
+	size_t start = (size_t)w & mMask;
+	size_t first = min( n, mBuffer.size() - start );
+	memcpy( &mBuffer[start], samples, first * sizeof( float ) );
+	if( n > first )
+		memcpy( &mBuffer[0], samples + first, ( n - first ) * sizeof( float ) );
+
+	mWritePos.store( w + n, memory_order_release );
+	return n;
+}
+
+size_t PcmRing::getNumAvailable() const
+{
+	return (size_t)( mWritePos.load( memory_order_acquire ) - mReadPos.load( memory_order_relaxed ) );
+}
+
+size_t PcmRing::read( float *samples, size_t count )
+{
+	uint64_t r = mReadPos.load( memory_order_relaxed );
+	uint64_t w = mWritePos.load( memory_order_acquire );
+	size_t n = min( count, (size_t)( w - r ) );
+
+	size_t start = (size_t)r & mMask;
+	size_t first = min( n, mBuffer.size() - start );
+	memcpy( samples, &mBuffer[start], first * sizeof( float ) );
+	if( n > first )
+		memcpy( samples + first, &mBuffer[0], ( n - first ) * sizeof( float ) );
+
+	mReadPos.store( r + n, memory_order_release );
+	return n;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - AudioAnalyzer
+// ----------------------------------------------------------------------------------------------------
+
+AudioAnalyzer::AudioAnalyzer( const Format &format )
+	: mFormat( format ), mIsRunning( false ), mFluxIndex( 0 ), mHop( 0 ), mBack( 0 ), mFront( 1 ), mMiddle( 2 )
+{
+	mFormat.mFftSize = max<size_t>( nextPowerOfTwo( mFormat.mFftSize ), 4 );
+	if( mFormat.mWindowSize == 0 || mFormat.mWindowSize > mFormat.mFftSize )
+		mFormat.mWindowSize = mFormat.mFftSize;
+	if( mFormat.mHopSize == 0 || mFormat.mHopSize > mFormat.mWindowSize )
+		mFormat.mHopSize = max<size_t>( mFormat.mWindowSize / 2, 1 );
+	mFormat.mOnsetHistory = max<size_t>( mFormat.mOnsetHistory, 1 );
+
+	const size_t n			= mFormat.mFftSize;
+	const size_t m			= n / 2;
+	const size_t window		= mFormat.mWindowSize;
+
+	mRing.setCapacity( max( (size_t)( mFormat.mSampleRate * mFormat.mRingSeconds ), window * 4 ) );
+
+	mWindow.assign( window, 0.0f );
+	mWindowCoeffs.resize( window );
+	for( size_t i = 0; i < window; i++ ) {
+		float x = window > 1 ? (float)i / (float)( window - 1 ) : 0.0f;
+		mWindowCoeffs[i] = 0.42f - 0.5f * cosf( 2.0f * kPi * x ) + 0.08f * cosf( 4.0f * kPi * x );
+	}
+
+	// complex FFT of m points over the even / odd samples, then a post-pass to the real spectrum
+	mReal.resize( m );
+	mImag.resize( m );
+	mCos.resize( m / 2 );
+	mSin.resize( m / 2 );
+	for( size_t k = 0; k < m / 2; k++ ) {
+		mCos[k] = cosf( 2.0f * kPi * k / (float)m );
+		mSin[k] = -sinf( 2.0f * kPi * k / (float)m );
+	}
+	mPostCos.resize( m );
+	mPostSin.resize( m );
+	for( size_t k = 0; k < m; k++ ) {
+		mPostCos[k] = cosf( 2.0f * kPi * k / (float)n );
+		mPostSin[k] = sinf( 2.0f * kPi * k / (float)n );
+	}
+
+	int bits = 0;
+	while( ( (size_t)1 << bits ) < m )
+		bits++;
+	mBitReverse.resize( m );
+	for( size_t i = 0; i < m; i++ ) {
+		uint32_t r = 0;
+		for( int b = 0; b < bits; b++ )
+			r |= ( ( i >> b ) & 1 ) << ( bits - 1 - b );
+		mBitReverse[i] = r;
+	}
+
+	mMag.assign( m, 0.0f );
+	mPrevMag.assign( m, 0.0f );
+	mSmoothedMag.assign( m, 0.0f );
+	mFluxHistory.assign( mFormat.mOnsetHistory, 0.0f );
+
+	setupMelBands();
+
+	for( int i = 0; i < 3; i++ ) {
+		AudioFeatures &slot = mSlots[i];
+		slot.mHop				= 0;
+		slot.mTime				= 0.0;
+		slot.mMagSpectrum.assign( m, 0.0f );
+		slot.mDecibelSpectrum.assign( m, 0.0f );
+		slot.mMelBands.assign( mFormat.mNumMelBands, 0.0f );
+		slot.mPeakMagnitude		= 0.0f;
+		slot.mRms				= 0.0f;
+		slot.mFlux				= 0.0f;
+		slot.mIsOnset			= false;
+	}
+}
+
+AudioAnalyzer::~AudioAnalyzer()
+{
+	stop();
+}
+
+void AudioAnalyzer::setupMelBands()
+{
+	const size_t numBins	= getNumBins();
+	const size_t numBands	= mFormat.mNumMelBands;
+	const float nyquist		= mFormat.mSampleRate * 0.5f;
+
+	// band b rises from edge b to b + 1 and falls back to zero at b + 2
+	vector<float> edges( numBands + 2 );
+	float melLow	= hzToMel( min( 20.0f, nyquist ) );
+	float melHigh	= hzToMel( nyquist );
+	for( size_t i = 0; i < edges.size(); i++ ) {
+		float mel = melLow + ( melHigh - melLow ) * i / (float)( numBands + 1 );
+		edges[i] = melToHz( mel ) * mFormat.mFftSize / mFormat.mSampleRate;
+	}
+
+	mMelStart.resize( numBands );
+	mMelWeights.resize( numBands );
+	for( size_t b = 0; b < numBands; b++ ) {
+		float lo = edges[b], mid = edges[b + 1], hi = edges[b + 2];
+		size_t first	= min( (size_t)ceilf( lo ), numBins );
+		size_t last		= min( (size_t)floorf( hi ), numBins - 1 );
+
+		mMelStart[b] = first;
+		mMelWeights[b].clear();
+		for( size_t bin = first; bin <= last && bin < numBins; bin++ ) {
+			float f = (float)bin;
+			float w = f <= mid ? ( f - lo ) / max( mid - lo, 1e-6f ) : ( hi - f ) / max( hi - mid, 1e-6f );
+			mMelWeights[b].push_back( max( w, 0.0f ) );
+		}
+		// narrow low bands can fall between two bins; give them the nearest one
+		if( mMelWeights[b].empty() ) {
+			mMelStart[b] = min( (size_t)( mid + 0.5f ), numBins - 1 );
+			mMelWeights[b].push_back( 1.0f );
+		}
+	}
+}
+
+void AudioAnalyzer::start()
+{
+	if( mThread.joinable() )
+		return;
+
+	mIsRunning = true;
+	mThread = thread( &AudioAnalyzer::run, this );
+}
+
+void AudioAnalyzer::stop()
+{
+	mIsRunning = false;
+	if( mThread.joinable() )
+		mThread.join();
+}
+
+void AudioAnalyzer::run()
+{
+	while( mIsRunning ) {
+		if( processAvailable() == 0 )
+			this_thread::sleep_for( chrono::milliseconds( 1 ) );
+	}
+}
+
+size_t AudioAnalyzer::processAvailable()
+{
+	const size_t hop	= mFormat.mHopSize;
+	const size_t keep	= mWindow.size() - hop;
+
+	size_t numHops = 0;
+	while( mRing.getNumAvailable() >= hop ) {
+		memmove( &mWindow[0], &mWindow[hop], keep * sizeof( float ) );
+		mRing.read( &mWindow[keep], hop );
+		analyze();
+		numHops++;
+	}
+	return numHops;
+}
+
+void AudioAnalyzer::fft()
+{
+	const size_t m = mReal.size();
+
+	// even samples go to the real part, odd ones to the imaginary part, zero-padded past the window
+	const size_t window = mWindow.size();
+	for( size_t i = 0; i < m; i++ ) {
+		size_t e = i * 2, o = e + 1;
+		size_t j = mBitReverse[i];
+		mReal[j] = e < window ? mWindow[e] * mWindowCoeffs[e] : 0.0f;
+		mImag[j] = o < window ? mWindow[o] * mWindowCoeffs[o] : 0.0f;
+	}
+
+	// iterative radix-2; the inner loop has no branches so the compiler can vectorise it
+	for( size_t size = 2; size <= m; size <<= 1 ) {
+		size_t half = size / 2;
+		size_t step = m / size;
+		for( size_t start = 0; start < m; start += size ) {
+			float *ar = &mReal[start], *ai = &mImag[start];
+			float *br = ar + half, *bi = ai + half;
+			for( size_t k = 0; k < half; k++ ) {
+				float wr = mCos[k * step], wi = mSin[k * step];
+				float tr = br[k] * wr - bi[k] * wi;
+				float ti = br[k] * wi + bi[k] * wr;
+				br[k] = ar[k] - tr;
+				bi[k] = ai[k] - ti;
+				ar[k] += tr;
+				ai[k] += ti;
+			}
+		}
+	}
+
+	// split the packed result into the spectrum of the real signal: X[k] = E[k] + W^k O[k]
+	const float scale = 1.0f / (float)mFormat.mFftSize;
+	for( size_t k = 1; k < m; k++ ) {
+		float zr = mReal[k], zi = mImag[k];
+		float cr = mReal[m - k], ci = -mImag[m - k];
+		float er = ( zr + cr ) * 0.5f, ei = ( zi + ci ) * 0.5f;
+		float orr = ( zi - ci ) * 0.5f, oi = -( zr - cr ) * 0.5f;
+		float c = mPostCos[k], s = mPostSin[k];
+		float xr = er + c * orr + s * oi;
+		float xi = ei + c * oi - s * orr;
+		mMag[k] = sqrtf( xr * xr + xi * xi ) * scale;
+	}
+	// z[0] holds DC + Nyquist as real + imag, the layout Cinder packs into real[0]/imag[0];
+	// MonitorSpectralNode zeroes that Nyquist term and keeps DC, so bin 0 is DC alone
+	mMag[0] = fabsf( mReal[0] + mImag[0] ) * scale;
+}
+
+void AudioAnalyzer::analyze()
+{
+	fft();
+
+	AudioFeatures &out	= mSlots[mBack];
+	const size_t numBins	= mMag.size();
+	const float smoothing	= mFormat.mSmoothingFactor;
+
+	float peak = 0.0f, flux = 0.0f;
+	for( size_t i = 0; i < numBins; i++ ) {
+		float mag = mMag[i];
+		mSmoothedMag[i] = mSmoothedMag[i] * smoothing + mag * ( 1.0f - smoothing );
+		flux += max( mag - mPrevMag[i], 0.0f );
+		peak = max( peak, mSmoothedMag[i] );
+	}
+	mPrevMag.swap( mMag );
+
+	copy( mSmoothedMag.begin(), mSmoothedMag.end(), out.mMagSpectrum.begin() );
+	for( size_t i = 0; i < numBins; i++ )
+		out.mDecibelSpectrum[i] = linearToDecibel( mSmoothedMag[i] );
+
+	// mPrevMag now holds this hop's unsmoothed magnitudes
+	for( size_t b = 0; b < mMelWeights.size(); b++ ) {
+		const vector<float> &weights = mMelWeights[b];
+		const float *mag = &mPrevMag[mMelStart[b]];
+		float energy = 0.0f;
+		for( size_t i = 0; i < weights.size(); i++ )
+			energy += weights[i] * mag[i] * mag[i];
+		out.mMelBands[b] = 10.0f * log10f( energy + 1e-12f );
+	}
+
+	float sumSqrd = 0.0f;
+	for( size_t i = 0; i < mWindow.size(); i++ )
+		sumSqrd += mWindow[i] * mWindow[i];
+
+	float meanFlux = 0.0f;
+	for( size_t i = 0; i < mFluxHistory.size(); i++ )
+		meanFlux += mFluxHistory[i];
+	meanFlux /= (float)mFluxHistory.size();
+	mFluxHistory[mFluxIndex] = flux;
+	mFluxIndex = ( mFluxIndex + 1 ) % mFluxHistory.size();
+
+	mHop++;
+	out.mHop			= mHop;
+	out.mTime			= mHop * mFormat.mHopSize / (double)mFormat.mSampleRate;
+	out.mPeakMagnitude	= peak;
+	out.mRms			= sqrtf( sumSqrd / (float)mWindow.size() );
+	out.mFlux			= flux;
+	out.mIsOnset		= mHop > mFluxHistory.size() && flux > meanFlux * mFormat.mOnsetThreshold && flux > 1e-6f;
+
+	// publish
+	mBack = mMiddle.exchange( mBack | kFresh, memory_order_acq_rel ) & 3;
+}
+
+const AudioFeatures& AudioAnalyzer::acquire()
+{
+	if( mMiddle.load( memory_order_acquire ) & kFresh )
+		mFront = mMiddle.exchange( mFront, memory_order_acq_rel ) & 3;
+
+	return mSlots[mFront];
+}
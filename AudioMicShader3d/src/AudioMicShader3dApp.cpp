@@ -30,12 +30,14 @@
 #include "cinder/ImageIo.h"
 #include "cinder/MayaCamUI.h"
 #include "cinder/Rand.h"
-#include "cinder/audio/MonitorNode.h"
+#include "cinder/audio/Context.h"
 #include "cinder/audio/Device.h"
 #include "cinderSyphon.h"
 #include "cinder/gl/Light.h"
 #include "Resources.h"
-#include "cinder/Perlin.h"
+#include "AnalyzerNode.h"
+#include "SpectrogramTexture.h"
+#include "BatchNoise.h"
 #include "cinder/params/Params.h"
 
 #define INPUT_DEVICE "Scarlett 2i2 USB"
@@ -69,8 +71,8 @@ private:
     static const int kBands = 1024;
     static const int kHistory = 128;
     
-    Channel32f			mChannelLeft;
-    Channel32f			mChannelRight;
+    SpectrogramHistory	mHistoryLeft;
+    SpectrogramHistory	mHistoryRight;
     CameraPersp			mCamera;
     MayaCamUI			mMayaCam;
     vector<gl::GlslProgRef>		mShader;
@@ -80,22 +82,22 @@ private:
     gl::Texture::Format	mTextureFormat;
     gl::VboMesh			mMesh;
 
-    uint32_t			mOffset;
     
     bool				mIsMouseDown;
     double				mMouseUpTime;
     double				mMouseUpDelay;
     
     audio::InputDeviceNodeRef		mInputDeviceNode;
-    audio::MonitorSpectralNodeRef	mMonitorSpectralNode;
-    vector<float>					mMagSpectrum;
-    Perlin				mPerlin;
+    AudioAnalyzerRef				mAnalyzer;
+    AnalyzerNodeRef					mAnalyzerNode;
+    BatchNoise			mNoise;
     uint32              mPerlinMove;
     std::vector<Vec3f>      mVertices;
     
 	syphonServer mTextureSyphon;
 
     float mFrameRate;
+    int   mUploadBytes;
     bool  mAutomaticSwitch;
     ci::params::InterfaceGl		mParams;
 
@@ -118,11 +120,13 @@ void AudioVisualizerApp::mouseWheel( MouseEvent event )
 void AudioVisualizerApp::setup()
 {
     
-    mPerlin = Perlin( 4, 0 );
+    mNoise = BatchNoise( 4, 0 );
     mPerlinMove = 0;
     mFrameRate	= 0.0f;
+    mUploadBytes = 0;
     mParams = params::InterfaceGl( "Params", Vec2i( 200, 100 ) );
 	mParams.addParam( "Frame rate",	&mFrameRate,"", true);
+	mParams.addParam( "Upload bytes",	&mUploadBytes,"", true);
 	mParams.addParam( "Shader",	&mShaderNum,"min=0 max=3 step=1", false);
     mParams.addParam( "Auto switch", &mAutomaticSwitch);
     
@@ -144,14 +148,17 @@ void AudioVisualizerApp::setup()
     
     // By providing an FFT size double that of the window size, we 'zero-pad' the analysis data, which gives
     // an increase in resolution of the resulting spectrum data.
-    auto monitorFormat = audio::MonitorSpectralNode::Format().fftSize( kBands ).windowSize( kBands / 2 );
-    mMonitorSpectralNode = ctx->makeNode( new audio::MonitorSpectralNode( monitorFormat ) );
+    // The analysis runs on its own thread; update() only picks up the latest result.
+    auto analyzerFormat = AudioAnalyzer::Format().fftSize( kBands ).windowSize( kBands / 2 ).sampleRate( (float)ctx->getSampleRate() );
+    mAnalyzer = AudioAnalyzer::create( analyzerFormat );
+    mAnalyzerNode = ctx->makeNode( new AnalyzerNode( mAnalyzer ) );
     
-    mInputDeviceNode >> mMonitorSpectralNode;
+    mInputDeviceNode >> mAnalyzerNode;
     
     // InputDeviceNode (and all InputNode subclasses) need to be enabled()'s to process audio. So does the Context:
     mInputDeviceNode->enable();
     ctx->enable();
+    mAnalyzer->start();
     
     getWindow()->setTitle( mInputDeviceNode->getDevice()->getName() );
     
@@ -161,17 +168,18 @@ void AudioVisualizerApp::setup()
     mCamera.setEyePoint( Vec3f(10239.3,7218.58,-7264.48));
     mCamera.setCenterOfInterestPoint( Vec3f(kWidth*0.5f, -kHeight*0.5f, kWidth*0.5f) );
     
-    // create channels from which we can construct our textures
-    mChannelLeft = Channel32f(kBands, kHistory);
-    mChannelRight = Channel32f(kBands, kHistory);
-    memset(	mChannelLeft.getData(), 0, mChannelLeft.getRowBytes() * kHistory );
-    memset(	mChannelRight.getData(), 0, mChannelRight.getRowBytes() * kHistory );
+    // spectrum histories; new rows overwrite the oldest and the shader scrolls by uTexOffset
+    mHistoryLeft = SpectrogramHistory( kBands, kHistory, SpectrogramHistory::HALF_FLOAT );
+    mHistoryRight = SpectrogramHistory( kBands, kHistory, SpectrogramHistory::HALF_FLOAT );
     
     // create texture format (wrap the y-axis, clamp the x-axis)
     mTextureFormat.setWrapS( GL_CLAMP );
     mTextureFormat.setWrapT( GL_REPEAT );
     mTextureFormat.setMinFilter( GL_LINEAR );
     mTextureFormat.setMagFilter( GL_LINEAR );
+    
+    mTextureLeft = spectrogram::createTexture( mHistoryLeft, mTextureFormat );
+    mTextureRight = spectrogram::createTexture( mHistoryRight, mTextureFormat );
 
     mShaderNum = 0;
     try {
@@ -186,6 +194,13 @@ void AudioVisualizerApp::setup()
         return;
     }
 
+    // the initial terrain, evaluated in one batch: heights[h * kWidth + w] = fBm( ( h, w, 0 ) * 0.005 )
+    std::vector<float>      heights(kWidth * kHeight);
+    const float origin[3] = { 0.0f, 0.0f, 0.0f };
+    const float wStep[3] = { 0.0f, 0.005f, 0.0f };
+    const float hStep[3] = { 0.005f, 0.0f, 0.0f };
+    mNoise.fractalGrid( origin, wStep, hStep, &heights[0], kWidth, kHeight, BatchNoise::FBM, BatchNoise::GRADIENT, 0 );
+    
     std::vector<Colorf>     colors;
     std::vector<Vec2f>      coords;
     std::vector<uint32_t>	indices;
@@ -208,7 +223,7 @@ void AudioVisualizerApp::setup()
             }
             
             // add vertex
-            float value = 80.0f * mPerlin.fBm(Vec3f(float(h), float(w), 0.f) * 0.005f);
+            float value = 80.0f * heights[h * kWidth + w];
             mVertices.push_back( Vec3f(float(w), value, float(h)) );
             
             // add texture coordinates
@@ -260,11 +275,6 @@ void AudioVisualizerApp::setup()
     mMouseUpDelay = 5.0;
     mMouseUpTime = getElapsedSeconds() - mMouseUpDelay;
     
-    // the texture offset has two purposes:
-    //  1) it tells us where to upload the next spectrum data
-    //  2) we use it to offset the texture coordinates in the shader for the scrolling effect
-    mOffset = 0;
-    
     mTextureSyphon.setName("Mic3d");
 
     setFrameRate(30.0f);
@@ -283,31 +293,19 @@ void AudioVisualizerApp::setup()
 
 void AudioVisualizerApp::shutdown()
 {
-
+    mAnalyzer->stop();
 }
 
 void AudioVisualizerApp::update()
 {
     mFrameRate = getAverageFps();
 
-    mMagSpectrum = mMonitorSpectralNode->getMagSpectrum();
+    const AudioFeatures &features = mAnalyzer->acquire();
+    const vector<float> &magSpectrum = features.mMagSpectrum;
     
     // get spectrum for left and right channels and copy it into our channels
-    float* pDataLeft = mChannelLeft.getData() + kBands * mOffset;
-    float* pDataRight = mChannelRight.getData() + kBands * mOffset;
-
-    std::reverse_copy(mMagSpectrum.begin(), mMagSpectrum.end(), pDataLeft);
-    std::copy(mMagSpectrum.begin(), mMagSpectrum.end(), pDataRight);
-
-    // increment texture offset
-    mOffset = (mOffset+1) % kHistory;
-
-    // clear the spectrum for this row to avoid old data from showing up
-    ////NOT SURE THIS IS NEEDED -- the texture will be overwritten completely next time by data
-//    pDataLeft = mChannelLeft.getData() + kBands * mOffset;
-//    pDataRight = mChannelRight.getData() + kBands * mOffset;
-//    memset( pDataLeft, 0, kBands * sizeof(float) );
-//    memset( pDataRight, 0, kBands * sizeof(float) );
+    mHistoryLeft.pushRow( &magSpectrum[0], magSpectrum.size(), true );
+    mHistoryRight.pushRow( &magSpectrum[0], magSpectrum.size() );
 
     // animate camera if mouse has not been down for more than 30 seconds
 
@@ -329,26 +327,31 @@ void AudioVisualizerApp::update()
         //cout<<interest<< " "<< (eye.lerp(0.995f, mCamera.getEyePoint()))<<endl;
         
         // gradually move to eye position and center of interest
-        float correction = 1.0 - 0.1*mMonitorSpectralNode->getVolume();
+        float correction = 1.0 - 0.1*features.mRms;
         mCamera.setEyePoint( eye.lerp(0.995f*correction, mCamera.getEyePoint()) );
         mCamera.setCenterOfInterestPoint( interest.lerp(0.990f*correction, mCamera.getCenterOfInterestPoint()) );
         
         
-        if (mAutomaticSwitch &&  (mMonitorSpectralNode->getVolume() < 0.001f || mMonitorSpectralNode->getVolume() > 0.5f)){
+        if (mAutomaticSwitch &&  (features.mRms < 0.001f || features.mRms > 0.5f)){
             mShaderNum = mShaderNum == mShader.size() - 1 ? 0 : mShaderNum + 1;
         }
     }
 
     mPerlinMove++;
 
+    // evaluate the new column in one batch
+    float column[kHeight];
+    const float origin[3] = { float(mPerlinMove) * 0.005f, float(kWidth - 1) * 0.005f, 0.0f };
+    const float step[3] = { 0.005f, 0.0f, 0.0f };
+    mNoise.fractalLine( origin, step, column, kHeight );
+
     for(size_t h = 0 ; h < kHeight; ++h) {
         for(size_t w = 0 ; w < kWidth; ++w) {
             size_t i = h * kWidth + w;
             if (w < kWidth - 1) {
                 mVertices [i].y = mVertices [i+1].y;
             } else {
-                float value = 80.0f*mPerlin.fBm(Vec3f(float(h+ mPerlinMove), float(w), 0.f)* 0.005f);
-                mVertices[i].y = value;
+                mVertices[i].y = 80.0f * column[h];
             }
         }
     }
@@ -387,15 +390,15 @@ void AudioVisualizerApp::draw()
 
         // bind shader
         mShader[mShaderNum]->bind();
-        float offSt = mOffset / float(kHistory);
+        float offSt = mHistoryLeft.getTexOffset();
         mShader[mShaderNum]->uniform("uTexOffset", offSt);
         mShader[mShaderNum]->uniform("uLeftTex", 0);
         mShader[mShaderNum]->uniform("uRightTex", 1);
         mShader[mShaderNum]->uniform("resolution", 0.5f*(float)kWidth);
         
-        // create textures from our channels and bind them
-        mTextureLeft = gl::Texture::create(mChannelLeft, mTextureFormat);
-        mTextureRight = gl::Texture::create(mChannelRight, mTextureFormat);
+        // upload the rows written since the last frame and bind the textures
+        mUploadBytes = (int)( spectrogram::uploadDirtyRows( mHistoryLeft, mTextureLeft )
+                             + spectrogram::uploadDirtyRows( mHistoryRight, mTextureRight ) );
         
         mTextureLeft->enableAndBind();
         mTextureRight->bind(1);
@@ -0,0 +1,426 @@
+//
+//  BatchNoise.cpp
+//
+
+#include "BatchNoise.h"
+#include "cinder/Rand.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const float kF2 = 0.366025403f;		// ( sqrt( 3 ) - 1 ) / 2
+const float kG2 = 0.211324865f;		// ( 3 - sqrt( 3 ) ) / 6
+const float kF3 = 1.0f / 3.0f;
+const float kG3 = 1.0f / 6.0f;
+
+const float kSimplexGradients[12][3] = {
+	{ 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+	{ 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+	{ 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 }
+};
+
+inline float fade( float t )					{ return t * t * t * ( t * ( t * 6.0f - 15.0f ) + 10.0f ); }
+inline float nlerp( float t, float a, float b )	{ return a + t * ( b - a ); }
+
+// ci::Perlin's gradients, written as selects so the loops using them vectorize
+inline float grad( int32_t hash, float x )
+{
+	int32_t h = hash & 15;
+	float u = h < 8 ? x : 0.0f;
+	float v = h < 4 ? 0.0f : ( h == 12 || h == 14 ? x : 0.0f );
+	return ( ( h & 1 ) == 0 ? u : -u ) + ( ( h & 2 ) == 0 ? v : -v );
+}
+
+inline float grad( int32_t hash, float x, float y )
+{
+	int32_t h = hash & 15;
+	float u = h < 8 ? x : y;
+	float v = h < 4 ? y : ( h == 12 || h == 14 ? x : 0.0f );
+	return ( ( h & 1 ) == 0 ? u : -u ) + ( ( h & 2 ) == 0 ? v : -v );
+}
+
+inline float grad( int32_t hash, float x, float y, float z )
+{
+	int32_t h = hash & 15;
+	float u = h < 8 ? x : y;
+	float v = h < 4 ? y : ( h == 12 || h == 14 ? x : z );
+	return ( ( h & 1 ) == 0 ? u : -u ) + ( ( h & 2 ) == 0 ? v : -v );
+}
+
+// contribution of one simplex corner, zero outside its radius
+inline float corner( float t, float dot )
+{
+	t = max( t, 0.0f );
+	t *= t;
+	return t * t * dot;
+}
+
+} // anonymous namespace
+
+// min() binds kBlockSize by reference, so it needs a definition
+const size_t BatchNoise::kBlockSize;
+
+BatchNoise::BatchNoise( uint8_t octaves, int32_t seed )
+	: mOctaves( octaves ), mSeed( seed )
+{
+	initPermutationTable();
+}
+
+void BatchNoise::setSeed( int32_t seed )
+{
+	mSeed = seed;
+	initPermutationTable();
+}
+
+void BatchNoise::initPermutationTable()
+{
+	// same sequence as ci::Perlin, so the same seed gives the same field
+	ci::Rand rand( mSeed );
+	for( size_t t = 0; t < 256; ++t )
+		mPerms[t] = mPerms[t + 256] = (uint8_t)( rand.nextInt() & 255 );
+}
+
+float BatchNoise::noise( float x ) const
+{
+	float out;
+	gradientBlock1( &x, &out, 1 );
+	return out;
+}
+
+float BatchNoise::noise( float x, float y ) const
+{
+	float out;
+	gradientBlock2( &x, &y, &out, 1 );
+	return out;
+}
+
+float BatchNoise::noise( float x, float y, float z ) const
+{
+	float out;
+	gradientBlock3( &x, &y, &z, &out, 1 );
+	return out;
+}
+
+float BatchNoise::simplex( float x, float y ) const
+{
+	float out;
+	simplexBlock2( &x, &y, &out, 1 );
+	return out;
+}
+
+float BatchNoise::simplex( float x, float y, float z ) const
+{
+	float out;
+	simplexBlock3( &x, &y, &z, &out, 1 );
+	return out;
+}
+
+void BatchNoise::noise( const float *x, const float *y, const float *z, float *out, size_t count, Basis basis ) const
+{
+	for( size_t start = 0; start < count; start += kBlockSize ) {
+		size_t n = min( kBlockSize, count - start );
+		noiseBlock( x + start, y ? y + start : 0, z ? z + start : 0, out + start, n, basis );
+	}
+}
+
+void BatchNoise::fractal( const float *x, const float *y, const float *z, float *out, size_t count, Fractal fractal, Basis basis ) const
+{
+	float bx[kBlockSize], by[kBlockSize], bz[kBlockSize];
+	for( size_t start = 0; start < count; start += kBlockSize ) {
+		size_t n = min( kBlockSize, count - start );
+		copy( x + start, x + start + n, bx );
+		if( y )
+			copy( y + start, y + start + n, by );
+		if( z )
+			copy( z + start, z + start + n, bz );
+		fractalBlock( bx, y ? by : 0, z ? bz : 0, out + start, n, fractal, basis );
+	}
+}
+
+void BatchNoise::fractalLine( const float origin[3], const float step[3], float *out, size_t count, Fractal fractal, Basis basis ) const
+{
+	float bx[kBlockSize], by[kBlockSize], bz[kBlockSize];
+	for( size_t start = 0; start < count; start += kBlockSize ) {
+		size_t n = min( kBlockSize, count - start );
+		for( size_t i = 0; i < n; i++ ) {
+			float t = float( start + i );
+			bx[i] = origin[0] + t * step[0];
+			by[i] = origin[1] + t * step[1];
+			bz[i] = origin[2] + t * step[2];
+		}
+		fractalBlock( bx, by, bz, out + start, n, fractal, basis );
+	}
+}
+
+void BatchNoise::fractalGrid( const float origin[3], const float columnStep[3], const float rowStep[3],
+							  float *out, size_t numColumns, size_t numRows, Fractal fractal, Basis basis, size_t numThreads ) const
+{
+	if( numThreads == 0 )
+		numThreads = max<size_t>( thread::hardware_concurrency(), 1 );
+	numThreads = max<size_t>( min( numThreads, numRows ), 1 );
+
+	auto evaluateRows = [=]( size_t firstRow, size_t lastRow ) {
+		for( size_t row = firstRow; row < lastRow; row++ ) {
+			float rowOrigin[3] = { origin[0] + row * rowStep[0], origin[1] + row * rowStep[1], origin[2] + row * rowStep[2] };
+			fractalLine( rowOrigin, columnStep, out + row * numColumns, numColumns, fractal, basis );
+		}
+	};
+
+	if( numThreads == 1 ) {
+		evaluateRows( 0, numRows );
+		return;
+	}
+
+	// the calling thread takes the last share
+	vector<thread> threads;
+	size_t rowsPerThread = ( numRows + numThreads - 1 ) / numThreads;
+	for( size_t first = 0; first + rowsPerThread < numRows; first += rowsPerThread )
+		threads.push_back( thread( evaluateRows, first, first + rowsPerThread ) );
+	evaluateRows( threads.size() * rowsPerThread, numRows );
+	for( size_t t = 0; t < threads.size(); t++ )
+		threads[t].join();
+}
+
+void BatchNoise::noiseBlock( const float *x, const float *y, const float *z, float *out, size_t count, Basis basis ) const
+{
+	if( basis == SIMPLEX && y ) {
+		if( z )
+			simplexBlock3( x, y, z, out, count );
+		else
+			simplexBlock2( x, y, out, count );
+	}
+	else if( z && y )
+		gradientBlock3( x, y, z, out, count );
+	else if( y )
+		gradientBlock2( x, y, out, count );
+	else
+		gradientBlock1( x, out, count );
+}
+
+void BatchNoise::fractalBlock( float *x, float *y, float *z, float *out, size_t count, Fractal fractal, Basis basis ) const
+{
+	float octave[kBlockSize];
+	fill( out, out + count, 0.0f );
+
+	float amp = 0.5f;
+	for( uint8_t o = 0; o < mOctaves; o++ ) {
+		noiseBlock( x, y, z, octave, count, basis );
+		switch( fractal ) {
+			case FBM:
+				for( size_t i = 0; i < count; i++ )
+					out[i] += octave[i] * amp;
+				break;
+			case TURBULENCE:
+				for( size_t i = 0; i < count; i++ )
+					out[i] += fabsf( octave[i] ) * amp;
+				break;
+			case RIDGED:
+				for( size_t i = 0; i < count; i++ ) {
+					float ridge = 1.0f - fabsf( octave[i] );
+					out[i] += ridge * ridge * amp;
+				}
+				break;
+		}
+
+		for( size_t i = 0; i < count; i++ )
+			x[i] *= 2.0f;
+		if( y ) {
+			for( size_t i = 0; i < count; i++ )
+				y[i] *= 2.0f;
+		}
+		if( z ) {
+			for( size_t i = 0; i < count; i++ )
+				z[i] *= 2.0f;
+		}
+		amp *= 0.5f;
+	}
+}
+
+void BatchNoise::gradientBlock1( const float *x, float *out, size_t count ) const
+{
+	int32_t X[kBlockSize], h0[kBlockSize], h1[kBlockSize];
+	float fx[kBlockSize];
+
+	for( size_t i = 0; i < count; i++ ) {
+		float floorX = floorf( x[i] );
+		X[i]	= (int32_t)floorX & 255;
+		fx[i]	= x[i] - floorX;
+	}
+
+	for( size_t i = 0; i < count; i++ ) {
+		int32_t A = mPerms[X[i]], B = mPerms[X[i] + 1];
+		h0[i] = mPerms[mPerms[A]];
+		h1[i] = mPerms[mPerms[B]];
+	}
+
+	for( size_t i = 0; i < count; i++ )
+		out[i] = nlerp( fade( fx[i] ), grad( h0[i], fx[i] ), grad( h1[i], fx[i] - 1.0f ) );
+}
+
+void BatchNoise::gradientBlock2( const float *x, const float *y, float *out, size_t count ) const
+{
+	int32_t X[kBlockSize], Y[kBlockSize];
+	int32_t h[4][kBlockSize];
+	float fx[kBlockSize], fy[kBlockSize];
+
+	for( size_t i = 0; i < count; i++ ) {
+		float floorX = floorf( x[i] ), floorY = floorf( y[i] );
+		X[i]	= (int32_t)floorX & 255;
+		Y[i]	= (int32_t)floorY & 255;
+		fx[i]	= x[i] - floorX;
+		fy[i]	= y[i] - floorY;
+	}
+
+	for( size_t i = 0; i < count; i++ ) {
+		int32_t A = mPerms[X[i]] + Y[i], AA = mPerms[A], AB = mPerms[A + 1];
+		int32_t B = mPerms[X[i] + 1] + Y[i], BA = mPerms[B], BB = mPerms[B + 1];
+		h[0][i] = mPerms[AA];
+		h[1][i] = mPerms[BA];
+		h[2][i] = mPerms[AB];
+		h[3][i] = mPerms[BB];
+	}
+
+	for( size_t i = 0; i < count; i++ ) {
+		float u = fade( fx[i] ), v = fade( fy[i] );
+		float x0 = fx[i], x1 = fx[i] - 1.0f, y0 = fy[i], y1 = fy[i] - 1.0f;
+		out[i] = nlerp( v, nlerp( u, grad( h[0][i], x0, y0 ), grad( h[1][i], x1, y0 ) ),
+						   nlerp( u, grad( h[2][i], x0, y1 ), grad( h[3][i], x1, y1 ) ) );
+	}
+}
+
+void BatchNoise::gradientBlock3( const float *x, const float *y, const float *z, float *out, size_t count ) const
+{
+	int32_t X[kBlockSize], Y[kBlockSize], Z[kBlockSize];
+	int32_t h[8][kBlockSize];
+	float fx[kBlockSize], fy[kBlockSize], fz[kBlockSize];
+
+	for( size_t i = 0; i < count; i++ ) {
+		float floorX = floorf( x[i] ), floorY = floorf( y[i] ), floorZ = floorf( z[i] );
+		X[i]	= (int32_t)floorX & 255;
+		Y[i]	= (int32_t)floorY & 255;
+		Z[i]	= (int32_t)floorZ & 255;
+		fx[i]	= x[i] - floorX;
+		fy[i]	= y[i] - floorY;
+		fz[i]	= z[i] - floorZ;
+	}
+
+	// the only part that cannot vectorize: eight hash lookups per point
+	for( size_t i = 0; i < count; i++ ) {
+		int32_t A = mPerms[X[i]] + Y[i], AA = mPerms[A] + Z[i], AB = mPerms[A + 1] + Z[i];
+		int32_t B = mPerms[X[i] + 1] + Y[i], BA = mPerms[B] + Z[i], BB = mPerms[B + 1] + Z[i];
+		h[0][i] = mPerms[AA];
+		h[1][i] = mPerms[BA];
+		h[2][i] = mPerms[AB];
+		h[3][i] = mPerms[BB];
+		h[4][i] = mPerms[AA + 1];
+		h[5][i] = mPerms[BA + 1];
+		h[6][i] = mPerms[AB + 1];
+		h[7][i] = mPerms[BB + 1];
+	}
+
+	for( size_t i = 0; i < count; i++ ) {
+		float u = fade( fx[i] ), v = fade( fy[i] ), w = fade( fz[i] );
+		float x0 = fx[i], x1 = fx[i] - 1.0f, y0 = fy[i], y1 = fy[i] - 1.0f, z0 = fz[i], z1 = fz[i] - 1.0f;
+		out[i] = nlerp( w, nlerp( v, nlerp( u, grad( h[0][i], x0, y0, z0 ), grad( h[1][i], x1, y0, z0 ) ),
+									 nlerp( u, grad( h[2][i], x0, y1, z0 ), grad( h[3][i], x1, y1, z0 ) ) ),
+						   nlerp( v, nlerp( u, grad( h[4][i], x0, y0, z1 ), grad( h[5][i], x1, y0, z1 ) ),
+									 nlerp( u, grad( h[6][i], x0, y1, z1 ), grad( h[7][i], x1, y1, z1 ) ) ) );
+	}
+}
+
+void BatchNoise::simplexBlock2( const float *x, const float *y, float *out, size_t count ) const
+{
+	int32_t I[kBlockSize], J[kBlockSize], I1[kBlockSize];
+	float x0[kBlockSize], y0[kBlockSize];
+	float g[3][2][kBlockSize];
+
+	// skew to find the simplex cell, then unskew the offsets to its first corner
+	for( size_t i = 0; i < count; i++ ) {
+		float s = ( x[i] + y[i] ) * kF2;
+		float cellX = floorf( x[i] + s ), cellY = floorf( y[i] + s );
+		float t = ( cellX + cellY ) * kG2;
+		x0[i]	= x[i] - ( cellX - t );
+		y0[i]	= y[i] - ( cellY - t );
+		I[i]	= (int32_t)cellX & 255;
+		J[i]	= (int32_t)cellY & 255;
+		I1[i]	= x0[i] > y0[i] ? 1 : 0;
+	}
+
+	for( size_t i = 0; i < count; i++ ) {
+		int32_t ii = I[i], jj = J[i], i1 = I1[i], j1 = 1 - i1;
+		const float *g0 = kSimplexGradients[mPerms[ii + mPerms[jj]] % 12];
+		const float *g1 = kSimplexGradients[mPerms[ii + i1 + mPerms[jj + j1]] % 12];
+		const float *g2 = kSimplexGradients[mPerms[ii + 1 + mPerms[jj + 1]] % 12];
+		g[0][0][i] = g0[0];	g[0][1][i] = g0[1];
+		g[1][0][i] = g1[0];	g[1][1][i] = g1[1];
+		g[2][0][i] = g2[0];	g[2][1][i] = g2[1];
+	}
+
+	for( size_t i = 0; i < count; i++ ) {
+		float i1 = (float)I1[i], j1 = 1.0f - i1;
+		float x1 = x0[i] - i1 + kG2, y1 = y0[i] - j1 + kG2;
+		float x2 = x0[i] - 1.0f + 2.0f * kG2, y2 = y0[i] - 1.0f + 2.0f * kG2;
+		float n = corner( 0.5f - x0[i] * x0[i] - y0[i] * y0[i], g[0][0][i] * x0[i] + g[0][1][i] * y0[i] )
+				+ corner( 0.5f - x1 * x1 - y1 * y1, g[1][0][i] * x1 + g[1][1][i] * y1 )
+				+ corner( 0.5f - x2 * x2 - y2 * y2, g[2][0][i] * x2 + g[2][1][i] * y2 );
+		out[i] = 70.0f * n;
+	}
+}
+
+void BatchNoise::simplexBlock3( const float *x, const float *y, const float *z, float *out, size_t count ) const
+{
+	int32_t I[kBlockSize], J[kBlockSize], K[kBlockSize];
+	int32_t c1[3][kBlockSize], c2[3][kBlockSize];
+	float x0[kBlockSize], y0[kBlockSize], z0[kBlockSize];
+	float g[4][3][kBlockSize];
+
+	for( size_t i = 0; i < count; i++ ) {
+		float s = ( x[i] + y[i] + z[i] ) * kF3;
+		float cellX = floorf( x[i] + s ), cellY = floorf( y[i] + s ), cellZ = floorf( z[i] + s );
+		float t = ( cellX + cellY + cellZ ) * kG3;
+		x0[i]	= x[i] - ( cellX - t );
+		y0[i]	= y[i] - ( cellY - t );
+		z0[i]	= z[i] - ( cellZ - t );
+		I[i]	= (int32_t)cellX & 255;
+		J[i]	= (int32_t)cellY & 255;
+		K[i]	= (int32_t)cellZ & 255;
+
+		// order the offsets to pick the second and third corners without branching
+		int32_t gx = x0[i] >= y0[i], gy = y0[i] >= z0[i], gz = z0[i] >= x0[i];
+		c1[0][i] = min( gx, 1 - gz );	c2[0][i] = max( gx, 1 - gz );
+		c1[1][i] = min( gy, 1 - gx );	c2[1][i] = max( gy, 1 - gx );
+		c1[2][i] = min( gz, 1 - gy );	c2[2][i] = max( gz, 1 - gy );
+	}
+
+	for( size_t i = 0; i < count; i++ ) {
+		int32_t ii = I[i], jj = J[i], kk = K[i];
+		const float *corners[4] = {
+			kSimplexGradients[mPerms[ii + mPerms[jj + mPerms[kk]]] % 12],
+			kSimplexGradients[mPerms[ii + c1[0][i] + mPerms[jj + c1[1][i] + mPerms[kk + c1[2][i]]]] % 12],
+			kSimplexGradients[mPerms[ii + c2[0][i] + mPerms[jj + c2[1][i] + mPerms[kk + c2[2][i]]]] % 12],
+			kSimplexGradients[mPerms[ii + 1 + mPerms[jj + 1 + mPerms[kk + 1]]] % 12]
+		};
+		for( int c = 0; c < 4; c++ ) {
+			g[c][0][i] = corners[c][0];
+			g[c][1][i] = corners[c][1];
+			g[c][2][i] = corners[c][2];
+		}
+	}
+
+	for( size_t i = 0; i < count; i++ ) {
+		float x1 = x0[i] - c1[0][i] + kG3, y1 = y0[i] - c1[1][i] + kG3, z1 = z0[i] - c1[2][i] + kG3;
+		float x2 = x0[i] - c2[0][i] + 2.0f * kG3, y2 = y0[i] - c2[1][i] + 2.0f * kG3, z2 = z0[i] - c2[2][i] + 2.0f * kG3;
+		float x3 = x0[i] - 1.0f + 3.0f * kG3, y3 = y0[i] - 1.0f + 3.0f * kG3, z3 = z0[i] - 1.0f + 3.0f * kG3;
+		float n = corner( 0.6f - x0[i] * x0[i] - y0[i] * y0[i] - z0[i] * z0[i], g[0][0][i] * x0[i] + g[0][1][i] * y0[i] + g[0][2][i] * z0[i] )
+				+ corner( 0.6f - x1 * x1 - y1 * y1 - z1 * z1, g[1][0][i] * x1 + g[1][1][i] * y1 + g[1][2][i] * z1 )
+				+ corner( 0.6f - x2 * x2 - y2 * y2 - z2 * z2, g[2][0][i] * x2 + g[2][1][i] * y2 + g[2][2][i] * z2 )
+				+ corner( 0.6f - x3 * x3 - y3 * y3 - z3 * z3, g[3][0][i] * x3 + g[3][1][i] * y3 + g[3][2][i] * z3 );
+		out[i] = 32.0f * n;
+	}
+}
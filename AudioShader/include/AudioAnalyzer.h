@@ -0,0 +1,138 @@
+//
+//  AudioAnalyzer.h
+//
+//  Spectral analysis on its own thread, fed PCM through a lock-free ring.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+//! One analysis hop. Slots are allocated once, so publishing never allocates.
+struct AudioFeatures {
+	uint64_t			mHop;				// hops analysed so far
+	double				mTime;				// seconds of audio consumed
+	std::vector<float>	mMagSpectrum;		// fftSize / 2 bins, scaled and smoothed like audio::MonitorSpectralNode
+	std::vector<float>	mDecibelSpectrum;	// mMagSpectrum through audio::linearToDecibel()
+	std::vector<float>	mMelBands;			// log energy (dB) per mel band
+	float				mPeakMagnitude;		// largest value in mMagSpectrum
+	float				mRms;				// of the unwindowed analysis window, like MonitorNode::getVolume()
+	float				mFlux;				// half-wave rectified spectral flux
+	bool				mIsOnset;
+};
+
+//! Lock-free ring for one producer and one consumer thread.
+class PcmRing {
+  public:
+	explicit PcmRing( size_t capacity = 0 );
+
+	void	setCapacity( size_t capacity );	// rounded up to a power of two; not thread safe
+	size_t	getCapacity() const { return mBuffer.size(); }
+
+	//! Producer side. Samples that don't fit are dropped and counted.
+	size_t	write( const float *samples, size_t count );
+	//! Consumer side.
+	size_t	getNumAvailable() const;
+	size_t	read( float *samples, size_t count );
+
+	uint64_t	getNumDropped() const { return mNumDropped.load( std::memory_order_relaxed ); }
+
+  private:
+	std::vector<float>		mBuffer;
+	size_t					mMask;
+	std::atomic<uint64_t>	mWritePos;
+	std::atomic<uint64_t>	mReadPos;
+	std::atomic<uint64_t>	mNumDropped;
+};
+
+typedef std::shared_ptr<class AudioAnalyzer> AudioAnalyzerRef;
+
+class AudioAnalyzer {
+  public:
+	class Format {
+	  public:
+		Format() : mFftSize( 2048 ), mWindowSize( 0 ), mHopSize( 0 ), mNumMelBands( 40 ), mSampleRate( 44100.0f ),
+			mSmoothingFactor( 0.5f ), mOnsetThreshold( 1.5f ), mOnsetHistory( 16 ), mRingSeconds( 1.0f ) {}
+
+		Format&	fftSize( size_t size )				{ mFftSize = size; return *this; }
+		//! defaults to fftSize; anything shorter is zero-padded
+		Format&	windowSize( size_t size )			{ mWindowSize = size; return *this; }
+		//! defaults to half the window
+		Format&	hopSize( size_t size )				{ mHopSize = size; return *this; }
+		Format&	numMelBands( size_t count )			{ mNumMelBands = count; return *this; }
+		Format&	sampleRate( float rate )			{ mSampleRate = rate; return *this; }
+		Format&	smoothingFactor( float factor )		{ mSmoothingFactor = factor; return *this; }
+		//! an onset fires when the flux exceeds threshold * the mean of the last \a history hops
+		Format&	onsetThreshold( float threshold )	{ mOnsetThreshold = threshold; return *this; }
+		Format&	onsetHistory( size_t hops )			{ mOnsetHistory = hops; return *this; }
+		Format&	ringSeconds( float seconds )		{ mRingSeconds = seconds; return *this; }
+
+		size_t	mFftSize, mWindowSize, mHopSize, mNumMelBands;
+		float	mSampleRate, mSmoothingFactor, mOnsetThreshold;
+		size_t	mOnsetHistory;
+		float	mRingSeconds;
+	};
+
+	static AudioAnalyzerRef	create( const Format &format = Format() ) { return AudioAnalyzerRef( new AudioAnalyzer( format ) ); }
+	~AudioAnalyzer();
+
+	//! Audio thread. Never blocks or allocates.
+	void		write( const float *samples, size_t count ) { mRing.write( samples, count ); }
+
+	//! Starts or stops the worker thread.
+	void		start();
+	void		stop();
+	bool		isRunning() const { return mThread.joinable(); }
+
+	//! Analyses every complete hop waiting in the ring on the calling thread and
+	//! returns how many there were. For offline use, while the worker is stopped.
+	size_t		processAvailable();
+
+	//! Render thread (one reader). The reference stays valid until the next call.
+	const AudioFeatures&	acquire();
+
+	const Format&	getFormat() const { return mFormat; }
+	size_t			getNumBins() const { return mFormat.mFftSize / 2; }
+	float			getFreqForBin( size_t bin ) const { return bin * mFormat.mSampleRate / (float)mFormat.mFftSize; }
+	uint64_t		getNumDroppedSamples() const { return mRing.getNumDropped(); }
+
+  private:
+	AudioAnalyzer( const Format &format );
+
+	void	run();
+	void	analyze();
+	void	fft();
+	void	setupMelBands();
+
+	Format					mFormat;
+	PcmRing					mRing;
+	std::thread				mThread;
+	std::atomic<bool>		mIsRunning;
+
+	// worker state
+	std::vector<float>		mWindow;			// last windowSize samples, oldest first
+	std::vector<float>		mWindowCoeffs;		// Blackman, as MonitorSpectralNode uses by default
+	std::vector<float>		mReal, mImag;		// fftSize / 2 point complex FFT, split format
+	std::vector<float>		mCos, mSin;			// twiddles for the complex FFT
+	std::vector<float>		mPostCos, mPostSin;	// twiddles for the real post-pass
+	std::vector<uint32_t>	mBitReverse;
+	std::vector<float>		mMag, mPrevMag;		// unsmoothed, for the flux
+	std::vector<float>		mSmoothedMag;
+	std::vector<size_t>		mMelStart;			// first bin of each mel filter
+	std::vector<std::vector<float> >	mMelWeights;
+	std::vector<float>		mFluxHistory;
+	size_t					mFluxIndex;
+	uint64_t				mHop;
+
+	// triple buffer: the writer owns mBack, the reader owns mFront, and the
+	// third slot is parked in mMiddle with kFresh set when it holds news
+	static const int		kFresh = 4;
+	AudioFeatures			mSlots[3];
+	int						mBack, mFront;
+	std::atomic<int>		mMiddle;
+};
@@ -4,8 +4,8 @@
 #include "cinder/gl/Texture.h"
 
 #include "cinder/audio/Context.h"
-#include "cinder/audio/MonitorNode.h"
 #include "cinder/audio/Utilities.h"
+#include "AnalyzerNode.h"
 
 
 using namespace ci;
@@ -22,8 +22,8 @@ private:
 	gl::GlslProg	mShader;
 	gl::Texture		mTexture;
     audio::InputDeviceNodeRef		mInputDeviceNode;
-    audio::MonitorSpectralNodeRef	mMonitorSpectralNode;
-    vector<float>					mMagSpectrum;
+    AudioAnalyzerRef				mAnalyzer;
+    AnalyzerNodeRef					mAnalyzerNode;
 };
 
 void AudioShaderApp::setup()
@@ -45,22 +45,25 @@ void AudioShaderApp::setup()
     
     // By providing an FFT size double that of the window size, we 'zero-pad' the analysis data, which gives
     // an increase in resolution of the resulting spectrum data.
-    auto monitorFormat = audio::MonitorSpectralNode::Format().fftSize( 2048 ).windowSize( 1024 );
-    mMonitorSpectralNode = ctx->makeNode( new audio::MonitorSpectralNode( monitorFormat ) );
+    // The analysis (including the decibel conversion) runs on its own thread.
+    auto analyzerFormat = AudioAnalyzer::Format().fftSize( 2048 ).windowSize( 1024 ).sampleRate( (float)ctx->getSampleRate() );
+    mAnalyzer = AudioAnalyzer::create( analyzerFormat );
+    mAnalyzerNode = ctx->makeNode( new AnalyzerNode( mAnalyzer ) );
     
-    mInputDeviceNode >> mMonitorSpectralNode;
+    mInputDeviceNode >> mAnalyzerNode;
     
     // InputDeviceNode (and all InputNode subclasses) need to be enabled()'s to process audio. So does the Context:
     mInputDeviceNode->enable();
     ctx->enable();
+    mAnalyzer->start();
 }
 
 void AudioShaderApp::update()
 {
     
-    mMagSpectrum = mMonitorSpectralNode->getMagSpectrum();
+    const AudioFeatures &features = mAnalyzer->acquire();
     
-    size_t numBins = mMonitorSpectralNode->getFftSize() / 2;
+    size_t numBins = mAnalyzer->getNumBins();
 //    size_t bin = min( numBins - 1, size_t( ( numBins * ( mouseX - mSpectrumPlot.getBounds().x1 ) ) / mSpectrumPlot.getBounds().getWidth() ) );
 //    
 //    float binFreqWidth = mMonitorSpectralNode->getFreqForBin( 1 ) - mMonitorSpectralNode->getFreqForBin( 0 );
@@ -89,15 +92,15 @@ void AudioShaderApp::update()
 	unsigned char signal[1024];
     
     //the first row is the spectrum (shadertoy)
-    float max = 0.;
+    float max = 1e-6f;
     for(int i=0;i<512;++i){
-        if (mMagSpectrum[i] > max) max = mMagSpectrum[i];
+        if (features.mMagSpectrum[i] > max) max = features.mMagSpectrum[i];
     }
     
-    float ht = 255.0/max;
+    float ht = audio::linearToDecibel( 255.0f / max );
     
     for(int i = 0; i < numBins; i++) {
-       signal[i] = (unsigned char) (audio::linearToDecibel(mMagSpectrum[i]) * audio::linearToDecibel(ht));
+       signal[i] = (unsigned char) (features.mDecibelSpectrum[i] * ht);
     }
     
     //waveform
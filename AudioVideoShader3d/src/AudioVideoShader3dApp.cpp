@@ -37,6 +37,7 @@
 #include "cinder/app/RendererGl.h"
 
 #include "Resources.h"
+#include "VideoUploader.h"
 #include "cinder/Perlin.h"
 #include "cinder/params/Params.h"
 #include "cinder/Capture.h"
@@ -105,6 +106,8 @@ private:
     
     CaptureRef mCapture;
     gl::TextureRef mTextureRef;
+    // capture frames go up into the same couple of textures rather than a new one each
+    std::shared_ptr<VideoUploader> mVideo;
     gl::BatchRef mBatch;
     
     gl::VboMeshRef vboMeshRef;
@@ -130,6 +133,7 @@ void AudioVisualizerApp::setup()
 {
     mCapture = Capture::create(  640, 480 );
     mCapture->start();
+    mVideo = std::shared_ptr<VideoUploader>( new VideoUploader() );
     
     
     mPerlin = Perlin( 4, 0 );
@@ -333,8 +337,10 @@ void AudioVisualizerApp::shutdown()
 void AudioVisualizerApp::update()
 {
     if( mCapture && mCapture->checkNewFrame() ) {
-        mTextureRef = gl::Texture::create( *mCapture->getSurface() );
+        mVideo->submit( mCapture->getSurface() );
     }
+    if( mVideo->update() )
+        mTextureRef = mVideo->getTexture();
     
     mFrameRate = getAverageFps();
 
@@ -0,0 +1,93 @@
+//
+//  VideoUploader.cpp
+//
+
+#include "VideoUploader.h"
+
+// core profile headers know these only by their core names
+#if ! defined( GL_HALF_FLOAT_ARB )
+	#define GL_HALF_FLOAT_ARB	GL_HALF_FLOAT
+	#define GL_RGBA16F_ARB		GL_RGBA16F
+	#define GL_RGBA32F_ARB		GL_RGBA32F
+#endif
+
+using namespace ci;
+using namespace std;
+
+VideoUploader::VideoUploader( VideoFrameQueue::Target target, size_t numTextures, const gl::Texture::Format &format )
+	: mQueue( target, numTextures + 1 ), mFormat( format ), mTextures( max( numTextures, (size_t)1 ) ), mCurrent( 0 ), mOpaque( false ), mBytesUploaded( 0 )
+{
+}
+
+#if CINDER_VERSION >= 900
+// a Surface copies its pixels with it, so the queue holds the reference instead
+void VideoUploader::submit( const Surface8uRef &surface )
+{
+	if( surface )
+		submit( *surface, surface );
+}
+#else
+// the surface shares its pixels with the copy, which the queue holds until it is done with them
+void VideoUploader::submit( const Surface8u &surface )
+{
+	if( surface )
+		submit( surface, shared_ptr<const void>( new Surface8u( surface ) ) );
+}
+#endif
+
+void VideoUploader::submit( const Surface8u &surface, const shared_ptr<const void> &owner )
+{
+	VideoFrameQueue::Source source;
+	source.mData = surface.getData();
+	source.mWidth = surface.getWidth();
+	source.mHeight = surface.getHeight();
+	source.mRowBytes = surface.getRowBytes();
+	source.mPixelInc = surface.getPixelInc();
+	source.mOffsets[0] = surface.getRedOffset();
+	source.mOffsets[1] = surface.getGreenOffset();
+	source.mOffsets[2] = surface.getBlueOffset();
+	source.mOffsets[3] = surface.hasAlpha() ? surface.getAlphaOffset() : -1;
+
+	// the padding byte of RGBX and BGRX goes up as alpha into a texture without any, which ignores it
+	mOpaque = ! surface.hasAlpha();
+	if( mOpaque && source.mPixelInc == 4 && mQueue.getTarget() == VideoFrameQueue::RGBA8 )
+		source.mOffsets[3] = 6 - source.mOffsets[0] - source.mOffsets[1] - source.mOffsets[2];
+
+	source.mOwner = owner;
+	mQueue.submit( source );
+}
+
+bool VideoUploader::update()
+{
+	VideoFrameQueue::Frame frame;
+	if( ! mQueue.take( &frame ) )
+		return false;
+
+	GLint internalFormat;
+	GLenum dataType;
+	size_t valueBytes;
+	switch( mQueue.getTarget() ) {
+		case VideoFrameQueue::RGBA16F:	internalFormat = GL_RGBA16F_ARB;	dataType = GL_HALF_FLOAT_ARB;	valueBytes = 2;	break;
+		case VideoFrameQueue::RGBA32F:	internalFormat = GL_RGBA32F_ARB;	dataType = GL_FLOAT;			valueBytes = 4;	break;
+		default:						internalFormat = mOpaque ? GL_RGB8 : GL_RGBA8;	dataType = GL_UNSIGNED_BYTE;	valueBytes = 1;	break;
+	}
+
+	// the next texture in turn, made again only when the frames change size or kind
+	mCurrent = ( mCurrent + 1 ) % mTextures.size();
+	gl::TextureRef &texture = mTextures[mCurrent];
+	if( ! texture || texture->getWidth() != frame.mWidth || texture->getHeight() != frame.mHeight || texture->getInternalFormat() != internalFormat ) {
+		gl::Texture::Format format = mFormat;
+		format.setInternalFormat( internalFormat );
+		texture = gl::Texture::create( frame.mWidth, frame.mHeight, format );
+	}
+
+	texture->bind();
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, (GLint)frame.mRowPixels );
+	glTexSubImage2D( texture->getTarget(), 0, 0, 0, frame.mWidth, frame.mHeight, frame.mBgra ? GL_BGRA : GL_RGBA, dataType, frame.mData );
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+	texture->unbind();
+
+	mBytesUploaded += (uint64_t)frame.mRowPixels * frame.mHeight * 4 * valueBytes;
+	mQueue.release();
+	return true;
+}
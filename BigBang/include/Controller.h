@@ -17,6 +17,8 @@
 #include "Streamer.h"
 #include "Balloon.h"
 #include "Shockwave.h"
+#include "LooseOctree.h"
+#include "InstanceBatch.h"
 #include <vector>
 #include <list>
 
@@ -32,6 +34,8 @@ class Controller
 	void checkForBalloonPop( const ci::Vec2f &mousePos );
 	void update( const ci::Camera &cam );
 	void applyBalloonCollisions();
+	void resolveBalloonCollision( Balloon *b1, Balloon *b2 );
+	void updateDepthOrder( const std::vector<int> &remap, int numBefore );
 	bool didParticlesCollide( const ci::Vec3f &dir, const ci::Vec3f &dirNormal, const float dist, const float sumRadii, const float sumRadiiSqrd, ci::Vec3f *moveVec );
 	void draw();
 	void drawConfettis( ci::gl::GlslProg *shader );
@@ -55,9 +59,21 @@ class Controller
 	std::vector<Balloon>	mBalloons;
 	std::vector<Shockwave>	mShockwaves;
 	
+	LooseOctree				mBalloonOctree;
+	std::vector<LooseOctree::Pair>	mBalloonPairs;
+	std::vector<int>		mBalloonRemap;
+	std::vector<int>		mDepthOrder;	// balloon indices, far to near
+	std::vector<float>		mDepthKeys;
+	
 	ci::gl::VboMesh			mBalloonsVbo;
+	float					mBalloonsRadius;	// the knot hangs below the unit sphere
+	ci::gl::VboMesh			mConfettiVbo;
+	std::vector<const Balloon*>	mBalloonDrawList;	// mBalloons in mDepthOrder
+	InstanceBatch			mBalloonBatch;
+	InstanceBatch			mConfettiBatch;
+	InstanceBatch::GlBackend	mBalloonBackend;
+	InstanceBatch::GlBackend	mConfettiBackend;
 	std::vector<ci::Vec3f>	mPosCoords;
 	std::vector<ci::Vec3f>	mNormals;
 };
-bool depthSortFunc( Balloon a, Balloon b );
 
@@ -1,17 +1,18 @@
 uniform float power;
 uniform samplerCube	cubeMap;
 uniform vec3 eyePos;
-uniform vec3 color;
 uniform vec3 roomDims;
 uniform float att;
 
 varying vec3 vEyeDir;
 varying vec4 vVertex;
 varying vec3 vNormal;
+varying vec3 vColor;
 
 
 void main()
 {
+	vec3 color			= vColor;
 	vec3 ppNormal		= vNormal * 0.8;
 	vec3 lightPos		= vec3( 0.0, 5000.0, 0.0 );
 	vec3 lightDir		= lightPos - vVertex.xyz;
@@ -2,17 +2,25 @@ uniform vec3 eyePos;
 uniform vec3 pos;
 uniform float radius;
 uniform mat4 matrix;
+uniform vec3 color;
 uniform mat4 mvpMatrix;
+uniform bool instanced;
+
+attribute mat4 instanceMatrix;
+attribute vec4 instanceColor;
 
 varying vec3 vEyeDir;
 varying vec4 vVertex;
 varying vec3 vNormal;
+varying vec3 vColor;
 
 void main()
 {
-	vNormal			= normalize( vec3( matrix * vec4( gl_Normal, 0.0 ) ) );
+	mat4 m			= instanced ? instanceMatrix : matrix;
+	vColor			= instanced ? instanceColor.rgb : color;
+	vNormal			= normalize( vec3( m * vec4( gl_Normal, 0.0 ) ) );
 	
-	vVertex			= matrix * vec4( gl_Vertex );
+	vVertex			= m * vec4( gl_Vertex );
 	
 //	vVertex.xz *= 0.9;
 //	
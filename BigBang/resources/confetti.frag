@@ -1,10 +1,11 @@
-uniform vec3 color;
 
 varying vec3 vNormal;
+varying vec3 vColor;
 
 
 void main()
 {
+	vec3 color			= vColor;
 	gl_FragColor.rgb	= color * ( vNormal.y * 0.3 + 0.7 ) * 3.0;
 	gl_FragColor.a		= 1.0;
 }
\ No newline at end of file
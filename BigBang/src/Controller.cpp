@@ -15,8 +15,24 @@ using namespace ci;
 using std::vector;
 using std::list;
 
+namespace {
+	void balloonToInstance( const Balloon* const &balloon, InstanceData *instance )
+	{
+		instance->mMatrix	= balloon->mMatrix;
+		instance->mColor	= Vec4f( balloon->mColor.r, balloon->mColor.g, balloon->mColor.b, 1.0f );
+	}
+	
+	void confettiToInstance( const Confetti &confetti, InstanceData *instance )
+	{
+		instance->mMatrix	= confetti.mMatrix;
+		instance->mColor	= Vec4f( confetti.mColor.r, confetti.mColor.g, confetti.mColor.b, 1.0f );
+	}
+}
+
 Controller::Controller()
 {
+	mBalloonBatch.setBackend( &mBalloonBackend );
+	mConfettiBatch.setBackend( &mConfettiBackend );
 }
 
 void Controller::init( Room *room )
@@ -27,6 +43,7 @@ void Controller::init( Room *room )
 	mTimeSinceBang		= 0.0f;
 	
 	createSphere( mBalloonsVbo, 3 );
+	mConfettiVbo		= InstanceBatch::createCube( 1.0f );
 	
 	mPresetIndex		= 1;
 }
@@ -114,6 +131,8 @@ void Controller::createSphere( gl::VboMesh &vbo, int res )
 	mNormals.push_back( Vec3f::yAxis() );
 	mNormals.push_back( Vec3f::yAxis() );
 	
+	mBalloonsRadius = InstanceBatch::getBoundingRadius( mPosCoords );
+	
 	vbo = gl::VboMesh( mPosCoords.size(), 0, layout, GL_TRIANGLES );	
 	vbo.bufferPositions( mPosCoords );
 	vbo.bufferNormals( mNormals );
@@ -177,7 +196,8 @@ void Controller::bang()
 
 void Controller::checkForBalloonPop( const Vec2f &mousePos )
 {
-	for( vector<Balloon>::reverse_iterator it = mBalloons.rbegin(); it != mBalloons.rend(); ++it ){
+	for( vector<int>::reverse_iterator index = mDepthOrder.rbegin(); index != mDepthOrder.rend(); ++index ){
+		vector<Balloon>::iterator it = mBalloons.begin() + *index;
 		Vec2f dir		= mousePos - it->mScreenPos;
 		float distSqrd	= dir.lengthSquared();
 		if( distSqrd < 1000.0f ){
@@ -237,25 +257,68 @@ void Controller::update( const Camera &cam )
 	}
 	
 	// BALLOONS
-	for( vector<Balloon>::iterator it = mBalloons.begin(); it != mBalloons.end(); ){
+	int numBefore	= (int)mBalloons.size();
+	int numAlive	= 0;
+	int index		= 0;
+	mBalloonRemap.resize( numBefore );
+	for( vector<Balloon>::iterator it = mBalloons.begin(); it != mBalloons.end(); ++index ){
 		if( it->mIsDead ){
 			it = mBalloons.erase( it );
+			mBalloonRemap[index] = -1;
 		} else {
 			it->update( cam, mRoom->getDims(), dt );
+			mBalloonRemap[index] = numAlive++;
 			++it;
 		}
 	}
 	
 	// SORT BALLOONS
-	sort( mBalloons.begin(), mBalloons.end(), depthSortFunc );
+	updateDepthOrder( mBalloonRemap, numBefore );
+}
+
+void Controller::updateDepthOrder( const vector<int> &remap, int numBefore )
+{
+	// carry last frame's order over to the surviving balloons, new ones go on the end
+	int numKnown	= (int)mDepthOrder.size();
+	int numKept		= 0;
+	for( int i=0; i<numKnown; i++ ){
+		int newIndex = remap[mDepthOrder[i]];
+		if( newIndex >= 0 ) mDepthOrder[numKept++] = newIndex;
+	}
+	mDepthOrder.resize( numKept );
+	for( int i=numKnown; i<numBefore; i++ ){
+		if( remap[i] >= 0 ) mDepthOrder.push_back( remap[i] );
+	}
+	
+	// the order barely changes between frames, so an insertion sort is close to linear
+	mDepthKeys.resize( mDepthOrder.size() );
+	for( size_t i=0; i<mDepthOrder.size(); i++ ){
+		mDepthKeys[i] = mBalloons[mDepthOrder[i]].mPos.z;
+	}
+	
+	for( int i=1; i<(int)mDepthOrder.size(); i++ ){
+		float key	= mDepthKeys[i];
+		int index	= mDepthOrder[i];
+		int j		= i - 1;
+		while( j >= 0 && mDepthKeys[j] < key ){
+			mDepthKeys[j+1]		= mDepthKeys[j];
+			mDepthOrder[j+1]	= mDepthOrder[j];
+			j--;
+		}
+		mDepthKeys[j+1]		= key;
+		mDepthOrder[j+1]	= index;
+	}
 }
 
 void Controller::applyBalloonCollisions()
 {
+	if( mBalloons.empty() ) return;
+	
+	// APPLY SHOCKWAVES TO BALLOONS
+	Vec3f minPos = mBalloons[0].mPos;
+	Vec3f maxPos = mBalloons[0].mPos;
 	for( vector<Balloon>::iterator it1 = mBalloons.begin(); it1 != mBalloons.end(); ++it1 )
 	{
-		
-		// APPLY SHOCKWAVES TO BALLOONS
 		for( vector<Shockwave>::iterator shockIt = mShockwaves.begin(); shockIt != mShockwaves.end(); ++shockIt )
 		{
 			Vec3f dirToParticle = shockIt->mPos - it1->mPos;
@@ -266,45 +329,63 @@ void Controller::applyBalloonCollisions()
 			}
 		}
 		
-		vector<Balloon>::iterator it2 = it1;
-		for( std::advance( it2, 1 ); it2 != mBalloons.end(); ++it2 )
-		{
-			Vec3f dir			= it1->mPos - it2->mPos;
-			Vec3f dirNormal		= dir.normalized();
-			float dist			= dir.length();
-			
-			Vec3f moveVec		= it2->mVel - it1->mVel;
-			
-			float sumRadii		= ( it1->mRadius * 0.7f + it2->mRadius * 0.7f );
-			float sumRadiiSqrd	= sumRadii * sumRadii;
+		minPos.x = std::min( minPos.x, it1->mPos.x );	maxPos.x = std::max( maxPos.x, it1->mPos.x );
+		minPos.y = std::min( minPos.y, it1->mPos.y );	maxPos.y = std::max( maxPos.y, it1->mPos.y );
+		minPos.z = std::min( minPos.z, it1->mPos.z );	maxPos.z = std::max( maxPos.z, it1->mPos.z );
+	}
+	
+	// BROADPHASE
+	// didParticlesCollide() also reports pairs closing in faster than their
+	// distance, so each sphere is grown by its speed to keep those candidates
+	mBalloonOctree.clear( minPos, maxPos );
+	for( size_t i=0; i<mBalloons.size(); i++ ){
+		const Balloon &b = mBalloons[i];
+		mBalloonOctree.insert( (int)i, b.mPos, b.mRadius * 0.7f + b.mVel.length() );
+	}
+	mBalloonOctree.findPairs( &mBalloonPairs );
+	
+	// NARROWPHASE, in the same pair order as the full i < j sweep
+	for( vector<LooseOctree::Pair>::const_iterator it = mBalloonPairs.begin(); it != mBalloonPairs.end(); ++it ){
+		resolveBalloonCollision( &mBalloons[it->first], &mBalloons[it->second] );
+	}
+}
+
+void Controller::resolveBalloonCollision( Balloon *b1, Balloon *b2 )
+{
+	Vec3f dir			= b1->mPos - b2->mPos;
+	Vec3f dirNormal		= dir.normalized();
+	float dist			= dir.length();
+	
+	Vec3f moveVec		= b2->mVel - b1->mVel;
+	
+	float sumRadii		= ( b1->mRadius * 0.7f + b2->mRadius * 0.7f );
+	float sumRadiiSqrd	= sumRadii * sumRadii;
+	
+	bool collision		= didParticlesCollide( dir, dirNormal, dist, sumRadii, sumRadiiSqrd, &moveVec );
+	
+	if( collision )
+	{
+		
+		float a1	= b1->mVel.dot( dirNormal );
+		float a2	= b2->mVel.dot( dirNormal );
+		float pVar	= ( 2.0f * ( a1 - a2 ) );
+		
+		dist -= sumRadii;
+		
+		if( dist < 0.0f ){
+			Vec3f off	= dirNormal * dist;
 			
-			bool collision		= didParticlesCollide( dir, dirNormal, dist, sumRadii, sumRadiiSqrd, &moveVec );
+			b1->mPos -= off * 0.25f;
+			b1->mVel -= off * 0.125f;
 			
-			if( collision )
-			{
-				
-				float a1	= it1->mVel.dot( dirNormal );
-				float a2	= it2->mVel.dot( dirNormal );
-				float pVar	= ( 2.0f * ( a1 - a2 ) );
-				
-				dist -= sumRadii;
-				
-				if( dist < 0.0f ){
-					Vec3f off	= dirNormal * dist;
-					
-					it1->mPos -= off * 0.25f;
-					it1->mVel -= off * 0.125f;
-					
-					it2->mPos += off * 0.25f;
-					it2->mVel += off * 0.125f;
-				}
-				
-				float collisionDecay = 0.375f;
-				Vec3f newDir = pVar * dirNormal * collisionDecay;
-				it1->mVel -= newDir;
-				it2->mVel += newDir;
-			}
+			b2->mPos += off * 0.25f;
+			b2->mVel += off * 0.125f;
 		}
+		
+		float collisionDecay = 0.375f;
+		Vec3f newDir = pVar * dirNormal * collisionDecay;
+		b1->mVel -= newDir;
+		b2->mVel += newDir;
 	}
 }
 
@@ -353,11 +434,10 @@ void Controller::draw()
 	
 void Controller::drawConfettis( gl::GlslProg *shader )
 {
-	for( vector<Confetti>::iterator it = mConfettis.begin(); it != mConfettis.end(); ++it ){
-		shader->uniform( "color", it->mColor );
-		shader->uniform( "matrix", it->mMatrix );
-		it->draw();
-	}
+	// unit cube, so half the diagonal bounds it
+	mConfettiBackend.setShader( shader );
+	mConfettiBatch.fill( mConfettis, confettiToInstance, 0.8660254f );
+	mConfettiBatch.draw( mConfettiVbo );
 }
 
 void Controller::drawStreamers()
@@ -370,11 +450,15 @@ void Controller::drawStreamers()
 
 void Controller::drawBalloons( gl::GlslProg *shader )
 {
-	for( vector<Balloon>::iterator it = mBalloons.begin(); it != mBalloons.end(); ++it ){
-		shader->uniform( "matrix", it->mMatrix );
-		shader->uniform( "color", it->mColor );
-		gl::draw( mBalloonsVbo );
+	// instances are drawn in buffer order, so the depth order survives batching
+	mBalloonDrawList.clear();
+	for( vector<int>::const_iterator index = mDepthOrder.begin(); index != mDepthOrder.end(); ++index ){
+		mBalloonDrawList.push_back( &mBalloons[*index] );
 	}
+	
+	mBalloonBackend.setShader( shader );
+	mBalloonBatch.fill( mBalloonDrawList, balloonToInstance, mBalloonsRadius );
+	mBalloonBatch.draw( mBalloonsVbo );
 }
 
 void Controller::drawPhysics()
@@ -423,6 +507,7 @@ void Controller::addBalloons( int amt, const Vec3f &pos )
 void Controller::clear()
 {
 	mBalloons.clear();
+	mDepthOrder.clear();
 	mStreamers.clear();
 	mConfettis.clear();
 }
@@ -432,7 +517,3 @@ void Controller::preset( int index )
 	mPresetIndex = index;
 }
 
-bool depthSortFunc( Balloon a, Balloon b ){
-	return a.mPos.z > b.mPos.z;
-}
-
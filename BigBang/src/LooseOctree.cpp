@@ -0,0 +1,131 @@
+//
+//  LooseOctree.cpp
+//  BigBang
+//
+
+#include "LooseOctree.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace ci;
+using std::vector;
+
+LooseOctree::LooseOctree( int maxDepth )
+{
+	mMaxDepth	= maxDepth;
+	mRootSize	= 1.0f;
+
+	int offset	= 0;
+	for( int level=0; level<=mMaxDepth; level++ ){
+		int res = 1 << level;
+		mLevelOffsets.push_back( offset );
+		offset += res * res * res;
+	}
+	mCellHeads.resize( offset, -1 );
+	mLevelCounts.resize( mMaxDepth + 1, 0 );
+}
+
+void LooseOctree::clear( const Vec3f &minPos, const Vec3f &maxPos )
+{
+	for( vector<int>::const_iterator it = mTouchedCells.begin(); it != mTouchedCells.end(); ++it ){
+		mCellHeads[*it] = -1;
+	}
+	mTouchedCells.clear();
+	std::fill( mLevelCounts.begin(), mLevelCounts.end(), 0 );
+
+	mNext.clear();
+	mPositions.clear();
+	mRadii.clear();
+
+	Vec3f dims	= maxPos - minPos;
+	mMin		= minPos;
+	mRootSize	= std::max( std::max( dims.x, dims.y ), std::max( dims.z, 0.001f ) );
+}
+
+int LooseOctree::getLevelFor( float radius ) const
+{
+	int level		= 0;
+	float cellSize	= mRootSize;
+	while( level < mMaxDepth && cellSize * 0.5f >= radius * 2.0f ){
+		cellSize *= 0.5f;
+		level++;
+	}
+	return level;
+}
+
+int LooseOctree::getCellIndex( int level, int x, int y, int z ) const
+{
+	int res = 1 << level;
+	return mLevelOffsets[level] + ( z * res + y ) * res + x;
+}
+
+int LooseOctree::toCell( float p, float minP, float cellSize, int numCells ) const
+{
+	int c = (int)floorf( ( p - minP ) / cellSize );
+	return c < 0 ? 0 : ( c >= numCells ? numCells - 1 : c );
+}
+
+void LooseOctree::insert( int id, const Vec3f &pos, float radius )
+{
+	if( id >= (int)mNext.size() ){
+		mNext.resize( id + 1, -1 );
+		mPositions.resize( id + 1 );
+		mRadii.resize( id + 1, -1.0f );
+	}
+	mPositions[id]	= pos;
+	mRadii[id]		= radius;
+
+	int level		= getLevelFor( radius );
+	int res			= 1 << level;
+	float cellSize	= mRootSize / (float)res;
+
+	int cell = getCellIndex( level,
+							 toCell( pos.x, mMin.x, cellSize, res ),
+							 toCell( pos.y, mMin.y, cellSize, res ),
+							 toCell( pos.z, mMin.z, cellSize, res ) );
+
+	if( mCellHeads[cell] < 0 ) mTouchedCells.push_back( cell );
+	mNext[id]			= mCellHeads[cell];
+	mCellHeads[cell]	= id;
+	mLevelCounts[level]++;
+}
+
+void LooseOctree::findPairs( vector<Pair> *pairs ) const
+{
+	pairs->clear();
+
+	for( int i=0; i<(int)mPositions.size(); i++ ){
+		float r = mRadii[i];
+		if( r < 0.0f ) continue;
+		const Vec3f &p = mPositions[i];
+
+		for( int level=0; level<=mMaxDepth; level++ ){
+			if( mLevelCounts[level] == 0 ) continue;
+
+			int res			= 1 << level;
+			float cellSize	= mRootSize / (float)res;
+			float reach		= r + cellSize * 0.5f;
+
+			int x0 = toCell( p.x - reach, mMin.x, cellSize, res ), x1 = toCell( p.x + reach, mMin.x, cellSize, res );
+			int y0 = toCell( p.y - reach, mMin.y, cellSize, res ), y1 = toCell( p.y + reach, mMin.y, cellSize, res );
+			int z0 = toCell( p.z - reach, mMin.z, cellSize, res ), z1 = toCell( p.z + reach, mMin.z, cellSize, res );
+
+			for( int z=z0; z<=z1; z++ ){
+				for( int y=y0; y<=y1; y++ ){
+					for( int x=x0; x<=x1; x++ ){
+						for( int j = mCellHeads[getCellIndex( level, x, y, z )]; j >= 0; j = mNext[j] ){
+							if( j <= i ) continue;
+
+							float sumRadii = r + mRadii[j];
+							if( ( p - mPositions[j] ).lengthSquared() <= sumRadii * sumRadii ){
+								pairs->push_back( Pair( i, j ) );
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	std::sort( pairs->begin(), pairs->end() );
+}
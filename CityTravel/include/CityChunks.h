@@ -0,0 +1,149 @@
+//
+//  CityChunks.h
+//
+//  The city mesh as frustum-culled grid chunks with coarser levels of detail.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ChunkBox {
+	float	mMin[3], mMax[3];
+};
+
+//! One level of a chunk, with vertices of its own.
+struct ChunkLevel {
+	ChunkLevel() : mError( 0.0f ) {}
+
+	size_t	getNumVertices() const	{ return mPositions.size() / 3; }
+	size_t	getNumTriangles() const	{ return mIndices.size() / 3; }
+
+	std::vector<float>		mPositions, mNormals, mTexCoords;	// normals and texture coordinates may be empty
+	std::vector<uint32_t>	mIndices;
+	float					mError;		// how far, in model units, it strays from the full mesh
+};
+
+class MeshSimplifier {
+  public:
+	//! Collapses edges of the triangles in \a indices, cheapest quadric error first, each onto one of
+	//! the edge's ends, until no more than \a targetTriangles remain or nothing more can go without
+	//! folding a triangle over. Vertices sharing a position collapse together, and those on a border
+	//! stay. \a result gets the triangles left, over the same vertices: a corner that moves takes the
+	//! vertex at its new position whose normal is nearest its own, when there are \a normals. The
+	//! return is the worst collapse's error: the root mean square distance, weighted by area, from
+	//! the vertex kept to the planes of the triangles merged into it.
+	static float	simplify( const float *positions, const float *normals, size_t numVertices, const std::vector<uint32_t> &indices,
+							  size_t targetTriangles, std::vector<uint32_t> *result );
+};
+
+class CityChunks {
+  public:
+	struct Options {
+		Options() : mTrianglesPerChunk( 32768 ), mNumLevels( 3 ), mReduction( 0.25f ) {}
+
+		size_t	mTrianglesPerChunk;		// on average; sets the grid
+		size_t	mNumLevels;				// the full chunk included
+		float	mReduction;				// triangles of each level against the one before
+	};
+
+	CityChunks();
+
+	//! Cuts the mesh into chunks; only the full level of each is made. Normals and texture coordinates may be null.
+	void				build( const float *positions, const float *normals, const float *texCoords, size_t numVertices,
+							   const uint32_t *indices, size_t numIndices, const Options &options = Options() );
+	void				clear();
+
+	size_t				getNumChunks() const	{ return mChunks.size(); }
+	size_t				getNumLevels() const	{ return mOptions.mNumLevels; }
+	size_t				getNumTriangles() const	{ return mNumTriangles; }
+	const ChunkBox&		getBounds( size_t chunk ) const	{ return mChunks[chunk]->mBounds; }
+
+	//! Makes the coarser levels of \a chunk; on any thread, but one thread to a chunk.
+	void				prepare( size_t chunk );
+	bool				isPrepared( size_t chunk ) const	{ return mChunks[chunk]->mPrepared; }
+	//! The full level, and the coarser ones once prepared.
+	size_t				getNumLevels( size_t chunk ) const	{ return isPrepared( chunk ) ? mChunks[chunk]->mLevels.size() : 1; }
+	const ChunkLevel&	getLevel( size_t chunk, size_t level ) const	{ return mChunks[chunk]->mLevels[level]; }
+
+  private:
+	struct Chunk {
+		Chunk() : mPrepared( false ) {}
+
+		ChunkBox				mBounds;
+		std::vector<ChunkLevel>	mLevels;		// reserved for every level, so the full one stays put while the rest are added
+		std::atomic<bool>		mPrepared;
+	};
+
+	Options								mOptions;
+	std::vector<std::unique_ptr<Chunk>>	mChunks;
+	size_t								mNumTriangles;
+};
+
+//! What a frame sees: \a mViewProjection takes the mesh's own coordinates to clip space, column major as GL
+//! keeps it, and \a mEye is the camera in the same coordinates. \a mProjectionScale is the viewport height
+//! over twice the tangent of half the vertical field of view: pixels per unit at distance one.
+struct ChunkView {
+	ChunkView() : mProjectionScale( 1.0f ), mMaxError( 1.0f ) {}
+
+	float	mViewProjection[16];
+	float	mEye[3];
+	float	mProjectionScale;
+	float	mMaxError;		// pixels
+};
+
+struct ChunkDraw {
+	uint32_t	mChunk, mLevel;
+};
+
+class ChunkSelector {
+  public:
+	struct Stats {
+		Stats() : mVisible( 0 ), mTriangles( 0 ) {}
+
+		size_t	mVisible, mTriangles;
+	};
+
+	//! The chunks \a view sees and the level each needs, nearest first. Chunks not yet prepared only
+	//! have their full level, which is what they get.
+	static Stats	select( const CityChunks &chunks, const ChunkView &view, std::vector<ChunkDraw> *draws );
+	//! Whether \a box is at least partly inside the frustum of \a viewProjection.
+	static bool		isVisible( const ChunkBox &box, const float *viewProjection );
+	//! The distance from \a point to \a box, 0 inside it.
+	static float	getDistance( const ChunkBox &box, const float *point );
+};
+
+class ChunkStreamer {
+  public:
+	//! \a chunks must outlive the streamer, and not be built again while it runs.
+	explicit ChunkStreamer( CityChunks &chunks );
+	~ChunkStreamer();
+
+	//! Points the camera will pass, x, y and z each, in the mesh's coordinates; the chunks nearest
+	//! any of them are prepared first. Replaces the points given before.
+	void		setLookahead( const std::vector<float> &points );
+	//! Appends the chunks prepared since the last call.
+	void		takePrepared( std::vector<size_t> *chunks );
+	size_t		getNumPrepared();
+
+  private:
+	void		run();
+
+	CityChunks				&mChunks;
+	std::vector<float>		mLookahead;
+	std::vector<bool>		mTaken;			// being or already prepared
+	std::vector<size_t>		mPrepared;
+	size_t					mNumPrepared;
+
+	std::thread				mWorker;
+	std::mutex				mMutex;
+	std::condition_variable	mWake;
+	bool					mQuit;
+};
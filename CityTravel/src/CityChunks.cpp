@@ -0,0 +1,581 @@
+//
+//  CityChunks.cpp
+//
+
+#include "CityChunks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+using namespace std;
+
+namespace {
+	// the plane quadrics of a vertex, weighted by the planes' triangle areas, as the upper
+	// half of a symmetric 4x4, x^T A x + 2 b.x + c, and the sum of the weights
+	struct Quadric {
+		Quadric() : mWeight( 0.0 )	{ fill( mA, mA + 10, 0.0 ); }
+
+		void add( const Quadric &q )
+		{
+			for( int i = 0; i < 10; ++i )
+				mA[i] += q.mA[i];
+			mWeight += q.mWeight;
+		}
+
+		// the plane n.p + d = 0, n unit length
+		void addPlane( double nx, double ny, double nz, double d, double weight )
+		{
+			mA[0] += weight * nx * nx;	mA[1] += weight * nx * ny;	mA[2] += weight * nx * nz;	mA[3] += weight * nx * d;
+			mA[4] += weight * ny * ny;	mA[5] += weight * ny * nz;	mA[6] += weight * ny * d;
+			mA[7] += weight * nz * nz;	mA[8] += weight * nz * d;
+			mA[9] += weight * d * d;
+			mWeight += weight;
+		}
+
+		// the mean squared distance from \a p to the planes
+		double evaluate( const float *p ) const
+		{
+			if( mWeight <= 0.0 )
+				return 0.0;
+			double x = p[0], y = p[1], z = p[2];
+			double sum = x * ( mA[0] * x + 2.0 * ( mA[1] * y + mA[2] * z + mA[3] ) )
+					   + y * ( mA[4] * y + 2.0 * ( mA[5] * z + mA[6] ) )
+					   + z * ( mA[7] * z + 2.0 * mA[8] )
+					   + mA[9];
+			return max( sum / mWeight, 0.0 );
+		}
+
+		double	mA[10], mWeight;
+	};
+
+	struct Collapse {
+		bool operator<( const Collapse &other ) const	{ return mCost > other.mCost; }	// cheapest on top
+
+		double		mCost;
+		uint32_t	mFrom, mTo, mFromStamp, mToStamp;
+	};
+
+	void cross( const float *a, const float *b, const float *c, double *n )
+	{
+		double ux = b[0] - a[0], uy = b[1] - a[1], uz = b[2] - a[2];
+		double vx = c[0] - a[0], vy = c[1] - a[1], vz = c[2] - a[2];
+		n[0] = uy * vz - uz * vy;
+		n[1] = uz * vx - ux * vz;
+		n[2] = ux * vy - uy * vx;
+	}
+
+	void growBox( ChunkBox *box, const float *p )
+	{
+		for( int i = 0; i < 3; ++i ) {
+			box->mMin[i] = min( box->mMin[i], p[i] );
+			box->mMax[i] = max( box->mMax[i], p[i] );
+		}
+	}
+
+	ChunkBox emptyBox()
+	{
+		ChunkBox box;
+		for( int i = 0; i < 3; ++i ) {
+			box.mMin[i] = numeric_limits<float>::max();
+			box.mMax[i] = -numeric_limits<float>::max();
+		}
+		return box;
+	}
+
+	// copies the vertices \a indices use out of \a source into \a level, renumbering them
+	void compact( const float *positions, const float *normals, const float *texCoords, const vector<uint32_t> &indices,
+				  vector<uint32_t> &remap, uint32_t stamp, vector<uint32_t> &stamps, ChunkLevel *level )
+	{
+		level->mIndices.resize( indices.size() );
+		for( size_t i = 0; i < indices.size(); ++i ) {
+			uint32_t v = indices[i];
+			if( stamps[v] != stamp ) {
+				stamps[v] = stamp;
+				remap[v] = (uint32_t)level->getNumVertices();
+				level->mPositions.insert( level->mPositions.end(), positions + v * 3, positions + v * 3 + 3 );
+				if( normals )
+					level->mNormals.insert( level->mNormals.end(), normals + v * 3, normals + v * 3 + 3 );
+				if( texCoords )
+					level->mTexCoords.insert( level->mTexCoords.end(), texCoords + v * 2, texCoords + v * 2 + 2 );
+			}
+			level->mIndices[i] = remap[v];
+		}
+	}
+}
+
+float MeshSimplifier::simplify( const float *positions, const float *normals, size_t numVertices, const vector<uint32_t> &indices,
+								size_t targetTriangles, vector<uint32_t> *result )
+{
+	// vertices at one position are one vertex here; the group keeps its members, lowest index first
+	vector<uint32_t> order( numVertices );
+	for( size_t i = 0; i < numVertices; ++i )
+		order[i] = (uint32_t)i;
+	sort( order.begin(), order.end(), [positions]( uint32_t a, uint32_t b ) {
+		const float *p = positions + a * 3, *q = positions + b * 3;
+		if( p[0] != q[0] ) return p[0] < q[0];
+		if( p[1] != q[1] ) return p[1] < q[1];
+		if( p[2] != q[2] ) return p[2] < q[2];
+		return a < b;
+	} );
+	vector<uint32_t> group( numVertices ), groupStart( numVertices + 1, 0 ), members( numVertices );
+	for( size_t i = 0, start = 0; i < numVertices; ++i ) {
+		const float *p = positions + order[i] * 3, *q = positions + order[start] * 3;
+		if( p[0] != q[0] || p[1] != q[1] || p[2] != q[2] )
+			start = i;
+		group[order[i]] = order[start];
+	}
+	for( size_t i = 0; i < numVertices; ++i )
+		++groupStart[group[i] + 1];
+	for( size_t i = 0; i < numVertices; ++i )
+		groupStart[i + 1] += groupStart[i];
+	{
+		vector<uint32_t> fill( groupStart.begin(), groupStart.end() - 1 );
+		for( size_t i = 0; i < numVertices; ++i )
+			members[fill[group[i]]++] = (uint32_t)i;
+	}
+
+	// triangles over groups, and over the vertices their corners use; ones with no area go now
+	vector<uint32_t> tris, corners;
+	tris.reserve( indices.size() );
+	corners.reserve( indices.size() );
+	for( size_t i = 0; i + 2 < indices.size(); i += 3 ) {
+		uint32_t a = group[indices[i]], b = group[indices[i + 1]], c = group[indices[i + 2]];
+		if( a == b || b == c || a == c )
+			continue;
+		tris.push_back( a );
+		tris.push_back( b );
+		tris.push_back( c );
+		corners.insert( corners.end(), indices.begin() + i, indices.begin() + i + 3 );
+	}
+	size_t numTris = tris.size() / 3, numAlive = numTris;
+
+	vector<Quadric> quadrics( numVertices );
+	vector<vector<uint32_t>> vertexTris( numVertices );
+	for( size_t t = 0; t < numTris; ++t ) {
+		const uint32_t *v = &tris[t * 3];
+		double n[3];
+		cross( positions + v[0] * 3, positions + v[1] * 3, positions + v[2] * 3, n );
+		double length = sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+		if( length > 0.0 ) {
+			n[0] /= length;		n[1] /= length;		n[2] /= length;
+			const float *p = positions + v[0] * 3;
+			Quadric q;
+			q.addPlane( n[0], n[1], n[2], -( n[0] * p[0] + n[1] * p[1] + n[2] * p[2] ), length * 0.5 );
+			for( int k = 0; k < 3; ++k )
+				quadrics[v[k]].add( q );
+		}
+		for( int k = 0; k < 3; ++k )
+			vertexTris[v[k]].push_back( (uint32_t)t );
+	}
+
+	// an edge not shared by exactly two triangles is a border; its ends stay where they are
+	vector<uint64_t> edges;
+	edges.reserve( numTris * 3 );
+	for( size_t t = 0; t < numTris; ++t ) {
+		for( int k = 0; k < 3; ++k ) {
+			uint64_t a = tris[t * 3 + k], b = tris[t * 3 + ( k + 1 ) % 3];
+			edges.push_back( a < b ? ( a << 32 ) | b : ( b << 32 ) | a );
+		}
+	}
+	sort( edges.begin(), edges.end() );
+	vector<bool> locked( numVertices, false );
+	for( size_t i = 0; i < edges.size(); ) {
+		size_t j = i + 1;
+		while( j < edges.size() && edges[j] == edges[i] )
+			++j;
+		if( j - i != 2 ) {
+			locked[edges[i] >> 32] = true;
+			locked[edges[i] & 0xffffffff] = true;
+		}
+		i = j;
+	}
+
+	vector<bool> alive( numTris, true ), removed( numVertices, false );
+	vector<uint32_t> stamps( numVertices, 0 );
+	priority_queue<Collapse> heap;
+	auto push = [&]( uint32_t from, uint32_t to ) {
+		if( locked[from] )
+			return;
+		Quadric q = quadrics[from];
+		q.add( quadrics[to] );
+		Collapse c = { q.evaluate( positions + to * 3 ), from, to, stamps[from], stamps[to] };
+		heap.push( c );
+	};
+	for( size_t i = 0; i < edges.size(); ++i ) {
+		if( i > 0 && edges[i] == edges[i - 1] )
+			continue;
+		uint32_t a = (uint32_t)( edges[i] >> 32 ), b = (uint32_t)( edges[i] & 0xffffffff );
+		push( a, b );
+		push( b, a );
+	}
+
+	double maxCost = 0.0;
+	uint32_t numCollapses = 0, numChecks = 0;
+	vector<uint32_t> visited( numVertices, 0 ), linked( numVertices, 0 );
+	while( numAlive > targetTriangles && ! heap.empty() ) {
+		Collapse c = heap.top();
+		heap.pop();
+		uint32_t u = c.mFrom, v = c.mTo;
+		if( removed[u] || removed[v] || stamps[u] != c.mFromStamp || stamps[v] != c.mToStamp )
+			continue;
+
+		// no triangle left after the collapse may turn over or lose its area
+		const float *pv = positions + v * 3;
+		bool folds = false;
+		size_t shared = 0;
+		++numChecks;
+		for( size_t i = 0; i < vertexTris[u].size() && ! folds; ++i ) {
+			uint32_t t = vertexTris[u][i];
+			if( ! alive[t] )
+				continue;
+			const uint32_t *w = &tris[t * 3];
+			for( int k = 0; k < 3; ++k )
+				linked[w[k]] = numChecks;
+			if( w[0] == v || w[1] == v || w[2] == v ) {
+				++shared;
+				continue;
+			}
+			const float *p[3], *q[3];
+			for( int k = 0; k < 3; ++k ) {
+				p[k] = positions + w[k] * 3;
+				q[k] = w[k] == u ? pv : p[k];
+			}
+			double before[3], after[3];
+			cross( p[0], p[1], p[2], before );
+			cross( q[0], q[1], q[2], after );
+			double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+			double lengths = sqrt( ( before[0] * before[0] + before[1] * before[1] + before[2] * before[2] )
+								 * ( after[0] * after[0] + after[1] * after[1] + after[2] * after[2] ) );
+			folds = dot <= 1e-3 * lengths || lengths == 0.0;
+		}
+		if( folds || ! shared )
+			continue;
+
+		// and the two may have no neighbours in common but across the triangles they share, or the
+		// collapse would pinch the surface into edges of more than two triangles
+		size_t common = 0;
+		++numChecks;
+		for( size_t i = 0; i < vertexTris[v].size(); ++i ) {
+			uint32_t t = vertexTris[v][i];
+			if( ! alive[t] )
+				continue;
+			for( int k = 0; k < 3; ++k ) {
+				uint32_t w = tris[t * 3 + k];
+				if( w != u && w != v && linked[w] == numChecks - 1 ) {
+					linked[w] = numChecks;
+					++common;
+				}
+			}
+		}
+		if( common != shared )
+			continue;
+
+		for( size_t i = 0; i < vertexTris[u].size(); ++i ) {
+			uint32_t t = vertexTris[u][i];
+			if( ! alive[t] )
+				continue;
+			uint32_t *w = &tris[t * 3];
+			if( w[0] == v || w[1] == v || w[2] == v ) {
+				alive[t] = false;
+				--numAlive;
+				continue;
+			}
+			for( int k = 0; k < 3; ++k ) {
+				if( w[k] != u )
+					continue;
+				w[k] = v;
+				// the member of the new position nearest the corner's normal, so hard edges stay hard
+				uint32_t &corner = corners[t * 3 + k], best = members[groupStart[v]];
+				if( normals ) {
+					const float *n = normals + corner * 3;
+					float bestDot = -numeric_limits<float>::max();
+					for( uint32_t m = groupStart[v]; m < groupStart[v + 1]; ++m ) {
+						const float *o = normals + members[m] * 3;
+						float dot = n[0] * o[0] + n[1] * o[1] + n[2] * o[2];
+						if( dot > bestDot ) {
+							bestDot = dot;
+							best = members[m];
+						}
+					}
+				}
+				corner = best;
+			}
+			vertexTris[v].push_back( t );
+		}
+		vector<uint32_t>().swap( vertexTris[u] );
+		removed[u] = true;
+		quadrics[v].add( quadrics[u] );
+		++stamps[v];
+		maxCost = max( maxCost, c.mCost );
+
+		// v took on u's planes, so every collapse to or from it is costed again, once per neighbour
+		++numCollapses;
+		vector<uint32_t> &around = vertexTris[v];
+		around.erase( remove_if( around.begin(), around.end(), [&alive]( uint32_t t ) { return ! alive[t]; } ), around.end() );
+		for( size_t i = 0; i < around.size(); ++i ) {
+			const uint32_t *w = &tris[around[i] * 3];
+			for( int k = 0; k < 3; ++k ) {
+				if( w[k] == v || visited[w[k]] == numCollapses )
+					continue;
+				visited[w[k]] = numCollapses;
+				push( v, w[k] );
+				push( w[k], v );
+			}
+		}
+	}
+
+	result->clear();
+	result->reserve( numAlive * 3 );
+	for( size_t t = 0; t < numTris; ++t )
+		if( alive[t] )
+			result->insert( result->end(), corners.begin() + t * 3, corners.begin() + t * 3 + 3 );
+	return (float)sqrt( maxCost );
+}
+
+CityChunks::CityChunks()
+	: mNumTriangles( 0 )
+{
+}
+
+void CityChunks::clear()
+{
+	mChunks.clear();
+	mNumTriangles = 0;
+}
+
+void CityChunks::build( const float *positions, const float *normals, const float *texCoords, size_t numVertices,
+						const uint32_t *indices, size_t numIndices, const Options &options )
+{
+	clear();
+	mOptions = options;
+	mOptions.mNumLevels = max( mOptions.mNumLevels, (size_t)1 );
+	size_t numTris = numIndices / 3;
+	mNumTriangles = numTris;
+	if( ! numTris )
+		return;
+
+	ChunkBox bounds = emptyBox();
+	for( size_t i = 0; i < numVertices; ++i )
+		growBox( &bounds, positions + i * 3 );
+
+	// the grid lies over the two widest axes, the city's ground, with cells about square
+	int axes[3] = { 0, 1, 2 };
+	float extent[3];
+	for( int i = 0; i < 3; ++i )
+		extent[i] = max( bounds.mMax[i] - bounds.mMin[i], 1e-6f );
+	sort( axes, axes + 3, [&extent]( int a, int b ) { return extent[a] > extent[b]; } );
+	int ax = axes[0], az = axes[1];
+	double cells = max( (double)numTris / max( options.mTrianglesPerChunk, (size_t)1 ), 1.0 );
+	int cols = max( 1, (int)lround( sqrt( cells * extent[ax] / extent[az] ) ) );
+	int rows = max( 1, (int)lround( cells / cols ) );
+
+	// triangles sorted into cells by centroid, keeping their order within each
+	vector<uint32_t> cellOf( numTris ), cellStart( cols * rows + 1, 0 );
+	for( size_t t = 0; t < numTris; ++t ) {
+		const uint32_t *v = indices + t * 3;
+		float x = ( positions[v[0] * 3 + ax] + positions[v[1] * 3 + ax] + positions[v[2] * 3 + ax] ) / 3.0f;
+		float z = ( positions[v[0] * 3 + az] + positions[v[1] * 3 + az] + positions[v[2] * 3 + az] ) / 3.0f;
+		int col = min( cols - 1, max( 0, (int)( ( x - bounds.mMin[ax] ) / extent[ax] * cols ) ) );
+		int row = min( rows - 1, max( 0, (int)( ( z - bounds.mMin[az] ) / extent[az] * rows ) ) );
+		cellOf[t] = (uint32_t)( row * cols + col );
+		++cellStart[cellOf[t] + 1];
+	}
+	for( int i = 0; i < cols * rows; ++i )
+		cellStart[i + 1] += cellStart[i];
+	vector<uint32_t> cellTris( numTris );
+	{
+		vector<uint32_t> fill( cellStart.begin(), cellStart.end() - 1 );
+		for( size_t t = 0; t < numTris; ++t )
+			cellTris[fill[cellOf[t]]++] = (uint32_t)t;
+	}
+
+	vector<uint32_t> remap( numVertices ), stamps( numVertices, 0 ), cellIndices;
+	for( int cell = 0; cell < cols * rows; ++cell ) {
+		if( cellStart[cell] == cellStart[cell + 1] )
+			continue;
+		cellIndices.clear();
+		for( uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; ++i )
+			cellIndices.insert( cellIndices.end(), indices + cellTris[i] * 3, indices + cellTris[i] * 3 + 3 );
+
+		unique_ptr<Chunk> chunk( new Chunk );
+		chunk->mLevels.reserve( mOptions.mNumLevels );
+		chunk->mLevels.push_back( ChunkLevel() );
+		ChunkLevel &level = chunk->mLevels.back();
+		compact( positions, normals, texCoords, cellIndices, remap, (uint32_t)( mChunks.size() + 1 ), stamps, &level );
+		chunk->mBounds = emptyBox();
+		for( size_t i = 0; i < level.getNumVertices(); ++i )
+			growBox( &chunk->mBounds, &level.mPositions[i * 3] );
+		chunk->mPrepared = mOptions.mNumLevels == 1;
+		mChunks.push_back( move( chunk ) );
+	}
+}
+
+void CityChunks::prepare( size_t index )
+{
+	Chunk &chunk = *mChunks[index];
+	if( chunk.mPrepared )
+		return;
+
+	// each level from the one before: cheaper than from the full one, and its error adds to theirs
+	vector<uint32_t> indices, remap, stamps;
+	for( size_t l = 1; l < mOptions.mNumLevels; ++l ) {
+		const ChunkLevel &finer = chunk.mLevels[l - 1];
+		size_t target = (size_t)( finer.getNumTriangles() * mOptions.mReduction );
+		const float *normals = finer.mNormals.empty() ? 0 : &finer.mNormals[0];
+		const float *texCoords = finer.mTexCoords.empty() ? 0 : &finer.mTexCoords[0];
+		float error = MeshSimplifier::simplify( &finer.mPositions[0], normals, finer.getNumVertices(), finer.mIndices, target, &indices );
+
+		ChunkLevel level;
+		remap.resize( finer.getNumVertices() );
+		stamps.assign( finer.getNumVertices(), 0 );
+		compact( &finer.mPositions[0], normals, texCoords, indices, remap, 1, stamps, &level );
+		level.mError = finer.mError + error;
+		chunk.mLevels.push_back( move( level ) );
+	}
+	chunk.mPrepared = true;
+}
+
+ChunkSelector::Stats ChunkSelector::select( const CityChunks &chunks, const ChunkView &view, vector<ChunkDraw> *draws )
+{
+	Stats stats;
+	vector<pair<float, ChunkDraw>> visible;
+	for( size_t i = 0; i < chunks.getNumChunks(); ++i ) {
+		const ChunkBox &box = chunks.getBounds( i );
+		if( ! isVisible( box, view.mViewProjection ) )
+			continue;
+
+		// the error of a level, in pixels, where the box comes nearest the eye
+		float distance = getDistance( box, view.mEye );
+		float pixels = distance > 0.0f ? view.mProjectionScale / distance : numeric_limits<float>::max();
+		uint32_t level = (uint32_t)chunks.getNumLevels( i ) - 1;
+		while( level > 0 && chunks.getLevel( i, level ).mError * pixels > view.mMaxError )
+			--level;
+
+		ChunkDraw draw = { (uint32_t)i, level };
+		visible.push_back( make_pair( distance, draw ) );
+		stats.mTriangles += chunks.getLevel( i, level ).getNumTriangles();
+	}
+	sort( visible.begin(), visible.end(), []( const pair<float, ChunkDraw> &a, const pair<float, ChunkDraw> &b ) { return a.first < b.first; } );
+
+	draws->clear();
+	for( size_t i = 0; i < visible.size(); ++i )
+		draws->push_back( visible[i].second );
+	stats.mVisible = visible.size();
+	return stats;
+}
+
+bool ChunkSelector::isVisible( const ChunkBox &box, const float *m )
+{
+	// each plane is the fourth row of the matrix plus or minus one of the others; the box is out
+	// when even its corner farthest along a plane's normal is behind it
+	for( int i = 0; i < 6; ++i ) {
+		int row = i / 2;
+		float sign = i % 2 ? -1.0f : 1.0f;
+		float plane[4];
+		for( int c = 0; c < 4; ++c )
+			plane[c] = m[c * 4 + 3] + sign * m[c * 4 + row];
+		float d = plane[3];
+		for( int k = 0; k < 3; ++k )
+			d += plane[k] * ( plane[k] > 0.0f ? box.mMax[k] : box.mMin[k] );
+		if( d < 0.0f )
+			return false;
+	}
+	return true;
+}
+
+float ChunkSelector::getDistance( const ChunkBox &box, const float *point )
+{
+	float sum = 0.0f;
+	for( int k = 0; k < 3; ++k ) {
+		float d = max( max( box.mMin[k] - point[k], point[k] - box.mMax[k] ), 0.0f );
+		sum += d * d;
+	}
+	return sqrt( sum );
+}
+
+ChunkStreamer::ChunkStreamer( CityChunks &chunks )
+	: mChunks( chunks ), mTaken( chunks.getNumChunks(), false ), mNumPrepared( 0 ), mQuit( false )
+{
+	for( size_t i = 0; i < mChunks.getNumChunks(); ++i ) {
+		if( mChunks.isPrepared( i ) ) {
+			mTaken[i] = true;
+			++mNumPrepared;
+		}
+	}
+	mWorker = thread( &ChunkStreamer::run, this );
+}
+
+ChunkStreamer::~ChunkStreamer()
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		mQuit = true;
+	}
+	mWake.notify_one();
+	mWorker.join();
+}
+
+void ChunkStreamer::setLookahead( const vector<float> &points )
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		mLookahead = points;
+	}
+	mWake.notify_one();
+}
+
+void ChunkStreamer::takePrepared( vector<size_t> *chunks )
+{
+	lock_guard<mutex> lock( mMutex );
+	chunks->insert( chunks->end(), mPrepared.begin(), mPrepared.end() );
+	mPrepared.clear();
+}
+
+size_t ChunkStreamer::getNumPrepared()
+{
+	lock_guard<mutex> lock( mMutex );
+	return mNumPrepared;
+}
+
+void ChunkStreamer::run()
+{
+	for(;;) {
+		size_t chunk = mTaken.size();
+		{
+			unique_lock<mutex> lock( mMutex );
+			while( ! mQuit ) {
+				// the chunk nearest any point ahead, or the next in line when there are none
+				float nearest = numeric_limits<float>::max();
+				for( size_t i = 0; i < mTaken.size(); ++i ) {
+					if( mTaken[i] )
+						continue;
+					if( mLookahead.size() < 3 ) {
+						chunk = i;
+						break;
+					}
+					for( size_t p = 0; p + 2 < mLookahead.size(); p += 3 ) {
+						float distance = ChunkSelector::getDistance( mChunks.getBounds( i ), &mLookahead[p] );
+						if( distance < nearest ) {
+							nearest = distance;
+							chunk = i;
+						}
+					}
+				}
+				if( chunk < mTaken.size() )
+					break;
+				mWake.wait( lock );
+			}
+			if( mQuit )
+				return;
+			mTaken[chunk] = true;
+		}
+
+		mChunks.prepare( chunk );
+
+		lock_guard<mutex> lock( mMutex );
+		mPrepared.push_back( chunk );
+		++mNumPrepared;
+	}
+}
@@ -1,4 +1,6 @@
 #include "Resources.h"
+#include "CityChunks.h"
+#include "TriMeshImport.h"
 
 #include "cinder/ObjLoader.h"
 #include "cinder/app/AppBasic.h"
@@ -9,6 +11,7 @@
 #include "cinder/gl/Vbo.h"
 #include "cinder/gl/Texture.h"
 #include "cinder/ImageIo.h"
+#include "cinder/Utilities.h"
 
 #include <stdio.h>
 
@@ -35,15 +38,28 @@ class CityTravelApp : public AppBasic {
 	void	draw();
     void    updateCamPosition();
     void    setLocations();
+    void    loadMesh( DataSourceRef source, bool generateNormals );
+    void    updateChunks();
+    void    drawChunks();
+    Vec3f   getFlightPosition( float elapsedTime );
     
     static const int VERTICES_X = 250, VERTICES_Z = 50;
+    static const size_t UPLOAD_TRIANGLES_PER_FRAME = 250000;
 	
 	Arcball			mArcball;
 	MayaCamUI		mMayaCam;
 	TriMesh			mMesh;
+	ObjImporter		mImporter;
 	gl::VboMesh		mVBO, mVboMesh2;
 	gl::GlslProg	mShader;
 	gl::Texture		mTexture;
+	
+	CityChunks						mChunks;
+	std::unique_ptr<ChunkStreamer>	mStreamer;
+	vector<vector<gl::VboMesh> >	mChunkVbos;		// per chunk and level, uploaded as they are first needed
+	vector<ChunkDraw>				mChunkDraws;
+	ChunkSelector::Stats			mChunkStats;
+	bool							mDrawChunks;
     
     vector<Vec3f> myLocations; 
     vector<Vec3f> myLookAts;
@@ -58,9 +74,7 @@ class CityTravelApp : public AppBasic {
 
 void CityTravelApp::setup(){
      setLocations();
-	ObjLoader loader( (DataSourceRef)loadResource( RES_CUBE_OBJ ) );
-	loader.load( &mMesh );
-	mVBO = gl::VboMesh( mMesh );
+	loadMesh( loadResource( RES_CUBE_OBJ ), false );
 	
 	mTexture = gl::Texture( loadImage( loadResource( RES_IMAGE ) ) );
 	mShader = gl::GlslProg( loadResource( RES_SHADER_VERT ), loadResource( RES_SHADER_FRAG ) );
@@ -76,6 +90,58 @@ void CityTravelApp::setup(){
 	mShader.uniform( "tex0", 0 );
 
     programCam = false;
+    mDrawChunks = true;
+}
+
+// Parsed on every core the first time, and mapped from the cache kept in
+// the temporary directory after that
+void CityTravelApp::loadMesh( DataSourceRef source, bool generateNormals )
+{
+	if( ! importObj( mImporter, source, &mMesh, generateNormals, true, getTemporaryDirectory() / "CityTravelMeshes" ) ) {
+		console() << "Unable to load the mesh: " << mImporter.getError() << std::endl;
+		return;
+	}
+	const ObjImporter::Stats &stats = mImporter.getStats();
+	console() << ( stats.mCached ? "Mapped cached mesh in " : "Parsed mesh in " ) << stats.mHashSeconds + stats.mLoadSeconds << "s" << std::endl;
+
+	// the whole mesh goes up only when it is drawn whole, with 'l'
+	mVBO = gl::VboMesh();
+
+	// chunks are cut here and simplified on the streamer's thread, which has to stop before they are cut again
+	mStreamer.reset();
+	mChunkVbos.clear();
+	mChunks.clear();
+	if( mMesh.getIndices().empty() )
+		return;
+	const float *normals = mMesh.getNormals().empty() ? 0 : &mMesh.getNormals()[0].x;
+	const float *texCoords = mMesh.getTexCoords().empty() ? 0 : &mMesh.getTexCoords()[0].x;
+	mChunks.build( &mMesh.getVertices()[0].x, normals, texCoords, mMesh.getNumVertices(), &mMesh.getIndices()[0], mMesh.getIndices().size() );
+	mChunkVbos.resize( mChunks.getNumChunks(), vector<gl::VboMesh>( mChunks.getNumLevels() ) );
+	mStreamer.reset( new ChunkStreamer( mChunks ) );
+	console() << "Cut into " << mChunks.getNumChunks() << " chunks" << std::endl;
+}
+
+namespace {
+	gl::VboMesh createChunkVbo( const ChunkLevel &level )
+	{
+		// a chunk can simplify away to nothing
+		if( level.mPositions.empty() || level.mIndices.empty() )
+			return gl::VboMesh();
+
+		TriMesh mesh;
+		mesh.getVertices().resize( level.getNumVertices() );
+		memcpy( &mesh.getVertices()[0], &level.mPositions[0], level.mPositions.size() * sizeof( float ) );
+		if( ! level.mNormals.empty() ) {
+			mesh.getNormals().resize( level.getNumVertices() );
+			memcpy( &mesh.getNormals()[0], &level.mNormals[0], level.mNormals.size() * sizeof( float ) );
+		}
+		if( ! level.mTexCoords.empty() ) {
+			mesh.getTexCoords().resize( level.getNumVertices() );
+			memcpy( &mesh.getTexCoords()[0], &level.mTexCoords[0], level.mTexCoords.size() * sizeof( float ) );
+		}
+		mesh.getIndices() = level.mIndices;
+		return gl::VboMesh( mesh );
+	}
 }
 
 void CityTravelApp::setupVertices()
@@ -126,8 +192,12 @@ void CityTravelApp::resize( )
 
 void CityTravelApp::updateCamPosition(){
     if (!programCam) return;
-    float elapsedTime = getElapsedSeconds() - startTime;
-    
+    CameraPersp cam = mMayaCam.getCamera();
+    cam.setEyePoint( getFlightPosition( getElapsedSeconds() - startTime ) );
+    mMayaCam.setCurrentCam( cam );
+}
+
+Vec3f CityTravelApp::getFlightPosition( float elapsedTime ){
     float t = elapsedTime / 10.0f; // 2 seconds per section
     int index = floor(t);
     
@@ -149,12 +219,7 @@ void CityTravelApp::updateCamPosition(){
     Vec3f location = cubicInterpolate(myLocations[p0], myLocations[p1], myLocations[p2], myLocations[p3], t);
     
     //cout<< "Loc: "<<location<<" "<<index<<" "<<p0<<" "<<p1<< " "<<p2<<" "<<p3<<" "<<t<<endl;
-    cinder::Vec3f lookat = cubicInterpolate(myLookAts[p0], myLookAts[p1], myLookAts[p2], myLookAts[p3], t);                 
-    CameraPersp cam = mMayaCam.getCamera();
-    cam.setEyePoint( location );
-    //cam.setCenterOfInterestPoint( lookat );
-    mMayaCam.setCurrentCam( cam );
-    
+    return location;
 }
 
 void CityTravelApp::mouseDown( MouseEvent event )
@@ -191,9 +256,7 @@ void CityTravelApp::keyDown( KeyEvent event )
 	if( event.getChar() == 'o' ) {
 		std::string path = getOpenFilePath().string();
 		if( ! path.empty() ) {
-			ObjLoader loader( (DataSourceRef)loadFile( path ) );
-			loader.load( &mMesh, true );
-			mVBO = gl::VboMesh( mMesh );
+			loadMesh( loadFile( path ), true );
 			console() << "Total verts: " << mMesh.getVertices().size() << std::endl;
 		}
 	}
@@ -221,10 +284,38 @@ void CityTravelApp::keyDown( KeyEvent event )
         startTime = getElapsedSeconds();
 		programCam = ! programCam;
 	}
+	else if( event.getChar() == 'l' ) {
+		mDrawChunks = ! mDrawChunks;
+		console() << ( mDrawChunks ? "Drawing chunks" : "Drawing the whole mesh" ) << "; last frame drew " << mChunkStats.mVisible << " of "
+				  << mChunks.getNumChunks() << " chunks, " << mChunkStats.mTriangles << " of " << mChunks.getNumTriangles() << " triangles" << std::endl;
+	}
 }
 
 void CityTravelApp::update(){
     updateCamPosition();
+    updateChunks();
+}
+
+// The streamer simplifies the chunks nearest where the camera is headed
+// first: the next eight seconds of the flight, or where it is now
+void CityTravelApp::updateChunks()
+{
+	if( ! mStreamer )
+		return;
+	Quatf toModel = mArcball.getQuat().inverse();
+	vector<float> lookahead;
+	if( programCam ) {
+		float elapsedTime = getElapsedSeconds() - startTime;
+		for( int i = 0; i <= 8; ++i ) {
+			Vec3f p = toModel * getFlightPosition( elapsedTime + i );
+			lookahead.insert( lookahead.end(), &p.x, &p.x + 3 );
+		}
+	}
+	else {
+		Vec3f p = toModel * mMayaCam.getCamera().getEyePoint();
+		lookahead.insert( lookahead.end(), &p.x, &p.x + 3 );
+	}
+	mStreamer->setLookahead( lookahead );
 }
 
 Vec3f CityTravelApp::cubicInterpolate(Vec3f &p0, Vec3f &p1, Vec3f &p2, Vec3f &p3, float t)
@@ -257,10 +348,57 @@ void CityTravelApp::draw()
 	mShader.bind();
 	gl::pushMatrices();
 		gl::rotate( mArcball.getQuat() );
-		gl::draw( mVBO );
+		if( mDrawChunks ) {
+			drawChunks();
+		}
+		else {
+			if( ! mVBO && mMesh.getNumIndices() )
+				mVBO = gl::VboMesh( mMesh );
+			gl::draw( mVBO );
+		}
 	gl::popMatrices();
 }
 
+// Only the chunks in view, each at the coarsest level that stays within a
+// pixel and a half of the full mesh, in the mesh's own coordinates
+void CityTravelApp::drawChunks()
+{
+	const CameraPersp &cam = mMayaCam.getCamera();
+	Quatf rotation = mArcball.getQuat();
+	Matrix44f viewProjection = cam.getProjectionMatrix() * cam.getModelViewMatrix() * rotation.toMatrix44();
+	Vec3f eye = rotation.inverse() * cam.getEyePoint();
+
+	ChunkView view;
+	std::copy( viewProjection.m, viewProjection.m + 16, view.mViewProjection );
+	std::copy( &eye.x, &eye.x + 3, view.mEye );
+	view.mProjectionScale = getWindowHeight() / ( 2.0f * math<float>::tan( toRadians( cam.getFov() ) / 2.0f ) );
+	view.mMaxError = 1.5f;
+	mChunkStats = ChunkSelector::select( mChunks, view, &mChunkDraws );
+
+	// nearest first, so what is close goes up first; until a level is up, the nearest one that is stands in
+	size_t uploaded = 0;
+	for( size_t i = 0; i < mChunkDraws.size(); ++i ) {
+		const ChunkDraw &draw = mChunkDraws[i];
+		vector<gl::VboMesh> &vbos = mChunkVbos[draw.mChunk];
+		if( ! vbos[draw.mLevel] && ( ! uploaded || uploaded < UPLOAD_TRIANGLES_PER_FRAME ) ) {
+			const ChunkLevel &level = mChunks.getLevel( draw.mChunk, draw.mLevel );
+			vbos[draw.mLevel] = createChunkVbo( level );
+			uploaded += level.getNumTriangles();
+		}
+		for( int offset = 0; offset < (int)vbos.size(); ++offset ) {
+			int finer = (int)draw.mLevel - offset, coarser = (int)draw.mLevel + offset;
+			if( finer >= 0 && vbos[finer] ) {
+				gl::draw( vbos[finer] );
+				break;
+			}
+			if( coarser < (int)vbos.size() && vbos[coarser] ) {
+				gl::draw( vbos[coarser] );
+				break;
+			}
+		}
+	}
+}
+
 void CityTravelApp::setLocations(){
     startTime = getElapsedSeconds();
     myLocations.push_back(Vec3f(47202.7, 35402.1, 47202.7));
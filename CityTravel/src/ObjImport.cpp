@@ -0,0 +1,772 @@
+//
+//  ObjImport.cpp
+//
+
+#include "ObjImport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#if ! defined( _WIN32 )
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+	double secondsSince( const chrono::steady_clock::time_point &start )
+	{
+		return chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+	}
+
+	// the exact powers of ten a double holds
+	const double kPowersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool isSpace( char c )	{ return c == ' ' || c == '\t' || c == '\r'; }
+	inline bool isDigit( char c )	{ return c >= '0' && c <= '9'; }
+
+	const char* skipSpace( const char *p, const char *end )
+	{
+		while( p < end && isSpace( *p ) )
+			++p;
+		return p;
+	}
+
+	const char* skipLine( const char *p, const char *end )
+	{
+		const char *n = (const char *)memchr( p, '\n', end - p );
+		return n ? n + 1 : end;
+	}
+
+	bool parseInt( const char *&p, const char *end, int64_t *value )
+	{
+		const char *s = p;
+		bool negative = false;
+		if( s < end && ( *s == '-' || *s == '+' ) )
+			negative = *s++ == '-';
+		if( s == end || ! isDigit( *s ) )
+			return false;
+		int64_t v = 0;
+		for( ; s < end && isDigit( *s ); ++s )
+			v = min( v * 10 + ( *s - '0' ), (int64_t)1 << 40 );
+		*value = negative ? -v : v;
+		p = s;
+		return true;
+	}
+
+	// one chunk of the file, tokenized on its own
+	struct Chunk {
+		Chunk() : mBegin( 0 ), mEnd( 0 ), mNumTriangles( 0 ), mNumLines( 0 ), mErrorLine( 0 ) { mCounts[0] = mCounts[1] = mCounts[2] = 0; }
+
+		const char					*mBegin, *mEnd;
+		vector<float>				mPositions, mTexCoords, mNormals;
+		size_t						mCounts[3];		// v, vt and vn lines
+		vector<int32_t>				mCorners;		// v, vt and vn per corner, 0-based; -1 when absent
+		vector<uint32_t>			mFaces;			// corners per face; 0 where a group starts
+		vector<pair<size_t, int64_t> >	mRelative;	// corners given as negative indices: slot and index from the chunk's first
+		size_t						mNumTriangles, mNumLines;
+		string						mError;
+		size_t						mErrorLine;
+	};
+
+	bool parseCorner( const char *&p, const char *end, Chunk &chunk )
+	{
+		for( int i = 0; i < 3; ++i ) {
+			int64_t index = 0;
+			bool given = false;
+			if( i == 0 || ( p < end && *p == '/' ) ) {
+				if( i > 0 )
+					++p;
+				given = parseInt( p, end, &index );
+				if( i == 0 && ! given )
+					return false;
+			}
+
+			size_t slot = chunk.mCorners.size();
+			if( ! given ) {
+				chunk.mCorners.push_back( -1 );
+			}
+			else if( index > 0 ) {
+				chunk.mCorners.push_back( (int32_t)min( index - 1, (int64_t)INT32_MAX ) );
+			}
+			else if( index < 0 ) {
+				chunk.mCorners.push_back( -1 );
+				chunk.mRelative.push_back( make_pair( slot, (int64_t)chunk.mCounts[i] + index ) );
+			}
+			else {
+				return false;
+			}
+		}
+		return p == end || isSpace( *p ) || *p == '\n';
+	}
+
+	void tokenize( Chunk &chunk )
+	{
+		const char *p = chunk.mBegin, *end = chunk.mEnd;
+		while( p < end ) {
+			++chunk.mNumLines;
+			p = skipSpace( p, end );
+			const char *line = p;
+			bool ok = true;
+
+			if( p + 1 < end && p[0] == 'v' && isSpace( p[1] ) ) {
+				p += 2;
+				float xyz[3];
+				for( int i = 0; i < 3 && ok; ++i )
+					ok = ObjParser::parseFloat( p, end, &xyz[i] );
+				chunk.mPositions.insert( chunk.mPositions.end(), xyz, xyz + 3 );
+				++chunk.mCounts[0];
+			}
+			else if( p + 2 < end && p[0] == 'v' && p[1] == 't' && isSpace( p[2] ) ) {
+				p += 3;
+				float uv[2] = { 0.0f, 0.0f };
+				ok = ObjParser::parseFloat( p, end, &uv[0] );
+				ObjParser::parseFloat( p, end, &uv[1] );
+				chunk.mTexCoords.insert( chunk.mTexCoords.end(), uv, uv + 2 );
+				++chunk.mCounts[1];
+			}
+			else if( p + 2 < end && p[0] == 'v' && p[1] == 'n' && isSpace( p[2] ) ) {
+				p += 3;
+				float xyz[3];
+				for( int i = 0; i < 3 && ok; ++i )
+					ok = ObjParser::parseFloat( p, end, &xyz[i] );
+				chunk.mNormals.insert( chunk.mNormals.end(), xyz, xyz + 3 );
+				++chunk.mCounts[2];
+			}
+			else if( p + 1 < end && p[0] == 'f' && isSpace( p[1] ) ) {
+				p += 2;
+				uint32_t corners = 0;
+				for(;;) {
+					p = skipSpace( p, end );
+					if( p == end || *p == '\n' || *p == '#' )
+						break;
+					if( ! parseCorner( p, end, chunk ) ) {
+						ok = false;
+						break;
+					}
+					++corners;
+				}
+				chunk.mFaces.push_back( corners );
+				chunk.mNumTriangles += corners > 2 ? corners - 2 : 0;
+			}
+			else if( p < end && p[0] == 'g' && ( p + 1 == end || isSpace( p[1] ) || p[1] == '\n' ) ) {
+				chunk.mFaces.push_back( 0 );
+			}
+
+			if( ! ok ) {
+				const char *lineEnd = skipLine( line, end );
+				while( lineEnd > line && ( lineEnd[-1] == '\n' || lineEnd[-1] == '\r' ) )
+					--lineEnd;
+				chunk.mError = "cannot read \"" + string( line, lineEnd ) + "\"";
+				chunk.mErrorLine = chunk.mNumLines;
+				return;
+			}
+			p = skipLine( p, end );
+		}
+	}
+
+	// (v, vt, vn) to the welded vertex, for one group at a time. Each position heads a list of
+	// the (vt, vn) pairs seen with it, so lookups follow the faces' own locality through the file
+	class WeldTable {
+	  public:
+		WeldTable() : mGeneration( 1 ) {}
+
+		void reserve( size_t numPositions )
+		{
+			mHeads.assign( numPositions, Entry() );
+			mNodes.clear();
+		}
+
+		// a new group starts empty without clearing the heads
+		void nextGroup()
+		{
+			++mGeneration;
+			mNodes.clear();
+		}
+
+		// the vertex already welded to \a key, or \a index when it is new
+		uint32_t insert( const int32_t *key, uint32_t index )
+		{
+			Entry *entry = &mHeads[key[0]];
+			if( entry->mGeneration != mGeneration ) {
+				*entry = Entry( key, index, mGeneration );
+				return index;
+			}
+			for(;;) {
+				if( entry->mTexCoord == key[1] && entry->mNormal == key[2] )
+					return entry->mIndex;
+				if( entry->mNext < 0 )
+					break;
+				entry = &mNodes[entry->mNext];
+			}
+			entry->mNext = (int32_t)mNodes.size();
+			mNodes.push_back( Entry( key, index, mGeneration ) );
+			return index;
+		}
+
+	  private:
+		struct Entry {
+			Entry() : mTexCoord( -1 ), mNormal( -1 ), mIndex( 0 ), mGeneration( 0 ), mNext( -1 ) {}
+			Entry( const int32_t *key, uint32_t index, uint32_t generation ) : mTexCoord( key[1] ), mNormal( key[2] ), mIndex( index ), mGeneration( generation ), mNext( -1 ) {}
+
+			int32_t		mTexCoord, mNormal;
+			uint32_t	mIndex, mGeneration;
+			int32_t		mNext;
+		};
+
+		vector<Entry>	mHeads, mNodes;
+		uint32_t		mGeneration;
+	};
+
+	const uint64_t kHashMultiplier = 0xFF51AFD7ED558CCDull;
+}
+
+void ObjMesh::clear()
+{
+	mPositions.clear();
+	mNormals.clear();
+	mTexCoords.clear();
+	mIndices.clear();
+}
+
+ObjParser::ObjParser( size_t numThreads )
+	: mNumThreads( numThreads ? numThreads : max( thread::hardware_concurrency(), 1u ) )
+{
+}
+
+bool ObjParser::parseFloat( const char *&p, const char *end, float *value )
+{
+	const char *s = skipSpace( p, end ), *start = s;
+	bool negative = false;
+	if( s < end && ( *s == '-' || *s == '+' ) )
+		negative = *s++ == '-';
+
+	// up to 19 significant digits go in the mantissa, the rest only move the exponent
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool any = false;
+	for( ; s < end && isDigit( *s ); ++s, any = true ) {
+		if( digits < 19 ) {
+			mantissa = mantissa * 10 + ( *s - '0' );
+			digits += mantissa != 0;
+		}
+		else {
+			++exponent;
+		}
+	}
+	if( s < end && *s == '.' ) {
+		for( ++s; s < end && isDigit( *s ); ++s, any = true ) {
+			if( digits < 19 ) {
+				mantissa = mantissa * 10 + ( *s - '0' );
+				digits += mantissa != 0;
+				--exponent;
+			}
+		}
+	}
+	if( any && s < end && ( *s == 'e' || *s == 'E' ) ) {
+		const char *e = s + 1;
+		int64_t power;
+		if( parseInt( e, end, &power ) ) {
+			exponent += (int)max( min( power, (int64_t)100000 ), (int64_t)-100000 );
+			s = e;
+		}
+	}
+
+	// exact in a double and scaled by an exact power of ten, the one rounding is strtod()'s
+	if( any && mantissa <= ( 1ull << 53 ) && exponent >= -22 && exponent <= 22 ) {
+		double result = (double)mantissa;
+		result = exponent < 0 ? result / kPowersOfTen[-exponent] : result * kPowersOfTen[exponent];
+		*value = (float)( negative ? -result : result );
+		p = s;
+		return true;
+	}
+
+	// long mantissas, large exponents, inf and nan
+	char token[64];
+	size_t length = 0;
+	while( start + length < end && length + 1 < sizeof( token ) && ! isSpace( start[length] ) && start[length] != '\n' ) {
+		token[length] = start[length];
+		++length;
+	}
+	token[length] = 0;
+	char *parsed;
+	double result = strtod( token, &parsed );
+	if( parsed == token )
+		return false;
+	*value = (float)result;
+	p = start + ( parsed - token );
+	return true;
+}
+
+bool ObjParser::parse( const char *data, size_t size, ObjMesh *mesh, bool generateNormals, bool includeUVs )
+{
+	mError.clear();
+	mStats = Stats();
+	mesh->clear();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	// chunks of at least a quarter megabyte, a few per thread so a slow one does not hold up the rest
+	const size_t minChunk = 256 * 1024;
+	size_t numChunks = max( min( mNumThreads * 4, size / minChunk ), (size_t)1 );
+	vector<Chunk> chunks( numChunks );
+	const char *end = data + size, *p = data;
+	for( size_t i = 0; i < numChunks; ++i ) {
+		chunks[i].mBegin = p;
+		p = i + 1 == numChunks ? end : skipLine( min( data + size / numChunks * ( i + 1 ), end ), end );
+		p = max( p, chunks[i].mBegin );
+		chunks[i].mEnd = p;
+	}
+
+	size_t numThreads = min( mNumThreads, numChunks );
+	atomic<size_t> next( 0 );
+	vector<thread> workers;
+	for( size_t t = 1; t < numThreads; ++t ) {
+		workers.push_back( thread( [&] {
+			for( size_t i = next++; i < numChunks; i = next++ )
+				tokenize( chunks[i] );
+		} ) );
+	}
+	for( size_t i = next++; i < numChunks; i = next++ )
+		tokenize( chunks[i] );
+	for( size_t t = 0; t < workers.size(); ++t )
+		workers[t].join();
+	mStats.mNumThreads = numThreads;
+	mStats.mNumChunks = numChunks;
+	mStats.mTokenizeSeconds = secondsSince( start );
+	start = chrono::steady_clock::now();
+
+	// where each chunk's v, vt and vn lines start in the whole file
+	vector<size_t> bases( numChunks * 3 );
+	size_t totals[3] = { 0, 0, 0 }, triangles = 0, lines = 0;
+	for( size_t i = 0; i < numChunks; ++i ) {
+		Chunk &chunk = chunks[i];
+		if( ! chunk.mError.empty() ) {
+			char number[24];
+			sprintf( number, "%llu", (unsigned long long)( lines + chunk.mErrorLine ) );
+			mError = "line " + string( number ) + ": " + chunk.mError;
+			return false;
+		}
+		lines += chunk.mNumLines;
+		triangles += chunk.mNumTriangles;
+		for( int k = 0; k < 3; ++k ) {
+			bases[i * 3 + k] = totals[k];
+			totals[k] += chunk.mCounts[k];
+		}
+	}
+
+	vector<float> positions, texCoords, normals;
+	positions.reserve( totals[0] * 3 );
+	texCoords.reserve( totals[1] * 2 );
+	normals.reserve( totals[2] * 3 );
+	for( size_t i = 0; i < numChunks; ++i ) {
+		Chunk &chunk = chunks[i];
+		positions.insert( positions.end(), chunk.mPositions.begin(), chunk.mPositions.end() );
+		texCoords.insert( texCoords.end(), chunk.mTexCoords.begin(), chunk.mTexCoords.end() );
+		normals.insert( normals.end(), chunk.mNormals.begin(), chunk.mNormals.end() );
+		vector<float>().swap( chunk.mPositions );
+		vector<float>().swap( chunk.mTexCoords );
+		vector<float>().swap( chunk.mNormals );
+		for( size_t r = 0; r < chunk.mRelative.size(); ++r ) {
+			size_t slot = chunk.mRelative[r].first;
+			int64_t index = (int64_t)bases[i * 3 + slot % 3] + chunk.mRelative[r].second;
+			chunk.mCorners[slot] = index < 0 ? INT32_MAX : (int32_t)index;
+		}
+	}
+	mStats.mMergeSeconds = secondsSince( start );
+	start = chrono::steady_clock::now();
+
+	// the corners, welded in file order
+	const bool uvs = includeUVs && totals[1] > 0;
+	WeldTable table;
+	table.reserve( totals[0] );
+	mesh->mPositions.reserve( totals[0] * 3 );
+	mesh->mNormals.reserve( generateNormals ? totals[0] * 3 : 0 );
+	mesh->mTexCoords.reserve( uvs ? totals[0] * 2 : 0 );
+	mesh->mIndices.reserve( triangles * 3 );
+	vector<uint32_t> face;
+	for( size_t i = 0; i < numChunks; ++i ) {
+		const Chunk &chunk = chunks[i];
+		const int32_t *corners = chunk.mCorners.empty() ? 0 : &chunk.mCorners[0];
+		for( size_t f = 0; f < chunk.mFaces.size(); ++f ) {
+			uint32_t n = chunk.mFaces[f];
+			if( n == 0 ) {
+				table.nextGroup();
+				continue;
+			}
+			const int32_t *c = corners;
+			corners += n * 3;
+			if( n < 3 )
+				continue;
+
+			for( uint32_t k = 0; k < n; ++k ) {
+				const int32_t *corner = c + k * 3;
+				if( corner[0] < 0 || (size_t)corner[0] >= totals[0] || ( uvs && corner[1] >= 0 && (size_t)corner[1] >= totals[1] )
+						|| ( generateNormals && corner[2] >= 0 && (size_t)corner[2] >= totals[2] ) ) {
+					mError = "face index out of range";
+					mesh->clear();
+					return false;
+				}
+			}
+
+			// a face without normals gets its own vertices and a flat normal, as ObjLoader gives it
+			const bool flat = generateNormals && c[2] < 0;
+			float normal[3] = { 0.0f, 0.0f, 0.0f };
+			if( flat ) {
+				const float *p0 = &positions[c[0] * 3], *p1 = &positions[c[3] * 3], *p2 = &positions[c[6] * 3];
+				float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				normal[0] = e0[1] * e1[2] - e0[2] * e1[1];
+				normal[1] = e0[2] * e1[0] - e0[0] * e1[2];
+				normal[2] = e0[0] * e1[1] - e0[1] * e1[0];
+				float length = sqrt( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+				if( length > 0.0f )
+					for( int k = 0; k < 3; ++k )
+						normal[k] /= length;
+			}
+
+			face.clear();
+			for( uint32_t k = 0; k < n; ++k ) {
+				const int32_t *corner = c + k * 3;
+				uint32_t index = (uint32_t)mesh->getNumVertices();
+				if( ! flat ) {
+					int32_t key[3] = { corner[0], uvs ? corner[1] : -1, generateNormals ? corner[2] : -1 };
+					index = table.insert( key, index );
+				}
+				face.push_back( index );
+				if( index < mesh->getNumVertices() )
+					continue;
+
+				const float *position = &positions[corner[0] * 3];
+				mesh->mPositions.insert( mesh->mPositions.end(), position, position + 3 );
+				if( generateNormals ) {
+					const float *n = flat || corner[2] < 0 ? normal : &normals[corner[2] * 3];
+					mesh->mNormals.insert( mesh->mNormals.end(), n, n + 3 );
+				}
+				if( uvs ) {
+					static const float none[2] = { 0.0f, 0.0f };
+					const float *uv = corner[1] >= 0 ? &texCoords[corner[1] * 2] : none;
+					mesh->mTexCoords.insert( mesh->mTexCoords.end(), uv, uv + 2 );
+				}
+			}
+
+			for( uint32_t k = 0; k + 2 < n; ++k ) {
+				mesh->mIndices.push_back( face[0] );
+				mesh->mIndices.push_back( face[k + 1] );
+				mesh->mIndices.push_back( face[k + 2] );
+			}
+		}
+	}
+	mStats.mWeldSeconds = secondsSince( start );
+	return true;
+}
+
+struct MeshCache::Header {
+	enum { HAS_NORMALS = 1, HAS_TEXCOORDS = 2 };
+
+	char		mMagic[8];
+	uint32_t	mVersion, mByteOrder;
+	uint64_t	mSourceHash, mSourceSize;
+	uint32_t	mOptions, mFlags;
+	uint64_t	mNumVertices, mNumIndices;
+	uint64_t	mPositions, mNormals, mTexCoords, mIndices;	// byte offsets; 0 for none
+	uint64_t	mFileSize;
+};
+
+namespace {
+	const char		kMagic[8] = { 'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E' };
+	const uint32_t	kByteOrder = 0x01020304;
+
+	uint64_t align( uint64_t offset )	{ return ( offset + 15 ) & ~(uint64_t)15; }
+}
+
+MeshCache::MeshCache()
+	: mHeader( 0 ), mMapping( 0 ), mMappedSize( 0 )
+{
+}
+
+MeshCache::~MeshCache()
+{
+	close();
+}
+
+bool MeshCache::open( const string &path, uint64_t sourceHash, uint64_t sourceSize, uint32_t options )
+{
+	close();
+
+	const void *data = 0;
+	size_t size = 0;
+#if ! defined( _WIN32 )
+	int file = ::open( path.c_str(), O_RDONLY );
+	if( file < 0 )
+		return false;
+	struct stat info;
+	if( fstat( file, &info ) == 0 && (size_t)info.st_size >= sizeof( Header ) ) {
+		void *mapping = mmap( 0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0 );
+		if( mapping != MAP_FAILED ) {
+			mMapping = mapping;
+			mMappedSize = (size_t)info.st_size;
+			data = mapping;
+			size = mMappedSize;
+		}
+	}
+	::close( file );
+#else
+	ifstream file( path.c_str(), ios::binary );
+	if( file ) {
+		file.seekg( 0, ios::end );
+		size = (size_t)file.tellg();
+		file.seekg( 0 );
+		mBuffer.resize( ( size + 7 ) / 8 );
+		if( size < sizeof( Header ) || ! file.read( (char *)&mBuffer[0], size ) )
+			size = 0;
+		data = size ? &mBuffer[0] : 0;
+	}
+#endif
+	if( ! data ) {
+		close();
+		return false;
+	}
+
+	// anything that does not match exactly is stale or broken
+	const Header *header = (const Header *)data;
+	uint64_t vertices = header->mNumVertices, indices = header->mNumIndices;
+	bool valid = memcmp( header->mMagic, kMagic, sizeof( kMagic ) ) == 0 && header->mVersion == kVersion && header->mByteOrder == kByteOrder
+		&& header->mSourceHash == sourceHash && header->mSourceSize == sourceSize && header->mOptions == options && header->mFileSize == size
+		&& vertices <= size && indices <= size
+		&& header->mPositions >= sizeof( Header ) && header->mPositions + vertices * 12 <= size
+		&& header->mIndices >= sizeof( Header ) && header->mIndices + indices * 4 <= size
+		&& ( ! ( header->mFlags & Header::HAS_NORMALS ) || ( header->mNormals >= sizeof( Header ) && header->mNormals + vertices * 12 <= size ) )
+		&& ( ! ( header->mFlags & Header::HAS_TEXCOORDS ) || ( header->mTexCoords >= sizeof( Header ) && header->mTexCoords + vertices * 8 <= size ) );
+	if( ! valid ) {
+		close();
+		return false;
+	}
+	mHeader = header;
+	return true;
+}
+
+void MeshCache::close()
+{
+#if ! defined( _WIN32 )
+	if( mMapping )
+		munmap( mMapping, mMappedSize );
+#endif
+	mMapping = 0;
+	mMappedSize = 0;
+	mHeader = 0;
+	vector<uint64_t>().swap( mBuffer );
+}
+
+const void* MeshCache::getArray( uint64_t offset ) const
+{
+	return (const uint8_t *)mHeader + offset;
+}
+
+size_t MeshCache::getNumVertices() const
+{
+	return mHeader ? (size_t)mHeader->mNumVertices : 0;
+}
+
+size_t MeshCache::getNumIndices() const
+{
+	return mHeader ? (size_t)mHeader->mNumIndices : 0;
+}
+
+const float* MeshCache::getPositions() const
+{
+	return mHeader ? (const float *)getArray( mHeader->mPositions ) : 0;
+}
+
+const float* MeshCache::getNormals() const
+{
+	return mHeader && ( mHeader->mFlags & Header::HAS_NORMALS ) ? (const float *)getArray( mHeader->mNormals ) : 0;
+}
+
+const float* MeshCache::getTexCoords() const
+{
+	return mHeader && ( mHeader->mFlags & Header::HAS_TEXCOORDS ) ? (const float *)getArray( mHeader->mTexCoords ) : 0;
+}
+
+const uint32_t* MeshCache::getIndices() const
+{
+	return mHeader ? (const uint32_t *)getArray( mHeader->mIndices ) : 0;
+}
+
+bool MeshCache::write( const string &path, const ObjMesh &mesh, uint64_t sourceHash, uint64_t sourceSize, uint32_t options )
+{
+	Header header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.mMagic, kMagic, sizeof( kMagic ) );
+	header.mVersion = kVersion;
+	header.mByteOrder = kByteOrder;
+	header.mSourceHash = sourceHash;
+	header.mSourceSize = sourceSize;
+	header.mOptions = options;
+	header.mNumVertices = mesh.getNumVertices();
+	header.mNumIndices = mesh.mIndices.size();
+
+	// each array on a 16 byte boundary, so a mapped file can be used in place
+	uint64_t offset = align( sizeof( Header ) );
+	header.mPositions = offset;
+	offset = align( offset + mesh.mPositions.size() * sizeof( float ) );
+	if( ! mesh.mNormals.empty() ) {
+		header.mFlags |= Header::HAS_NORMALS;
+		header.mNormals = offset;
+		offset = align( offset + mesh.mNormals.size() * sizeof( float ) );
+	}
+	if( ! mesh.mTexCoords.empty() ) {
+		header.mFlags |= Header::HAS_TEXCOORDS;
+		header.mTexCoords = offset;
+		offset = align( offset + mesh.mTexCoords.size() * sizeof( float ) );
+	}
+	header.mIndices = offset;
+	header.mFileSize = offset + mesh.mIndices.size() * sizeof( uint32_t );
+
+	string temporary = path + ".tmp";
+	{
+		ofstream file( temporary.c_str(), ios::binary | ios::trunc );
+		const char padding[16] = { 0 };
+		uint64_t written = 0;
+		const uint64_t offsets[] = { 0, header.mPositions, header.mNormals, header.mTexCoords, header.mIndices };
+		const void *arrays[] = { &header, mesh.mPositions.empty() ? 0 : &mesh.mPositions[0], mesh.mNormals.empty() ? 0 : &mesh.mNormals[0],
+								 mesh.mTexCoords.empty() ? 0 : &mesh.mTexCoords[0], mesh.mIndices.empty() ? 0 : &mesh.mIndices[0] };
+		const size_t sizes[] = { sizeof( Header ), mesh.mPositions.size() * sizeof( float ), mesh.mNormals.size() * sizeof( float ),
+								 mesh.mTexCoords.size() * sizeof( float ), mesh.mIndices.size() * sizeof( uint32_t ) };
+		for( int i = 0; i < 5 && file; ++i ) {
+			if( ! arrays[i] )
+				continue;
+			file.write( padding, offsets[i] - written );
+			file.write( (const char *)arrays[i], sizes[i] );
+			written = offsets[i] + sizes[i];
+		}
+		if( ! file ) {
+			file.close();
+			remove( temporary.c_str() );
+			return false;
+		}
+	}
+
+	// rename() does not replace an existing file everywhere
+	remove( path.c_str() );
+	return rename( temporary.c_str(), path.c_str() ) == 0;
+}
+
+uint64_t MeshCache::hash( const void *data, size_t size )
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+	uint64_t h = 0x9E3779B97F4A7C15ull ^ size;
+	size_t words = size / 8;
+	for( size_t i = 0; i < words; ++i ) {
+		uint64_t word;
+		memcpy( &word, bytes + i * 8, 8 );
+		h = ( h ^ word ) * kHashMultiplier;
+		h ^= h >> 32;
+	}
+	uint64_t tail = 0;
+	memcpy( &tail, bytes + words * 8, size - words * 8 );
+	h = ( h ^ tail ) * kHashMultiplier;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	return h ^ ( h >> 33 );
+}
+
+ObjImporter::ObjImporter( size_t numThreads )
+	: mParser( numThreads )
+{
+}
+
+bool ObjImporter::load( const char *data, size_t size, bool generateNormals, bool includeUVs, const string &cacheDirectory )
+{
+	mStats = Stats();
+	mCache.close();
+	mMesh.clear();
+	const uint32_t options = ( generateNormals ? 1 : 0 ) | ( includeUVs ? 2 : 0 );
+
+	string path;
+	uint64_t sourceHash = 0;
+	if( ! cacheDirectory.empty() ) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		sourceHash = MeshCache::hash( data, size );
+		mStats.mHashSeconds = secondsSince( start );
+		path = getCachePath( cacheDirectory, sourceHash );
+
+		start = chrono::steady_clock::now();
+		mStats.mCached = mCache.open( path, sourceHash, size, options );
+		mStats.mLoadSeconds = secondsSince( start );
+		if( mStats.mCached )
+			return true;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	bool parsed = mParser.parse( data, size, &mMesh, generateNormals, includeUVs );
+	mStats.mParse = mParser.getStats();
+	mStats.mLoadSeconds = secondsSince( start );
+	if( ! parsed )
+		return false;
+
+	// a cache that cannot be written only costs the next launch the parse
+	if( ! path.empty() ) {
+		start = chrono::steady_clock::now();
+		MeshCache::write( path, mMesh, sourceHash, size, options );
+		mStats.mWriteSeconds = secondsSince( start );
+	}
+	return true;
+}
+
+size_t ObjImporter::getNumVertices() const
+{
+	return mCache.isOpen() ? mCache.getNumVertices() : mMesh.getNumVertices();
+}
+
+size_t ObjImporter::getNumIndices() const
+{
+	return mCache.isOpen() ? mCache.getNumIndices() : mMesh.mIndices.size();
+}
+
+const float* ObjImporter::getPositions() const
+{
+	if( mCache.isOpen() )
+		return mCache.getPositions();
+	return mMesh.mPositions.empty() ? 0 : &mMesh.mPositions[0];
+}
+
+const float* ObjImporter::getNormals() const
+{
+	if( mCache.isOpen() )
+		return mCache.getNormals();
+	return mMesh.mNormals.empty() ? 0 : &mMesh.mNormals[0];
+}
+
+const float* ObjImporter::getTexCoords() const
+{
+	if( mCache.isOpen() )
+		return mCache.getTexCoords();
+	return mMesh.mTexCoords.empty() ? 0 : &mMesh.mTexCoords[0];
+}
+
+const uint32_t* ObjImporter::getIndices() const
+{
+	if( mCache.isOpen() )
+		return mCache.getIndices();
+	return mMesh.mIndices.empty() ? 0 : &mMesh.mIndices[0];
+}
+
+string ObjImporter::getCachePath( const string &cacheDirectory, uint64_t sourceHash )
+{
+	char name[32];
+	sprintf( name, "%016llx.objcache", (unsigned long long)sourceHash );
+	return cacheDirectory + "/" + name;
+}
@@ -7,6 +7,8 @@
 #include "cinder/audio/Input.h"
 #include "cinder/audio/FftProcessor.h"
 
+#include "Waveform.h"
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
@@ -56,6 +58,9 @@ protected:
     audio::PcmBuffer32fRef mPcmBuffer;
     std::shared_ptr<float> mFftDataRef;
     
+    WaveformLine mLeftLine;
+    WaveformLine mRightLine;
+    
     void drawWaveForm();
     void setupAudio();
 };
@@ -173,25 +178,18 @@ void GeometryShaderApp::drawWaveForm()
 	audio::Buffer32fRef leftBuffer = mPcmBuffer->getChannelData( audio::CHANNEL_FRONT_LEFT );
 	audio::Buffer32fRef rightBuffer = mPcmBuffer->getChannelData( audio::CHANNEL_FRONT_RIGHT );
     
-	int displaySize = getWindowWidth();
-	float scale = displaySize / (float)bufferLength;
-	
-	PolyLine<Vec2f>	leftBufferLine;
-	PolyLine<Vec2f>	rightBufferLine;
+	// the lines keep their vertex arrays between frames and fold the buffer to two vertices per pixel column
+	float displaySize = (float)getWindowWidth();
+	mLeftLine.update( leftBuffer->mData, bufferLength, displaySize, -1.0f, -100.0f );
+	mRightLine.update( rightBuffer->mData, bufferLength, displaySize, -1.0f, -100.0f );
 	
-	for( int i = 0; i < bufferLength; i++ ) {
-		float x = ( i * scale );
-        
-		//get the PCM value from the left channel buffer
-		float y = ( ( leftBuffer->mData[i] - 1 ) * - 100 );
-		leftBufferLine.push_back( Vec2f( x , y) );
-		
-		y = ( ( rightBuffer->mData[i] - 1 ) * - 100 );
-		rightBufferLine.push_back( Vec2f( x , y) );
-	}
 	gl::color( Color( 1.0f, 0.5f, 0.25f ) );
-	gl::draw( leftBufferLine );
-	gl::draw( rightBufferLine );
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 2, GL_FLOAT, 0, mLeftLine.getVertices() );
+	glDrawArrays( GL_LINE_STRIP, 0, mLeftLine.getNumVertices() );
+	glVertexPointer( 2, GL_FLOAT, 0, mRightLine.getVertices() );
+	glDrawArrays( GL_LINE_STRIP, 0, mRightLine.getNumVertices() );
+	glDisableClientState( GL_VERTEX_ARRAY );
 	
 }
 
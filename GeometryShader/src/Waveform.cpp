@@ -0,0 +1,111 @@
+//
+//  Waveform.cpp
+//
+
+#include "Waveform.h"
+
+#include <algorithm>
+#include <cstring>
+
+WaveformLine::WaveformLine()
+	: mNumVertices( 0 )
+{
+}
+
+void WaveformLine::update( const float *samples, size_t count, float width, float bias, float gain )
+{
+	size_t numColumns = std::max<size_t>( (size_t)width, 1 );
+	bool decimate = count > numColumns * 2;
+	size_t numVertices = decimate ? numColumns * 2 : count;
+	if( mVertices.size() < numVertices * 2 )
+		mVertices.resize( numVertices * 2 );
+
+	float scale = width / (float)count;
+	float *v = mVertices.empty() ? 0 : &mVertices[0];
+
+	if( ! decimate ) {
+		for( size_t i = 0; i < count; ++i ) {
+			v[i * 2] = i * scale;
+			v[i * 2 + 1] = ( samples[i] + bias ) * gain;
+		}
+		mNumVertices = count;
+		return;
+	}
+
+	size_t begin = 0;
+	for( size_t c = 0; c < numColumns; ++c ) {
+		size_t end = ( c + 1 ) * count / numColumns;
+		size_t lo = begin, hi = begin;
+		for( size_t i = begin + 1; i < end; ++i ) {
+			if( samples[i] < samples[lo] ) lo = i;
+			if( samples[i] > samples[hi] ) hi = i;
+		}
+		size_t first = std::min( lo, hi ), second = std::max( lo, hi );
+		v[0] = first * scale;
+		v[1] = ( samples[first] + bias ) * gain;
+		v[2] = second * scale;
+		v[3] = ( samples[second] + bias ) * gain;
+		v += 4;
+		begin = end;
+	}
+	mNumVertices = numVertices;
+}
+
+WaveformRows::WaveformRows()
+	: mPixels( 0 ), mWidth( 0 ), mHeight( 0 ), mRowStep( 0 ), mRowStride( 0 )
+{
+}
+
+void WaveformRows::fillRow( float *row, const float *values, size_t count, int width, float bias, float gain, bool stretch )
+{
+	int numValues = stretch ? width : (int)std::min<size_t>( count, (size_t)width );
+	if( stretch && count == 0 )
+		numValues = 0;
+
+	// red only; green, blue and alpha were written once with the rest of the row
+	if( stretch ) {
+		for( int x = 0; x < numValues; ++x )
+			row[x * 4] = ( values[(size_t)x * count / width] + bias ) * gain;
+	}
+	else {
+		for( int x = 0; x < numValues; ++x )
+			row[x * 4] = ( values[x] + bias ) * gain;
+	}
+	for( int x = numValues; x < width; ++x )
+		row[x * 4] = 0.0f;
+}
+
+void WaveformRows::update( const float *values, size_t count, float *pixels, int width, int height, size_t rowStride,
+						   int rowStep, float bias, float gain, bool stretch )
+{
+	rowStep = std::max( rowStep, 1 );
+	size_t rowBytes = (size_t)width * 4 * sizeof( float );
+
+	if( mRow.size() < (size_t)width * 4 ) {
+		mRow.resize( (size_t)width * 4 );
+		mPixels = 0;
+	}
+	float *row = &mRow[0];
+
+	if( pixels != mPixels || width != mWidth || height != mHeight || rowStride != mRowStride || rowStep != mRowStep ) {
+		for( int x = 0; x < width; ++x ) {
+			row[x * 4] = 0.0f;
+			row[x * 4 + 1] = 0.0f;
+			row[x * 4 + 2] = 0.0f;
+			row[x * 4 + 3] = 1.0f;
+		}
+		for( int y = 0; y < height; ++y ) {
+			if( y % rowStep != 0 )
+				std::memcpy( pixels + y * rowStride, row, rowBytes );
+		}
+		mPixels = pixels;
+		mWidth = width;
+		mHeight = height;
+		mRowStride = rowStride;
+		mRowStep = rowStep;
+	}
+
+	fillRow( row, values, count, width, bias, gain, stretch );
+	for( int y = 0; y < height; y += rowStep )
+		std::memcpy( pixels + y * rowStride, row, rowBytes );
+}
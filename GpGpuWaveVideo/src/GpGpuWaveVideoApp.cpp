@@ -37,8 +37,11 @@
 
 #include "cinder/Color.h"
 #include "cinder/ImageIo.h"
+#include "cinder/Timer.h"
 #include "cinder/Utilities.h"
 
+#include <sstream>
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
@@ -51,47 +54,63 @@ void GpGpuWaveVideoApp::draw()
 	///////////////////////////////////////////////////////////////
 	// GPGPU pass
 
-	// Enable text
-	gl::enable( GL_TEXTURE_2D );
-	gl::color( Colorf::white() );
-
-	// Bind the other FBO to draw onto it
 	size_t pong = ( mFboIndex + 1 ) % 2;
-	mFbo[ pong ].bindFramebuffer();
 
-	// Set up the window to match the FBO
-	gl::setViewport( mFbo[ mFboIndex ].getBounds() );
-	gl::setMatricesWindow( mFbo[ mFboIndex ].getSize(), false );
-	gl::clear();
+	if ( mCpu ) {
 
-	// Bind the texture from the FBO on which we last 
-	// wrote data
-	mFbo[ mFboIndex ].bindTexture();
+		// Step on the CPU and hand the result to the refraction
+		// pass as though the shader had written it
+		mSolver->step();
+		if ( mMouseDown ) {
+			mSolver->impulse( (float)mMouse.x, (float)mMouse.y );
+		}
+		mSolver->getState( &mState[ 0 ], kWindowSize.x * 4 );
+		mFbo[ pong ].getTexture().bind();
+		glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, kWindowSize.x, kWindowSize.y, GL_RGBA, GL_FLOAT, &mState[ 0 ] );
+		mFbo[ pong ].getTexture().unbind();
+	} else {
 
-	// Bind and configure the GPGPU shader
-	mShaderGpGpu.bind();
-	mShaderGpGpu.uniform( "buffer", 0 ); 
-	mShaderGpGpu.uniform( "pixel", kPixel );
+		// Enable text
+		gl::enable( GL_TEXTURE_2D );
+		gl::color( Colorf::white() );
 
-	// Draw a fullscreen rectangle to process data
-	drawFullScreenRect();
+		// Bind the other FBO to draw onto it
+		mFbo[ pong ].bindFramebuffer();
 
-	// End shader output
-	mShaderGpGpu.unbind();
+		// Set up the window to match the FBO
+		gl::setViewport( mFbo[ mFboIndex ].getBounds() );
+		gl::setMatricesWindow( mFbo[ mFboIndex ].getSize(), false );
+		gl::clear();
 
-	// Unbind and disable textures
-	mFbo[ mFboIndex ].unbindTexture();
-	gl::disable( GL_TEXTURE_2D );
+		// Bind the texture from the FBO on which we last 
+		// wrote data
+		mFbo[ mFboIndex ].bindTexture();
 
-	// Draw mouse input into red channel
-	if ( mMouseDown ) {
-		gl::color( ColorAf( 1.0f, 0.0f, 0.0f, 1.0f ) );
-		gl::drawSolidCircle( Vec2f( mMouse ), 5.0f, 32 );
-		gl::color( Color::white() );
-	}
+		// Bind and configure the GPGPU shader
+		mShaderGpGpu.bind();
+		mShaderGpGpu.uniform( "buffer", 0 ); 
+		mShaderGpGpu.uniform( "pixel", kPixel );
+
+		// Draw a fullscreen rectangle to process data
+		drawFullScreenRect();
+
+		// End shader output
+		mShaderGpGpu.unbind();
+
+		// Unbind and disable textures
+		mFbo[ mFboIndex ].unbindTexture();
+		gl::disable( GL_TEXTURE_2D );
+
+		// Draw mouse input into red channel
+		if ( mMouseDown ) {
+			gl::color( ColorAf( 1.0f, 0.0f, 0.0f, 1.0f ) );
+			gl::drawSolidCircle( Vec2f( mMouse ), 5.0f, 32 );
+			gl::color( Color::white() );
+		}
 
-	// Stop drawing to FBO
-	mFbo[ pong ].unbindFramebuffer();
+		// Stop drawing to FBO
+		mFbo[ pong ].unbindFramebuffer();
+	}
 
 	// Swap FBOs
 	mFboIndex = pong;
@@ -132,6 +151,12 @@ void GpGpuWaveVideoApp::draw()
 		// End shader output
 		mShaderRefraction.unbind();
 	}
+
+	// Start reading this frame back; the CPU path records the movie
+	// frame itself in update()
+	if ( mRecorder && isWriting && !( mCpu && mSurface ) ) {
+		mReader->read( *mRecorder, getWindowWidth(), getWindowHeight(), getElapsedSeconds() );
+	}
 }
 
 void GpGpuWaveVideoApp::drawFullScreenRect()
@@ -189,11 +214,40 @@ void GpGpuWaveVideoApp::keyDown( KeyEvent event )
     
     if (event.getChar() == 'w'){
         isWriting = !isWriting;
+        if (!isWriting && mRecorder)
+            mReader->flush( *mRecorder );
+    }
+
+    if (event.getChar() == 'b'){
+        // one at a time; update() joins the thread once it is done
+        if( mBenchmarkThread ) {
+            console() << "Benchmark already running" << std::endl;
+        }
+        else {
+            console() << "Benchmarking the recorder..." << std::endl;
+            mBenchmarkThread = std::shared_ptr<boost::thread>( new boost::thread( [ this ]() {
+                std::string report = benchmarkRecorder();
+                boost::lock_guard<boost::mutex> lock( mBenchmarkMutex );
+                mBenchmarkReport = report;
+                mBenchmarkDone = true;
+            } ) );
+        }
     }
     
     if (event.getChar() == 'p'){
         mMovie.play();
     }
+
+    if (event.getChar() == 'c'){
+        // Pick up where the shader left off
+        mCpu = !mCpu;
+        if (mCpu) {
+            mFbo[ mFboIndex ].bindFramebuffer();
+            glReadPixels( 0, 0, kWindowSize.x, kWindowSize.y, GL_RGBA, GL_FLOAT, &mState[ 0 ] );
+            mFbo[ mFboIndex ].unbindFramebuffer();
+            mSolver->setState( &mState[ 0 ], kWindowSize.x * 4 );
+        }
+    }
 }
 
 void GpGpuWaveVideoApp::mouseDown( MouseEvent event )
@@ -227,6 +281,7 @@ void GpGpuWaveVideoApp::setup()
 	mMouse		= Vec2i::zero();
 	mMouseDown	= false;
 	mShowInput	= false;
+	mBenchmarkDone	= false;
 
 	// Load shaders
 	try {
@@ -279,9 +334,19 @@ void GpGpuWaveVideoApp::setup()
     cinder::qtime::MovieWriter::Format format;
 	if( qtime::MovieWriter::getUserCompressionSettings( &format, loadImage( loadResource( RES_TEXTURE ) ) ) ) {
 		mMovieWriter = qtime::MovieWriter::create( savePath, getWindowWidth(), getWindowHeight(), format );
+
+        // a movie keeps every frame, so a backed up queue holds the draw loop rather than dropping;
+        // one worker, as the Movie Toolbox is entered per thread
+        mRecorder = std::shared_ptr<FrameRecorder>( new FrameRecorder( std::shared_ptr<FrameSink>( new MovieSink( mMovieWriter ) ), 6, FrameRecorder::BLOCK, 1 ) );
+        mReader = std::shared_ptr<WindowReader>( new WindowReader() );
 	}
     
     isWriting = false;
+
+    mSolver = std::shared_ptr<WaveSolver>( new WaveSolver( kWindowSize.x, kWindowSize.y ) );
+    mVideo = std::shared_ptr<VideoUploader>( new VideoUploader() );
+    mState.resize( kWindowSize.x * kWindowSize.y * 4 );
+    mCpu = false;
 }
 
 void GpGpuWaveVideoApp::loadMovieFile( const fs::path &moviePath )
@@ -301,17 +366,105 @@ void GpGpuWaveVideoApp::loadMovieFile( const fs::path &moviePath )
 void GpGpuWaveVideoApp::update()
 {
 	if( mMovie ){
+        bool newFrame = mMovie.checkNewFrame();
 		mSurface = mMovie.getSurface();
-        if (mSurface) {
-            gl::Texture::Format format;
-            format.setInternalFormat( GL_RGBA32F_ARB );
-            mTexture = cinder::gl::Texture(mSurface, format);
-        }
+        if (newFrame && mSurface)
+            mVideo->submit( mSurface );
+        if (mVideo->update())
+            mTexture = *mVideo->getTexture();
     }
     
-    if( mMovieWriter && isWriting) {
-        mMovieWriter->addFrame( copyWindowSurface() );
+    // refraction_frag.glsl over the movie frame, with the texture's edge clamp
+    if( mRecorder && isWriting && mCpu && mSurface ) {
+        if (!mRippled || mRippled.getChannelOrder().getCode() != mSurface.getChannelOrder().getCode())
+            mRippled = Surface( kWindowSize.x, kWindowSize.y, mSurface.hasAlpha(), mSurface.getChannelOrder() );
+        mSolver->refract( mSurface.getData(), mSurface.getWidth(), mSurface.getHeight(), mSurface.getRowBytes(), mSurface.getPixelInc(), false,
+                          mRippled.getData(), mRippled.getRowBytes() );
+        recordSurface( mRippled );
+    }
+
+    boost::lock_guard<boost::mutex> lock( mBenchmarkMutex );
+    if( mBenchmarkDone ) {
+        mBenchmarkThread->join();
+        mBenchmarkThread.reset();
+        mBenchmarkDone = false;
+        console() << mBenchmarkReport;
+    }
+}
+
+void GpGpuWaveVideoApp::shutdown()
+{
+    if( mBenchmarkThread )
+        mBenchmarkThread->join();
+
+    // the last reads, then the movie's end
+    if( mRecorder ) {
+        mReader->flush( *mRecorder );
+        mRecorder->finish();
+    }
+}
+
+void GpGpuWaveVideoApp::recordSurface( const Surface &surface )
+{
+    RecorderFrame *frame = mRecorder->acquire( surface.getWidth(), surface.getHeight(), 3, RecorderFrame::UINT8 );
+    if( !frame )
+        return;
+
+    // frames are RGB whatever order the movie decodes to
+    int8_t r = surface.getRedOffset(), g = surface.getGreenOffset(), b = surface.getBlueOffset();
+    uint8_t inc = surface.getPixelInc();
+    for( int32_t y = 0; y < surface.getHeight(); ++y ) {
+        const uint8_t *src = surface.getData() + y * surface.getRowBytes();
+        uint8_t *dst = frame->getRow( y );
+        for( int32_t x = 0; x < surface.getWidth(); ++x, src += inc, dst += 3 ) {
+            dst[0] = src[r];
+            dst[1] = src[g];
+            dst[2] = src[b];
+        }
+    }
+    frame->mTime = getElapsedSeconds();
+    mRecorder->submit( frame );
+}
+
+// Synthetic frames through the raw and Y4M sinks as fast as they are taken,
+// against the rates the recorder has to keep up with
+std::string GpGpuWaveVideoApp::benchmarkRecorder()
+{
+    std::ostringstream report;
+    struct Mode { int width, height, rate; };
+    const Mode modes[] = { { 1920, 1080, 60 }, { 3840, 2160, 30 } };
+
+    for( size_t i = 0; i < 2; ++i ) {
+        const Mode &mode = modes[i];
+        std::vector<uint8_t> pixels( mode.width * mode.height * 4 );
+        for( size_t j = 0; j < pixels.size(); ++j )
+            pixels[j] = (uint8_t)( j * 7 + j / 4093 );
+
+        for( int y4m = 0; y4m < 2; ++y4m ) {
+            fs::path path = getTemporaryDirectory() / ( y4m ? "FrameRecorderBenchmark.y4m" : "FrameRecorderBenchmark.raw" );
+            std::shared_ptr<FrameSink> sink( y4m ? (FrameSink *)new Y4mSink( path.string(), mode.rate ) : (FrameSink *)new RawSink( path.string() ) );
+            FrameRecorder recorder( sink, 6, FrameRecorder::BLOCK );
+
+            // two seconds of frames
+            int count = mode.rate * 2;
+            double caller = 0.0;
+            Timer timer( true );
+            for( int j = 0; j < count; ++j ) {
+                Timer call( true );
+                recorder.record( &pixels[0], mode.width, mode.height, mode.width * 4, 4, RecorderFrame::UINT8, true );
+                caller += call.getSeconds();
+            }
+            recorder.finish();
+            double seconds = timer.getSeconds();
+
+            FrameRecorder::Stats stats = recorder.getStats();
+            report << mode.width << "x" << mode.height << ( y4m ? " y4m: " : " raw: " ) << count / seconds << " frames/s for " << mode.rate
+                << ", " << caller / count * 1000.0 << " ms per frame on the caller, " << stats.mPeakQueued << " queued at most, "
+                << stats.mFailed << " failed\n";
+            fs::remove( path );
+        }
     }
+    return report.str();
 }
 
 CINDER_APP_BASIC( GpGpuWaveVideoApp, RendererGl( RendererGl::AA_MSAA_32 ) )
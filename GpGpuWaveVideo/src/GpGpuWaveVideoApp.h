@@ -41,6 +41,15 @@
 #include "Resources.h"
 #include "cinder/qtime/QuickTime.h"
 #include "cinder/qtime/MovieWriter.h"
+#include "WaveSolver.h"
+#include "FrameCapture.h"
+#include "MovieSink.h"
+#include "VideoUploader.h"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <string>
+
 /* 
  * This application demonstrates how to use the FBO
  * ping pong technique to update interactive data on 
@@ -61,6 +70,7 @@ public:
 	void				prepareSettings( ci::app::AppBasic::Settings *settings );
 	void				setup();
     void                update();
+    void                shutdown();
 private:
 	// Convenience method for drawing fullscreeen rectangle
 	// with texture coordinates
@@ -88,8 +98,34 @@ private:
     bool isWriting;
     cinder::qtime::MovieSurface	mMovie;
     cinder::Surface				mSurface;
+
+    // Movie frames go up into the same few textures, and only when
+    // the movie has a new one
+    std::shared_ptr<VideoUploader>  mVideo;
     cinder::fs::path savePath;
     
     cinder::qtime::MovieWriterRef	mMovieWriter;
 
+    // Frames go to the movie on worker threads; the window is read
+    // back through pixel buffers a few frames behind the draw
+    std::shared_ptr<FrameRecorder>  mRecorder;
+    std::shared_ptr<WindowReader>   mReader;
+    void recordSurface( const cinder::Surface &surface );
+
+    // The recorder benchmark writes gigabytes, so it runs off the
+    // main thread; update() logs mBenchmarkReport once it is done
+    std::string benchmarkRecorder();
+    std::shared_ptr<boost::thread>  mBenchmarkThread;
+    boost::mutex                    mBenchmarkMutex;
+    bool                            mBenchmarkDone;
+    std::string                     mBenchmarkReport;
+
+    // CPU solver; with mCpu on it steps in place of the shader and
+    // refracts the movie itself, so frames are written without a
+    // window read back
+    std::shared_ptr<WaveSolver> mSolver;
+    std::vector<float>          mState;
+    cinder::Surface             mRippled;
+    bool                        mCpu;
+
 };
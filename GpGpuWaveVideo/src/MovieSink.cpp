@@ -0,0 +1,53 @@
+//
+//  MovieSink.cpp
+//
+
+#include "MovieSink.h"
+
+#include "cinder/Surface.h"
+
+#if defined( CINDER_MAC )
+	#include <QuickTime/QuickTime.h>
+#else
+	#include <QTML.h>
+	#include <Movies.h>
+#endif
+
+using namespace ci;
+
+MovieSink::MovieSink( const qtime::MovieWriterRef &writer, float frameDuration )
+	: mWriter( writer ), mFrameDuration( frameDuration )
+{
+}
+
+void MovieSink::beginThread()
+{
+	// QuickTime calls off the main thread have to be bracketed, and only use thread safe components
+	::EnterMoviesOnThread( 0 );
+	::CSSetComponentsThreadMode( kCSAcceptThreadSafeComponentsOnlyMode );
+}
+
+void MovieSink::endThread()
+{
+	::ExitMoviesOnThread();
+}
+
+bool MovieSink::write( RecorderFrame &frame )
+{
+	if( ! mWriter || frame.mWidth != mWriter->getWidth() || frame.mHeight != mWriter->getHeight() )
+		return false;
+
+	// window reads carry an alpha the movie should not see
+	SurfaceChannelOrder order = frame.mChannels == 3 ? SurfaceChannelOrder::RGB : SurfaceChannelOrder::RGBX;
+	if( frame.mFormat == RecorderFrame::FLOAT32 )
+		mWriter->addFrame( Surface32f( (float *)&frame.mData[0], frame.mWidth, frame.mHeight, (int32_t)frame.mRowBytes, order ), mFrameDuration );
+	else
+		mWriter->addFrame( Surface8u( &frame.mData[0], frame.mWidth, frame.mHeight, (int32_t)frame.mRowBytes, order ), mFrameDuration );
+	return true;
+}
+
+void MovieSink::close()
+{
+	if( mWriter )
+		mWriter->finish();
+}
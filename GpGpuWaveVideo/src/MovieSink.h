@@ -0,0 +1,26 @@
+//
+//  MovieSink.h
+//
+//  FrameRecorder frames into a QuickTime movie, on the recorder's one worker.
+//
+
+#pragma once
+
+#include "cinder/qtime/MovieWriter.h"
+#include "FrameRecorder.h"
+
+class MovieSink : public FrameSink {
+  public:
+	//! Each frame lasts \a frameDuration seconds, or the writer's default when negative. The Movie
+	//! Toolbox takes one thread at a time, so the recorder must have a single worker.
+	explicit MovieSink( const ci::qtime::MovieWriterRef &writer, float frameDuration = -1.0f );
+
+	void	beginThread();
+	void	endThread();
+	bool	write( RecorderFrame &frame );
+	void	close();
+
+  private:
+	ci::qtime::MovieWriterRef	mWriter;
+	float						mFrameDuration;
+};
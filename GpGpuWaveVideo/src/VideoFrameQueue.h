@@ -0,0 +1,104 @@
+//
+//  VideoFrameQueue.h
+//
+//  Movie and capture frames made ready for glTexSubImage2D on a worker thread; no GL.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class VideoFrameQueue {
+  public:
+	//! What the texture holds.
+	enum Target { RGBA8, RGBA16F, RGBA32F };
+
+	//! 8-bit pixels \a mPixelInc bytes apart; the offsets say where red, green, blue and
+	//! alpha sit in a pixel, with a negative alpha offset for none.
+	struct Source {
+		Source() : mData( 0 ), mWidth( 0 ), mHeight( 0 ), mRowBytes( 0 ), mPixelInc( 0 ) { mOffsets[0] = 0; mOffsets[1] = 1; mOffsets[2] = 2; mOffsets[3] = -1; }
+
+		const uint8_t				*mData;
+		int							mWidth, mHeight;
+		ptrdiff_t					mRowBytes;
+		int							mPixelInc;
+		int							mOffsets[4];
+		std::shared_ptr<const void>	mOwner;		// keeps mData alive until the frame is released
+	};
+
+	//! Pixels ready to upload, RGBA or BGRA, 8-bit, half or float per Target.
+	struct Frame {
+		const void	*mData;
+		int			mWidth, mHeight;
+		size_t		mRowPixels;		// pixels from one row to the next
+		bool		mBgra;
+		uint64_t	mSerial;		// counts submitted frames, from 1
+	};
+
+	struct Stats {
+		Stats() : mSubmitted( 0 ), mPassedThrough( 0 ), mConverted( 0 ), mReplaced( 0 ), mSkipped( 0 ), mTaken( 0 ) {}
+
+		uint64_t	mSubmitted, mPassedThrough, mConverted;
+		uint64_t	mReplaced;		// waiting for the worker when a newer frame arrived
+		uint64_t	mSkipped;		// converted, but a newer frame was taken first
+		uint64_t	mTaken;
+	};
+
+	//! \a numBuffers staging buffers, at least two: one being converted, one being uploaded.
+	//! \a threaded false converts in submit(), for tests and single threaded callers.
+	explicit VideoFrameQueue( Target target, size_t numBuffers = 3, bool threaded = true );
+	~VideoFrameQueue();
+
+	Target			getTarget() const	{ return mTarget; }
+	//! Whether \a source can go to the texture without conversion.
+	bool			isDirect( const Source &source ) const;
+
+	//! Hands over a new frame.
+	void			submit( const Source &source );
+	//! The newest frame not yet taken, or false. It stays valid until release().
+	bool			take( Frame *frame );
+	void			release();
+	//! Waits until the worker has nothing left to convert.
+	void			wait();
+
+	Stats			getStats();
+
+	//! The conversions, \a width pixels of one row into RGBA.
+	static void		convertRow( const Source &source, int y, uint8_t *dst );
+	static void		convertRow( const Source &source, int y, uint16_t *dst );
+	static void		convertRow( const Source &source, int y, float *dst );
+	//! \a value as the nearest half float, ties to even.
+	static uint16_t	toHalf( float value );
+
+  private:
+	enum State { FREE, PENDING, CONVERTING, READY, TAKEN };
+
+	struct Buffer {
+		Buffer() : mState( FREE ), mSerial( 0 ), mDirect( false ) {}
+
+		State					mState;
+		uint64_t				mSerial;
+		bool					mDirect;	// mSource is uploaded as it is
+		Source					mSource;
+		std::vector<uint8_t>	mPixels;
+	};
+
+	void			convert( Buffer &buffer );
+	void			run();
+
+	Target					mTarget;
+	std::vector<Buffer>		mBuffers;
+	uint64_t				mSerial;
+	Stats					mStats;
+
+	std::thread				mWorker;
+	std::mutex				mMutex;
+	std::condition_variable	mWake, mIdle;
+	bool					mThreaded, mQuit;
+};
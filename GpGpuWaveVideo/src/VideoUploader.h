@@ -0,0 +1,48 @@
+//
+//  VideoUploader.h
+//
+//  Movie and capture frames uploaded into a few textures kept for the uploader's lifetime.
+//
+
+#pragma once
+
+#include "cinder/Surface.h"
+#include "cinder/gl/gl.h"
+#include "cinder/gl/Texture.h"
+#include "VideoFrameQueue.h"
+
+#include <memory>
+#include <vector>
+
+class VideoUploader {
+  public:
+	//! RGBA8 uploads four channel frames as they are; RGBA16F and RGBA32F are for shaders that want
+	//! float textures, and have the worker convert. \a format supplies filtering and wrap.
+	explicit VideoUploader( VideoFrameQueue::Target target = VideoFrameQueue::RGBA8, size_t numTextures = 2,
+							const ci::gl::Texture::Format &format = ci::gl::Texture::Format() );
+
+	//! A new frame; its pixels are held, not copied, until converted or uploaded.
+#if CINDER_VERSION >= 900
+	void						submit( const ci::Surface8uRef &surface );
+#else
+	void						submit( const ci::Surface8u &surface );
+#endif
+	//! Uploads the newest frame that came in since the last call. True when getTexture() changed.
+	bool						update();
+
+	//! The texture holding the last frame uploaded; null before the first.
+	const ci::gl::TextureRef&	getTexture() const	{ return mTextures[mCurrent]; }
+	VideoFrameQueue::Stats		getStats()			{ return mQueue.getStats(); }
+	uint64_t					getBytesUploaded() const	{ return mBytesUploaded; }
+
+  private:
+	//! \a owner keeps the pixels of \a surface alive.
+	void						submit( const ci::Surface8u &surface, const std::shared_ptr<const void> &owner );
+
+	VideoFrameQueue					mQueue;
+	ci::gl::Texture::Format			mFormat;
+	std::vector<ci::gl::TextureRef>	mTextures;
+	size_t							mCurrent;
+	bool							mOpaque;	// the last frame had no alpha, so the texture has none
+	uint64_t						mBytesUploaded;
+};
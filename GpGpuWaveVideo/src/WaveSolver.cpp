@@ -0,0 +1,383 @@
+//
+//  WaveSolver.cpp
+//
+
+#include "WaveSolver.h"
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+	const int	TILE_ROWS = 16;
+	const int	TILE_COLUMNS = 512;		// seven rows of this many floats fit in L1
+
+	// gpgpu_frag.glsl's constants, and its spring factors with the power folded in as GLSL folds it
+	const float	DAMPEN = 0.993f;
+	const float	POWER = 1.5f;
+	const float	W23 = 0.0022411859348636983f * POWER;
+	const float	W03 = 0.0056818181818181820f * POWER;
+	const float	W22 = 0.0066566640639421000f * POWER;
+	const float	W02 = 0.0113636363636363640f * POWER;
+	const float	W31 = 0.0047597860217705710f * POWER;
+	const float	W11 = 0.0146919683956074150f * POWER;
+
+	// the shader's taps in its order: x offset, y offset, factor
+	struct Tap { int x, y; float factor; };
+	const Tap TAPS[22] = {
+		{  2,  3, W23 }, {  0,  3, W03 }, { -2,  3, W23 },
+		{  2,  2, W22 }, {  0,  2, W02 }, { -2,  2, W22 },
+		{  3,  1, W31 }, {  1,  1, W11 }, { -1,  1, W11 }, { -3,  1, W31 },
+		{  2,  0, W02 }, { -2,  0, W02 },
+		{  3, -1, W31 }, {  1, -1, W11 }, { -1, -1, W11 }, { -3, -1, W31 },
+		{  2, -2, W22 }, {  0, -2, W02 }, { -2, -2, W22 },
+		{  2, -3, W23 }, {  0, -3, W03 }, { -2, -3, W23 }
+	};
+
+	// one row of the stencil; the rows above and below come in as pointers to the same column,
+	// and the sum runs in the shader's order so the result is the shader's to the last bit
+	void stepRow( int begin, int end,
+				  const float * __restrict m3, const float * __restrict m2, const float * __restrict m1, const float * __restrict c,
+				  const float * __restrict p1, const float * __restrict p2, const float * __restrict p3,
+				  float * __restrict velocities, float * __restrict out )
+	{
+		for( int x = begin; x < end; ++x ) {
+			float h = c[x];
+			float v = velocities[x];
+			v += ( p3[x + 2] - h ) * W23;
+			v += ( p3[x] - h ) * W03;
+			v += ( p3[x - 2] - h ) * W23;
+			v += ( p2[x + 2] - h ) * W22;
+			v += ( p2[x] - h ) * W02;
+			v += ( p2[x - 2] - h ) * W22;
+			v += ( p1[x + 3] - h ) * W31;
+			v += ( p1[x + 1] - h ) * W11;
+			v += ( p1[x - 1] - h ) * W11;
+			v += ( p1[x - 3] - h ) * W31;
+			v += ( c[x + 2] - h ) * W02;
+			v += ( c[x - 2] - h ) * W02;
+			v += ( m1[x + 3] - h ) * W31;
+			v += ( m1[x + 1] - h ) * W11;
+			v += ( m1[x - 1] - h ) * W11;
+			v += ( m1[x - 3] - h ) * W31;
+			v += ( m2[x + 2] - h ) * W22;
+			v += ( m2[x] - h ) * W02;
+			v += ( m2[x - 2] - h ) * W22;
+			v += ( m3[x + 2] - h ) * W23;
+			v += ( m3[x] - h ) * W03;
+			v += ( m3[x - 2] - h ) * W23;
+			out[x] = h + v;
+			velocities[x] = v * DAMPEN;
+		}
+	}
+
+	inline int wrap( int i, int n )
+	{
+		i %= n;
+		return i < 0 ? i + n : i;
+	}
+}
+
+WaveSolver::WaveSolver( int width, int height, int numThreads )
+	: mWidth( width ), mHeight( height ), mStride( width + 2 * BORDER ), mBoundary( REPEAT ), mCurrent( 0 ),
+	mJob( 0 ), mNumTiles( 0 ), mNextTile( 0 ), mNumBusy( 0 ), mGeneration( 0 ), mQuit( false )
+{
+	for( int i = 0; i < 2; ++i )
+		mHeights[i].resize( (size_t)mStride * ( height + 2 * BORDER ) );
+	mVelocities.resize( (size_t)width * height );
+	mTileColumns = ( width + TILE_COLUMNS - 1 ) / TILE_COLUMNS;
+	memset( &mRefract, 0, sizeof( mRefract ) );
+
+	if( numThreads <= 0 )
+		numThreads = max( (int)boost::thread::hardware_concurrency(), 1 );
+	for( int i = 1; i < numThreads; ++i )
+		mWorkers.create_thread( boost::bind( &WaveSolver::run, this ) );
+}
+
+WaveSolver::~WaveSolver()
+{
+	{
+		boost::lock_guard<boost::mutex> lock( mMutex );
+		mQuit = true;
+	}
+	mWake.notify_all();
+	mWorkers.join_all();
+}
+
+void WaveSolver::setBoundary( Boundary boundary )
+{
+	mBoundary = boundary;
+	fillBorder( &mHeights[mCurrent][0] );
+}
+
+void WaveSolver::clear()
+{
+	for( int i = 0; i < 2; ++i )
+		fill( mHeights[i].begin(), mHeights[i].end(), 0.0f );
+	fill( mVelocities.begin(), mVelocities.end(), 0.0f );
+}
+
+void WaveSolver::fillBorder( float *heights )
+{
+	const int w = mWidth, h = mHeight, stride = mStride;
+	float *origin = heights + BORDER * stride + BORDER;
+
+	// left and right of every row first, then whole rows above and below, which takes the corners along
+	for( int y = 0; y < h; ++y ) {
+		float *row = origin + y * stride;
+		for( int i = 1; i <= BORDER; ++i ) {
+			switch( mBoundary ) {
+				case REPEAT:	row[-i] = row[wrap( -i, w )];	row[w - 1 + i] = row[wrap( w - 1 + i, w )];	break;
+				case CLAMP:		row[-i] = row[0];				row[w - 1 + i] = row[w - 1];				break;
+				case FIXED:		row[-i] = 0.0f;					row[w - 1 + i] = 0.0f;						break;
+			}
+		}
+	}
+	size_t rowFloats = (size_t)stride;
+	for( int i = 1; i <= BORDER; ++i ) {
+		float *below = origin - i * stride - BORDER, *above = origin + ( h - 1 + i ) * stride - BORDER;
+		switch( mBoundary ) {
+			case REPEAT:
+				memcpy( below, origin + wrap( -i, h ) * stride - BORDER, rowFloats * sizeof( float ) );
+				memcpy( above, origin + wrap( h - 1 + i, h ) * stride - BORDER, rowFloats * sizeof( float ) );
+				break;
+			case CLAMP:
+				memcpy( below, origin - BORDER, rowFloats * sizeof( float ) );
+				memcpy( above, origin + ( h - 1 ) * stride - BORDER, rowFloats * sizeof( float ) );
+				break;
+			case FIXED:
+				fill( below, below + rowFloats, 0.0f );
+				fill( above, above + rowFloats, 0.0f );
+				break;
+		}
+	}
+}
+
+void WaveSolver::stepTile( int tile )
+{
+	int band = tile / mTileColumns, column = tile % mTileColumns;
+	int y0 = band * TILE_ROWS, y1 = min( y0 + TILE_ROWS, mHeight );
+	int x0 = column * TILE_COLUMNS, x1 = min( x0 + TILE_COLUMNS, mWidth );
+
+	const float *current = &mHeights[mCurrent][BORDER * mStride + BORDER];
+	float *next = &mHeights[1 - mCurrent][BORDER * mStride + BORDER];
+	const int s = mStride;
+	for( int y = y0; y < y1; ++y ) {
+		const float *c = current + y * s;
+		stepRow( x0, x1, c - 3 * s, c - 2 * s, c - s, c, c + s, c + 2 * s, c + 3 * s,
+				 &mVelocities[(size_t)y * mWidth], next + y * s );
+	}
+}
+
+void WaveSolver::step()
+{
+	int numBands = ( mHeight + TILE_ROWS - 1 ) / TILE_ROWS;
+	runJob( &WaveSolver::stepTile, numBands * mTileColumns );
+	mCurrent = 1 - mCurrent;
+	fillBorder( &mHeights[mCurrent][0] );
+}
+
+void WaveSolver::impulse( float x, float y, float radius, float height )
+{
+	int x0 = max( (int)floorf( x - radius ), 0 ), x1 = min( (int)ceilf( x + radius ), mWidth - 1 );
+	int y0 = max( (int)floorf( y - radius ), 0 ), y1 = min( (int)ceilf( y + radius ), mHeight - 1 );
+	float r2 = radius * radius;
+	float *heights = &mHeights[mCurrent][BORDER * mStride + BORDER];
+	for( int py = y0; py <= y1; ++py ) {
+		float dy = py + 0.5f - y;
+		for( int px = x0; px <= x1; ++px ) {
+			float dx = px + 0.5f - x;
+			if( dx * dx + dy * dy < r2 ) {
+				heights[py * mStride + px] = height;
+				mVelocities[(size_t)py * mWidth + px] = 0.0f;
+			}
+		}
+	}
+	fillBorder( &mHeights[mCurrent][0] );
+}
+
+void WaveSolver::setState( const float *rgba, size_t rowStride )
+{
+	float *heights = &mHeights[mCurrent][BORDER * mStride + BORDER];
+	for( int y = 0; y < mHeight; ++y ) {
+		const float *src = rgba + y * rowStride;
+		for( int x = 0; x < mWidth; ++x ) {
+			heights[y * mStride + x] = src[x * 4];
+			mVelocities[(size_t)y * mWidth + x] = src[x * 4 + 1];
+		}
+	}
+	fillBorder( &mHeights[mCurrent][0] );
+}
+
+void WaveSolver::getState( float *rgba, size_t rowStride ) const
+{
+	for( int y = 0; y < mHeight; ++y ) {
+		float *dst = rgba + y * rowStride;
+		for( int x = 0; x < mWidth; ++x ) {
+			dst[x * 4] = getHeight( x, y );
+			dst[x * 4 + 1] = getVelocity( x, y );
+			dst[x * 4 + 2] = 0.0f;
+			dst[x * 4 + 3] = 1.0f;
+		}
+	}
+}
+
+float WaveSolver::velocityAt( int x, int y ) const
+{
+	if( x >= 0 && x < mWidth && y >= 0 && y < mHeight )
+		return getVelocity( x, y );
+	switch( mBoundary ) {
+		case REPEAT:	return getVelocity( wrap( x, mWidth ), wrap( y, mHeight ) );
+		case CLAMP:		return getVelocity( min( max( x, 0 ), mWidth - 1 ), min( max( y, 0 ), mHeight - 1 ) );
+		default:		return 0.0f;
+	}
+}
+
+void WaveSolver::displacementAt( int x, int y, float *dx, float *dy ) const
+{
+	// the border already holds the heights past the edge
+	*dx = velocityAt( x, y - 1 ) - velocityAt( x + 1, y );
+	*dy = getHeight( x, y - 1 ) - getHeight( x, y + 1 );
+}
+
+void WaveSolver::getDisplacement( float *xy, size_t rowStride ) const
+{
+	for( int y = 0; y < mHeight; ++y ) {
+		float *dst = xy + y * rowStride;
+		for( int x = 0; x < mWidth; ++x )
+			displacementAt( x, y, &dst[x * 2], &dst[x * 2 + 1] );
+	}
+}
+
+void WaveSolver::refractTile( int tile )
+{
+	const RefractJob &job = mRefract;
+	const int inc = job.mIncrement;
+	const float sw = (float)job.mSrcWidth, sh = (float)job.mSrcHeight;
+	int y0 = tile * TILE_ROWS, y1 = min( y0 + TILE_ROWS, mHeight );
+
+	for( int y = y0; y < y1; ++y ) {
+		uint8_t *dst = job.mDst + y * job.mDstRowBytes;
+		float v0 = ( y + 0.5f ) / mHeight;
+		for( int x = 0; x < mWidth; ++x ) {
+			float dx, dy;
+			displacementAt( x, y, &dx, &dy );
+			float u = ( x + 0.5f ) / mWidth + dx, v = v0 + dy;
+			if( job.mRepeat ) {
+				u -= floorf( u );
+				v -= floorf( v );
+			}
+
+			// GL_LINEAR: texel centres at half coordinates, edges wrapped or clamped as the sampler would
+			float fx = min( max( u * sw - 0.5f, -1.0f ), sw ), fy = min( max( v * sh - 0.5f, -1.0f ), sh );
+			float xf = floorf( fx ), yf = floorf( fy );
+			float a = fx - xf, b = fy - yf;
+			int sx0 = (int)xf, sy0 = (int)yf, sx1 = sx0 + 1, sy1 = sy0 + 1;
+			if( job.mRepeat ) {
+				sx0 = wrap( sx0, job.mSrcWidth );	sx1 = wrap( sx1, job.mSrcWidth );
+				sy0 = wrap( sy0, job.mSrcHeight );	sy1 = wrap( sy1, job.mSrcHeight );
+			}
+			else {
+				sx0 = min( max( sx0, 0 ), job.mSrcWidth - 1 );	sx1 = min( max( sx1, 0 ), job.mSrcWidth - 1 );
+				sy0 = min( max( sy0, 0 ), job.mSrcHeight - 1 );	sy1 = min( max( sy1, 0 ), job.mSrcHeight - 1 );
+			}
+			const uint8_t *r0 = job.mSrc + sy0 * job.mSrcRowBytes, *r1 = job.mSrc + sy1 * job.mSrcRowBytes;
+			const uint8_t *t00 = r0 + sx0 * inc, *t10 = r0 + sx1 * inc, *t01 = r1 + sx0 * inc, *t11 = r1 + sx1 * inc;
+			uint8_t *out = dst + x * inc;
+			for( int c = 0; c < inc; ++c ) {
+				float top = t00[c] + ( t10[c] - t00[c] ) * a;
+				float bottom = t01[c] + ( t11[c] - t01[c] ) * a;
+				out[c] = (uint8_t)( top + ( bottom - top ) * b + 0.5f );
+			}
+		}
+	}
+}
+
+void WaveSolver::refract( const uint8_t *src, int srcWidth, int srcHeight, ptrdiff_t srcRowBytes, int increment, bool repeat,
+						  uint8_t *dst, ptrdiff_t dstRowBytes )
+{
+	RefractJob job = { src, srcWidth, srcHeight, increment, srcRowBytes, dstRowBytes, repeat, dst };
+	mRefract = job;
+	runJob( &WaveSolver::refractTile, ( mHeight + TILE_ROWS - 1 ) / TILE_ROWS );
+}
+
+void WaveSolver::runTiles()
+{
+	for(;;) {
+		int tile;
+		{
+			boost::lock_guard<boost::mutex> lock( mMutex );
+			tile = mNextTile++;
+		}
+		if( tile >= mNumTiles )
+			return;
+		( this->*mJob )( tile );
+	}
+}
+
+void WaveSolver::run()
+{
+	uint32_t generation = 0;
+	for(;;) {
+		{
+			boost::unique_lock<boost::mutex> lock( mMutex );
+			while( mGeneration == generation && ! mQuit )
+				mWake.wait( lock );
+			if( mQuit )
+				return;
+			generation = mGeneration;
+		}
+		runTiles();
+		{
+			boost::lock_guard<boost::mutex> lock( mMutex );
+			if( --mNumBusy == 0 )
+				mDone.notify_one();
+		}
+	}
+}
+
+void WaveSolver::runJob( void ( WaveSolver::*job )( int ), int numTiles )
+{
+	{
+		boost::lock_guard<boost::mutex> lock( mMutex );
+		mJob = job;
+		mNumTiles = numTiles;
+		mNextTile = 0;
+		mNumBusy = (int)mWorkers.size();
+		++mGeneration;
+	}
+	if( mWorkers.size() == 0 ) {
+		runTiles();
+		return;
+	}
+	mWake.notify_all();
+	runTiles();
+
+	boost::unique_lock<boost::mutex> lock( mMutex );
+	while( mNumBusy > 0 )
+		mDone.wait( lock );
+}
+
+void WaveSolver::stepNaive( const float *rgba, float *out, int width, int height )
+{
+	for( int y = 0; y < height; ++y ) {
+		for( int x = 0; x < width; ++x ) {
+			const float *color = rgba + ( (size_t)y * width + x ) * 4;
+			float h = color[0];
+			float v = color[1];
+			for( int i = 0; i < 22; ++i ) {
+				const Tap &tap = TAPS[i];
+				const float *neighbour = rgba + ( (size_t)wrap( y + tap.y, height ) * width + wrap( x + tap.x, width ) ) * 4;
+				v += ( neighbour[0] - h ) * tap.factor;
+			}
+			float *dst = out + ( (size_t)y * width + x ) * 4;
+			dst[0] = h + v;
+			dst[1] = v * DAMPEN;
+			dst[2] = 0.0f;
+			dst[3] = 1.0f;
+		}
+	}
+}
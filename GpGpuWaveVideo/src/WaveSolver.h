@@ -0,0 +1,97 @@
+//
+//  WaveSolver.h
+//
+//  gpgpu_frag.glsl and refraction_frag.glsl on the CPU; rows run bottom up, as the FBO's do.
+//
+
+#pragma once
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class WaveSolver {
+  public:
+	enum Boundary {
+		REPEAT,		// waves leave one side and come back on the other, as in the shader
+		CLAMP,		// the edge pixel repeats outwards
+		FIXED		// still water all around
+	};
+
+	//! \a numThreads 0 uses every hardware thread.
+	WaveSolver( int width, int height, int numThreads = 0 );
+	~WaveSolver();
+
+	int			getWidth() const		{ return mWidth; }
+	int			getHeight() const		{ return mHeight; }
+	int			getNumThreads() const	{ return (int)mWorkers.size() + 1; }
+
+	void		setBoundary( Boundary boundary );
+	Boundary	getBoundary() const		{ return mBoundary; }
+
+	//! Flat water, as the FBOs are cleared to.
+	void		clear();
+	//! One pass of gpgpu_frag.glsl.
+	void		step();
+	//! What mouseDown()/mouseDrag() draw after the pass: every pixel whose centre lies within
+	//! \a radius of ( \a x, \a y ) is set to ( \a height, 0 ), as the red drawSolidCircle() writes it.
+	void		impulse( float x, float y, float radius = 5.0f, float height = 1.0f );
+
+	//! Loads heights and velocities from the red and green of RGBA floats, \a rowStride floats apart.
+	void		setState( const float *rgba, size_t rowStride );
+	//! Writes ( height, velocity, 0, 1 ) per pixel, as the shader writes the FBO.
+	void		getState( float *rgba, size_t rowStride ) const;
+	float		getHeight( int x, int y ) const		{ return mHeights[mCurrent][( y + BORDER ) * mStride + x + BORDER]; }
+	float		getVelocity( int x, int y ) const	{ return mVelocities[(size_t)y * mWidth + x]; }
+
+	//! The offset refraction_frag.glsl adds to each pixel's texture coordinate, as x, y pairs.
+	void		getDisplacement( float *xy, size_t rowStride ) const;
+	//! refraction_frag.glsl: pixel ( x, y ) of \a dst reads \a src bilinearly at its texture coordinate plus the
+	//! displacement. Both images are 8-bit with \a increment channels per pixel; \a dst is the solver's size.
+	void		refract( const uint8_t *src, int srcWidth, int srcHeight, ptrdiff_t srcRowBytes, int increment, bool repeat,
+						 uint8_t *dst, ptrdiff_t dstRowBytes );
+
+	//! gpgpu_frag.glsl written out a pixel and a tap at a time over RGBA floats, wrapping as GL_REPEAT does.
+	//! The reference step() is checked and timed against.
+	static void	stepNaive( const float *rgba, float *out, int width, int height );
+
+	static const int	BORDER = 3;		// the stencil's reach
+
+  private:
+	struct RefractJob {
+		const uint8_t	*mSrc;
+		int				mSrcWidth, mSrcHeight, mIncrement;
+		ptrdiff_t		mSrcRowBytes, mDstRowBytes;
+		bool			mRepeat;
+		uint8_t			*mDst;
+	};
+
+	void		fillBorder( float *heights );
+	float		velocityAt( int x, int y ) const;
+	void		displacementAt( int x, int y, float *dx, float *dy ) const;
+
+	void		runJob( void ( WaveSolver::*job )( int ), int numTiles );
+	void		runTiles();
+	void		run();
+	void		stepTile( int tile );
+	void		refractTile( int tile );
+
+	int						mWidth, mHeight, mStride;
+	Boundary				mBoundary;
+	int						mCurrent;
+	std::vector<float>		mHeights[2];	// ( width + 2 * BORDER ) x ( height + 2 * BORDER )
+	std::vector<float>		mVelocities;	// width x height, already dampened as the shader stores them
+	int						mTileColumns;
+	RefractJob				mRefract;
+
+	boost::thread_group			mWorkers;
+	boost::mutex				mMutex;
+	boost::condition_variable	mWake, mDone;
+	void ( WaveSolver::*mJob )( int );
+	int							mNumTiles, mNextTile, mNumBusy;
+	uint32_t					mGeneration;
+	bool						mQuit;
+};
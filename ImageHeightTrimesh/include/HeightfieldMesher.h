@@ -0,0 +1,65 @@
+//
+//  HeightfieldMesher.h
+//
+//  An adaptive, crack-free triangle mesh over a heightfield image, from a right-triangulated irregular network.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class HeightfieldMesher {
+  public:
+	//! Where the mesh is seen from, for extract() to keep triangles finer nearer the eye. \a mEye is
+	//! the eye's position in pixels over the image, x along a row and y down the rows; \a mPixelsPerUnit
+	//! is the viewport height over twice the tangent of half the vertical field of view. Heights are
+	//! taken to be in pixels too.
+	struct View {
+		View() : mPixelsPerUnit( 1.0f ), mMaxPixels( 1.0f ) { mEye[0] = mEye[1] = 0.0f; }
+
+		float	mEye[2];
+		float	mPixelsPerUnit;
+		float	mMaxPixels;		// how far, on screen, a triangle may stray from the pixels under it
+	};
+
+	//! \a numThreads 0 uses every hardware thread.
+	explicit HeightfieldMesher( size_t numThreads = 0 );
+
+	//! Error bounds for the \a width by \a height \a heights, row after row. Keeps no pointer to them.
+	void			build( const float *heights, int width, int height );
+
+	int				getWidth() const		{ return mWidth; }
+	int				getHeight() const		{ return mHeight; }
+	//! The largest error bound of any triangle that does not cross the image's edge: extracting with
+	//! it gives the fewest triangles there can be.
+	float			getMaxError() const		{ return mMaxError; }
+
+	//! Triangles, wound alike, that are nowhere further than \a maxError in height from the pixels
+	//! they cover. \a vertices gets the pixels used, as y * width + x in order, and \a indices the
+	//! triangles over them.
+	void			extract( float maxError, std::vector<uint32_t> *vertices, std::vector<uint32_t> *indices ) const;
+	//! As extract(), but with the smallest error, to within a hundredth, that needs no more than
+	//! \a maxTriangles; returns it. There are more when even getMaxError() needs more.
+	float			extractBudget( size_t maxTriangles, std::vector<uint32_t> *vertices, std::vector<uint32_t> *indices ) const;
+	//! As extract(), but a triangle's error may grow with its distance from the eye, as long as it
+	//! stays under \a view's pixels on screen. Still without cracks, between any two levels.
+	void			extract( const View &view, std::vector<uint32_t> *vertices, std::vector<uint32_t> *indices ) const;
+
+  private:
+	// \a level counts down from the two largest triangles to -1 for the smallest; see mRadii
+	template<typename S>
+	void			extractWith( const S &split, std::vector<uint32_t> *vertices, std::vector<uint32_t> *indices ) const;
+	template<typename S>
+	void			addTriangle( const S &split, int level, int ax, int ay, int bx, int by, int cx, int cy, std::vector<uint32_t> *triangles ) const;
+	template<typename S>
+	size_t			countTriangles( const S &split, int level, int ax, int ay, int bx, int by, int cx, int cy ) const;
+	int				getTopLevel() const;
+
+	size_t				mNumThreads;
+	int					mWidth, mHeight, mSize;		// mSize the grid's, a power of two, in cells
+	std::vector<float>	mErrors;					// per grid vertex, (mSize + 1) to a row
+	float				mMaxError;
+	std::vector<float>	mRadii;						// per level, how far from its midpoint a triangle and those below it reach
+};
@@ -0,0 +1,314 @@
+//
+//  HeightfieldMesher.cpp
+//
+
+#include "HeightfieldMesher.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+namespace {
+	// below this many vertices a thread costs more than it saves
+	const size_t kMinPerThread = 16384;
+
+	size_t resolveThreads( size_t numThreads )
+	{
+		if( numThreads )
+			return numThreads;
+		return max( (size_t)boost::thread::hardware_concurrency(), (size_t)1 );
+	}
+
+	// calls \a f( begin, end ) over \a count items split into contiguous ranges of at least
+	// \a minPerThread, the last on this thread
+	template<typename F>
+	void parallelFor( size_t count, size_t numThreads, size_t minPerThread, const F &f )
+	{
+		size_t n = max( (size_t)1, min( numThreads, count / max( minPerThread, (size_t)1 ) ) );
+		boost::thread_group threads;
+		for( size_t i = 0; i + 1 < n; ++i )
+			threads.create_thread( boost::bind<void>( f, count * i / n, count * ( i + 1 ) / n ) );
+		f( count * ( n - 1 ) / n, count );
+		threads.join_all();
+	}
+
+	int countBits( uint64_t bits )
+	{
+		bits -= ( bits >> 1 ) & 0x5555555555555555ULL;
+		bits = ( bits & 0x3333333333333333ULL ) + ( ( bits >> 2 ) & 0x3333333333333333ULL );
+		bits = ( bits + ( bits >> 4 ) ) & 0x0f0f0f0f0f0f0f0fULL;
+		return (int)( ( bits * 0x0101010101010101ULL ) >> 56 );
+	}
+
+	// the grid over the image, with the heights of its last row and column carried on past it
+	struct Grid {
+		const float	*mHeights;
+		int			mWidth, mHeight;
+		float		*mErrors;
+		size_t		mRow;
+
+		float	getHeight( int x, int y ) const	{ return mHeights[(size_t)min( y, mHeight - 1 ) * mWidth + min( x, mWidth - 1 )]; }
+		float&	getError( int x, int y ) const	{ return mErrors[(size_t)y * mRow + x]; }
+
+		// The bound at the midpoint of the hypotenuse from a to b, for the \a numApexes triangles on
+		// it. Off a triangle's plane, a pixel is no further than it is off the plane of the half it
+		// falls in, plus how far the midpoint is off the hypotenuse; so the bound is that plus the
+		// largest below it, at the midpoints of the legs, unless these are the smallest triangles.
+		float	getBound( int ax, int ay, int bx, int by, const int *apexes, int numApexes, bool smallest ) const
+		{
+			float below = 0.0f;
+			bool inside = false;
+			for( int i = 0; i < numApexes; ++i ) {
+				int cx = apexes[i * 2], cy = apexes[i * 2 + 1];
+				if( min( ax, min( bx, cx ) ) >= mWidth - 1 || min( ay, min( by, cy ) ) >= mHeight - 1 )
+					continue;
+				if( max( ax, max( bx, cx ) ) > mWidth - 1 || max( ay, max( by, cy ) ) > mHeight - 1 )
+					return numeric_limits<float>::infinity();
+				inside = true;
+				if( ! smallest )
+					below = max( below, max( getError( ( ax + cx ) / 2, ( ay + cy ) / 2 ), getError( ( bx + cx ) / 2, ( by + cy ) / 2 ) ) );
+			}
+			if( ! inside )
+				return 0.0f;
+			float middle = getHeight( ( ax + bx ) / 2, ( ay + by ) / 2 );
+			return fabs( middle - ( getHeight( ax, ay ) + getHeight( bx, by ) ) * 0.5f ) + below;
+		}
+	};
+
+	struct SplitAbove {
+		const float	*mErrors;
+		size_t		mRow;
+		float		mMaxError;
+
+		bool operator()( int, int x, int y ) const	{ return mErrors[(size_t)y * mRow + x] > mMaxError; }
+	};
+
+	// the error allowed grows with the distance from the eye to the nearest a triangle and those
+	// below it can be, which never grows going down, so no triangle splits unless its parent did
+	struct SplitInView {
+		const float						*mErrors;
+		size_t							mRow;
+		const vector<float>				*mRadii;
+		HeightfieldMesher::View			mView;
+
+		bool operator()( int level, int x, int y ) const
+		{
+			float error = mErrors[(size_t)y * mRow + x];
+			if( error <= 0.0f )
+				return false;
+			float dx = (float)x - mView.mEye[0], dy = (float)y - mView.mEye[1];
+			float distance = max( sqrt( dx * dx + dy * dy ) - (*mRadii)[level], 0.0f );
+			return error * mView.mPixelsPerUnit > mView.mMaxPixels * distance;
+		}
+	};
+}
+
+HeightfieldMesher::HeightfieldMesher( size_t numThreads )
+	: mNumThreads( resolveThreads( numThreads ) ), mWidth( 0 ), mHeight( 0 ), mSize( 0 ), mMaxError( 0.0f )
+{
+}
+
+void HeightfieldMesher::build( const float *heights, int width, int height )
+{
+	mWidth = max( width, 0 );
+	mHeight = max( height, 0 );
+	mSize = 0;
+	mMaxError = 0.0f;
+	mErrors.clear();
+	mRadii.clear();
+	if( mWidth < 2 || mHeight < 2 )
+		return;
+	for( mSize = 1; mSize < max( mWidth, mHeight ) - 1; mSize *= 2 )
+		;
+
+	Grid grid;
+	grid.mHeights = heights;
+	grid.mWidth = mWidth;
+	grid.mHeight = mHeight;
+	grid.mRow = (size_t)mSize + 1;
+	mErrors.assign( grid.mRow * grid.mRow, 0.0f );
+	grid.mErrors = &mErrors[0];
+
+	// from the smallest triangles up, every level's midpoints depending only on the level below
+	vector<float> rowMaxima;
+	for( int s = 1; s <= mSize / 2; s *= 2 ) {
+		// midpoints of hypotenuses 2 * s along a row or a column, on every row a multiple of s
+		size_t numRows = (size_t)( mSize / s + 1 );
+		rowMaxima.assign( numRows, 0.0f );
+		parallelFor( numRows, mNumThreads, kMinPerThread / numRows + 1, [&]( size_t begin, size_t end ) {
+			for( size_t r = begin; r < end; ++r ) {
+				int y = (int)r * s, apexes[4];
+				float rowMax = 0.0f;
+				for( int x = r % 2 ? 0 : s; x <= mSize; x += 2 * s ) {
+					int n = 0;
+					float bound;
+					if( r % 2 == 0 ) {
+						// along the row, with triangles above and below it
+						for( int cy = y - s; cy <= y + s; cy += 2 * s )
+							if( cy >= 0 && cy <= mSize ) {
+								apexes[n * 2] = x;
+								apexes[n * 2 + 1] = cy;
+								++n;
+							}
+						bound = grid.getBound( x - s, y, x + s, y, apexes, n, s == 1 );
+					}
+					else {
+						// down the column, with triangles left and right of it
+						for( int cx = x - s; cx <= x + s; cx += 2 * s )
+							if( cx >= 0 && cx <= mSize ) {
+								apexes[n * 2] = cx;
+								apexes[n * 2 + 1] = y;
+								++n;
+							}
+						bound = grid.getBound( x, y - s, x, y + s, apexes, n, s == 1 );
+					}
+					grid.getError( x, y ) = bound;
+					if( bound < numeric_limits<float>::infinity() )
+						rowMax = max( rowMax, bound );
+				}
+				rowMaxima[r] = rowMax;
+			}
+		} );
+		mMaxError = max( mMaxError, *max_element( rowMaxima.begin(), rowMaxima.end() ) );
+
+		// midpoints of the diagonals of squares 2 * s across
+		numRows = (size_t)( mSize / ( 2 * s ) );
+		rowMaxima.assign( numRows, 0.0f );
+		parallelFor( numRows, mNumThreads, kMinPerThread / numRows + 1, [&]( size_t begin, size_t end ) {
+			for( size_t r = begin; r < end; ++r ) {
+				int y = s + (int)r * 2 * s;
+				float rowMax = 0.0f;
+				for( int x = s; x < mSize; x += 2 * s ) {
+					// the diagonals alternate like a chequerboard, as the larger triangles split
+					bool down = ( ( x - s ) / ( 2 * s ) + r ) % 2 == 0;
+					int flip = down ? 1 : -1;
+					int apexes[4] = { x + s, y - s * flip, x - s, y + s * flip };
+					float bound = grid.getBound( x - s, y - s * flip, x + s, y + s * flip, apexes, 2, false );
+					grid.getError( x, y ) = bound;
+					if( bound < numeric_limits<float>::infinity() )
+						rowMax = max( rowMax, bound );
+				}
+				rowMaxima[r] = rowMax;
+			}
+		} );
+		mMaxError = max( mMaxError, *max_element( rowMaxima.begin(), rowMaxima.end() ) );
+	}
+
+	// a midpoint's triangles reach as far as the hypotenuse is half long, or across a square; those
+	// below them as far as their own midpoints do, plus how far those are from this one
+	mRadii.resize( getTopLevel() + 1 );
+	for( int level = 0; level < (int)mRadii.size(); ++level ) {
+		float s = (float)( 1 << ( level / 2 ) );
+		if( level % 2 == 0 )
+			mRadii[level] = max( s, level > 0 ? s * sqrt( 0.5f ) + mRadii[level - 1] : 0.0f );
+		else
+			mRadii[level] = max( s * sqrt( 2.0f ), s + mRadii[level - 1] );
+	}
+}
+
+int HeightfieldMesher::getTopLevel() const
+{
+	// the two largest triangles share the diagonal of a square mSize across
+	int level = -1;
+	for( int s = 1; s < mSize; s *= 2 )
+		level += 2;
+	return level;
+}
+
+void HeightfieldMesher::extract( float maxError, vector<uint32_t> *vertices, vector<uint32_t> *indices ) const
+{
+	SplitAbove split = { mErrors.empty() ? 0 : &mErrors[0], (size_t)mSize + 1, maxError };
+	extractWith( split, vertices, indices );
+}
+
+float HeightfieldMesher::extractBudget( size_t maxTriangles, vector<uint32_t> *vertices, vector<uint32_t> *indices ) const
+{
+	SplitAbove split = { mErrors.empty() ? 0 : &mErrors[0], (size_t)mSize + 1, 0.0f };
+	int top = getTopLevel();
+	auto count = [&]( float maxError ) -> size_t {
+		split.mMaxError = maxError;
+		if( ! mSize )
+			return 0;
+		return countTriangles( split, top, 0, 0, mSize, mSize, mSize, 0 ) + countTriangles( split, top, mSize, mSize, 0, 0, 0, mSize );
+	};
+
+	// fewer triangles need a larger error, so the smallest that fits is halved down to, to within a hundredth
+	float low = 0.0f, high = mMaxError;
+	for( int i = 0; i < 32 && high - low > high * 0.01f; ++i ) {
+		float middle = ( low + high ) * 0.5f;
+		if( count( middle ) <= maxTriangles )
+			high = middle;
+		else
+			low = middle;
+	}
+	if( low == 0.0f && count( 0.0f ) <= maxTriangles )
+		high = 0.0f;
+	split.mMaxError = high;
+	extractWith( split, vertices, indices );
+	return high;
+}
+
+void HeightfieldMesher::extract( const View &view, vector<uint32_t> *vertices, vector<uint32_t> *indices ) const
+{
+	SplitInView split = { mErrors.empty() ? 0 : &mErrors[0], (size_t)mSize + 1, &mRadii, view };
+	extractWith( split, vertices, indices );
+}
+
+template<typename S>
+void HeightfieldMesher::extractWith( const S &split, vector<uint32_t> *vertices, vector<uint32_t> *indices ) const
+{
+	vector<uint32_t> triangles;
+	if( mSize ) {
+		addTriangle( split, getTopLevel(), 0, 0, mSize, mSize, mSize, 0, &triangles );
+		addTriangle( split, getTopLevel(), mSize, mSize, 0, 0, 0, mSize, &triangles );
+	}
+
+	// the pixels used, marked, then numbered in order
+	vector<uint64_t> used( ( (size_t)mWidth * mHeight + 63 ) / 64, 0 );
+	for( size_t i = 0; i < triangles.size(); ++i )
+		used[triangles[i] / 64] |= 1ULL << ( triangles[i] % 64 );
+	vector<uint32_t> ranks( used.size() );
+	vertices->clear();
+	for( size_t w = 0; w < used.size(); ++w ) {
+		ranks[w] = (uint32_t)vertices->size();
+		for( uint64_t bits = used[w]; bits; bits &= bits - 1 )
+			vertices->push_back( (uint32_t)( w * 64 + countBits( ( bits & ( ~bits + 1 ) ) - 1 ) ) );
+	}
+
+	indices->resize( triangles.size() );
+	for( size_t i = 0; i < triangles.size(); ++i ) {
+		uint32_t pixel = triangles[i];
+		(*indices)[i] = ranks[pixel / 64] + countBits( used[pixel / 64] & ( ( 1ULL << ( pixel % 64 ) ) - 1 ) );
+	}
+}
+
+template<typename S>
+void HeightfieldMesher::addTriangle( const S &split, int level, int ax, int ay, int bx, int by, int cx, int cy, vector<uint32_t> *triangles ) const
+{
+	if( min( ax, min( bx, cx ) ) >= mWidth - 1 || min( ay, min( by, cy ) ) >= mHeight - 1 )
+		return;
+	int mx = ( ax + bx ) / 2, my = ( ay + by ) / 2;
+	if( level >= 0 && split( level, mx, my ) ) {
+		addTriangle( split, level - 1, cx, cy, ax, ay, mx, my, triangles );
+		addTriangle( split, level - 1, bx, by, cx, cy, mx, my, triangles );
+		return;
+	}
+	triangles->push_back( (uint32_t)( ay * mWidth + ax ) );
+	triangles->push_back( (uint32_t)( by * mWidth + bx ) );
+	triangles->push_back( (uint32_t)( cy * mWidth + cx ) );
+}
+
+template<typename S>
+size_t HeightfieldMesher::countTriangles( const S &split, int level, int ax, int ay, int bx, int by, int cx, int cy ) const
+{
+	if( min( ax, min( bx, cx ) ) >= mWidth - 1 || min( ay, min( by, cy ) ) >= mHeight - 1 )
+		return 0;
+	int mx = ( ax + bx ) / 2, my = ( ay + by ) / 2;
+	if( level >= 0 && split( level, mx, my ) )
+		return countTriangles( split, level - 1, cx, cy, ax, ay, mx, my ) + countTriangles( split, level - 1, bx, by, cx, cy, mx, my );
+	return 1;
+}
@@ -5,6 +5,7 @@
 #include "cinder/Surface.h"
 #include "cinder/gl/Vbo.h"
 #include "cinder/ImageIo.h"
+#include "HeightfieldMesher.h"
 
 using namespace ci;
 using namespace ci::app;
@@ -16,6 +17,7 @@ class ImageHFApp : public AppBasic {
 	void    mouseDown( MouseEvent event );
 	void    mouseDrag( MouseEvent event );
 	void    keyDown( KeyEvent event );
+	void    update();
 	void    draw();
 	void	openFile();
 
@@ -24,6 +26,7 @@ class ImageHFApp : public AppBasic {
 		kColor, kRed, kGreen, kBlue
 	};
 	void updateData( ColorSwitch whichColor );
+	void updateMesh( bool report = true );
  
 	CameraPersp mCam;
 	Arcball     mArcball;
@@ -32,6 +35,15 @@ class ImageHFApp : public AppBasic {
 
 	Surface32f		mImage;
 	gl::VboMesh		mVboMesh;
+	size_t			mNumVertices, mNumIndices;		// used of mVboMesh's, which only grows
+
+	// the mesh only has the vertices its error needs, rather than one for every pixel
+	HeightfieldMesher		mMesher;
+	std::vector<float>		mHeights;
+	Color					mMute;
+	float					mMaxError;		// in the mesh's units, or in pixels on screen when view dependent
+	bool					mViewDependent;
+	Quatf					mMeshQuat;		// the rotation the view dependent mesh was made for
 };
 
 void ImageHFApp::setup()
@@ -43,6 +55,9 @@ void ImageHFApp::setup()
 	// initialize the arcball with a semi-arbitrary rotation just to give an interesting angle
 	mArcball.setQuat( Quatf( Vec3f( 0.0577576f, -0.956794f, 0.284971f ), 3.68f ) );
 
+	mMaxError = 0.25f;
+	mViewDependent = false;
+	mNumVertices = mNumIndices = 0;
 	openFile();
 }
 
@@ -56,38 +71,6 @@ void ImageHFApp::openFile()
         mWidth = mImage.getWidth();
         mHeight = mImage.getHeight();
         
-        gl::VboMesh::Layout layout;
-        layout.setDynamicColorsRGB();
-        layout.setDynamicPositions();
-        layout.setStaticIndices();
-        
-        bool forward = false;
-        std::vector<uint32_t> indices;
-        for(int y=0;y<mHeight-1;++y) {
-            if(forward) {
-                indices.push_back( y*mWidth + 0 );
-                
-                for(int x=0;x<mWidth;++x) {
-                    indices.push_back( y*mWidth + x );
-                    indices.push_back( (y+1)*mWidth + x );
-                }
-            }
-            else {
-                indices.push_back( y*mWidth + mWidth-1 );
-                
-                for(int x=mWidth-1;x>=0;--x) {
-                    indices.push_back( y*mWidth + x );
-                    indices.push_back( (y+1)*mWidth + x );
-                }
-            }
-            
-            forward = !forward;
-        }
-        
-        mVboMesh = gl::VboMesh( mWidth * mHeight, indices.size(),
-                               layout, GL_TRIANGLE_STRIP );
-        mVboMesh.bufferIndices( indices );
-        
         updateData( kColor );		
     }
 }
@@ -131,9 +114,31 @@ void ImageHFApp::keyDown( KeyEvent event )
 		case 'o':
 			openFile();
 		break;
+		case '[':
+			mMaxError *= 0.5f;
+			updateMesh();
+		break;
+		case ']':
+			mMaxError *= 2.0f;
+			updateMesh();
+		break;
+		case 'v':
+			// as far off on screen, at most, as the mesh was in its own units
+			mViewDependent = ! mViewDependent;
+			mMaxError = mViewDependent ? 1.0f : 0.25f;
+			updateMesh();
+		break;
 	}
 }
 
+void ImageHFApp::update()
+{
+	// the view dependent mesh follows the rotation, only when it changes
+	Quatf quat = mArcball.getQuat();
+	if( mViewDependent && ( quat.w != mMeshQuat.w || quat.v != mMeshQuat.v ) )
+		updateMesh( false );
+}
+
 void ImageHFApp::draw()
 {
     glClearColor( 0.0f, 0.0f, 0.0f, 1.0f );
@@ -142,50 +147,93 @@ void ImageHFApp::draw()
     gl::pushModelView();
 		gl::translate( Vec3f( 0.0f, 0.0f, mHeight / 2.0f ) );
 		gl::rotate( mArcball.getQuat() );
-		if( mVboMesh )
-			gl::draw( mVboMesh );
+		if( mNumIndices )
+			gl::drawRange( mVboMesh, 0, mNumIndices, 0, (int)mNumVertices - 1 );
     gl::popModelView();
 }
 
 void ImageHFApp::updateData( ImageHFApp::ColorSwitch whichColor )
 {
-	Surface32f::Iter pixelIter = mImage.getIter();
-	gl::VboMesh::VertexIter vertexIter( mVboMesh );
+	if( ! mImage )
+		return;
+
+	// calculate the height based on a weighted average of the RGB, and emphasize either the red green or blue color in each of those modes
+	const float muteColor = 0.2f;
+	Color weights;
+	switch( whichColor ) {
+		case kColor:
+			weights = Color( 0.3333f, 0.3333f, 0.3333f );
+			mMute = Color( 1, 1, 1 );
+		break;
+		case kRed:
+			weights = Color( 1, 0, 0 );
+			mMute = Color( 1, muteColor, muteColor );
+		break;
+		case kGreen:
+			weights = Color( 0, 1, 0 );
+			mMute = Color( muteColor, 1, muteColor );
+		break;
+		case kBlue:
+			weights = Color( 0, 0, 1 );
+			mMute = Color( muteColor, muteColor, 1 );
+		break;
+	}
 
+	mHeights.resize( mWidth * mHeight );
+	Surface32f::Iter pixelIter = mImage.getIter();
+	float *height = &mHeights[0];
 	while( pixelIter.line() ) {
-		while( pixelIter.pixel() ) {
-			Color color( pixelIter.r(), pixelIter.g(), pixelIter.b() );
-			float height;
-			const float muteColor = 0.2f;
-
-			// calculate the height based on a weighted average of the RGB, and emphasize either the red green or blue color in each of those modes
-			switch( whichColor ) {
-				case kColor:
-					height = color.dot( Color( 0.3333f, 0.3333f, 0.3333f ) );
-				break;
-				case kRed:
-					height = color.dot( Color( 1, 0, 0 ) );
-					color *= Color( 1, muteColor, muteColor );
-				break;
-				case kGreen:
-					height = color.dot( Color( 0, 1, 0 ) );
-					color *= Color( muteColor, 1, muteColor );
-				break;
-				case kBlue:
-					height = color.dot( Color( 0, 0, 1 ) );
-					color *= Color( muteColor, muteColor, 1 );					
-				break;            
-			}
-
-			// the x and the z coordinates correspond to the pixel's x & y
-			float x = pixelIter.x() - mWidth / 2.0f;
-			float z = pixelIter.y() - mHeight / 2.0f;
-
-            vertexIter.setPosition( x, height * 30.0f, z );
-			vertexIter.setColorRGB( color );
-			++vertexIter;
-		}
+		while( pixelIter.pixel() )
+			*height++ = Color( pixelIter.r(), pixelIter.g(), pixelIter.b() ).dot( weights ) * 30.0f;
+	}
+
+	mMesher.build( &mHeights[0], mWidth, mHeight );
+	updateMesh();
+}
+
+void ImageHFApp::updateMesh( bool report )
+{
+	std::vector<uint32_t> vertices, indices;
+	if( mViewDependent ) {
+		// the eye in the image's pixels, undoing the translation and rotation draw() makes
+		mMeshQuat = mArcball.getQuat();
+		Vec3f eye = mMeshQuat.inverse() * ( mCam.getEyePoint() - Vec3f( 0.0f, 0.0f, mHeight / 2.0f ) );
+		HeightfieldMesher::View view;
+		view.mEye[0] = eye.x + mWidth / 2.0f;
+		view.mEye[1] = eye.z + mHeight / 2.0f;
+		view.mPixelsPerUnit = getWindowHeight() / ( 2.0f * math<float>::tan( toRadians( mCam.getFov() ) * 0.5f ) );
+		view.mMaxPixels = mMaxError;
+		mMesher.extract( view, &vertices, &indices );
+	}
+	else
+		mMesher.extract( mMaxError, &vertices, &indices );
+
+	mNumVertices = vertices.size();
+	mNumIndices = indices.size();
+	if( indices.empty() )
+		return;
+
+	// the view dependent mesh changes every frame while dragging, so the buffers are kept, with room to grow
+	if( ! mVboMesh || mVboMesh.getNumVertices() < vertices.size() || mVboMesh.getNumIndices() < indices.size() ) {
+		gl::VboMesh::Layout layout;
+		layout.setDynamicColorsRGB();
+		layout.setDynamicPositions();
+		layout.setDynamicIndices();
+		mVboMesh = gl::VboMesh( vertices.size() * 3 / 2, indices.size() * 3 / 2, layout, GL_TRIANGLES );
+	}
+	mVboMesh.getIndexVbo().bufferSubData( 0, indices.size() * sizeof( uint32_t ), &indices[0] );
+
+	gl::VboMesh::VertexIter vertexIter( mVboMesh );
+	for( size_t i = 0; i < vertices.size(); ++i ) {
+		// the x and the z coordinates correspond to the pixel's x & y
+		int x = vertices[i] % mWidth, y = vertices[i] / mWidth;
+		ColorA color = mImage.getPixel( Vec2i( x, y ) );
+		vertexIter.setPosition( x - mWidth / 2.0f, mHeights[vertices[i]], y - mHeight / 2.0f );
+		vertexIter.setColorRGB( Color( color.r, color.g, color.b ) * mMute );
+		++vertexIter;
 	}
+	if( report )
+		console() << indices.size() / 3 << " triangles over " << vertices.size() << " of " << mWidth * mHeight << " pixels" << std::endl;
 }
 
 CINDER_APP_BASIC( ImageHFApp, RendererGl );
@@ -0,0 +1,148 @@
+//
+//  ParticleEngine.h
+//
+//  shdrVelF.glsl's velocity pass on the CPU, and recordings of GPU frames to replay through it.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ParticleEngine {
+  public:
+	enum Wrap { CLAMP, REPEAT };
+	enum Filter { NEAREST, LINEAR };
+
+	//! texNoise2: red and green of the source, as floats from 0 to 1
+	struct Field {
+		Field() : mWidth( 0 ), mHeight( 0 ), mWrap( REPEAT ), mFilter( NEAREST ), mVersion( 0 ) {}
+
+		std::vector<float>	mData;		// r, g pairs, row-major
+		int					mWidth, mHeight;
+		Wrap				mWrap;
+		Filter				mFilter;
+		uint32_t			mVersion;	// bumped by every setField()
+	};
+
+	//! How far a state is from another, per attachment: positions, velocities, information.
+	struct Difference {
+		Difference() : mNumOver( 0 ) { for( int i = 0; i < 3; ++i ) { mMaxError[i] = 0.0f; mWorst[i] = 0; } }
+
+		float	mMaxError[3];
+		size_t	mWorst[3];		// particle with the largest error
+		size_t	mNumOver;		// values off by more than the tolerance
+	};
+
+	//! \a numThreads 0 uses every hardware thread.
+	ParticleEngine( int width, int height, int numThreads = 0 );
+	~ParticleEngine();
+
+	int				getWidth() const		{ return mWidth; }
+	int				getHeight() const		{ return mHeight; }
+	int				getNumThreads() const	{ return (int)mWorkers.size() + 1; }
+
+	//! Round every value written to half precision, as the RGBA16F attachments do.
+	void			setHalfFloat( bool half )	{ mHalfFloat = half; }
+	bool			isHalfFloat() const			{ return mHalfFloat; }
+	//! Particle row y reads row height - 1 - y of the state and origins, as a pass drawn under
+	//! setMatricesWindow()'s upper-left origin does; reset() then loads the state upside down too.
+	void			setRowsFlipped( bool flipped )	{ mRowsFlipped = flipped; }
+	bool			isRowsFlipped() const			{ return mRowsFlipped; }
+
+	//! Loads oPositions, oVelocities and the first information image; the state starts
+	//! from them, as initFbo() copies them into the attachments. Rows are \a rowStride floats apart.
+	void			reset( const float *positions, const float *velocities, const float *information, size_t rowStride );
+	//! Replaces the current state only.
+	void			setState( const float *positions, const float *velocities, const float *information, size_t rowStride );
+
+	//! 8-bit red and green, \a increment bytes between pixels as ci::Surface8u lays them out;
+	//! pass the same channel twice for a luminance texture, which reads the same in red and green.
+	void			setField( const uint8_t *red, const uint8_t *green, int width, int height, ptrdiff_t rowBytes, int increment, Wrap wrap, Filter filter );
+	//! Float pixels of \a channels floats each, red and green first; a single channel is luminance.
+	void			setField( const float *data, int width, int height, size_t rowStride, int channels, Wrap wrap, Filter filter );
+	const Field&	getField() const	{ return mField; }
+
+	//! One pass of shdrVelF.glsl with its speed and direction uniforms.
+	void			step( float speed, float direction );
+
+	//! The current state, width * 4 floats per row.
+	const float*	getPositions() const		{ return &mPositions[mCurrent][0]; }
+	const float*	getVelocities() const		{ return &mVelocities[mCurrent][0]; }
+	const float*	getInformation() const		{ return &mInformation[mCurrent][0]; }
+	const float*	getOriginPositions() const	{ return &mOriginPositions[0]; }
+	const float*	getOriginVelocities() const	{ return &mOriginVelocities[0]; }
+
+	//! Compares the current state with another, \a rowStride floats between rows.
+	Difference		compare( const float *positions, const float *velocities, const float *information, size_t rowStride, float tolerance ) const;
+
+	//! \a value as a half float would hold it.
+	static float	roundHalf( float value );
+
+  private:
+	void			run();
+	void			runTiles();
+	void			stepRows( int begin, int end );
+	void			sampleField( const float *positions, float *samples, int count ) const;
+
+	int						mWidth, mHeight;
+	bool					mHalfFloat, mRowsFlipped;
+	float					mSpeed, mDirection;
+
+	int						mCurrent;
+	std::vector<float>		mPositions[2], mVelocities[2], mInformation[2];
+	std::vector<float>		mOriginPositions, mOriginVelocities;
+	Field					mField;
+
+	std::vector<std::thread>	mWorkers;
+	std::mutex					mMutex;
+	std::condition_variable		mWake, mDone;
+	uint32_t					mGeneration;
+	int							mNumBusy;
+	int							mNextTile;		// guarded by mMutex; tiles are coarse enough for a lock
+	bool						mQuit;
+};
+
+class ParticleRecording {
+  public:
+	ParticleRecording();
+
+	//! Starts a recording of \a engine's origins and rounding, with \a positions, \a velocities
+	//! and \a information ( read back from the GPU ) as the state it starts from.
+	bool		create( const std::string &path, const ParticleEngine &engine,
+						const float *positions, const float *velocities, const float *information, size_t rowStride );
+	//! Appends one GPU step: its uniforms, \a field when it changed since the last frame, and the state it produced.
+	bool		append( float speed, float direction, const ParticleEngine::Field &field,
+						const float *positions, const float *velocities, const float *information, size_t rowStride );
+
+	bool		open( const std::string &path );
+	void		close();
+	bool		isOpen() const		{ return mFile.is_open(); }
+	bool		isWriting() const	{ return mWriting; }
+	int			getWidth() const	{ return mWidth; }
+	int			getHeight() const	{ return mHeight; }
+
+	//! Loads the recorded origins, starting state and rounding into \a engine, which must be the recording's size.
+	bool		start( ParticleEngine &engine );
+	//! Steps \a engine as the next recorded frame was stepped and compares the result with it;
+	//! false once the frames run out.
+	bool		next( ParticleEngine &engine, float tolerance, ParticleEngine::Difference *difference );
+
+  private:
+	bool		writeImage( const float *pixels, size_t rowStride );
+	bool		readFloats( std::vector<float> &values, size_t count );
+
+	std::fstream			mFile;
+	bool					mWriting;
+	int						mWidth, mHeight;
+	int32_t					mFlags;
+	bool					mFieldWritten;
+	uint32_t				mFieldVersion;		// version of the field last written
+	std::vector<float>		mPositions, mVelocities, mInformation, mFieldData;
+};
@@ -17,6 +17,7 @@
 #include "cinderSyphon.h"
 
 #include "Resources.h"
+#include "ParticleEngine.h"
 
 #include "CinderFreenect.h"
 
@@ -44,6 +45,9 @@ public:
 	void keyDown(KeyEvent event);
 	void drawText();
 	void loadShaders();
+	void readAttachments(gl::Fbo &fbo);
+	void writeAttachments(gl::Fbo &fbo);
+	void toggleRecording();
 	
 private:
 	int m_pos;
@@ -85,6 +89,12 @@ private:
 	
 	KinectRef m_kinect;
 	gl::Texture m_depthTex;
+	
+	// the same simulation on the CPU; 'c' swaps it in for the shader, 'r' records the shader's frames for it
+	std::shared_ptr<ParticleEngine> m_engine;
+	ParticleRecording m_recording;
+	bool m_cpuParticles;
+	vector<float> m_attachments[3];
 };
 
 void KinectToParticles::initFbo()
@@ -212,6 +222,17 @@ void KinectToParticles::setup()
 	
 	GLenum interp = GL_NEAREST;
 	
+	// the quad and initFbo() draw with the window's upper-left origin, so every pass reads the attachments upside down
+	size_t rowStride = posSurf.getRowBytes() / sizeof(float);
+	m_engine = make_shared<ParticleEngine>(PARTICLES, PARTICLES);
+	m_engine->setHalfFloat(true);
+	m_engine->setRowsFlipped(true);
+	m_engine->reset(posSurf.getData(), velSurf.getData(), infoSurf.getData(), rowStride);
+	m_engine->setField(noiseSurf.getData(), PARTICLES, PARTICLES, noiseSurf.getRowBytes() / sizeof(float), 4, ParticleEngine::REPEAT, ParticleEngine::NEAREST);
+	m_cpuParticles = false;
+	for (int i = 0; i < 3; i++)
+		m_attachments[i].resize(PARTICLES * PARTICLES * 4);
+	
 	m_texNoise = gl::Texture(noiseSurf, tFormatSmall);
 	m_texNoise.setWrap(GL_REPEAT, GL_REPEAT);
 	m_texNoise.setMinFilter(interp);
@@ -325,6 +346,60 @@ void KinectToParticles::keyDown( KeyEvent event)
 	{
 		m_createParticles = true;
 	}
+	else if (event.getChar() == 'c')
+	{
+		// carry on from whatever the shader wrote last
+		if (!m_cpuParticles)
+		{
+			readAttachments(m_fbo[m_bufferOut]);
+			m_engine->setState(&m_attachments[0][0], &m_attachments[1][0], &m_attachments[2][0], PARTICLES * 4);
+		}
+		m_cpuParticles = !m_cpuParticles;
+	}
+	else if (event.getChar() == 'r')
+	{
+		toggleRecording();
+	}
+}
+
+void KinectToParticles::readAttachments(gl::Fbo &fbo)
+{
+	fbo.bindFramebuffer();
+	for (int i = 0; i < 3; i++)
+	{
+		glReadBuffer(GL_COLOR_ATTACHMENT0_EXT + i);
+		glReadPixels(0, 0, PARTICLES, PARTICLES, GL_RGBA, GL_FLOAT, &m_attachments[i][0]);
+	}
+	fbo.unbindFramebuffer();
+}
+
+void KinectToParticles::writeAttachments(gl::Fbo &fbo)
+{
+	const float *data[3] = { m_engine->getPositions(), m_engine->getVelocities(), m_engine->getInformation() };
+	for (int i = 0; i < 3; i++)
+	{
+		gl::Texture &tex = fbo.getTexture(i);
+		tex.bind();
+		glTexSubImage2D(tex.getTarget(), 0, 0, 0, PARTICLES, PARTICLES, GL_RGBA, GL_FLOAT, data[i]);
+		tex.unbind();
+	}
+}
+
+void KinectToParticles::toggleRecording()
+{
+	if (m_recording.isOpen())
+	{
+		m_recording.close();
+		console() << "Stopped recording particles" << std::endl;
+		return;
+	}
+	
+	string path = (getHomeDirectory() / "KinectToParticles.ptrc").string();
+	readAttachments(m_fbo[m_bufferOut]);
+	if (m_recording.create(path, *m_engine, &m_attachments[0][0], &m_attachments[1][0], &m_attachments[2][0], PARTICLES * 4))
+		console() << "Recording particles to " << path << std::endl;
+	else
+		console() << "Unable to record particles to " << path << std::endl;
 }
 
 void KinectToParticles::update()
@@ -333,10 +408,27 @@ void KinectToParticles::update()
 	
 	// we don't need to update the kinect every frame, it doesn't make much difference in appearance
 	if (getElapsedFrames() % 2 == 0 && m_kinect->checkNewDepthFrame())
-		m_depthTex = m_kinect->getDepthImage();
+	{
+		ImageSourceRef depth = m_kinect->getDepthImage();
+		m_depthTex = depth;
+		// kept current even while the shader runs, so 'c' and 'r' pick up the depth it is using
+		Channel8u depthChannel(depth);
+		m_engine->setField(depthChannel.getData(), depthChannel.getData(), depthChannel.getWidth(), depthChannel.getHeight(),
+						   depthChannel.getRowBytes(), depthChannel.getIncrement(), ParticleEngine::CLAMP, ParticleEngine::LINEAR);
+	}
 	
 	///////
 	
+	if (m_cpuParticles)
+	{
+		m_engine->step(m_parts_speed, m_parts_direction);
+		writeAttachments(m_fbo[m_bufferIn]);
+		
+		m_bufferIn = (m_bufferIn + 1) % 2;
+		m_bufferOut = (m_bufferIn + 1) % 2;
+		return;
+	}
+	
 	m_fbo[m_bufferIn].bindFramebuffer();
 	
 	gl::setMatricesWindow(m_fbo[0].getSize());
@@ -388,6 +480,13 @@ void KinectToParticles::update()
 	if (m_depthTex)
 		m_depthTex.unbind();
 	
+	if (m_recording.isOpen())
+	{
+		readAttachments(m_fbo[m_bufferIn]);
+		m_recording.append(m_parts_speed, m_parts_direction, m_engine->getField(),
+						   &m_attachments[0][0], &m_attachments[1][0], &m_attachments[2][0], PARTICLES * 4);
+	}
+	
 	m_bufferIn = (m_bufferIn + 1) % 2;
 	m_bufferOut = (m_bufferIn + 1) % 2;
 	
@@ -520,6 +619,8 @@ void KinectToParticles::drawText()
 	
 	layout.addLine("F - switch to fullscreen");
 	layout.addLine("t - draw textures");
+	layout.addLine("c - step on the CPU");
+	layout.addLine("r - record frames");
 	
 	char fps[50];
 	sprintf(fps, "FPS: %.2f", getAverageFps());
@@ -0,0 +1,325 @@
+/*
+ *  BrushSession.cpp
+ *
+ */
+
+#include "BrushSession.h"
+#include "RibbonMesh.h"
+#include "RibbonRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace {
+
+// "SILK" followed by the format version; values are stored in host byte order.
+// Version 2 adds the noise offset to every rebuild.
+const char		kMagic[4]	= { 'S', 'I', 'L', 'K' };
+const uint32_t	kVersion	= 2;
+
+template<typename T>
+void writeValue( std::ostream &out, const T &value )
+{
+	out.write( reinterpret_cast<const char*>( &value ), sizeof( T ) );
+}
+
+template<typename T>
+bool readValue( std::istream &in, T &value )
+{
+	return (bool)in.read( reinterpret_cast<char*>( &value ), sizeof( T ) );
+}
+
+// whether \a count items of at least \a itemBytes each can still be in the file, which ends at \a end
+bool fits( std::istream &in, std::streamoff end, uint64_t count, size_t itemBytes )
+{
+	std::streamoff left = end - (std::streamoff)in.tellg();
+	return left >= 0 && count <= (uint64_t)left / itemBytes;
+}
+
+} // anonymous namespace
+
+BrushSession::BrushSession()
+	: _noiseSeed( 0 ), _width( 0 ), _height( 0 ), _lastCreate( -1 )
+{
+}
+
+void BrushSession::begin( int32_t noiseSeed, int width, int height )
+{
+	_noiseSeed	= noiseSeed;
+	_width		= width;
+	_height		= height;
+	_frames.clear();
+	_lastCreate = -1;
+	_pending = Frame();
+	_lastColors.clear();
+	_lastWidths.clear();
+}
+
+void BrushSession::recordCreate( const SilkBrush::Settings &settings, uint32_t seed, float noiseOffset )
+{
+	_pending.flags			|= kFrameCreate;
+	_pending.settings		= settings;
+	_pending.seed			= seed;
+	_pending.noiseOffset	= noiseOffset;
+}
+
+void BrushSession::recordStep( const ci::Vec2f &mousePosition, float damping )
+{
+	_pending.flags			|= kFrameStep;
+	_pending.mousePosition	= mousePosition;
+	_pending.damping		= damping;
+}
+
+void BrushSession::recordClear()
+{
+	_pending.flags |= kFrameClear;
+}
+
+void BrushSession::recordDraw( bool additiveBlending, int bezierSegments, bool dropLastVertex,
+							   const std::vector<ci::ColorA> &colors, const std::vector<float> &widths )
+{
+	if( isFull() ) {
+		_pending = Frame();
+		return;
+	}
+
+	if( additiveBlending )
+		_pending.flags |= kFrameAdditive;
+	if( dropLastVertex )
+		_pending.flags |= kFrameDropLast;
+	_pending.bezierSegments = bezierSegments;
+
+	// the style tables only change with the colour mode, alpha and brush
+	if( _frames.empty() || colors != _lastColors || widths != _lastWidths ) {
+		_pending.flags	|= kFrameStyle;
+		_pending.colors	= colors;
+		_pending.widths	= widths;
+		_lastColors		= colors;
+		_lastWidths		= widths;
+	}
+
+	if( _pending.flags & kFrameCreate )
+		_lastCreate = (int)_frames.size();
+	_frames.push_back( _pending );
+	_pending = Frame();
+
+	if( _frames.back().flags & kFrameClear )
+		dropBeforeLastCreate();
+}
+
+void BrushSession::dropBeforeLastCreate()
+{
+	// without its noise offset a rebuild still needs every step before it
+	if( _lastCreate <= 0 || _frames[_lastCreate].noiseOffset < 0 )
+		return;
+
+	// the rebuild takes over the style tables in use when it happened
+	Frame &create = _frames[_lastCreate];
+	if( ! ( create.flags & kFrameStyle ) ) {
+		for( int f = _lastCreate - 1; f >= 0; f-- ) {
+			if( _frames[f].flags & kFrameStyle ) {
+				create.flags	|= kFrameStyle;
+				create.colors	= _frames[f].colors;
+				create.widths	= _frames[f].widths;
+				break;
+			}
+		}
+	}
+
+	_frames.erase( _frames.begin(), _frames.begin() + _lastCreate );
+	_lastCreate = 0;
+}
+
+bool BrushSession::write( const std::string &path ) const
+{
+	std::ofstream out( path.c_str(), std::ios::binary );
+	if( ! out )
+		return false;
+
+	out.write( kMagic, sizeof( kMagic ) );
+	writeValue( out, kVersion );
+	writeValue( out, _noiseSeed );
+	writeValue( out, (int32_t)_width );
+	writeValue( out, (int32_t)_height );
+	writeValue( out, (uint32_t)_frames.size() );
+
+	for( size_t f = 0; f < _frames.size(); f++ ) {
+		const Frame &frame = _frames[f];
+		writeValue( out, frame.flags );
+		writeValue( out, frame.bezierSegments );
+		if( frame.flags & kFrameStep ) {
+			writeValue( out, frame.mousePosition.x );
+			writeValue( out, frame.mousePosition.y );
+			writeValue( out, frame.damping );
+		}
+		if( frame.flags & kFrameCreate ) {
+			writeValue( out, frame.seed );
+			writeValue( out, (int32_t)frame.settings.bristleCount );
+			writeValue( out, frame.settings.brushRadius );
+			writeValue( out, frame.settings.filamentSpacing );
+			writeValue( out, frame.settings.filamentCount );
+			writeValue( out, frame.settings.frictionMin );
+			writeValue( out, frame.settings.frictionMax );
+			writeValue( out, frame.settings.gravity );
+			writeValue( out, frame.noiseOffset );
+		}
+		if( frame.flags & kFrameStyle ) {
+			writeValue( out, (uint32_t)frame.colors.size() );
+			for( size_t i = 0; i < frame.colors.size(); i++ ) {
+				writeValue( out, frame.colors[i].r );
+				writeValue( out, frame.colors[i].g );
+				writeValue( out, frame.colors[i].b );
+				writeValue( out, frame.colors[i].a );
+				writeValue( out, frame.widths[i] );
+			}
+		}
+	}
+
+	return (bool)out;
+}
+
+bool BrushSession::read( const std::string &path )
+{
+	std::ifstream in( path.c_str(), std::ios::binary | std::ios::ate );
+	std::streamoff end = in.tellg();
+	in.seekg( 0 );
+	char magic[4];
+	uint32_t version, numFrames;
+	int32_t noiseSeed, width, height;
+	if( ! in.read( magic, sizeof( magic ) ) || ! std::equal( magic, magic + 4, kMagic ) )
+		return false;
+	if( ! readValue( in, version ) || version < 1 || version > kVersion )
+		return false;
+	if( ! readValue( in, noiseSeed ) || ! readValue( in, width ) || ! readValue( in, height ) || ! readValue( in, numFrames ) )
+		return false;
+
+	// counts are checked against what is left of the file before anything is sized by them
+	const size_t minFrameBytes = sizeof( uint8_t ) + sizeof( int32_t );
+	const size_t pieceBytes = 5 * sizeof( float );
+	if( ! fits( in, end, numFrames, minFrameBytes ) )
+		return false;
+
+	std::vector<Frame> frames( numFrames );
+	int lastCreate = -1;
+	for( size_t f = 0; f < frames.size(); f++ ) {
+		Frame &frame = frames[f];
+		if( ! readValue( in, frame.flags ) || ! readValue( in, frame.bezierSegments ) )
+			return false;
+		if( frame.flags & kFrameStep ) {
+			if( ! readValue( in, frame.mousePosition.x ) || ! readValue( in, frame.mousePosition.y ) || ! readValue( in, frame.damping ) )
+				return false;
+		}
+		if( frame.flags & kFrameCreate ) {
+			int32_t bristleCount;
+			SilkBrush::Settings &s = frame.settings;
+			if( ! readValue( in, frame.seed ) || ! readValue( in, bristleCount ) || ! readValue( in, s.brushRadius )
+				|| ! readValue( in, s.filamentSpacing ) || ! readValue( in, s.filamentCount ) || ! readValue( in, s.frictionMin )
+				|| ! readValue( in, s.frictionMax ) || ! readValue( in, s.gravity ) )
+				return false;
+			if( version >= 2 && ! readValue( in, frame.noiseOffset ) )
+				return false;
+			s.bristleCount = bristleCount;
+			lastCreate = (int)f;
+		}
+		if( frame.flags & kFrameStyle ) {
+			uint32_t numPieces;
+			if( ! readValue( in, numPieces ) || ! fits( in, end, numPieces, pieceBytes ) )
+				return false;
+			frame.colors.resize( numPieces );
+			frame.widths.resize( numPieces );
+			for( size_t i = 0; i < numPieces; i++ ) {
+				ci::ColorA &c = frame.colors[i];
+				if( ! readValue( in, c.r ) || ! readValue( in, c.g ) || ! readValue( in, c.b ) || ! readValue( in, c.a ) || ! readValue( in, frame.widths[i] ) )
+					return false;
+			}
+		}
+	}
+
+	begin( noiseSeed, width, height );
+	_frames.swap( frames );
+	_lastCreate = lastCreate;
+	return true;
+}
+
+bool BrushSession::render( const std::string &path, const RenderFormat &format ) const
+{
+	int width	= (int)std::floor( _width * format.scale + 0.5f );
+	int height	= (int)std::floor( _height * format.scale + 0.5f );
+	if( width <= 0 || height <= 0 )
+		return false;
+
+	std::ofstream out( path.c_str(), std::ios::binary );
+	if( ! out )
+		return false;
+
+	bool wide = format.bitsPerChannel > 8;
+	int maxValue = wide ? 65535 : 255;
+	out << "P6\n" << width << " " << height << "\n" << maxValue << "\n";
+
+	// a clear wipes everything drawn before it, so only the brush and style are replayed up to the last one
+	size_t firstDrawn = 0;
+	for( size_t f = 0; f < _frames.size(); f++ ) {
+		if( _frames[f].flags & kFrameClear )
+			firstDrawn = f;
+	}
+
+	size_t rowBytes = (size_t)width * 3 * sizeof( float );
+	int bandRows = (int)std::min<size_t>( std::max<size_t>( format.maxBandBytes / rowBytes, 1 ), height );
+
+	RibbonRasterizer raster;
+	raster.setNumThreads( format.numThreads );
+	std::vector<uint8_t> line( (size_t)width * 3 * ( wide ? 2 : 1 ) );
+
+	for( int firstRow = 0; firstRow < height; firstRow += bandRows ) {
+		int numRows = std::min( bandRows, height - firstRow );
+		raster.setRegion( width, firstRow, numRows );
+
+		// the app starts out cleared to black; everything after that is recorded
+		SilkBrush brush;
+		RibbonMesh ribbons;
+		brush.setNoiseSeed( _noiseSeed );
+
+		for( size_t f = 0; f < _frames.size(); f++ ) {
+			const Frame &frame = _frames[f];
+			bool additive = ( frame.flags & kFrameAdditive ) != 0;
+
+			if( frame.flags & kFrameCreate ) {
+				if( frame.noiseOffset >= 0 )
+					brush.setNoiseOffset( frame.noiseOffset );
+				brush.create( frame.settings, frame.seed );
+			}
+			if( frame.flags & kFrameStep )
+				brush.update( frame.mousePosition, frame.damping );
+			if( frame.flags & kFrameStyle )
+				ribbons.setSegmentStyle( frame.colors, frame.widths );
+			if( f < firstDrawn )
+				continue;
+			if( frame.flags & kFrameClear )
+				raster.clear( additive ? ci::Color( 0, 0, 0 ) : ci::Color( 1, 1, 1 ) );
+
+			ribbons.setShape( frame.bezierSegments, ( frame.flags & kFrameDropLast ) != 0 );
+			ribbons.fill( brush.getLines(), format.numThreads );
+			raster.drawStrip( ribbons.getVertices(), ribbons.getNumVertices(), format.scale,
+							  additive ? RibbonRasterizer::BLEND_ADDITIVE : RibbonRasterizer::BLEND_ALPHA );
+		}
+
+		for( int y = firstRow; y < firstRow + numRows; y++ ) {
+			const float *row = raster.getRow( y );
+			for( size_t i = 0; i < (size_t)width * 3; i++ ) {
+				int value = (int)( std::min( std::max( row[i], 0.0f ), 1.0f ) * maxValue + 0.5f );
+				if( wide ) {
+					// PPM stores 16 bit samples most significant byte first
+					line[i * 2]		= (uint8_t)( value >> 8 );
+					line[i * 2 + 1]	= (uint8_t)( value & 0xff );
+				}
+				else {
+					line[i] = (uint8_t)value;
+				}
+			}
+			out.write( reinterpret_cast<const char*>( &line[0] ), line.size() );
+		}
+	}
+
+	return (bool)out;
+}
@@ -0,0 +1,94 @@
+/*
+ *  BrushSession.h
+ *
+ *  A frame-by-frame record of the brush's inputs, replayed offline by render().
+ *
+ */
+
+#pragma once
+
+#include "cinder/Color.h"
+#include "cinder/Vector.h"
+#include "SilkBrush.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class BrushSession
+{
+public:
+	struct RenderFormat
+	{
+		float	scale;				// output size relative to the recorded window
+		int		bitsPerChannel;		// 8 or 16
+		size_t	numThreads;			// 0 uses one thread per core
+		size_t	maxBandBytes;		// float accumulation memory per band
+
+		RenderFormat() : scale( 4.0f ), bitsPerChannel( 8 ), numThreads( 0 ), maxBandBytes( 1 << 30 ) {}
+	};
+
+	//! Over an hour at 60 frames a second without a rebuild.
+	static const size_t kMaxFrames = 1 << 18;
+
+	BrushSession();
+
+	//! Starts a new recording; drops any recorded frames.
+	void	begin( int32_t noiseSeed, int width, int height );
+	void	setCanvasSize( int width, int height )	{ _width = width; _height = height; }
+
+	// Recorded into the frame being built; recordDraw() closes it.
+	void	recordCreate( const SilkBrush::Settings &settings, uint32_t seed, float noiseOffset );
+	void	recordStep( const ci::Vec2f &mousePosition, float damping );
+	void	recordClear();
+	void	recordDraw( bool additiveBlending, int bezierSegments, bool dropLastVertex,
+						const std::vector<ci::ColorA> &colors, const std::vector<float> &widths );
+
+	size_t	getNumFrames() const	{ return _frames.size(); }
+	//! True once kMaxFrames are recorded; later frames are not.
+	bool	isFull() const			{ return _frames.size() >= kMaxFrames; }
+	int		getWidth() const		{ return _width; }
+	int		getHeight() const		{ return _height; }
+
+	bool	write( const std::string &path ) const;
+	bool	read( const std::string &path );
+
+	//! Replays the session into a PPM at \a path, returning false if it could not be written.
+	bool	render( const std::string &path, const RenderFormat &format = RenderFormat() ) const;
+
+private:
+	enum
+	{
+		kFrameStep		= 1 << 0,
+		kFrameCreate	= 1 << 1,
+		kFrameClear		= 1 << 2,
+		kFrameAdditive	= 1 << 3,
+		kFrameDropLast	= 1 << 4,
+		kFrameStyle		= 1 << 5
+	};
+
+	struct Frame
+	{
+		uint8_t					flags;
+		ci::Vec2f				mousePosition;
+		float					damping;
+		uint32_t				seed;
+		float					noiseOffset;	// negative when not recorded (version 1 files)
+		SilkBrush::Settings		settings;
+		int32_t					bezierSegments;
+		std::vector<ci::ColorA>	colors;
+		std::vector<float>		widths;
+
+		Frame() : flags( 0 ), damping( 0 ), seed( 0 ), noiseOffset( -1 ), bezierSegments( 0 ) {}
+	};
+
+	void	dropBeforeLastCreate();
+
+	int32_t					_noiseSeed;
+	int						_width, _height;
+	std::vector<Frame>		_frames;
+	int						_lastCreate;		// index into _frames, -1 for none
+	Frame					_pending;
+	std::vector<ci::ColorA>	_lastColors;
+	std::vector<float>		_lastWidths;
+};
@@ -0,0 +1,61 @@
+//
+//  FrameCapture.h
+//
+//  The Cinder ends of FrameRecorder: image sequence files and asynchronous window reads.
+//
+
+#pragma once
+
+#include "cinder/Filesystem.h"
+#include "cinder/gl/gl.h"
+#include "FrameRecorder.h"
+
+#include <string>
+#include <vector>
+
+class ImageSequenceSink : public FrameSink {
+  public:
+	//! Files go in \a directory as \a prefix, the frame's index in six digits and \a extension,
+	//! or as the frame's name when it has one. Four channel frames keep alpha only with \a alpha.
+	ImageSequenceSink( const ci::fs::path &directory, const std::string &prefix = "", const std::string &extension = "png", bool alpha = false );
+
+	bool	isOrdered() const	{ return false; }
+	bool	write( RecorderFrame &frame );
+
+  private:
+	ci::fs::path	mDirectory;
+	std::string		mPrefix, mExtension;
+	bool			mAlpha;
+};
+
+#if ! defined( CINDER_GLES )
+
+class WindowReader {
+  public:
+	//! \a numBuffers reads are in flight at once; frames reach the recorder that many calls late, less one.
+	explicit WindowReader( size_t numBuffers = 3 );
+	~WindowReader();
+
+	//! Starts reading \a width x \a height pixels from the bottom left of the bound framebuffer
+	//! as RGBA, and hands the oldest read still in flight to \a recorder once the ring is full.
+	//! \a name becomes the frame's name.
+	void	read( FrameRecorder &recorder, int width, int height, double time = 0.0, const std::string &name = "" );
+	//! Hands every read still in flight to \a recorder, oldest first.
+	void	flush( FrameRecorder &recorder );
+
+  private:
+	struct Read {
+		GLuint		mBuffer;
+		int			mWidth, mHeight;
+		double		mTime;
+		std::string	mName;
+		bool		mPending;
+	};
+
+	void	deliver( Read &read, FrameRecorder &recorder );
+
+	std::vector<Read>	mReads;
+	size_t				mNext;
+};
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ *  IKLineSystem.cpp
+ *
+ */
+
+#include "IKLineSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+IKLineSystem::IKLineSystem()
+	: _numLines( 0 ), _segmentNum( 0 ), _gravity( 0 )
+{
+}
+
+void IKLineSystem::reset( size_t numLines, int segmentNum, float segmentLength, float gravity, ci::Rand &rand )
+{
+	_numLines	= numLines;
+	_segmentNum	= std::max( segmentNum, 1 );
+	_gravity	= gravity;
+
+	_lineX.assign( _numLines, 0.0f );
+	_lineY.assign( _numLines, 0.0f );
+	_oldX.assign( _numLines, 0.0f );
+	_oldY.assign( _numLines, 0.0f );
+	_friction.assign( _numLines, 3.0f );
+
+	// as IKLine::init(): the first segment has no length
+	_length.resize( _segmentNum );
+	for( int s = 0; s < _segmentNum; s++ )
+		_length[s] = segmentLength * ( (float)s * 0.45f );
+
+	size_t count = _numLines * _segmentNum;
+	_x.resize( count );
+	_y.resize( count );
+	_vx.resize( count );
+	_vy.resize( count );
+	_prevX.resize( count );
+	_prevY.resize( count );
+	_dirX.assign( count, 1.0f );
+	_dirY.assign( count, 0.0f );
+
+	// same ranges as the Segment constructor
+	for( size_t i = 0; i < count; i++ ) {
+		_x[i]		= rand.nextFloat( 1.0f, 1.5f );
+		_y[i]		= rand.nextFloat( 1.0f, 1.5f );
+		_vx[i]		= rand.nextFloat( 0.0f, 1.0f );
+		_vy[i]		= rand.nextFloat( 0.0f, 1.0f );
+		_prevX[i]	= rand.nextFloat( 0.0f, 1.0f );
+		_prevY[i]	= rand.nextFloat( 0.0f, 1.0f );
+	}
+}
+
+void IKLineSystem::setLine( size_t line, float x, float y, float friction )
+{
+	_lineX[line]	= x;
+	_lineY[line]	= y;
+	_friction[line]	= friction;
+}
+
+ci::Vec2f IKLineSystem::getPin( size_t line, int segment ) const
+{
+	size_t i = segment * _numLines + line;
+	return ci::Vec2f( _x[i] + _dirX[i] * _length[segment], _y[i] + _dirY[i] * _length[segment] );
+}
+
+void IKLineSystem::nextFrame( const ci::Vec2f *targets, float damping, size_t numThreads )
+{
+	if( numThreads == 0 )
+		numThreads = std::max<size_t>( std::thread::hardware_concurrency(), 1 );
+	numThreads = std::max<size_t>( std::min( numThreads, _numLines / kMinLinesPerThread ), 1 );
+
+	if( numThreads == 1 ) {
+		advance( targets, damping, 0, _numLines );
+		return;
+	}
+
+	// the calling thread takes the last range
+	std::vector<std::thread> threads;
+	size_t linesPerThread = ( _numLines + numThreads - 1 ) / numThreads;
+	size_t first = 0;
+	for( ; first + linesPerThread < _numLines; first += linesPerThread )
+		threads.push_back( std::thread( &IKLineSystem::advance, this, targets, damping, first, first + linesPerThread ) );
+	advance( targets, damping, first, _numLines );
+	for( size_t t = 0; t < threads.size(); t++ )
+		threads[t].join();
+}
+
+void IKLineSystem::advance( const ci::Vec2f *targets, float damping, size_t firstLine, size_t lastLine )
+{
+	// the head of each line eases towards its target
+	for( size_t l = firstLine; l < lastLine; l++ ) {
+		_oldX[l] += ( targets[l].x - _oldX[l] ) * damping;
+		_oldY[l] += ( targets[l].y - _oldY[l] ) * damping;
+	}
+
+	const float velocityDamping = 0.981f;
+	for( int s = 0; s < _segmentNum; s++ ) {
+		// segment 0 is dragged to the eased head, every other one to its predecessor's new position
+		const float *toX = s == 0 ? &_oldX[0] : &_x[( s - 1 ) * _numLines];
+		const float *toY = s == 0 ? &_oldY[0] : &_y[( s - 1 ) * _numLines];
+		float length = _length[s];
+
+		float *x = &_x[s * _numLines], *y = &_y[s * _numLines];
+		float *vx = &_vx[s * _numLines], *vy = &_vy[s * _numLines];
+		float *prevX = &_prevX[s * _numLines], *prevY = &_prevY[s * _numLines];
+		float *dirX = &_dirX[s * _numLines], *dirY = &_dirY[s * _numLines];
+		const float *friction = &_friction[0];
+
+		for( size_t l = firstLine; l < lastLine; l++ ) {
+			// Segment::next()
+			float px = x[l] + vx[l];
+			float py = y[l] + vy[l];
+
+			// cos / sin of atan2( dy, dx ); atan2( 0, 0 ) is 0, so a zero offset points along +x
+			float dx = toX[l] - px;
+			float dy = toY[l] - py;
+			float lengthSq = dx * dx + dy * dy;
+			float invLength = lengthSq > 0.0f ? 1.0f / sqrtf( lengthSq ) : 0.0f;
+			float cx = lengthSq > 0.0f ? dx * invLength : 1.0f;
+			float cy = dy * invLength;
+			dirX[l] = cx;
+			dirY[l] = cy;
+
+			px = toX[l] - cx * length;
+			py = toY[l] - cy * length;
+
+			// Segment::setVector()
+			bool hasPrev = prevX[l] != 0.0f && prevY[l] != 0.0f;
+			float nvx = hasPrev ? vx[l] + ( ( px - prevX[l] ) - vx[l] ) * velocityDamping : vx[l];
+			float nvy = hasPrev ? vy[l] + ( ( py - prevY[l] ) - vy[l] ) * velocityDamping : vy[l];
+			prevX[l] = px;
+			prevY[l] = py;
+
+			x[l] = px;
+			y[l] = py;
+			vx[l] = nvx * friction[l];
+			vy[l] = nvy * friction[l] + _gravity;
+		}
+	}
+}
@@ -0,0 +1,60 @@
+/*
+ *  IKLineSystem.h
+ *
+ *  Every bristle's IK chain in contiguous arrays, advanced together across lines.
+ *
+ */
+
+#pragma once
+
+#include "cinder/Rand.h"
+#include "cinder/Vector.h"
+
+#include <vector>
+
+class IKLineSystem
+{
+public:
+	IKLineSystem();
+
+	//! Allocates \a numLines chains of \a segmentNum segments laid out like IKLine::init(),
+	//! drawing the starting state from \a rand so a brush can be rebuilt exactly.
+	void reset( size_t numLines, int segmentNum, float segmentLength, float gravity, ci::Rand &rand );
+	//! Position offset of a line within the brush and its canvas friction.
+	void setLine( size_t line, float x, float y, float friction );
+
+	//! Drags line i towards targets[i], as IKLine::nextFrame() does for each line.
+	//! \a numThreads 0 uses one thread per core once the brush is large enough to pay for it.
+	void nextFrame( const ci::Vec2f *targets, float damping, size_t numThreads = 1 );
+
+	size_t		getNumLines() const			{ return _numLines; }
+	int			getSegmentNum() const		{ return _segmentNum; }
+	ci::Vec2f	getLineOffset( size_t line ) const	{ return ci::Vec2f( _lineX[line], _lineY[line] ); }
+	ci::Vec2f	getSegmentPosition( size_t line, int segment ) const	{ size_t i = segment * _numLines + line; return ci::Vec2f( _x[i], _y[i] ); }
+	//! Same as Segment::getPin().
+	ci::Vec2f	getPin( size_t line, int segment ) const;
+
+	//! Below this many lines per thread nextFrame() stays on the calling thread.
+	static const size_t kMinLinesPerThread = 256;
+
+private:
+	void advance( const ci::Vec2f *targets, float damping, size_t firstLine, size_t lastLine );
+
+	size_t	_numLines;
+	int		_segmentNum;
+	float	_gravity;
+
+	// per line
+	std::vector<float>	_lineX, _lineY;
+	std::vector<float>	_oldX, _oldY;
+	std::vector<float>	_friction;
+
+	// per segment, shared by all lines
+	std::vector<float>	_length;
+
+	// per segment and line
+	std::vector<float>	_x, _y;
+	std::vector<float>	_vx, _vy;
+	std::vector<float>	_prevX, _prevY;
+	std::vector<float>	_dirX, _dirY;
+};
@@ -0,0 +1,154 @@
+/*
+ *  RibbonMesh.cpp
+ *
+ */
+
+#include "RibbonMesh.h"
+#include "cinder/gl/gl.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+void RibbonMesh::RecordingBackend::submit( const RibbonVertex *vertices, size_t count )
+{
+	this->vertices.assign( vertices, vertices + count );
+	numSubmissions++;
+}
+
+void RibbonMesh::GlBackend::submit( const RibbonVertex *vertices, size_t count )
+{
+	if( count == 0 )
+		return;
+
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glEnableClientState( GL_COLOR_ARRAY );
+	glVertexPointer( 2, GL_FLOAT, sizeof( RibbonVertex ), &vertices[0].position );
+	glColorPointer( 4, GL_FLOAT, sizeof( RibbonVertex ), &vertices[0].color );
+	glDrawArrays( GL_TRIANGLE_STRIP, 0, (GLsizei)count );
+	glDisableClientState( GL_COLOR_ARRAY );
+	glDisableClientState( GL_VERTEX_ARRAY );
+}
+
+RibbonMesh::RibbonMesh()
+	: _backend( 0 ), _bezierSegments( 10 ), _dropLastVertex( false ), _numVertices( 0 )
+{
+}
+
+void RibbonMesh::setShape( int bezierSegments, bool dropLastVertex )
+{
+	_bezierSegments	= std::max( bezierSegments, 0 );
+	_dropLastVertex	= dropLastVertex;
+}
+
+void RibbonMesh::setSegmentStyle( const std::vector<ci::ColorA> &colors, const std::vector<float> &widths )
+{
+	_colors = colors;
+	_widths = widths;
+}
+
+size_t RibbonMesh::getNumVerticesPerPiece() const
+{
+	// two per point along the curve, plus the repeated first and last vertex that join pieces
+	size_t numPoints = _bezierSegments > 0 ? _bezierSegments + ( _dropLastVertex ? 0 : 1 ) : 2;
+	return numPoints * 2 + 2;
+}
+
+void RibbonMesh::fill( const IKLineSystem &brush, size_t numThreads )
+{
+	size_t numPieces = (size_t)std::max( brush.getSegmentNum() - 2, 0 );
+	if( _colors.empty() || _widths.empty() )
+		numPieces = 0;
+
+	_numVertices = brush.getNumLines() * numPieces * getNumVerticesPerPiece();
+	if( _vertices.size() < _numVertices )
+		_vertices.resize( _numVertices );
+	if( _numVertices == 0 )
+		return;
+
+	size_t numLines = brush.getNumLines();
+	if( numThreads == 0 )
+		numThreads = std::max<size_t>( std::thread::hardware_concurrency(), 1 );
+	numThreads = std::max<size_t>( std::min( numThreads, numLines / kMinStrandsPerThread ), 1 );
+
+	// the calling thread takes the last range
+	std::vector<std::thread> threads;
+	size_t linesPerThread = ( numLines + numThreads - 1 ) / numThreads;
+	size_t first = 0;
+	for( ; first + linesPerThread < numLines; first += linesPerThread )
+		threads.push_back( std::thread( &RibbonMesh::fillStrands, this, &brush, first, first + linesPerThread ) );
+	fillStrands( &brush, first, numLines );
+	for( size_t t = 0; t < threads.size(); t++ )
+		threads[t].join();
+}
+
+void RibbonMesh::draw()
+{
+	if( _backend )
+		_backend->submit( getVertices(), _numVertices );
+}
+
+void RibbonMesh::fillStrands( const IKLineSystem *brush, size_t firstLine, size_t lastLine )
+{
+	int numPieces = brush->getSegmentNum() - 2;
+	size_t perPiece = getNumVerticesPerPiece();
+	int numSteps = _bezierSegments > 0 ? _bezierSegments : 1;
+	int numPoints = (int)( perPiece - 2 ) / 2;
+	float h = 1.0f / numSteps;
+
+	for( size_t line = firstLine; line < lastLine; line++ ) {
+		RibbonVertex *v = &_vertices[line * numPieces * perPiece];
+		ci::Vec2f offset = brush->getLineOffset( line );
+		ci::Vec2f start = offset + brush->getSegmentPosition( line, 0 );
+
+		for( int i = 0; i < numPieces; i++ ) {
+			ci::Vec2f control = offset + brush->getSegmentPosition( line, i );
+			ci::Vec2f end = ( control + offset + brush->getSegmentPosition( line, i + 1 ) ) * 0.5f;
+
+			const ci::ColorA &color = _colors[std::min<size_t>( i, _colors.size() - 1 )];
+			float width = _widths[std::min<size_t>( i, _widths.size() - 1 )];
+			float nextWidth = _widths[std::min<size_t>( i + 1, _widths.size() - 1 )];
+
+			// B( t ) = start + a t + b t^2, stepped by forward differences along with its tangent a + 2 b t
+			ci::Vec2f a, b;
+			if( _bezierSegments > 0 ) {
+				a = ( control - start ) * 2.0f;
+				b = start - control * 2.0f + end;
+			}
+			else {
+				a = end - start;
+				b = ci::Vec2f::zero();
+			}
+			ci::Vec2f p = start, dp = a * h + b * ( h * h ), ddp = b * ( 2.0f * h * h );
+			ci::Vec2f tangent = a, dTangent = b * ( 2.0f * h );
+			float halfWidth = width * 0.5f, dHalfWidth = ( nextWidth - width ) * 0.5f * h;
+
+			RibbonVertex *first = v++;
+			for( int k = 0; k < numPoints; k++ ) {
+				// land exactly on the end point, as drawBezier() does
+				ci::Vec2f point = k == numSteps ? end : p;
+
+				float lengthSq = tangent.lengthSquared();
+				float scale = lengthSq > 0.0f ? halfWidth / sqrtf( lengthSq ) : 0.0f;
+				ci::Vec2f side( -tangent.y * scale, tangent.x * scale );
+
+				v[0].position	= point + side;
+				v[0].color		= color;
+				v[1].position	= point - side;
+				v[1].color		= color;
+				v += 2;
+
+				p += dp;
+				dp += ddp;
+				tangent += dTangent;
+				halfWidth += dHalfWidth;
+			}
+			// degenerate joins to the previous and next piece
+			*first = first[1];
+			*v = v[-1];
+			v++;
+
+			start = end;
+		}
+	}
+}
@@ -0,0 +1,81 @@
+/*
+ *  RibbonMesh.h
+ *
+ *  Every strand of an IKLineSystem as ribbons in a single triangle strip.
+ *
+ */
+
+#pragma once
+
+#include "cinder/Color.h"
+#include "cinder/Vector.h"
+#include "IKLineSystem.h"
+
+#include <vector>
+
+struct RibbonVertex
+{
+	ci::Vec2f	position;
+	ci::ColorA	color;
+};
+
+class RibbonMesh
+{
+public:
+	class Backend
+	{
+	public:
+		virtual ~Backend() {}
+		virtual void submit( const RibbonVertex *vertices, size_t count ) = 0;
+	};
+
+	class RecordingBackend : public Backend
+	{
+	public:
+		void submit( const RibbonVertex *vertices, size_t count );
+
+		std::vector<RibbonVertex>	vertices;
+		int							numSubmissions;
+
+		RecordingBackend() : numSubmissions( 0 ) {}
+	};
+
+	class GlBackend : public Backend
+	{
+	public:
+		void submit( const RibbonVertex *vertices, size_t count );
+	};
+
+	RibbonMesh();
+
+	void	setBackend( Backend *backend )		{ _backend = backend; }
+	//! \a bezierSegments steps per piece; 0 draws straight pieces. \a dropLastVertex
+	//! leaves each Bezier one step short, like drawBezier() with _glitchSegment.
+	void	setShape( int bezierSegments, bool dropLastVertex );
+	//! Colour and width of piece i, for i < segmentNum - 2. Widths are in pixels and
+	//! are blended from piece i to piece i + 1 along the curve.
+	void	setSegmentStyle( const std::vector<ci::ColorA> &colors, const std::vector<float> &widths );
+
+	//! Tessellates every strand of \a brush; 0 threads means one per core.
+	void	fill( const IKLineSystem &brush, size_t numThreads = 0 );
+	void	draw();
+
+	const RibbonVertex*	getVertices() const		{ return _numVertices ? &_vertices[0] : 0; }
+	size_t				getNumVertices() const	{ return _numVertices; }
+	size_t				getNumVerticesPerPiece() const;
+
+	//! Below this many strands per thread fill() stays on the calling thread.
+	static const size_t kMinStrandsPerThread = 128;
+
+private:
+	void	fillStrands( const IKLineSystem *brush, size_t firstLine, size_t lastLine );
+
+	Backend						*_backend;
+	int							_bezierSegments;
+	bool						_dropLastVertex;
+	std::vector<ci::ColorA>		_colors;
+	std::vector<float>			_widths;
+
+	std::vector<RibbonVertex>	_vertices;		// grows only
+	size_t						_numVertices;
+};
@@ -0,0 +1,316 @@
+/*
+ *  RibbonRasterizer.cpp
+ *
+ */
+
+#include "RibbonRasterizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+namespace {
+
+const int kSamples = 4;		// per side, on pixels an edge crosses
+
+inline float saturate( float v )
+{
+	return std::min( std::max( v, 0.0f ), 1.0f );
+}
+
+// edge a -> b as e( x, y ) = A * ( x - a.x ) + B * ( y - a.y ), positive inside a counter-clockwise triangle
+struct Edge
+{
+	float	A, B, C;
+	bool	owns;			// whether points exactly on the edge count, so a shared edge is counted once
+	float	minCorner;		// the function is linear, so its extremes over a pixel are at two of its corners
+	float	maxCorner;
+	float	sample[kSamples * kSamples];	// offsets of the coverage samples from the pixel origin
+
+	Edge() : A( 0 ), B( 0 ), C( -1 ), owns( false ), minCorner( 0 ), maxCorner( 0 ) {}
+	Edge( const ci::Vec2f &a, const ci::Vec2f &b )
+		: A( a.y - b.y ), B( b.x - a.x ), C( -( a.y - b.y ) * a.x - ( b.x - a.x ) * a.y ), owns( A > 0.0f || ( A == 0.0f && B > 0.0f ) )
+	{
+		minCorner = std::min( A, 0.0f ) + std::min( B, 0.0f );
+		maxCorner = std::max( A, 0.0f ) + std::max( B, 0.0f );
+		for( int sy = 0; sy < kSamples; sy++ )
+			for( int sx = 0; sx < kSamples; sx++ )
+				sample[sy * kSamples + sx] = A * ( sx + 0.5f ) / kSamples + B * ( sy + 0.5f ) / kSamples;
+	}
+
+	float	at( float x, float y ) const	{ return A * x + B * y + C; }
+	bool	inside( float e ) const			{ return ( e > 0.0f ) | ( ( e == 0.0f ) & owns ); }
+
+	// narrows [lo, hi] to the pixels of row y that have a corner on the inner side
+	void	clipRow( float y, float &lo, float &hi ) const
+	{
+		float k = B * y + C + maxCorner;
+		if( A > 0.0f )
+			lo = std::max( lo, std::floor( -k / A ) );
+		else if( A < 0.0f )
+			hi = std::min( hi, std::ceil( -k / A ) );
+		else if( k < 0.0f )
+			hi = lo - 1.0f;
+	}
+};
+
+// one triangle of a strip, turned counter-clockwise; e[k] is the edge opposite corner k
+struct Triangle
+{
+	Edge				e[3];
+	const ci::ColorA	*c[3];
+	bool				valid;
+
+	Triangle() : valid( false ) {}
+
+	void set( ci::Vec2f p0, ci::Vec2f p1, ci::Vec2f p2, const ci::ColorA *c0, const ci::ColorA *c1, const ci::ColorA *c2 )
+	{
+		float area = ( p1.x - p0.x ) * ( p2.y - p0.y ) - ( p1.y - p0.y ) * ( p2.x - p0.x );
+		valid = std::fabs( area ) >= 1e-8f;
+		// the strip alternates winding
+		if( area < 0.0f ) {
+			std::swap( p1, p2 );
+			std::swap( c1, c2 );
+		}
+		e[0] = Edge( p1, p2 );
+		e[1] = Edge( p2, p0 );
+		e[2] = Edge( p0, p1 );
+		c[0] = c0;
+		c[1] = c1;
+		c[2] = c2;
+	}
+};
+
+} // anonymous namespace
+
+RibbonRasterizer::RibbonRasterizer()
+	: _width( 0 ), _firstRow( 0 ), _numRows( 0 ), _numTilesX( 0 ), _numTilesY( 0 ), _numThreads( 0 )
+{
+}
+
+void RibbonRasterizer::setRegion( int width, int firstRow, int numRows )
+{
+	_width		= std::max( width, 0 );
+	_firstRow	= firstRow;
+	_numRows	= std::max( numRows, 0 );
+	_numTilesX	= ( _width + kTileSize - 1 ) / kTileSize;
+	_numTilesY	= ( _numRows + kTileSize - 1 ) / kTileSize;
+
+	_pixels.assign( (size_t)_width * _numRows * 3, 0.0f );
+	_bins.clear();
+	_bins.resize( _numTilesX * _numTilesY );
+}
+
+void RibbonRasterizer::clear( const ci::Color &color )
+{
+	for( size_t i = 0; i < _pixels.size(); i += 3 ) {
+		_pixels[i]		= color.r;
+		_pixels[i + 1]	= color.g;
+		_pixels[i + 2]	= color.b;
+	}
+}
+
+void RibbonRasterizer::drawStrip( const RibbonVertex *vertices, size_t count, float scale, Blend blend )
+{
+	if( count < 3 || _bins.empty() )
+		return;
+
+	_scale = scale;
+	_quads.clear();
+	for( size_t b = 0; b < _bins.size(); b++ )
+		_bins[b].clear();
+
+	int lastRow = _firstRow + _numRows - 1;
+	for( size_t i = 0; i + 2 < count; i += 2 ) {
+		Quad quad;
+		quad.v				= vertices + i;
+		quad.numVertices	= (int)std::min<size_t>( count - i, 4 );
+
+		float minX = quad.v[0].position.x, maxX = minX;
+		float minY = quad.v[0].position.y, maxY = minY;
+		for( int k = 1; k < quad.numVertices; k++ ) {
+			minX = std::min( minX, quad.v[k].position.x );
+			maxX = std::max( maxX, quad.v[k].position.x );
+			minY = std::min( minY, quad.v[k].position.y );
+			maxY = std::max( maxY, quad.v[k].position.y );
+		}
+		// the joins between pieces collapse to nothing
+		if( maxX - minX <= 0.0f || maxY - minY <= 0.0f )
+			continue;
+
+		quad.x0 = std::max( (int)std::floor( minX * scale ), 0 );
+		quad.x1 = std::min( (int)std::ceil( maxX * scale ) - 1, _width - 1 );
+		quad.y0 = std::max( (int)std::floor( minY * scale ), _firstRow );
+		quad.y1 = std::min( (int)std::ceil( maxY * scale ) - 1, lastRow );
+		if( quad.x0 > quad.x1 || quad.y0 > quad.y1 )
+			continue;
+
+		uint32_t index = (uint32_t)_quads.size();
+		_quads.push_back( quad );
+
+		int tileX1 = quad.x1 / kTileSize;
+		int tileY1 = ( quad.y1 - _firstRow ) / kTileSize;
+		for( int ty = ( quad.y0 - _firstRow ) / kTileSize; ty <= tileY1; ty++ )
+			for( int tx = quad.x0 / kTileSize; tx <= tileX1; tx++ )
+				_bins[ty * _numTilesX + tx].push_back( index );
+	}
+
+	if( ! _quads.empty() )
+		rasterizeTiles( blend );
+}
+
+void RibbonRasterizer::rasterizeTiles( Blend blend )
+{
+	size_t numThreads = _numThreads;
+	if( numThreads == 0 )
+		numThreads = std::max<size_t>( std::thread::hardware_concurrency(), 1 );
+	numThreads = std::max<size_t>( std::min( numThreads, _bins.size() ), 1 );
+
+	if( numThreads == 1 ) {
+		for( size_t tile = 0; tile < _bins.size(); tile++ )
+			rasterizeTile( tile, blend );
+		return;
+	}
+
+	// tiles are uneven, so threads pull the next one as they finish
+	std::atomic<size_t> nextTile( 0 );
+	auto work = [&]() {
+		for( size_t tile = nextTile++; tile < _bins.size(); tile = nextTile++ )
+			rasterizeTile( tile, blend );
+	};
+
+	std::vector<std::thread> threads;
+	for( size_t t = 1; t < numThreads; t++ )
+		threads.push_back( std::thread( work ) );
+	work();
+	for( size_t t = 0; t < threads.size(); t++ )
+		threads[t].join();
+}
+
+void RibbonRasterizer::rasterizeTile( size_t tile, Blend blend )
+{
+	const std::vector<uint32_t> &bin = _bins[tile];
+	if( bin.empty() )
+		return;
+
+	int tileX0 = (int)( tile % _numTilesX ) * kTileSize;
+	int tileY0 = (int)( tile / _numTilesX ) * kTileSize + _firstRow;
+	int tileX1 = std::min( tileX0 + kTileSize, _width ) - 1;
+	int tileY1 = std::min( tileY0 + kTileSize, _firstRow + _numRows ) - 1;
+
+	for( size_t i = 0; i < bin.size(); i++ )
+		rasterize( _quads[bin[i]], tileX0, tileY0, tileX1, tileY1, blend );
+}
+
+void RibbonRasterizer::rasterize( const Quad &quad, int tileX0, int tileY0, int tileX1, int tileY1, Blend blend )
+{
+	const float kSampleWeight = 1.0f / ( kSamples * kSamples );
+	// an edge that misses the pixel is moved well inside so its sample tests always pass
+	const float kInside = 1e30f;
+
+	ci::Vec2f p[4];
+	for( int k = 0; k < quad.numVertices; k++ )
+		p[k] = quad.v[k].position * _scale;
+
+	// the two triangles share the diagonal p1 - p2 with opposite directions, so only one of them owns it
+	Triangle tris[2];
+	tris[0].set( p[0], p[1], p[2], &quad.v[0].color, &quad.v[1].color, &quad.v[2].color );
+	if( quad.numVertices == 4 )
+		tris[1].set( p[2], p[1], p[3], &quad.v[2].color, &quad.v[1].color, &quad.v[3].color );
+
+	int x0 = std::max( quad.x0, tileX0 ), x1 = std::min( quad.x1, tileX1 );
+	int y0 = std::max( quad.y0, tileY0 ), y1 = std::min( quad.y1, tileY1 );
+
+	for( int y = y0; y <= y1; y++ ) {
+		float *row = &_pixels[(size_t)( y - _firstRow ) * _width * 3];
+		float fy = (float)y;
+
+		// thin ribbons cover little of their bounds, so only walk the span each row touches
+		float lo = (float)x1 + 1.0f, hi = (float)x0 - 1.0f;
+		for( int t = 0; t < 2; t++ ) {
+			if( ! tris[t].valid )
+				continue;
+			float tLo = (float)x0, tHi = (float)x1;
+			for( int k = 0; k < 3; k++ )
+				tris[t].e[k].clipRow( fy, tLo, tHi );
+			if( tLo <= tHi ) {
+				lo = std::min( lo, tLo );
+				hi = std::max( hi, tHi );
+			}
+		}
+
+		for( int x = (int)lo, last = (int)hi; x <= last; x++ ) {
+			float fx = (float)x;
+
+			float e[2][3];
+			bool touches[2], covers[2];
+			for( int t = 0; t < 2; t++ ) {
+				touches[t] = covers[t] = tris[t].valid;
+				for( int k = 0; k < 3; k++ ) {
+					const Edge &edge = tris[t].e[k];
+					e[t][k] = edge.at( fx, fy );
+					touches[t] = touches[t] && e[t][k] + edge.maxCorner >= 0.0f;
+					covers[t] = covers[t] && e[t][k] + edge.minCorner >= 0.0f;
+				}
+			}
+			if( ! touches[0] && ! touches[1] )
+				continue;
+
+			float coverage = 1.0f;
+			if( ! covers[0] && ! covers[1] ) {
+				// a sample counts once even when it lies in both triangles
+				int inside[kSamples * kSamples] = { 0 };
+				for( int t = 0; t < 2; t++ ) {
+					if( ! touches[t] )
+						continue;
+					const Edge *edges = tris[t].e;
+					float s[3];
+					for( int k = 0; k < 3; k++ )
+						s[k] = e[t][k] + edges[k].minCorner < 0.0f ? e[t][k] : kInside;
+					for( int k = 0; k < kSamples * kSamples; k++ )
+						inside[k] |= edges[0].inside( s[0] + edges[0].sample[k] ) & edges[1].inside( s[1] + edges[1].sample[k] ) & edges[2].inside( s[2] + edges[2].sample[k] );
+				}
+				int hits = 0;
+				for( int k = 0; k < kSamples * kSamples; k++ )
+					hits += inside[k];
+				if( hits == 0 )
+					continue;
+				coverage = hits * kSampleWeight;
+			}
+
+			// colour at the pixel centre from the triangle it falls in, clamped to it on edge pixels
+			float cx = fx + 0.5f, cy = fy + 0.5f;
+			bool inFirst = tris[0].valid && tris[0].e[0].at( cx, cy ) >= 0.0f && tris[0].e[1].at( cx, cy ) >= 0.0f && tris[0].e[2].at( cx, cy ) >= 0.0f;
+			const Triangle &tri = ( inFirst || ! touches[1] ) ? tris[0] : tris[1];
+			float w0 = std::max( tri.e[0].at( cx, cy ), 0.0f );
+			float w1 = std::max( tri.e[1].at( cx, cy ), 0.0f );
+			float w2 = std::max( tri.e[2].at( cx, cy ), 0.0f );
+			float sum = w0 + w1 + w2;
+			if( sum > 0.0f ) {
+				w0 /= sum; w1 /= sum; w2 /= sum;
+			}
+			else {
+				w0 = w1 = w2 = 1.0f / 3.0f;
+			}
+
+			const ci::ColorA &c0 = *tri.c[0], &c1 = *tri.c[1], &c2 = *tri.c[2];
+			float r		= saturate( c0.r * w0 + c1.r * w1 + c2.r * w2 );
+			float g		= saturate( c0.g * w0 + c1.g * w1 + c2.g * w2 );
+			float bl	= saturate( c0.b * w0 + c1.b * w1 + c2.b * w2 );
+			float alpha	= saturate( c0.a * w0 + c1.a * w1 + c2.a * w2 ) * coverage;
+
+			float *dst = row + x * 3;
+			if( blend == BLEND_ADDITIVE ) {
+				dst[0] = std::min( dst[0] + r * alpha, 1.0f );
+				dst[1] = std::min( dst[1] + g * alpha, 1.0f );
+				dst[2] = std::min( dst[2] + bl * alpha, 1.0f );
+			}
+			else {
+				dst[0] = r * alpha + dst[0] * ( 1.0f - alpha );
+				dst[1] = g * alpha + dst[1] * ( 1.0f - alpha );
+				dst[2] = bl * alpha + dst[2] * ( 1.0f - alpha );
+			}
+		}
+	}
+}
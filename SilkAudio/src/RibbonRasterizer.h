@@ -0,0 +1,61 @@
+/*
+ *  RibbonRasterizer.h
+ *
+ *  CPU rasterizer for RibbonMesh strips, one horizontal band of a large image at a time.
+ *
+ */
+
+#pragma once
+
+#include "cinder/Color.h"
+#include "cinder/Vector.h"
+#include "RibbonMesh.h"
+
+#include <cstdint>
+#include <vector>
+
+class RibbonRasterizer
+{
+public:
+	enum Blend { BLEND_ADDITIVE, BLEND_ALPHA };
+
+	RibbonRasterizer();
+
+	//! Covers rows [firstRow, firstRow + numRows) of an image \a width pixels wide.
+	void	setRegion( int width, int firstRow, int numRows );
+	//! 0 uses one thread per core.
+	void	setNumThreads( size_t numThreads )	{ _numThreads = numThreads; }
+
+	void	clear( const ci::Color &color );
+	//! Draws a triangle strip given in window coordinates, multiplied by \a scale.
+	void	drawStrip( const RibbonVertex *vertices, size_t count, float scale, Blend blend );
+
+	int				getWidth() const		{ return _width; }
+	int				getFirstRow() const		{ return _firstRow; }
+	int				getNumRows() const		{ return _numRows; }
+	//! RGB floats of image row \a row, which must lie in the region.
+	const float*	getRow( int row ) const	{ return &_pixels[(size_t)( row - _firstRow ) * _width * 3]; }
+
+	static const int kTileSize = 64;
+
+private:
+	//! Strip vertices i to i + 3; the second triangle is missing at the end of an odd strip.
+	struct Quad
+	{
+		const RibbonVertex	*v;
+		int					numVertices;
+		int					x0, y0, x1, y1;		// pixel bounds, inclusive
+	};
+
+	void	rasterizeTiles( Blend blend );
+	void	rasterizeTile( size_t tile, Blend blend );
+	void	rasterize( const Quad &quad, int tileX0, int tileY0, int tileX1, int tileY1, Blend blend );
+
+	int							_width, _firstRow, _numRows;
+	int							_numTilesX, _numTilesY;
+	size_t						_numThreads;
+	std::vector<float>			_pixels;
+	float						_scale;
+	std::vector<Quad>			_quads;
+	std::vector<std::vector<uint32_t> >	_bins;		// quad indices per tile, in submission order
+};
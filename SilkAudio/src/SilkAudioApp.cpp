@@ -8,8 +8,7 @@
  */
 
 #import "SilkAudioApp.h"
-#import "IKLine.h"
-#import "Segment.h"
+#import "SilkBrush.h"
 #import "Cinder/gl/gl.h"
 
 using namespace ci;
@@ -30,14 +29,23 @@ void SilkAudioApp::setup()
 
 	srandom( time(NULL) );
 	ci::Rand::randSeed( random() );
-	_perlinNoise.setSeed( sin( time( NULL ) ) * 10);
+	int32_t noiseSeed = sin( time( NULL ) ) * 10;
+	_perlinNoise.setSeed( noiseSeed );
 	_perlinNoise.setOctaves( 4 );
+	_brush.setNoiseSeed( noiseSeed );
+	_session.begin( noiseSeed, getWindowWidth(), getWindowHeight() );
+	_exportScale = 4.0f;
+	_exportDone = true;
 
 	_mousePosition = getWindowCenter();
 
 	_gravity = 0.0;
 	_glitchSegment = false;
 	_drawPins = false;
+	_bristleWidth = 1.0f;
+	_ribbons.setBackend( &_ribbonBackend );
+	_snapshots = std::shared_ptr<FrameRecorder>( new FrameRecorder( std::shared_ptr<FrameSink>( new ImageSequenceSink( ci::getHomeDirectory() / "SilkAudioApp" ) ), 2, FrameRecorder::BLOCK, 1 ) );
+	_snapshotReader = std::shared_ptr<WindowReader>( new WindowReader( 1 ) );
 	
 	// Behavior modification
 	_alphaWhenDrawing = 0.11;
@@ -53,8 +61,9 @@ void SilkAudioApp::setup()
 	// PARAMS
 	_drawParams = false;
 	_params = ci::params::InterfaceGl( "Settings", ci::Vec2i( 200, 250 ) );
-	_params.addParam("BristleCount", &_bristleCount, "min=1 max=100.0 step=1");
+	_params.addParam("BristleCount", &_bristleCount, "min=1 max=4000.0 step=1");
 	_params.addParam("BrushRadius", &_brushRadius, "min=0 max=25.0 step=0.5");
+	_params.addParam("BristleWidth", &_bristleWidth, "min=1.0 max=6.0 step=0.5");
 	_params.addSeparator();
 	_params.addParam("FilamentSpacing", &_filamentSpacing, "min=1.0 max=20.0 step=0.5");
 	_params.addParam("FilamentCount", &_filamentCount, "min=5.0 max=100 step=5.0");
@@ -66,6 +75,8 @@ void SilkAudioApp::setup()
 	_params.addSeparator();
 	_params.addParam("ChaseSpeed", &_mouseChaseDamping, "", true);
 	_params.addParam("Alpha", &_alphaWhenDrawingFloat, "", true);
+	_params.addSeparator();
+	_params.addParam("ExportScale", &_exportScale, "min=1.0 max=16.0 step=1.0");
 	
 #ifdef __COLORMODE__TEST
 	_params.addSeparator();
@@ -107,12 +118,14 @@ void SilkAudioApp::toggleAdditiveBlending( bool enableAdditiveBlending )
 		_clearColor = ci::Colorf(0, 0, 0);
 		ci::gl::enableAdditiveBlending();
 		ci::gl::clear( _clearColor );
+		_session.recordClear();
 		
 	} else {
 		// alpha blending
 		_clearColor = ci::Colorf(1, 1, 1);
 		ci::gl::enableAlphaBlending();
 		ci::gl::clear( _clearColor );
+		_session.recordClear();
 	}
 	
 	_additiveBlending = enableAdditiveBlending;
@@ -132,8 +145,10 @@ void SilkAudioApp::mouseDrag( ci::app::MouseEvent event )
 	if(_state != kStateNormal) return;
 	
 	// Not drawing lines, clear the frame
-	if(drawLines == false)
+	if(drawLines == false) {
 		ci::gl::clear( _clearColor );
+		_session.recordClear();
+	}
 	
 	_alphaWhenDrawing = _oldAlphaWhenDrawing;
 		
@@ -174,6 +189,9 @@ void SilkAudioApp::keyDown( ci::app::KeyEvent event )
 		case 's':
 			saveOutBrushImageAndParameters();
 			break;
+		case 'e':
+			exportSession();
+			break;
 		case 'o':
 			_drawParams = !_drawParams;
 			_params.show( !_params.isVisible() );
@@ -231,6 +249,7 @@ void SilkAudioApp::keyDown( ci::app::KeyEvent event )
 	if ( event.getChar() == 'f' || (isFullScreen() && event.getCode() == ci::app::KeyEvent::KEY_ESCAPE) )
 	{
 		ci::gl::clear(_clearColor);
+		_session.recordClear();
 		setFullScreen( !isFullScreen() );
 	}
 }
@@ -290,8 +309,52 @@ void SilkAudioApp::saveOutBrushImageAndParameters()
 	oStream->writeData( myString.data(), myString.length() );
 	
 
-	// Write the image now that the directory exist
-	writeImage( fileName + ".png", copyWindowSurface() );
+	// Write the image now that the directory exist; the read back waits for the GPU, the PNG goes to a worker
+	_snapshotReader->read( *_snapshots, getWindowWidth(), getWindowHeight(), getElapsedSeconds(), "Brush_" + timeStamp + ".png" );
+	_snapshotReader->flush( *_snapshots );
+	
+	// and everything needed to render it again at any size
+	_session.setCanvasSize( getWindowWidth(), getWindowHeight() );
+	_session.write( fileName + ".silk" );
+}
+
+void SilkAudioApp::exportSession()
+{
+	using namespace boost::posix_time;
+	
+	// one export at a time; a running one is only waited for in shutdown()
+	if( ! _exportDone ) {
+		trace( "Still exporting, try again when it is done" );
+		return;
+	}
+	if( _exportThread.joinable() )
+		_exportThread.join();
+	
+	ptime now = second_clock::local_time();
+	std::stringstream ss;
+	ss << now.date().month() <<  now.date().day() << "_" << now.time_of_day().hours() << now.time_of_day().minutes() << now.time_of_day().seconds();
+	std::string fileName = ci::getHomeDirectory().string() + "SilkAudioApp/Brush_" + ss.str() + ".ppm";
+	
+	// saving makes the directory too, but an export can come first; render() reports a failure
+	try {
+		ci::fs::create_directories( ci::fs::path( fileName ).parent_path() );
+	}
+	catch( ... ) {
+	}
+	
+	// the replay runs on a copy, so painting carries on while it renders
+	_session.setCanvasSize( getWindowWidth(), getWindowHeight() );
+	BrushSession session = _session;
+	BrushSession::RenderFormat format;
+	format.scale = _exportScale;
+	
+	trace( "Exporting " << session.getNumFrames() << " frames at " << _exportScale << "x to " << fileName );
+	_exportDone = false;
+	std::atomic<bool> *done = &_exportDone;
+	_exportThread = std::thread( [session, format, fileName, done]() {
+		ci::app::console() << ( session.render( fileName, format ) ? "Exported " : "Export failed: " ) << fileName << std::endl;
+		*done = true;
+	} );
 }
 
 
@@ -411,31 +474,22 @@ void SilkAudioApp::setBrushSettingsFromStringParameters( std::string currentLine
 
 void SilkAudioApp::createBrush()
 {	
-	if(_lines.size() != 0)
-		_lines.clear();
-	
 	if(_canvasFrictionMin >= _canvasFrictionMax)
 		_canvasFrictionMin = _canvasFrictionMax;
 	
-	for (int i = 0; i < _bristleCount; i++)
-	{
-		float radius = ci::Rand::randFloat() * _brushRadius;
-		float radian = ci::Rand::randFloat() * M_PI * 2;
-		
-		//linePointer
-		linePointer line = linePointer(new IKLine());
-		
-		line->x = cosf(radian) * radius;
-		line->y = sinf(radian) * radius;
-		
-		line->segmentLength = _filamentSpacing;
-		line->segmentNum = _filamentCount;
-		line->gravity = _gravity;
-		line->friction = ci::Rand::randFloat(_canvasFrictionMin, _canvasFrictionMax);
-		line->init();
-		
-		_lines.push_back(line);
-	}
+	SilkBrush::Settings settings;
+	settings.bristleCount		= _bristleCount;
+	settings.brushRadius		= _brushRadius;
+	settings.filamentSpacing	= _filamentSpacing;
+	settings.filamentCount		= _filamentCount;
+	settings.frictionMin		= _canvasFrictionMin;
+	settings.frictionMax		= _canvasFrictionMax;
+	settings.gravity			= _gravity;
+	
+	// the seed is all a replay needs to rebuild the same brush
+	uint32_t seed = ci::Rand::randInt();
+	_brush.create( settings, seed );
+	_session.recordCreate( settings, seed, _brush.getNoiseOffset() );
 }
 
 #pragma mark Update / Draw 
@@ -462,26 +516,8 @@ void SilkAudioApp::update()
 		mousePosition = _mousePosition;
 	}
 
-	static float i;
-	for( std::vector<linePointer>::iterator p = _lines.begin(); p != _lines.end(); ++p) {
-		
-		if(doNoise)
-		{
-			float localNoise = _perlinNoise.fBm( i*0.01f );
-			localNoise*=5;
-			
-			ci::Vec2f localPos = mousePosition;
-			localPos.x += cosf(localNoise) * 5;
-			localPos.y += sinf(localNoise) * 5;
-			(*p)->nextFrame(localPos, _mouseChaseDamping);
-			
-			i++;
-		}
-		else
-		{
-			(*p)->nextFrame(mousePosition, _mouseChaseDamping);
-		}
-	}
+	_brush.update( mousePosition, _mouseChaseDamping );
+	_session.recordStep( mousePosition, _mouseChaseDamping );
 
     xshift = getElapsedFrames() % getWindowWidth();
     if (xshift == 0.0f){
@@ -497,17 +533,24 @@ void SilkAudioApp::draw()
 	// Not drawing, clear screen
 	if( drawLines == false ) {
 		ci::gl::clear( _clearColor );
+		_session.recordClear();
 	} else { // overdraw to clear a little
 //		ColorA stringColor = (_colorMode > COLORMODE_GRAYSCALE) ? ColorA(1.0, 1.0, 1.0, 1.0) : ColorA(0.0, 0.0, 0.0, 1.0);
 //		glColor4f( stringColor.r, stringColor.g, stringColor.b, 0.01 );
 //		gl::drawSolidRect(Rectf(0, 0, getWindowWidth(), getWindowHeight() ) );
 	}
 	
-	glEnableClientState(GL_VERTEX_ARRAY);
-	for( std::vector<linePointer>::iterator p = _lines.begin(); p != _lines.end(); ++p) {
-		drawIKLine( *p );
-	}
-	glDisableClientState(GL_VERTEX_ARRAY);
+	// the whole brush as one triangle strip
+	updateRibbonStyle();
+	_ribbons.fill( _brush.getLines() );
+	_ribbons.draw();
+	bool sessionWasFull = _session.isFull();
+	_session.recordDraw( _additiveBlending, _useBezier ? ( _drawPins ? 5 : 10 ) : 0, _glitchSegment, _ribbonColors, _ribbonWidths );
+	if( ! sessionWasFull && _session.isFull() )
+		trace( "Session full; exports stop here until the brush is rebuilt" );
+	
+	if(_drawPins)
+		drawPins();
 	
 	if(_drawParams) {
 		ci::params::InterfaceGl::draw();
@@ -528,13 +571,16 @@ void SilkAudioApp::draw()
 	}
 }
 
+void SilkAudioApp::shutdown()
+{
+	// let a running export finish its file, and the last snapshot
+	if( _exportThread.joinable() )
+		_exportThread.join();
+	_snapshots->finish();
+}
 
-void SilkAudioApp::drawIKLine( linePointer& lineToDraw )
-{		
-	ci::Vec2f start = ci::Vec2f::zero();
-	start.x = lineToDraw->x + lineToDraw->_segments[0]->x;
-	start.y = lineToDraw->y + lineToDraw->_segments[0]->y;
-	
+void SilkAudioApp::updateRibbonStyle()
+{
 	double alpha;
 	
 	// If drawing lines, h
@@ -547,74 +593,47 @@ void SilkAudioApp::drawIKLine( linePointer& lineToDraw )
 		alpha = 1.0;
 	}
 	
-	for (int i = 0; i < lineToDraw->segmentNum - 2; i++)
+	// one entry per piece, shared by every strand
+	int numPieces = ci::math<int>::max( _brush.getLines().getSegmentNum() - 2, 0 );
+	_ribbonColors.resize( numPieces );
+	_ribbonWidths.resize( numPieces );
+	for (int i = 0; i < numPieces; i++)
 	{
-		ci::Vec2f end = ci::Vec2f::zero();
-		end.x = (lineToDraw->x + lineToDraw->_segments[i]->x + lineToDraw->x + lineToDraw->_segments[i+1]->x ) * 0.5;
-		end.y = (lineToDraw->y + lineToDraw->_segments[i]->y + lineToDraw->y + lineToDraw->_segments[i+1]->y ) * 0.5;
-		
-		ci::Vec2f control = ci::Vec2f::zero();
-		control.x = lineToDraw->x + lineToDraw->_segments[i]->x;
-		control.y = lineToDraw->y + lineToDraw->_segments[i]->y;
-		
-		
 		// Get the color based on distance in array from line
-		double nonInverseI = ( (double)i / (double)(lineToDraw->segmentNum-2) );
+		double nonInverseI = ( (double)i / (double)numPieces );
 		double inverseI = 1.0f - nonInverseI;
 		
-		getColorMode( inverseI, alpha);
-		glLineWidth(inverseI);
-		
-		Segment segment = *(lineToDraw->_segments[i]);
-		if(_useBezier)
-		{
-			if(_drawPins)
-			{
-				ci::Vec2f pin = segment.getPin();
-				ci::gl::drawSolidCircle(ci::Vec2f(lineToDraw->x, lineToDraw->y) + pin, 2, 6);
-				
-				glEnableClientState(GL_VERTEX_ARRAY);
-				drawBezier(start, control, end, 5);	
-				glDisableClientState(GL_VERTEX_ARRAY);
-			} else {
-				drawBezier(start, control, end, 10);
-			}
-		}
-		else  // draw straight lines
-		{
-			if(_drawPins) 
-			{
-				ci::Vec2f pin = segment.getPin();
-				ci::gl::drawSolidCircle(ci::Vec2f(lineToDraw->x, lineToDraw->y) + pin, 2, 6);
-			}
-			
-			glEnableClientState(GL_VERTEX_ARRAY);
-			ci::Vec2f vertices[2];
-			vertices[0] = start;
-			vertices[1] = end;
-			
-			//glVertexPointer(2, GL_FLOAT, 0, vertices);
-			//glDrawArrays(GL_LINES, 0, 2);
-			glVertexPointer(2, GL_FLOAT, 0, vertices);
-			glDrawArrays(GL_LINE_STRIP, 0, 2);
-			glDisableClientState(GL_VERTEX_ARRAY);
+		_ribbonColors[i] = getColorMode( inverseI, alpha );
+		// glLineWidth() rounded the old inverseI widths up to one pixel
+		_ribbonWidths[i] = ci::math<float>::max( inverseI * _bristleWidth, 1.0f );
+	}
+	
+	_ribbons.setSegmentStyle( _ribbonColors, _ribbonWidths );
+	_ribbons.setShape( _useBezier ? ( _drawPins ? 5 : 10 ) : 0, _glitchSegment );
+}
 
+void SilkAudioApp::drawPins()
+{
+	const IKLineSystem &lines = _brush.getLines();
+	for( size_t n = 0; n < lines.getNumLines(); ++n ) {
+		ci::Vec2f offset = lines.getLineOffset( n );
+		for (int i = 0; i < (int)_ribbonColors.size(); i++)
+		{
+			ci::gl::color( _ribbonColors[i] );
+			ci::gl::drawSolidCircle(offset + lines.getPin( n, i ), 2, 6);
 		}
-		
-		start = end;
 	}
 }
 
-inline void SilkAudioApp::getColorMode(double inverseI, double alpha)
+ci::ColorA SilkAudioApp::getColorMode(double inverseI, double alpha)
 {
 // Use when creating new color modes with ParamsGui
 #ifdef __COLORMODE__TEST	
 	double defaultAlpha = 0.8;
-	glColor4d((__R_LEFT + (inverseI * __R_RIGHT)),
+	return ci::ColorA((__R_LEFT + (inverseI * __R_RIGHT)),
 			  (__G_LEFT + (cos(inverseI * M_PI * 2) * __G_RIGHT)),
 			  (__B_LEFT + (sin(inverseI * M_PI * 2) * __B_RIGHT)), 
 			  inverseI * alpha);
-	return;
 #endif
 	
 	// color mode inverse
@@ -625,87 +644,59 @@ inline void SilkAudioApp::getColorMode(double inverseI, double alpha)
 	{
 		case COLORMODE_HSV: // 1
 			HSVtoRGB( &r, &g, &b, 101.0 + cos(inverseI * M_PI * 2) * 300.0, ci::math<float>::max(0.89 + sin(inverseI * M_PI * 2) * 0.51, 1.0), 0.05 );
-			glColor4d(r,g,b, inverseI * alpha * 1.5);
-			break;
+			return ci::ColorA(r,g,b, inverseI * alpha * 1.5);
 		case COLORMODE_RGB: // 2
-			glColor4d((0.3 + (inverseI * 0.25)),
+			return ci::ColorA((0.3 + (inverseI * 0.25)),
 					  (0.3 + (cos(inverseI * M_PI * 2) * 0.25)),
 					  (0.3 + (sin(inverseI * M_PI * 2) * 0.25)), 
 					  inverseI * alpha);
-			break;
 		case COLORMODE_RGBINVERSE: // 3 
 			left = 0.35;
 			right = 0.45;
-			glColor4d(0.9 - (left + (inverseI * right)),
+			return ci::ColorA(0.9 - (left + (inverseI * right)),
 					  0.9 - (left + (sin(inverseI * M_PI * 2) * right)),
 					  0.9 - (left + (cos(inverseI * M_PI * 2) * right)), 
 					  inverseI * alpha*0.8);	
-			break;
 		case COLORMODE_RGB_B: // 4
-			glColor4d(0.0 + inverseI * 0.25,
+			return ci::ColorA(0.0 + inverseI * 0.25,
 					  0.0 + cos(inverseI * M_PI * 2) * 0.1,
 					  0.0, 
 					  inverseI * alpha);
-			break;	
 		case COLORMODE_RGB_C: // 5
-			glColor4f( 0.7f + (inverseI * 0.5f),
+			return ci::ColorA( 0.7f + (inverseI * 0.5f),
 					  0.7f + (sinf(inverseI * M_PI * 2) * 0.5f),
 					  0.7f + (cosf(inverseI * M_PI * 2) * 0.5f), 
 					  inverseI * 0.1 );
-			break;
 			
 		case COLORMODE_GRAYSCALE: // 6
-			glColor4d(0.25, 0.25, 0.25, inverseI * alpha * 0.5);
-			break;
+			return ci::ColorA(0.25, 0.25, 0.25, inverseI * alpha * 0.5);
 		case COLORMODE_ALPHABLEND_1: // 7
 			left = 0.4;
 			right = 0.5;
-			glColor4d(1.0 - (left + (inverseI * right)),
+			return ci::ColorA(1.0 - (left + (inverseI * right)),
 					  1.0 - (left + (sin(inverseI * M_PI * 2) * right)),
 					  1.0 - (left + (cos(inverseI * M_PI * 2) * right)), 
 					  inverseI * alpha );	
-			break;
 		case COLORMODE_ALPHABLEND_2: // 8
-			glColor4d(0.83 + (inverseI * 0.4),
+			return ci::ColorA(0.83 + (inverseI * 0.4),
 					  0.4 + (cos(inverseI * M_PI * 2) * 0.44),
 					  (0.37 + (sin(inverseI * M_PI * 2) * 0.4)),
 					  inverseI * alpha );
-			break;
 		case COLORMODE_ALPHABLEND_3: // 9
-			glColor4d((0.4 + (sin(inverseI * M_PI * 2) * 0.32)),
+			return ci::ColorA((0.4 + (sin(inverseI * M_PI * 2) * 0.32)),
 					  (0.23 + (cos(inverseI * M_PI * 2) * 0.25)),
 					  (0.5 + (inverseI * 0.21)),
 					  inverseI * alpha );
-			break;
 		default:
 			left = 0.4;
 			right = 0.5;
-			glColor4d(1.0 - (left + (inverseI * right)),
+			return ci::ColorA(1.0 - (left + (inverseI * right)),
 					  1.0 - (left + (sin(inverseI * M_PI * 2) * right)),
 					  1.0 - (left + (cos(inverseI * M_PI * 2) * right)), 
 					  inverseI * alpha );	
-			break;
 	}	
 }
 
-inline void SilkAudioApp::drawBezier(ci::Vec2f origin, ci::Vec2f control, ci::Vec2f destination, const int segments)
-{
-	ci::Vec2f vertices[11];
-	
-	float t = 0.0;
-	for(int i = 0; i <= segments; i++)
-	{
-		float x = pow(1.0f - t, 2) * origin.x + 2.0f * (1.0f - t) * t * control.x + t * t * destination.x;
-		float y = pow(1.0f - t, 2) * origin.y + 2.0f * (1.0f - t) * t * control.y + t * t * destination.y;
-		vertices[i] = ci::Vec2f(x, y);
-		t += 1.0f / segments;
-	}
-	vertices[segments] = destination;
-
-	glVertexPointer(2, GL_FLOAT, 0, vertices);
-	glDrawArrays(GL_LINE_STRIP, 0, segments + !_glitchSegment);
-}
-
 template <class T> inline std::string SilkAudioApp::toString (const T& t)
 {
 	std::setprecision(2);
@@ -8,7 +8,6 @@
 #include "cinder/app/KeyEvent.h"
 #include "cinder/Camera.h"
 #include "cinder/gl/Texture.h"
-#include "cinder/Perlin.h"
 #include "cinder/Url.h"
 #include "cinder/DataSource.h"
 #include "cinder/Xml.h"
@@ -16,7 +15,9 @@
 #include "cinder/audio/FftProcessor.h"
 
 // Absolute imports
+#include <atomic>
 #include <vector>
+#include <thread>
 #include <boost/regex.hpp>
 #include <boost/smart_ptr.hpp>
 #include <boost/algorithm/string.hpp>
@@ -24,7 +25,11 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 // app
-#include "IKLine.h"
+#include "SilkBrush.h"
+#include "BrushSession.h"
+#include "RibbonMesh.h"
+#include "BatchNoise.h"
+#include "FrameCapture.h"
 #include "Resources.h"
 
 #define trace(__X__) console() << __X__ << std::endl;
@@ -48,8 +53,6 @@ enum
 	kStateNormal
 };
 
-typedef boost::shared_ptr<IKLine> linePointer;
-
 class SilkAudioApp : public ci::app::AppBasic
 {
 public:
@@ -69,17 +72,19 @@ public:
 	void fileDrop( ci::app::FileDropEvent event );
 	// Files
 	void saveOutBrushImageAndParameters();
+	void exportSession();
 	// Creation / Deletion
 	void randomizeBrush();
 	void setBrushSettingsFromStringParameters( std::string currentLine );
 	void createBrush();
 	// Drawing events
 	void draw();
-	void drawIKLine(linePointer& lineToDraw);
-	void drawBezier(ci::Vec2f origin, ci::Vec2f control, ci::Vec2f destination, const int segments);
+	void shutdown();
+	void updateRibbonStyle();
+	void drawPins();
 	// Colors and states
 	void toggleAdditiveBlending( bool enableAdditiveBlending );
-	void getColorMode(double inverseI, double alpha);
+	ci::ColorA getColorMode(double inverseI, double alpha);
 	// Utils
 	template <class T> inline std::string toString(const T& t);
 	void updateParams();
@@ -92,8 +97,17 @@ public:
 	
 	ci::Vec2f					_mousePosition;
 	ci::Colorf					_clearColor;
-	ci::Perlin					_perlinNoise;
-	std::vector<linePointer>		_lines;
+	BatchNoise					_perlinNoise;
+	SilkBrush					_brush;
+	BrushSession				_session;
+	std::thread					_exportThread;
+	std::atomic<bool>			_exportDone;		// no export running, _exportThread only left to join
+	std::shared_ptr<FrameRecorder>	_snapshots;		// PNG compression off the main thread
+	std::shared_ptr<WindowReader>	_snapshotReader;
+	RibbonMesh					_ribbons;
+	RibbonMesh::GlBackend		_ribbonBackend;
+	std::vector<ci::ColorA>		_ribbonColors;
+	std::vector<float>			_ribbonWidths;
 	
 	// STATES
 	int		_state;
@@ -109,12 +123,14 @@ public:
 	double	_alphaWhenDrawing;
 	float	_alphaWhenDrawingFloat;
 	float	_mouseChaseDamping;
+	float	_exportScale;
 	
 	// BRUSH PROPERTIES
 	int		_bristleCount;
 	float	_gravity;
 	float	_filamentSpacing;
 	float	_filamentCount;
+	float	_bristleWidth;
 	float	_brushRadius;
 	float	_canvasFrictionMin;
 	float	_canvasFrictionMax;
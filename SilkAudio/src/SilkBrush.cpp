@@ -0,0 +1,66 @@
+/*
+ *  SilkBrush.cpp
+ *
+ */
+
+#include "SilkBrush.h"
+#include "cinder/Rand.h"
+
+#include <algorithm>
+#include <cmath>
+
+SilkBrush::SilkBrush()
+	: _noise( 4 ), _noiseOffset( 0 )
+{
+}
+
+void SilkBrush::setNoiseSeed( int32_t seed )
+{
+	_noise.setSeed( seed );
+}
+
+void SilkBrush::create( const Settings &settings, uint32_t seed )
+{
+	ci::Rand rand( seed );
+
+	int bristleCount = std::max( settings.bristleCount, 0 );
+	float frictionMin = std::min( settings.frictionMin, settings.frictionMax );
+
+	_lines.reset( bristleCount, (int)settings.filamentCount, settings.filamentSpacing, settings.gravity, rand );
+	_targets.resize( bristleCount );
+
+	for (int i = 0; i < bristleCount; i++)
+	{
+		float radius = rand.nextFloat() * settings.brushRadius;
+		float radian = rand.nextFloat() * M_PI * 2;
+
+		_lines.setLine( i, cosf(radian) * radius, sinf(radian) * radius, rand.nextFloat(frictionMin, settings.frictionMax) );
+	}
+}
+
+void SilkBrush::update( const ci::Vec2f &mousePosition, float damping )
+{
+	size_t numLines = _lines.getNumLines();
+	if( numLines == 0 )
+		return;
+
+	// evaluate every line's noise in one batch
+	_noiseCoords.resize( numLines );
+	_noiseValues.resize( numLines );
+	for( size_t n = 0; n < numLines; ++n )
+		_noiseCoords[n] = ( _noiseOffset + n ) * 0.01f;
+	_noise.fBm( &_noiseCoords[0], 0, 0, &_noiseValues[0], numLines );
+	_noiseOffset += numLines;
+
+	for( size_t n = 0; n < numLines; ++n ) {
+		float localNoise = _noiseValues[n] * 5;
+
+		ci::Vec2f localPos = mousePosition;
+		localPos.x += cosf(localNoise) * 5;
+		localPos.y += sinf(localNoise) * 5;
+		_targets[n] = localPos;
+	}
+
+	// all bristles advance together; big brushes spread over the cores
+	_lines.nextFrame( &_targets[0], damping, 0 );
+}
@@ -0,0 +1,53 @@
+/*
+ *  SilkBrush.h
+ *
+ *  The brush simulation without drawing, deterministic from the seeds it is given.
+ *
+ */
+
+#pragma once
+
+#include "cinder/Vector.h"
+#include "BatchNoise.h"
+#include "IKLineSystem.h"
+
+#include <cstdint>
+#include <vector>
+
+class SilkBrush
+{
+public:
+	//! The values the "Parameters Used" line stores, minus alpha and damping.
+	struct Settings
+	{
+		int		bristleCount;
+		float	brushRadius;
+		float	filamentSpacing;
+		float	filamentCount;
+		float	frictionMin, frictionMax;
+		float	gravity;
+	};
+
+	SilkBrush();
+
+	//! Seed of the noise that jitters each bristle's target.
+	void	setNoiseSeed( int32_t seed );
+	//! Rebuilds the bristles; the layout and starting state follow from \a seed.
+	void	create( const Settings &settings, uint32_t seed );
+	//! Advances every bristle towards \a mousePosition.
+	void	update( const ci::Vec2f &mousePosition, float damping );
+
+	//! How far along its noise the brush is; the only state that outlives create().
+	float	getNoiseOffset() const				{ return _noiseOffset; }
+	void	setNoiseOffset( float noiseOffset )	{ _noiseOffset = noiseOffset; }
+
+	const IKLineSystem&	getLines() const	{ return _lines; }
+
+private:
+	BatchNoise				_noise;
+	IKLineSystem			_lines;
+	std::vector<float>		_noiseCoords;
+	std::vector<float>		_noiseValues;
+	std::vector<ci::Vec2f>	_targets;
+	float					_noiseOffset;		// keeps running across create()
+};
@@ -0,0 +1,246 @@
+//
+//  MeshNormals.cpp
+//
+
+#include "MeshNormals.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+using namespace std;
+
+namespace {
+	// below this many items a thread costs more than it saves
+	const size_t kMinPerThread = 16384;
+
+	size_t resolveThreads( size_t numThreads )
+	{
+		if( numThreads )
+			return numThreads;
+		return max( (size_t)thread::hardware_concurrency(), (size_t)1 );
+	}
+
+	// calls \a f( begin, end ) over \a count items split into contiguous ranges of at least
+	// \a minPerThread, the last on this thread
+	template<typename F>
+	void parallelFor( size_t count, size_t numThreads, size_t minPerThread, const F &f )
+	{
+		size_t n = max( (size_t)1, min( numThreads, count / max( minPerThread, (size_t)1 ) ) );
+		vector<thread> threads;
+		for( size_t i = 0; i + 1 < n; ++i )
+			threads.push_back( thread( f, count * i / n, count * ( i + 1 ) / n ) );
+		f( count * ( n - 1 ) / n, count );
+		for( size_t i = 0; i < threads.size(); ++i )
+			threads[i].join();
+	}
+
+	void normalize( float *n )
+	{
+		float length = sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+		if( length > 0.0f ) {
+			n[0] /= length;
+			n[1] /= length;
+			n[2] /= length;
+		}
+	}
+
+	float angleBetween( const float *a, const float *b )
+	{
+		float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+		float la = a[0] * a[0] + a[1] * a[1] + a[2] * a[2], lb = b[0] * b[0] + b[1] * b[1] + b[2] * b[2];
+		if( la <= 0.0f || lb <= 0.0f )
+			return 0.0f;
+		return acos( max( -1.0f, min( 1.0f, dot / sqrt( la * lb ) ) ) );
+	}
+
+	// the parent of \a i in a union find over \a parents, halving the path on the way
+	uint32_t findRoot( vector<uint32_t> &parents, uint32_t i )
+	{
+		while( parents[i] != i ) {
+			parents[i] = parents[parents[i]];
+			i = parents[i];
+		}
+		return i;
+	}
+}
+
+MeshNormals::MeshNormals( size_t numThreads )
+	: mNumThreads( resolveThreads( numThreads ) )
+{
+}
+
+void MeshNormals::setTopology( const uint32_t *indices, size_t numIndices, size_t numVertices )
+{
+	mIndices.assign( indices, indices + numIndices - numIndices % 3 );
+	mOffsets.assign( numVertices + 1, 0 );
+	for( size_t i = 0; i < mIndices.size(); ++i )
+		++mOffsets[mIndices[i] + 1];
+	for( size_t v = 0; v < numVertices; ++v )
+		mOffsets[v + 1] += mOffsets[v];
+
+	// corners land in triangle order, so every vertex sums its triangles the same way each time
+	mCorners.resize( mIndices.size() );
+	vector<uint32_t> fill( mOffsets.begin(), mOffsets.end() - 1 );
+	for( size_t i = 0; i < mIndices.size(); ++i )
+		mCorners[fill[mIndices[i]]++] = (uint32_t)i;
+}
+
+void MeshNormals::computeFaces( const float *positions, Weighting weighting )
+{
+	size_t numTriangles = mIndices.size() / 3;
+	mFaces.resize( numTriangles * 6 );
+	parallelFor( numTriangles, mNumThreads, kMinPerThread, [&]( size_t begin, size_t end ) {
+		for( size_t t = begin; t < end; ++t ) {
+			const float *p0 = positions + mIndices[t * 3] * 3, *p1 = positions + mIndices[t * 3 + 1] * 3, *p2 = positions + mIndices[t * 3 + 2] * 3;
+			float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float e2[3] = { p2[0] - p1[0], p2[1] - p1[1], p2[2] - p1[2] };
+			float *face = &mFaces[t * 6];
+			face[0] = e0[1] * e1[2] - e0[2] * e1[1];
+			face[1] = e0[2] * e1[0] - e0[0] * e1[2];
+			face[2] = e0[0] * e1[1] - e0[1] * e1[0];
+			float length = sqrt( face[0] * face[0] + face[1] * face[1] + face[2] * face[2] );
+			if( length <= 0.0f ) {
+				fill( face, face + 6, 0.0f );
+				continue;
+			}
+			normalize( face );
+
+			switch( weighting ) {
+				case UNIFORM:
+					face[3] = face[4] = face[5] = 1.0f;
+					break;
+				case AREA:
+					face[3] = face[4] = face[5] = length * 0.5f;
+					break;
+				case ANGLE: {
+					float back0[3] = { -e0[0], -e0[1], -e0[2] }, back1[3] = { -e1[0], -e1[1], -e1[2] }, back2[3] = { -e2[0], -e2[1], -e2[2] };
+					face[3] = angleBetween( e0, e1 );
+					face[4] = angleBetween( back0, e2 );
+					face[5] = angleBetween( back1, back2 );
+					break;
+				}
+			}
+		}
+	} );
+}
+
+void MeshNormals::compute( const float *positions, float *normals, Weighting weighting )
+{
+	computeFaces( positions, weighting );
+	parallelFor( getNumVertices(), mNumThreads, kMinPerThread, [&]( size_t begin, size_t end ) {
+		for( size_t v = begin; v < end; ++v ) {
+			float n[3] = { 0.0f, 0.0f, 0.0f };
+			for( uint32_t i = mOffsets[v]; i < mOffsets[v + 1]; ++i ) {
+				uint32_t corner = mCorners[i];
+				const float *face = &mFaces[corner / 3 * 6];
+				float weight = face[3 + corner % 3];
+				n[0] += face[0] * weight;
+				n[1] += face[1] * weight;
+				n[2] += face[2] * weight;
+			}
+			normalize( n );
+			copy( n, n + 3, normals + v * 3 );
+		}
+	} );
+}
+
+void MeshNormals::computeSplit( const float *positions, float creaseDegrees, Weighting weighting, vector<uint32_t> *sources,
+								vector<uint32_t> *indices, vector<float> *normals )
+{
+	computeFaces( positions, weighting );
+	float minDot = cos( creaseDegrees * 3.14159265358979f / 180.0f );
+	size_t numVertices = getNumVertices();
+
+	// first the runs around each vertex: two triangles join when they share an edge out of it and
+	// meet within the crease, one with no area joins either way
+	vector<uint32_t> groups( mCorners.size() ), numGroups( numVertices + 1, 0 );
+	parallelFor( numVertices, mNumThreads, kMinPerThread, [&]( size_t begin, size_t end ) {
+		vector<uint32_t> parents, labels;
+		for( size_t v = begin; v < end; ++v ) {
+			uint32_t first = mOffsets[v], count = mOffsets[v + 1] - first;
+			parents.resize( count );
+			for( uint32_t i = 0; i < count; ++i )
+				parents[i] = i;
+			for( uint32_t i = 0; i < count; ++i ) {
+				uint32_t ci = mCorners[first + i], ti = ci / 3;
+				uint32_t ai = mIndices[ti * 3 + ( ci + 1 ) % 3], bi = mIndices[ti * 3 + ( ci + 2 ) % 3];
+				const float *ni = &mFaces[ti * 6];
+				for( uint32_t j = i + 1; j < count; ++j ) {
+					uint32_t cj = mCorners[first + j], tj = cj / 3;
+					uint32_t aj = mIndices[tj * 3 + ( cj + 1 ) % 3], bj = mIndices[tj * 3 + ( cj + 2 ) % 3];
+					if( ai != aj && ai != bj && bi != aj && bi != bj )
+						continue;
+					const float *nj = &mFaces[tj * 6];
+					float dot = ni[0] * nj[0] + ni[1] * nj[1] + ni[2] * nj[2];
+					bool flat = ( ni[0] == 0.0f && ni[1] == 0.0f && ni[2] == 0.0f ) || ( nj[0] == 0.0f && nj[1] == 0.0f && nj[2] == 0.0f );
+					if( dot >= minDot || flat )
+						parents[findRoot( parents, j )] = findRoot( parents, i );
+				}
+			}
+
+			// runs numbered in the order of their first triangle
+			labels.assign( count, UINT32_MAX );
+			uint32_t next = 0;
+			for( uint32_t i = 0; i < count; ++i ) {
+				uint32_t root = findRoot( parents, i );
+				if( labels[root] == UINT32_MAX )
+					labels[root] = next++;
+				groups[first + i] = labels[root];
+			}
+			numGroups[v + 1] = next;
+		}
+	} );
+	for( size_t v = 0; v < numVertices; ++v )
+		numGroups[v + 1] += numGroups[v];
+
+	// then a vertex per run; every corner belongs to one vertex, so each is written once
+	size_t numOut = numGroups[numVertices];
+	sources->resize( numOut );
+	normals->assign( numOut * 3, 0.0f );
+	indices->resize( mIndices.size() );
+	parallelFor( numVertices, mNumThreads, kMinPerThread, [&]( size_t begin, size_t end ) {
+		for( size_t v = begin; v < end; ++v ) {
+			uint32_t base = numGroups[v];
+			for( uint32_t g = base; g < numGroups[v + 1]; ++g )
+				(*sources)[g] = (uint32_t)v;
+			for( uint32_t i = mOffsets[v]; i < mOffsets[v + 1]; ++i ) {
+				uint32_t corner = mCorners[i], out = base + groups[i];
+				const float *face = &mFaces[corner / 3 * 6];
+				float weight = face[3 + corner % 3];
+				float *n = &(*normals)[out * 3];
+				n[0] += face[0] * weight;
+				n[1] += face[1] * weight;
+				n[2] += face[2] * weight;
+				(*indices)[corner] = out;
+			}
+			for( uint32_t g = base; g < numGroups[v + 1]; ++g )
+				normalize( &(*normals)[g * 3] );
+		}
+	} );
+}
+
+void MeshNormals::computeGrid( const float *positions, size_t numColumns, size_t numRows, float *normals, size_t numThreads )
+{
+	parallelFor( numRows, resolveThreads( numThreads ), kMinPerThread / max( numColumns, (size_t)1 ), [=]( size_t begin, size_t end ) {
+		for( size_t r = begin; r < end; ++r ) {
+			const float *above = positions + ( r > 0 ? r - 1 : r ) * numColumns * 3;
+			const float *below = positions + ( r + 1 < numRows ? r + 1 : r ) * numColumns * 3;
+			const float *row = positions + r * numColumns * 3;
+			float *n = normals + r * numColumns * 3;
+			for( size_t c = 0; c < numColumns; ++c, n += 3 ) {
+				size_t left = c > 0 ? c - 1 : c, right = c + 1 < numColumns ? c + 1 : c;
+				float down[3], along[3];
+				for( int k = 0; k < 3; ++k ) {
+					down[k] = below[c * 3 + k] - above[c * 3 + k];
+					along[k] = row[right * 3 + k] - row[left * 3 + k];
+				}
+				n[0] = down[1] * along[2] - down[2] * along[1];
+				n[1] = down[2] * along[0] - down[0] * along[2];
+				n[2] = down[0] * along[1] - down[1] * along[0];
+				normalize( n );
+			}
+		}
+	} );
+}
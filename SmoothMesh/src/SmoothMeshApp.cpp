@@ -11,6 +11,8 @@
 #include "cinder/gl/Texture.h"
 #include "cinder/ip/Hdr.h"
 
+#include "MeshNormals.h"
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
@@ -52,7 +54,6 @@ private:
 
 	Matrix44f		mShadowMatrix;
 	CameraPersp		mShadowCamera;
-    void generateNormals(TriMesh);
 };
 
 void SmoothMeshApp::setup()
@@ -355,34 +356,9 @@ void SmoothMeshApp::setupMesh(uint32_t model)
 
 	mTriMesh.appendIndices( &indices.front(), indices.size() );
 
-	// use this custom function to create the normal buffer
-	generateNormals(mTriMesh);
-}
-
-void SmoothMeshApp::generateNormals(TriMesh		mTriMesh)
-{
-    mTriMesh.getNormals().clear();
-    
-    for(size_t i=0;i< mTriMesh.getVertices().size();++i)
-        mTriMesh.getNormals().push_back( Vec3f::zero() );
-    
-    for(size_t i=0;i<mTriMesh.getNumTriangles();++i)
-    {
-        Vec3f v0 = mTriMesh.getVertices()[ mTriMesh.getIndices()[i * 3] ];
-        Vec3f v1 = mTriMesh.getVertices()[ mTriMesh.getIndices()[i * 3 + 1] ];
-        Vec3f v2 = mTriMesh.getVertices()[ mTriMesh.getIndices()[i * 3 + 2] ];
-        
-        Vec3f e0 = (v2 - v0).normalized();
-        Vec3f e1 = (v2 - v1).normalized();
-        Vec3f n = e0.cross(e1).normalized();
-        
-        mTriMesh.getNormals()[ mTriMesh.getIndices()[i * 3] ] += n;
-        mTriMesh.getNormals()[ mTriMesh.getIndices()[i * 3 + 1] ] += n;
-        mTriMesh.getNormals()[ mTriMesh.getIndices()[i * 3 + 2] ] += n;
-    }
-    
-    for(size_t i=0;i<mTriMesh.getNormals().size();++i)
-        mTriMesh.getNormals()[i].normalize();
+	// the mesh is a grid, so each normal comes straight from the vertex's neighbours
+	mTriMesh.getNormals().resize( mTriMesh.getNumVertices() );
+	MeshNormals::computeGrid( &mTriMesh.getVertices()[0].x, width + 1, depth + 1, &mTriMesh.getNormals()[0].x );
 }
 
 
@@ -0,0 +1,55 @@
+//
+//  MeshNormals.h
+//
+//  Smooth vertex normals for indexed triangle meshes, from a cached vertex-to-triangle adjacency.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class MeshNormals {
+  public:
+	enum Weighting {
+		UNIFORM,	// every triangle alike
+		AREA,		// by the triangle's area
+		ANGLE		// by the triangle's angle at the vertex
+	};
+
+	//! \a numThreads 0 uses every hardware thread.
+	explicit MeshNormals( size_t numThreads = 0 );
+
+	//! The triangles of \a numIndices \a indices over \a numVertices vertices; again only when they change.
+	void			setTopology( const uint32_t *indices, size_t numIndices, size_t numVertices );
+	size_t			getNumVertices() const	{ return mOffsets.empty() ? 0 : mOffsets.size() - 1; }
+	size_t			getNumIndices() const	{ return mIndices.size(); }
+
+	//! Writes x, y and z per vertex to \a normals: the normalized sum of the normals of the triangles
+	//! around it, as \a weighting weighs them. Triangles wound counter-clockwise face their normal.
+	//! A vertex with no triangles, or only ones with no area, gets zero.
+	void			compute( const float *positions, float *normals, Weighting weighting = AREA );
+
+	//! As compute(), but triangles around a vertex only share its normal when they meet across an edge
+	//! at no more than \a creaseDegrees, directly or through others that do. Each run of triangles gets
+	//! a vertex of its own: \a sources gets the vertex each came from, to copy the rest of it from,
+	//! \a indices the triangles over the new vertices and \a normals their normals.
+	void			computeSplit( const float *positions, float creaseDegrees, Weighting weighting, std::vector<uint32_t> *sources,
+								  std::vector<uint32_t> *indices, std::vector<float> *normals );
+
+	//! Normals of a grid of \a numColumns by \a numRows vertices stored row after row, by central
+	//! differences: the change down the rows crossed with the change along them, so triangles
+	//! wound from a vertex to the one below it to the one beside it face their normal. Vertices
+	//! on the edges take one-sided differences.
+	static void		computeGrid( const float *positions, size_t numColumns, size_t numRows, float *normals, size_t numThreads = 0 );
+
+  private:
+	void			computeFaces( const float *positions, Weighting weighting );
+
+	size_t					mNumThreads;
+	std::vector<uint32_t>	mIndices;
+	std::vector<uint32_t>	mOffsets;		// into mCorners, per vertex and one past the last
+	std::vector<uint32_t>	mCorners;		// triangle * 3 + corner, grouped by vertex
+	std::vector<float>		mFaces;			// per triangle: its unit normal and the weight of each corner
+};
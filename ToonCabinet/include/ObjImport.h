@@ -0,0 +1,130 @@
+//
+//  ObjImport.h
+//
+//  OBJ meshes parsed on several threads, in ci::ObjLoader's order, and cached in a mappable file.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//! Flat arrays, as a TriMesh keeps them.
+struct ObjMesh {
+	size_t	getNumVertices() const	{ return mPositions.size() / 3; }
+	size_t	getNumTriangles() const	{ return mIndices.size() / 3; }
+	void	clear();
+
+	std::vector<float>		mPositions;		// x, y, z per vertex
+	std::vector<float>		mNormals;		// x, y, z per vertex, or empty
+	std::vector<float>		mTexCoords;		// u, v per vertex, or empty
+	std::vector<uint32_t>	mIndices;		// three per triangle
+};
+
+class ObjParser {
+  public:
+	struct Stats {
+		Stats() : mNumThreads( 0 ), mNumChunks( 0 ), mTokenizeSeconds( 0.0 ), mMergeSeconds( 0.0 ), mWeldSeconds( 0.0 ) {}
+
+		size_t	mNumThreads, mNumChunks;
+		double	mTokenizeSeconds, mMergeSeconds, mWeldSeconds;
+	};
+
+	//! \a numThreads 0 uses every hardware thread.
+	explicit ObjParser( size_t numThreads = 0 );
+
+	//! Parses \a size bytes of OBJ text into \a mesh. As ObjLoader::load(): \a generateNormals takes the
+	//! file's normals, and gives faces without any a flat one on vertices of their own; \a includeUVs
+	//! takes texture coordinates. Polygons are fanned from their first corner. False, with getError(),
+	//! when an index is out of range or a line cannot be read.
+	bool				parse( const char *data, size_t size, ObjMesh *mesh, bool generateNormals = false, bool includeUVs = true );
+
+	const std::string&	getError() const	{ return mError; }
+	const Stats&		getStats() const	{ return mStats; }
+
+	//! Reads a float as strtod() would, advancing \a p; false when there is none.
+	static bool			parseFloat( const char *&p, const char *end, float *value );
+
+  private:
+	size_t		mNumThreads;
+	std::string	mError;
+	Stats		mStats;
+};
+
+class MeshCache {
+  public:
+	static const uint32_t	kVersion = 1;
+
+	MeshCache();
+	~MeshCache();
+
+	//! Maps the cache at \a path, if it is this version and was made from the source with \a sourceHash
+	//! and \a sourceSize, with the same \a options. The arrays stay valid until close().
+	bool			open( const std::string &path, uint64_t sourceHash, uint64_t sourceSize, uint32_t options );
+	void			close();
+	bool			isOpen() const	{ return mHeader != 0; }
+
+	size_t			getNumVertices() const;
+	size_t			getNumIndices() const;
+	const float*	getPositions() const;
+	//! Null when the mesh has none.
+	const float*	getNormals() const;
+	const float*	getTexCoords() const;
+	const uint32_t*	getIndices() const;
+
+	//! Writes \a mesh to \a path, through a temporary file so a reader never sees half of it.
+	static bool		write( const std::string &path, const ObjMesh &mesh, uint64_t sourceHash, uint64_t sourceSize, uint32_t options );
+	//! A 64-bit hash of \a size bytes, eight at a time.
+	static uint64_t	hash( const void *data, size_t size );
+
+  private:
+	struct Header;
+
+	MeshCache( const MeshCache & );
+	MeshCache& operator=( const MeshCache & );
+
+	const void*				getArray( uint64_t offset ) const;
+
+	const Header			*mHeader;
+	void					*mMapping;
+	size_t					mMappedSize;
+	std::vector<uint64_t>	mBuffer;		// the whole file, where it cannot be mapped
+};
+
+class ObjImporter {
+  public:
+	struct Stats {
+		Stats() : mCached( false ), mHashSeconds( 0.0 ), mLoadSeconds( 0.0 ), mWriteSeconds( 0.0 ) {}
+
+		bool				mCached;		// the mesh came from the cache
+		double				mHashSeconds, mLoadSeconds, mWriteSeconds;
+		ObjParser::Stats	mParse;
+	};
+
+	explicit ObjImporter( size_t numThreads = 0 );
+
+	//! Parses \a size bytes of OBJ text, as ObjParser::parse(). With a \a cacheDirectory, the cache of
+	//! this text is mapped from there when it has one, and written there when it does not.
+	bool				load( const char *data, size_t size, bool generateNormals = false, bool includeUVs = true, const std::string &cacheDirectory = "" );
+
+	//! The loaded mesh, valid until the next load().
+	size_t				getNumVertices() const;
+	size_t				getNumIndices() const;
+	const float*		getPositions() const;
+	const float*		getNormals() const;
+	const float*		getTexCoords() const;
+	const uint32_t*		getIndices() const;
+
+	const std::string&	getError() const	{ return mParser.getError(); }
+	const Stats&		getStats() const	{ return mStats; }
+	//! Where the cache of text with \a sourceHash goes in \a cacheDirectory.
+	static std::string	getCachePath( const std::string &cacheDirectory, uint64_t sourceHash );
+
+  private:
+	ObjParser	mParser;
+	ObjMesh		mMesh;
+	MeshCache	mCache;
+	Stats		mStats;
+};
@@ -0,0 +1,58 @@
+//
+//  TriMeshImport.h
+//
+//  ObjImporter into a ci::TriMesh, in place of ObjLoader::load().
+//
+
+#pragma once
+
+#include "cinder/DataSource.h"
+#include "cinder/Filesystem.h"
+#include "cinder/TriMesh.h"
+#include "ObjImport.h"
+
+#include <cstring>
+
+//! Loads the OBJ in \a source into \a mesh, as ObjLoader( source ).load( mesh, generateNormals, includeUVs )
+//! does. With a \a cacheDirectory, made if need be, the mesh is kept there between launches. False, with
+//! \a importer's error and \a mesh left empty, when the file cannot be read.
+inline bool importObj( ObjImporter &importer, const ci::DataSourceRef &source, ci::TriMesh *mesh, bool generateNormals = false, bool includeUVs = true,
+					   const ci::fs::path &cacheDirectory = ci::fs::path() )
+{
+	mesh->clear();
+
+	std::string directory;
+	if( ! cacheDirectory.empty() ) {
+		try {
+			ci::fs::create_directories( cacheDirectory );
+			directory = cacheDirectory.string();
+		}
+		catch( ... ) {
+			// no cache, only a slower load
+		}
+	}
+
+	ci::Buffer &buffer = source->getBuffer();
+	if( ! importer.load( (const char *)buffer.getData(), buffer.getDataSize(), generateNormals, includeUVs, directory ) )
+		return false;
+
+	// the TriMesh arrays are the importer's, a Vec3f or Vec2f to each three or two floats
+	const size_t numVertices = importer.getNumVertices(), numIndices = importer.getNumIndices();
+	if( numVertices ) {
+		mesh->getVertices().resize( numVertices );
+		memcpy( &mesh->getVertices()[0], importer.getPositions(), numVertices * sizeof( ci::Vec3f ) );
+		if( importer.getNormals() ) {
+			mesh->getNormals().resize( numVertices );
+			memcpy( &mesh->getNormals()[0], importer.getNormals(), numVertices * sizeof( ci::Vec3f ) );
+		}
+		if( importer.getTexCoords() ) {
+			mesh->getTexCoords().resize( numVertices );
+			memcpy( &mesh->getTexCoords()[0], importer.getTexCoords(), numVertices * sizeof( ci::Vec2f ) );
+		}
+	}
+	if( numIndices ) {
+		mesh->getIndices().resize( numIndices );
+		memcpy( &mesh->getIndices()[0], importer.getIndices(), numIndices * sizeof( uint32_t ) );
+	}
+	return true;
+}
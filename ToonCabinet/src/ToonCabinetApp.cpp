@@ -8,6 +8,9 @@
 #include "cinder/gl/Texture.h"
 #include "cinder/ImageIo.h"
 #include "cinder/gl/Light.h"
+#include "cinder/Utilities.h"
+#include "MeshNormals.h"
+#include "TriMeshImport.h"
 
 using namespace ci;
 using namespace ci::app;
@@ -51,8 +54,9 @@ void ToonApp::setup()
 	camera.setPerspective(60.0f, getWindowAspectRatio(), 5.0f, 3000.0f);
 	camera.lookAt(Vec3f(0.0f, 0.0f, -500.0f), Vec3f::zero(), -1*Vec3f::yAxis());
 
-	ObjLoader loader(loadAsset("cube.obj"));
-	loader.load(&arcadeCabinet, true);
+	ObjImporter importer;
+	if( ! importObj( importer, loadAsset( "cube.obj" ), &arcadeCabinet, true, true, getTemporaryDirectory() / "ToonCabinetMeshes" ) )
+		console() << "Unable to load cube.obj: " << importer.getError() << std::endl;
 	// Obj loader doesn't properly export normals for the trimesh
 	recalculateNormals(&arcadeCabinet);
 
@@ -353,38 +357,14 @@ void ToonApp::draw()
 // Since ObjLoader or Blender doesn't correctly export normals, we need to create a new mesh based on the old mesh and redo the normals
 void ToonApp::recalculateNormals( TriMesh *mesh )
 {
-	// create an empty normal buffer and fill it with zero-length vectors
-	std::vector<Vec3f> normals;
-	normals.assign( mesh->getVertices().size(), Vec3f::zero() );
-
-	size_t n = mesh->getNumTriangles();
-	for( size_t i = 0; i < n; ++i ) {
-		// note: repeatedly calling getIndices() may not seem optimal,
-		//  but most compilers will automatically optimize this to using const references.
-		uint32_t index0 = mesh->getIndices()[i * 3];
-		uint32_t index1 = mesh->getIndices()[i * 3 + 1];
-		uint32_t index2 = mesh->getIndices()[i * 3 + 2];
-		
-		// note: repeatedly calling getVertices() may not seem optimal,
-		//  but most compilers will automatically optimize this to using const references.
-		Vec3f v0 = mesh->getVertices()[ index0 ];
-		Vec3f v1 = mesh->getVertices()[ index1 ];
-		Vec3f v2 = mesh->getVertices()[ index2 ];
-
-		Vec3f e0 = v1 - v0;
-		Vec3f e1 = v2 - v0;
-		Vec3f normal = e0.cross(e1).normalized();
-
-		normals[ index0 ] += normal;
-		normals[ index1 ] += normal;
-		normals[ index2 ] += normal;
-	}
-
-	// normalize all normals
-	std::for_each( normals.begin(), normals.end(), std::mem_fun_ref(&Vec3f::normalize) );
-
-	// magic trick: use swap() to exchange the TriMesh's normal buffer for our new one
-	mesh->getNormals().swap( normals );
+	if( mesh->getIndices().empty() )
+		return;
+
+	// every triangle counts alike around a vertex, as it always has here
+	MeshNormals normals;
+	normals.setTopology( &mesh->getIndices()[0], mesh->getNumIndices(), mesh->getNumVertices() );
+	mesh->getNormals().resize( mesh->getNumVertices() );
+	normals.compute( &mesh->getVertices()[0].x, &mesh->getNormals()[0].x, MeshNormals::UNIFORM );
 }
 
 CINDER_APP_BASIC( ToonApp, RendererGl )
@@ -0,0 +1,74 @@
+//
+//  SpectrogramTexture.h
+//
+//  GL texture for a SpectrogramHistory, patched with only the rows that changed.
+//
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/gl/gl.h"
+#include "cinder/gl/Texture.h"
+#include "SpectrogramHistory.h"
+
+namespace spectrogram {
+
+inline void getGlFormats( SpectrogramHistory::Quantization quantization, GLint *internalFormat, GLenum *dataFormat, GLenum *dataType )
+{
+#if CINDER_VERSION >= 900
+	*dataFormat = GL_RED;
+	switch( quantization ) {
+		case SpectrogramHistory::HALF_FLOAT:	*internalFormat = GL_R16F;	*dataType = GL_HALF_FLOAT;		break;
+		case SpectrogramHistory::LOG_8BIT:		*internalFormat = GL_R8;	*dataType = GL_UNSIGNED_BYTE;	break;
+		default:								*internalFormat = GL_R32F;	*dataType = GL_FLOAT;			break;
+	}
+#else
+	*dataFormat = GL_LUMINANCE;
+	switch( quantization ) {
+		case SpectrogramHistory::HALF_FLOAT:	*internalFormat = GL_LUMINANCE16F_ARB;	*dataType = GL_HALF_FLOAT_ARB;	break;
+		case SpectrogramHistory::LOG_8BIT:		*internalFormat = GL_LUMINANCE8;		*dataType = GL_UNSIGNED_BYTE;	break;
+		default:								*internalFormat = GL_LUMINANCE32F_ARB;	*dataType = GL_FLOAT;			break;
+	}
+#endif
+}
+
+//! Allocates a texture matching \a history; rows arrive through uploadDirtyRows().
+inline ci::gl::TextureRef createTexture( SpectrogramHistory &history, ci::gl::Texture::Format format )
+{
+	GLint internalFormat;
+	GLenum dataFormat, dataType;
+	getGlFormats( history.getQuantization(), &internalFormat, &dataFormat, &dataType );
+
+	format.setInternalFormat( internalFormat );
+	history.markAllDirty();
+	return ci::gl::Texture::create( (int)history.getNumBands(), (int)history.getNumRows(), format );
+}
+
+//! Uploads the dirty rows of \a history, at most two glTexSubImage2D calls, and
+//! returns the number of bytes sent.
+inline size_t uploadDirtyRows( SpectrogramHistory &history, const ci::gl::TextureRef &texture )
+{
+	SpectrogramHistory::Span spans[2];
+	size_t numSpans = history.getDirtySpans( spans );
+	if( numSpans == 0 || ! texture )
+		return 0;
+
+	GLint internalFormat;
+	GLenum dataFormat, dataType;
+	getGlFormats( history.getQuantization(), &internalFormat, &dataFormat, &dataType );
+
+	texture->bind();
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	for( size_t i = 0; i < numSpans; i++ ) {
+		glTexSubImage2D( texture->getTarget(), 0, 0, (GLint)spans[i].mFirstRow, (GLsizei)history.getNumBands(), (GLsizei)spans[i].mNumRows,
+						 dataFormat, dataType, history.getRowData( spans[i].mFirstRow ) );
+	}
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	texture->unbind();
+
+	size_t numBytes = history.getNumDirtyBytes();
+	history.markClean();
+	return numBytes;
+}
+
+} // namespace spectrogram
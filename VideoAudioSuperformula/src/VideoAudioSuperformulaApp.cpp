@@ -7,11 +7,13 @@
 #include "cinder/Utilities.h"
 #include "cinder/params/Params.h"
 #include "cinder/gl/Ubo.h"
-#include "cinder/audio/MonitorNode.h"
+#include "cinder/audio/Context.h"
 #include "cinder/audio/Device.h"
 #include "cinder/gl/Texture.h"
 #include "cinder/MayaCamUI.h"
 #include "Resources.h"
+#include "AnalyzerNode.h"
+#include "SpectrogramTexture.h"
 
 
 #define INPUT_DEVICE "Scarlett 2i2 USB"
@@ -46,20 +48,20 @@ class VideoAudioSuperformulaApp : public AppNative {
 	int						mSubdivisions;
 	int						mCheckerFrequency;
     audio::InputDeviceNodeRef		mInputDeviceNode;
-    audio::MonitorSpectralNodeRef	mMonitorSpectralNode;
-    std::vector<float>					mMagSpectrum;
+    AudioAnalyzerRef				mAnalyzer;
+    AnalyzerNodeRef					mAnalyzerNode;
     // number of frequency bands of our spectrum
     static const int kBands = 1024;
     static const int kHistory = 128;
-    Channel32f			mChannelLeft;
-    Channel32f			mChannelRight;
+    SpectrogramHistory	mHistoryLeft;
+    SpectrogramHistory	mHistoryRight;
     gl::TextureRef			mTextureLeft;
     gl::TextureRef		mTextureRight;
     gl::Texture::Format	mTextureFormat;
     gl::TextureRef			mTexture;
-    uint32_t mOffset;
     MayaCamUI			mMayaCam;
     float mFrameRate;
+    int   mUploadBytes;
 	
 	// This is dependent on the C++ compiler structuring these vars in RAM the same way that GL's std140 does
 	struct {
@@ -109,7 +111,9 @@ void VideoAudioSuperformulaApp::setup()
 
 #if ! defined( CINDER_GL_ES )
 	mParams = params::InterfaceGl::create( getWindow(), "App parameters", toPixels( ivec2( 200, 400 ) ) );
+    mUploadBytes = 0;
     mParams->addParam( "Frame rate",	&mFrameRate,"", true);
+    mParams->addParam( "Upload bytes",	&mUploadBytes,"", true);
 	mParams->addParam( "A (1)", &mFormulaParams.mA1 ).min( 0 ).max( 5 ).step( 0.05f );
 	mParams->addParam( "B (1)", &mFormulaParams.mB1 ).min( 0 ).max( 5 ).step( 0.05f );
 	mParams->addParam( "M (1)", &mFormulaParams.mM1 ).min( 0 ).max( 20 ).step( 0.25f );
@@ -171,28 +175,32 @@ void VideoAudioSuperformulaApp::setup()
     
     // By providing an FFT size double that of the window size, we 'zero-pad' the analysis data, which gives
     // an increase in resolution of the resulting spectrum data.
-    auto monitorFormat = audio::MonitorSpectralNode::Format().fftSize( kBands ).windowSize( kBands / 2 );
-    mMonitorSpectralNode = ctx->makeNode( new audio::MonitorSpectralNode( monitorFormat ) );
+    // The analysis runs on its own thread; update() only picks up the latest result.
+    auto analyzerFormat = AudioAnalyzer::Format().fftSize( kBands ).windowSize( kBands / 2 ).sampleRate( (float)ctx->getSampleRate() );
+    mAnalyzer = AudioAnalyzer::create( analyzerFormat );
+    mAnalyzerNode = ctx->makeNode( new AnalyzerNode( mAnalyzer ) );
     
-    mInputDeviceNode >> mMonitorSpectralNode;
+    mInputDeviceNode >> mAnalyzerNode;
     
     // InputDeviceNode (and all InputNode subclasses) need to be enabled()'s to process audio. So does the Context:
     mInputDeviceNode->enable();
     ctx->enable();
+    mAnalyzer->start();
     
     getWindow()->setTitle( mInputDeviceNode->getDevice()->getName() );
     
-    // create channels from which we can construct our textures
-    mChannelLeft = Channel32f(kBands, kHistory);
-    mChannelRight = Channel32f(kBands, kHistory);
-    memset(	mChannelLeft.getData(), 0, mChannelLeft.getRowBytes() * kHistory );
-    memset(	mChannelRight.getData(), 0, mChannelRight.getRowBytes() * kHistory );
+    // spectrum histories; new rows overwrite the oldest and the shader scrolls by uTexOffset
+    mHistoryLeft = SpectrogramHistory( kBands, kHistory, SpectrogramHistory::HALF_FLOAT );
+    mHistoryRight = SpectrogramHistory( kBands, kHistory, SpectrogramHistory::HALF_FLOAT );
     
     // create texture format (wrap the y-axis, clamp the x-axis)
 //    mTextureFormat.setWrapS( GL_CLAMP );
     mTextureFormat.setWrapT( GL_REPEAT );
     mTextureFormat.setMinFilter( GL_LINEAR );
     mTextureFormat.setMagFilter( GL_LINEAR );
+    
+    mTextureLeft = spectrogram::createTexture( mHistoryLeft, mTextureFormat );
+    mTextureRight = spectrogram::createTexture( mHistoryRight, mTextureFormat );
 
     mTexture = gl::Texture::create( loadImage( loadResource( RES_LANDSCAPE_IMAGE) ) );
 
@@ -240,23 +248,20 @@ void VideoAudioSuperformulaApp::update()
 	mNormalsBatch->getGlslProg()->uniform( "uNormalsLength", mNormalsLength );
 	mBatch->getGlslProg()->uniform( "uCheckerFrequency", mCheckerFrequency );
     
-    mMagSpectrum = mMonitorSpectralNode->getMagSpectrum();
-    mOffset = (mOffset+1) % kHistory;
+    const AudioFeatures &features = mAnalyzer->acquire();
+    const vector<float> &magSpectrum = features.mMagSpectrum;
     // get spectrum for left and right channels and copy it into our channels
-    float* pDataLeft = mChannelLeft.getData() + kBands * mOffset;
-    float* pDataRight = mChannelRight.getData() + kBands * mOffset;
-    
-    std::reverse_copy(mMagSpectrum.begin(), mMagSpectrum.end(), pDataLeft);
-    std::copy(mMagSpectrum.begin(), mMagSpectrum.end(), pDataRight);
+    mHistoryLeft.pushRow( &magSpectrum[0], magSpectrum.size(), true );
+    mHistoryRight.pushRow( &magSpectrum[0], magSpectrum.size() );
     
-    float offSt = mOffset / float(kHistory);
+    float offSt = mHistoryLeft.getNewestRow() / float(kHistory);
     mBatch->getGlslProg()->uniform("uTexOffset", offSt);
     mBatch->getGlslProg()->uniform("uVideoTex", 0);
     mBatch->getGlslProg()->uniform("uLeftTex", 1);
     mBatch->getGlslProg()->uniform("uRightTex", 2);
 
-    mTextureLeft = gl::Texture::create(mChannelLeft, mTextureFormat);
-    mTextureRight = gl::Texture::create(mChannelRight, mTextureFormat);
+    mUploadBytes = (int)( spectrogram::uploadDirtyRows( mHistoryLeft, mTextureLeft )
+                         + spectrogram::uploadDirtyRows( mHistoryRight, mTextureRight ) );
     
     mFrameRate = getAverageFps();
 
@@ -3,8 +3,21 @@
 uniform float		uTexOffset;
 uniform sampler2D	uLeftTex;
 uniform sampler2D	uRightTex;
+uniform sampler2D	uHeightTex;
+uniform float		uHeightOffset;
+uniform vec2		uHeightSize;
 uniform float time;
 const float tenLogBase10 = 3.0102999566398;
+
+// the terrain is a ring of columns: uHeightOffset is the oldest one, drawn at x = 0
+vec4 terrainVertex()
+{
+	vec2 coord = vec2( ( gl_Vertex.x + 0.5 ) / uHeightSize.x + uHeightOffset, ( gl_Vertex.z + 0.5 ) / uHeightSize.y );
+	vec4 vertex = gl_Vertex;
+	vertex.y = texture2D( uHeightTex, coord ).r;
+	return vertex;
+}
+
 void main(void)
 {	
 	// retrieve texture coordinate and offset it to scroll the texture
@@ -17,7 +30,7 @@ void main(void)
 	float decibels = log( fft ) * tenLogBase10;
 
 	// offset the vertex based on the decibels
-	vec4 vertex = gl_Vertex;
+	vec4 vertex = terrainVertex();
 	vertex.y += 20.0 * decibels;
 
 	// pass (unchanged) texture coordinates, bumped vertex and vertex color
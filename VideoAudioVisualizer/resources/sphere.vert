@@ -6,6 +6,9 @@
 uniform float		uTexOffset;
 uniform sampler2D	uLeftTex;
 uniform sampler2D	uRightTex;
+uniform sampler2D	uHeightTex;
+uniform float		uHeightOffset;
+uniform vec2		uHeightSize;
 const float two_pi = 6.2831853;
 const float tenLogBase10 = 3.0102999566398; // 10.0 / log(10.0);
 uniform float time;
@@ -22,6 +25,15 @@ const float flat_width = 200.0;
 const float flat_height = 200.0;
 const float flatness = 0.0;
 
+// the terrain is a ring of columns: uHeightOffset is the oldest one, drawn at x = 0
+vec4 terrainVertex()
+{
+	vec2 coord = vec2( ( gl_Vertex.x + 0.5 ) / uHeightSize.x + uHeightOffset, ( gl_Vertex.z + 0.5 ) / uHeightSize.y );
+	vec4 vertex = gl_Vertex;
+	vertex.y = texture2D( uHeightTex, coord ).r;
+	return vertex;
+}
+
 void main(void)
 {
     vec3 directionVec = normalize(vec3(gl_MultiTexCoord0));
@@ -44,7 +56,7 @@ void main(void)
     //gl_Position = gl_ModelViewProjectionMatrix * timeVec;
     
     
-    vec3 sphere_position = gl_Vertex.xyz * sphere_radius;
+    vec3 sphere_position = terrainVertex().xyz * sphere_radius;
     vec3 flat_position = vec3 (vec2 (flat_width, flat_height) * (gl_MultiTexCoord0.xy - vec2 (0.5, 0.5)), 0.0);
     
     
@@ -64,7 +76,7 @@ void main(void)
     // offset the vertex based on the decibels and create a cylinder
     float fade = gl_MultiTexCoord0.t;
     float r = 100.0 + decibels;
-    vec4 vertex = gl_Vertex;
+    vec4 vertex = terrainVertex();
     vertex.y = r * cos(gl_MultiTexCoord0.t * two_pi) - 0.25 * vertex.y;
     vertex.z = r * sin(gl_MultiTexCoord0.t * two_pi) - time * vertex.z;
 
@@ -0,0 +1,67 @@
+//
+//  BatchNoise.h
+//
+//  Perlin and simplex noise over whole arrays, matching ci::Perlin up to float rounding.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class BatchNoise {
+  public:
+	enum Basis { GRADIENT, SIMPLEX };
+	//! How octaves are summed, with octave i weighted by 0.5^( i + 1 ):
+	//! FBM adds n, TURBULENCE adds |n|, RIDGED adds ( 1 - |n| )^2.
+	enum Fractal { FBM, TURBULENCE, RIDGED };
+
+	BatchNoise( uint8_t octaves = 4, int32_t seed = 0x214 );
+
+	void		setSeed( int32_t seed );
+	int32_t		getSeed() const				{ return mSeed; }
+	void		setOctaves( uint8_t octaves )	{ mOctaves = octaves; }
+	uint8_t		getOctaves() const			{ return mOctaves; }
+
+	//! Single samples, for comparison with ci::Perlin::noise().
+	float		noise( float x ) const;
+	float		noise( float x, float y ) const;
+	float		noise( float x, float y, float z ) const;
+	float		simplex( float x, float y ) const;
+	float		simplex( float x, float y, float z ) const;
+
+	//! out[i] = noise( x[i], y[i], z[i] ). Pass null \a y / \a z for fewer dimensions.
+	//! Simplex noise needs at least \a x and \a y.
+	void		noise( const float *x, const float *y, const float *z, float *out, size_t count, Basis basis = GRADIENT ) const;
+	//! out[i] = fractal sum at ( x[i], y[i], z[i] ); FBM with GRADIENT matches ci::Perlin::fBm().
+	void		fractal( const float *x, const float *y, const float *z, float *out, size_t count,
+						 Fractal fractal = FBM, Basis basis = GRADIENT ) const;
+	void		fBm( const float *x, const float *y, const float *z, float *out, size_t count ) const	{ fractal( x, y, z, out, count, FBM ); }
+
+	//! out[i] = fractal sum at origin + i * step, for \a count points.
+	void		fractalLine( const float origin[3], const float step[3], float *out, size_t count,
+							 Fractal fractal = FBM, Basis basis = GRADIENT ) const;
+	//! out[row * numColumns + column] = fractal sum at origin + column * columnStep + row * rowStep.
+	//! Rows are shared out over \a numThreads threads, 0 meaning one per hardware thread.
+	void		fractalGrid( const float origin[3], const float columnStep[3], const float rowStep[3],
+							 float *out, size_t numColumns, size_t numRows,
+							 Fractal fractal = FBM, Basis basis = GRADIENT, size_t numThreads = 1 ) const;
+
+	static const size_t kBlockSize = 64;
+
+  private:
+	void		initPermutationTable();
+	//! Evaluates up to kBlockSize points of one octave.
+	void		noiseBlock( const float *x, const float *y, const float *z, float *out, size_t count, Basis basis ) const;
+	void		gradientBlock1( const float *x, float *out, size_t count ) const;
+	void		gradientBlock2( const float *x, const float *y, float *out, size_t count ) const;
+	void		gradientBlock3( const float *x, const float *y, const float *z, float *out, size_t count ) const;
+	void		simplexBlock2( const float *x, const float *y, float *out, size_t count ) const;
+	void		simplexBlock3( const float *x, const float *y, const float *z, float *out, size_t count ) const;
+	//! Sums the octaves of up to kBlockSize points; the coordinates are scratch space and get scaled.
+	void		fractalBlock( float *x, float *y, float *z, float *out, size_t count, Fractal fractal, Basis basis ) const;
+
+	uint8_t		mOctaves;
+	int32_t		mSeed;
+	uint8_t		mPerms[512];
+};
@@ -0,0 +1,25 @@
+//
+//  HeightfieldRing.cpp
+//
+
+#include "HeightfieldRing.h"
+
+HeightfieldRing::HeightfieldRing()
+	: mNumColumns( 1 ), mNumRows( 0 ), mOldest( 0 ), mNumDirty( 0 )
+{
+}
+
+HeightfieldRing::HeightfieldRing( int numColumns, int numRows )
+	: mNumColumns( numColumns > 0 ? numColumns : 1 ), mNumRows( numRows > 0 ? numRows : 0 ), mOldest( 0 ), mNumDirty( 0 )
+{
+	mHeights.assign( mNumColumns * mNumRows, 0.0f );
+	markAllDirty();
+}
+
+void HeightfieldRing::pushColumn()
+{
+	// the slot just written was the oldest; the one after it is now
+	mOldest = ( mOldest + 1 ) % mNumColumns;
+	if( mNumDirty < mNumColumns )
+		mNumDirty++;
+}
@@ -0,0 +1,45 @@
+//
+//  HeightfieldRing.h
+//
+//  A heightfield that scrolls by overwriting its oldest column.
+//
+
+#pragma once
+
+#include <vector>
+
+class HeightfieldRing {
+  public:
+	HeightfieldRing();
+	HeightfieldRing( int numColumns, int numRows );
+
+	//! Storage for the next column, which replaces the oldest. Call pushColumn() when it is filled.
+	float*			getNextColumn()			{ return &mHeights[getNextSlot() * mNumRows]; }
+	void			pushColumn();
+
+	//! Height as seen after scrolling: column 0 is the oldest, numColumns - 1 the newest.
+	float			getHeight( int column, int row ) const	{ return mHeights[getSlot( column ) * mNumRows + row]; }
+	void			setHeight( int column, int row, float height )	{ mHeights[getSlot( column ) * mNumRows + row] = height; }
+
+	//! Storage slot of the oldest column, i.e. the texture offset for the shader.
+	int				getOldestColumn() const	{ return mOldest; }
+	int				getSlot( int column ) const	{ return ( mOldest + column ) % mNumColumns; }
+	const float*	getSlotData( int slot ) const	{ return &mHeights[slot * mNumRows]; }
+
+	//! Slots pushed since the last markClean(), oldest first; capped at numColumns.
+	int				getNumDirtyColumns() const	{ return mNumDirty; }
+	int				getDirtySlot( int i ) const	{ return ( mOldest + mNumColumns - mNumDirty + i ) % mNumColumns; }
+	void			markClean()				{ mNumDirty = 0; }
+	void			markAllDirty()			{ mNumDirty = mNumColumns; }
+
+	int				getNumColumns() const	{ return mNumColumns; }
+	int				getNumRows() const		{ return mNumRows; }
+
+  private:
+	int				getNextSlot() const		{ return mOldest; }
+
+	int					mNumColumns, mNumRows;
+	std::vector<float>	mHeights;		// column-major, by slot
+	int					mOldest;
+	int					mNumDirty;
+};
@@ -0,0 +1,130 @@
+//
+//  SpectrogramHistory.cpp
+//
+
+#include "SpectrogramHistory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+SpectrogramHistory::SpectrogramHistory()
+	: mNumBands( 0 ), mNumRows( 1 ), mQuantization( FLOAT32 ), mOffset( 0 ), mDirtyStart( 0 ), mNumDirty( 0 ), mNumBytesUploaded( 0 )
+{
+}
+
+SpectrogramHistory::SpectrogramHistory( size_t numBands, size_t numRows, Quantization quantization )
+	: mNumBands( numBands ), mNumRows( max<size_t>( numRows, 1 ) ), mQuantization( quantization ),
+	mOffset( 0 ), mDirtyStart( 0 ), mNumDirty( 0 ), mNumBytesUploaded( 0 )
+{
+	mData.assign( getBytesPerRow() * mNumRows, 0 );
+	markAllDirty();
+}
+
+size_t SpectrogramHistory::getBytesPerTexel() const
+{
+	switch( mQuantization ) {
+		case HALF_FLOAT:	return 2;
+		case LOG_8BIT:		return 1;
+		default:			return 4;
+	}
+}
+
+void SpectrogramHistory::pushRow( const float *bins, size_t count, bool reversed )
+{
+	if( mNumBands == 0 )
+		return;
+
+	count = min( count, mNumBands );
+	uint8_t *row = &mData[mOffset * getBytesPerRow()];
+	memset( row, 0, getBytesPerRow() );
+
+	for( size_t i = 0; i < count; i++ ) {
+		float value = reversed ? bins[count - 1 - i] : bins[i];
+		switch( mQuantization ) {
+			case FLOAT32:		reinterpret_cast<float*>( row )[i] = value;				break;
+			case HALF_FLOAT:	reinterpret_cast<uint16_t*>( row )[i] = floatToHalf( value );	break;
+			case LOG_8BIT:		row[i] = floatToLog8( value );							break;
+		}
+	}
+
+	if( mNumDirty == 0 )
+		mDirtyStart = mOffset;
+	if( mNumDirty < mNumRows )
+		mNumDirty++;
+	else
+		mDirtyStart = ( mOffset + 1 ) % mNumRows;
+
+	mOffset = ( mOffset + 1 ) % mNumRows;
+}
+
+size_t SpectrogramHistory::getDirtySpans( Span spans[2] ) const
+{
+	if( mNumDirty == 0 )
+		return 0;
+
+	size_t first = min( mNumDirty, mNumRows - mDirtyStart );
+	spans[0].mFirstRow	= mDirtyStart;
+	spans[0].mNumRows	= first;
+	if( first == mNumDirty )
+		return 1;
+
+	spans[1].mFirstRow	= 0;
+	spans[1].mNumRows	= mNumDirty - first;
+	return 2;
+}
+
+void SpectrogramHistory::markClean()
+{
+	mNumBytesUploaded	+= getNumDirtyBytes();
+	mNumDirty			= 0;
+}
+
+void SpectrogramHistory::markAllDirty()
+{
+	mDirtyStart	= 0;
+	mNumDirty	= mNumRows;
+}
+
+uint16_t SpectrogramHistory::floatToHalf( float value )
+{
+	uint32_t bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+
+	uint32_t sign		= ( bits >> 16 ) & 0x8000;
+	int32_t exponent	= (int32_t)( ( bits >> 23 ) & 0xff ) - 127 + 15;
+	uint32_t mantissa	= bits & 0x7fffff;
+
+	if( ( ( bits >> 23 ) & 0xff ) == 0xff )					// inf / nan
+		return (uint16_t)( sign | 0x7c00 | ( mantissa ? 0x200 : 0 ) );
+	if( exponent >= 31 )									// too large, clamp to inf
+		return (uint16_t)( sign | 0x7c00 );
+	if( exponent <= 0 ) {									// subnormal or zero
+		if( exponent < -10 )
+			return (uint16_t)sign;
+		mantissa |= 0x800000;
+		uint32_t shift	= (uint32_t)( 14 - exponent );
+		uint32_t half	= mantissa >> shift;
+		uint32_t rest	= mantissa & ( ( 1u << shift ) - 1 );
+		uint32_t middle	= 1u << ( shift - 1 );
+		if( rest > middle || ( rest == middle && ( half & 1 ) ) )
+			half++;
+		return (uint16_t)( sign | half );
+	}
+
+	// round to nearest even; a carry out of the mantissa correctly bumps the exponent
+	uint32_t half = sign | ( (uint32_t)exponent << 10 ) | ( mantissa >> 13 );
+	uint32_t rest = mantissa & 0x1fff;
+	if( rest > 0x1000 || ( rest == 0x1000 && ( half & 1 ) ) )
+		half++;
+	return (uint16_t)half;
+}
+
+uint8_t SpectrogramHistory::floatToLog8( float value )
+{
+	// audio::linearToDecibel() maps 1e-5..1 to 0..100 dB
+	float db = value < 1e-5f ? 0.0f : 20.0f * log10f( value ) + 100.0f;
+	return (uint8_t)min( max( db * 2.55f + 0.5f, 0.0f ), 255.0f );
+}
@@ -0,0 +1,63 @@
+//
+//  SpectrogramHistory.h
+//
+//  A ring of spectrum rows that tracks which rows still need uploading.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class SpectrogramHistory {
+  public:
+	//! LOG_8BIT stores audio::linearToDecibel( mag ) / 100 * 255.
+	enum Quantization { FLOAT32, HALF_FLOAT, LOG_8BIT };
+
+	//! A run of consecutive rows.
+	struct Span {
+		size_t	mFirstRow;
+		size_t	mNumRows;
+	};
+
+	SpectrogramHistory();
+	SpectrogramHistory( size_t numBands, size_t numRows, Quantization quantization = FLOAT32 );
+
+	//! Writes \a count bins into the row at getOffset(), high to low if \a reversed,
+	//! zero-fills the rest of the row and advances the offset.
+	void			pushRow( const float *bins, size_t count, bool reversed = false );
+
+	//! The row the next pushRow() writes to, which is also the oldest row.
+	size_t			getOffset() const		{ return mOffset; }
+	//! The row the last pushRow() wrote to.
+	size_t			getNewestRow() const	{ return ( mOffset + mNumRows - 1 ) % mNumRows; }
+	float			getTexOffset() const	{ return mOffset / (float)mNumRows; }
+
+	//! Rows written since the last markClean(), as at most two spans. Returns the span count.
+	size_t			getDirtySpans( Span spans[2] ) const;
+	size_t			getNumDirtyBytes() const	{ return mNumDirty * getBytesPerRow(); }
+	void			markClean();
+	void			markAllDirty();
+
+	//! Bytes handed out through markClean() so far.
+	uint64_t		getNumBytesUploaded() const	{ return mNumBytesUploaded; }
+
+	size_t			getNumBands() const		{ return mNumBands; }
+	size_t			getNumRows() const		{ return mNumRows; }
+	Quantization	getQuantization() const	{ return mQuantization; }
+	size_t			getBytesPerTexel() const;
+	size_t			getBytesPerRow() const	{ return mNumBands * getBytesPerTexel(); }
+	const void*		getRowData( size_t row ) const	{ return &mData[row * getBytesPerRow()]; }
+
+	static uint16_t	floatToHalf( float value );
+	static uint8_t	floatToLog8( float value );
+
+  private:
+	size_t					mNumBands, mNumRows;
+	Quantization			mQuantization;
+	std::vector<uint8_t>	mData;
+	size_t					mOffset;
+	size_t					mDirtyStart, mNumDirty;
+	uint64_t				mNumBytesUploaded;
+};
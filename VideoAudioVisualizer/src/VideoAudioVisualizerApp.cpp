@@ -29,12 +29,16 @@
 #include "cinder/Channel.h"
 #include "cinder/ImageIo.h"
 #include "cinder/MayaCamUI.h"
-#include "cinder/audio/MonitorNode.h"
+#include "cinder/audio/Context.h"
 #include "cinder/audio/Device.h"
 //#include "cinderSyphon.h"
 #include "cinder/gl/Light.h"
 #include "Resources.h"
-#include "cinder/Perlin.h"
+#include "AnalyzerNode.h"
+#include "SpectrogramTexture.h"
+#include "HeightfieldRing.h"
+#include "BatchNoise.h"
+#include "VideoUploader.h"
 #include "cinder/params/Params.h"
 #include "cinder/Capture.h"
 
@@ -59,6 +63,7 @@ public:
     void keyDown( KeyEvent event );
     void mouseWheel( MouseEvent event );
     void resize();
+    void uploadHeightColumns();
     
 private:
     // width and height of our mesh
@@ -69,8 +74,8 @@ private:
     static const int kBands = 1024;
     static const int kHistory = 128;
     
-    Channel32f			mChannelLeft;
-    Channel32f			mChannelRight;
+    SpectrogramHistory	mHistoryLeft;
+    SpectrogramHistory	mHistoryRight;
     CameraPersp			mCamera;
     MayaCamUI			mMayaCam;
     vector<gl::GlslProgRef>		mShader;
@@ -81,27 +86,30 @@ private:
     gl::TextureRef			mTexture;
     gl::VboMesh			mMesh;
     
-    uint32_t			mOffset;
     
     bool				mIsMouseDown;
     double				mMouseUpTime;
     double				mMouseUpDelay;
     
     audio::InputDeviceNodeRef		mInputDeviceNode;
-    audio::MonitorSpectralNodeRef	mMonitorSpectralNode;
-    vector<float>					mMagSpectrum;
-    Perlin				mPerlin;
+    AudioAnalyzerRef				mAnalyzer;
+    AnalyzerNodeRef					mAnalyzerNode;
+    BatchNoise			mNoise;
     uint32              mPerlinMove;
-    std::vector<Vec3f>      mVertices;
+    HeightfieldRing     mHeights;
+    gl::TextureRef      mHeightTexture;
     
 //    syphonServer mTextureSyphon;
     
     float mFrameRate;
+    int   mUploadBytes;
     float mTimeParam;
     bool  mAutomaticSwitch;
     ci::params::InterfaceGl		mParams;
     
     CaptureRef mCapture;
+    // capture frames go up into the same couple of textures rather than a new one each
+    std::shared_ptr<VideoUploader> mVideo;
     
 };
 
@@ -122,9 +130,10 @@ void VideoAudioVisualizerApp::mouseWheel( MouseEvent event )
 void VideoAudioVisualizerApp::setup()
 {
     
-    mPerlin = Perlin( 4, 0 );
+    mNoise = BatchNoise( 4, 0 );
     mPerlinMove = 0;
     mFrameRate	= 0.0f;
+    mUploadBytes = 0;
 
     auto ctx = audio::Context::master();
     std::cout << "Devices available: " << endl;
@@ -144,14 +153,17 @@ void VideoAudioVisualizerApp::setup()
     
     // By providing an FFT size double that of the window size, we 'zero-pad' the analysis data, which gives
     // an increase in resolution of the resulting spectrum data.
-    auto monitorFormat = audio::MonitorSpectralNode::Format().fftSize( kBands ).windowSize( kBands / 2 );
-    mMonitorSpectralNode = ctx->makeNode( new audio::MonitorSpectralNode( monitorFormat ) );
+    // The analysis runs on its own thread; update() only picks up the latest result.
+    auto analyzerFormat = AudioAnalyzer::Format().fftSize( kBands ).windowSize( kBands / 2 ).sampleRate( (float)ctx->getSampleRate() );
+    mAnalyzer = AudioAnalyzer::create( analyzerFormat );
+    mAnalyzerNode = ctx->makeNode( new AnalyzerNode( mAnalyzer ) );
     
-    mInputDeviceNode >> mMonitorSpectralNode;
+    mInputDeviceNode >> mAnalyzerNode;
     
     // InputDeviceNode (and all InputNode subclasses) need to be enabled()'s to process audio. So does the Context:
     mInputDeviceNode->enable();
     ctx->enable();
+    mAnalyzer->start();
     
     getWindow()->setTitle( mInputDeviceNode->getDevice()->getName() );
     
@@ -161,11 +173,9 @@ void VideoAudioVisualizerApp::setup()
     mCamera.setEyePoint( Vec3f(10239.3,7218.58,-726.448));
     mCamera.setCenterOfInterestPoint( Vec3f(kWidth*0.5f, -kHeight*0.5f, kWidth*0.5f) );
     
-    // create channels from which we can construct our textures
-    mChannelLeft = Channel32f(kBands, kHistory);
-    mChannelRight = Channel32f(kBands, kHistory);
-    memset(	mChannelLeft.getData(), 0, mChannelLeft.getRowBytes() * kHistory );
-    memset(	mChannelRight.getData(), 0, mChannelRight.getRowBytes() * kHistory );
+    // spectrum histories; new rows overwrite the oldest and the shader scrolls by uTexOffset
+    mHistoryLeft = SpectrogramHistory( kBands, kHistory, SpectrogramHistory::HALF_FLOAT );
+    mHistoryRight = SpectrogramHistory( kBands, kHistory, SpectrogramHistory::HALF_FLOAT );
     
     // create texture format (wrap the y-axis, clamp the x-axis)
     mTextureFormat.setWrapS( GL_CLAMP );
@@ -173,6 +183,9 @@ void VideoAudioVisualizerApp::setup()
     mTextureFormat.setMinFilter( GL_LINEAR );
     mTextureFormat.setMagFilter( GL_LINEAR );
     
+    mTextureLeft = spectrogram::createTexture( mHistoryLeft, mTextureFormat );
+    mTextureRight = spectrogram::createTexture( mHistoryRight, mTextureFormat );
+    
     mShaderNum = 0;
     try {
         mShader.push_back(gl::GlslProg::create( loadResource( GLSL_VERT1 ), loadResource( GLSL_FRAG1 ) ));
@@ -187,6 +200,7 @@ void VideoAudioVisualizerApp::setup()
         return;
     }
     
+    std::vector<Vec3f>      positions;
     std::vector<Colorf>     colors;
     std::vector<Vec2f>      coords;
     std::vector<uint32_t>	indices;
@@ -198,7 +212,7 @@ void VideoAudioVisualizerApp::setup()
             // add polygon indices
             if(h < kHeight-1 && w < kWidth-1)
             {
-                size_t offset = mVertices.size();
+                size_t offset = positions.size();
                 
                 indices.push_back(offset);
                 indices.push_back(offset+kWidth);
@@ -208,9 +222,8 @@ void VideoAudioVisualizerApp::setup()
                 indices.push_back(offset+1);
             }
             
-            // add vertex
-            float value = 80.0f * mPerlin.fBm(Vec3f(float(h), float(w), 0.f) * 0.005f);
-            mVertices.push_back( Vec3f(float(w), value, float(h)) );
+            // add vertex; the height comes from mHeightTexture in the vertex shader
+            positions.push_back( Vec3f(float(w), 0.0f, float(h)) );
             
             // add texture coordinates
             // note: we only want to draw the lower part of the frequency bands,
@@ -232,16 +245,39 @@ void VideoAudioVisualizerApp::setup()
     layout.setStaticIndices();
     layout.setStaticTexCoords2d();
     
-    mMesh = gl::VboMesh(mVertices.size(), indices.size(), layout, GL_TRIANGLES);
+    mMesh = gl::VboMesh(positions.size(), indices.size(), layout, GL_TRIANGLES);
     
-    mMesh.bufferPositions(mVertices);
+    mMesh.bufferPositions(positions);
     mMesh.bufferColorsRGB(colors);
     mMesh.bufferIndices(indices);
     mMesh.bufferTexCoords2d(0, coords);
     
+    // the terrain heights live in a ring of columns; scrolling overwrites the oldest one
+    mHeights = HeightfieldRing( kWidth, kHeight );
+    {
+        // one grid row per terrain column: row w holds fBm( ( h, w, 0 ) * 0.005 ) for every h
+        const float origin[3] = { 0.0f, 0.0f, 0.0f };
+        const float hStep[3] = { 0.005f, 0.0f, 0.0f };
+        const float wStep[3] = { 0.0f, 0.005f, 0.0f };
+        std::vector<float> grid(kWidth * kHeight);
+        mNoise.fractalGrid( origin, hStep, wStep, &grid[0], kHeight, kWidth, BatchNoise::FBM, BatchNoise::GRADIENT, 0 );
+        for(int w=0;w<kWidth;++w)
+            for(int h=0;h<kHeight;++h)
+                mHeights.setHeight( w, h, 80.0f * grid[w * kHeight + h] );
+    }
+    
+    gl::Texture::Format heightFormat;
+    heightFormat.setInternalFormat( GL_LUMINANCE32F_ARB );
+    heightFormat.setWrapS( GL_REPEAT );
+    heightFormat.setWrapT( GL_CLAMP_TO_EDGE );
+    heightFormat.setMinFilter( GL_NEAREST );
+    heightFormat.setMagFilter( GL_NEAREST );
+    mHeightTexture = gl::Texture::create( kWidth, kHeight, heightFormat );
+    uploadHeightColumns();
+    
     //    gl::VboMesh::VertexIter iter = mMesh.mapVertexBuffer();
     //    for( int idx = 0; idx < mMesh.getNumVertices(); ++idx ) {
-    //        iter.setPosition(mVertices [idx]);
+    //        iter.setPosition(positions [idx]);
     //        ++iter;
     //    }
     
@@ -261,11 +297,6 @@ void VideoAudioVisualizerApp::setup()
     mMouseUpDelay = 5.0;
     mMouseUpTime = getElapsedSeconds() - mMouseUpDelay;
     
-    // the texture offset has two purposes:
-    //  1) it tells us where to upload the next spectrum data
-    //  2) we use it to offset the texture coordinates in the shader for the scrolling effect
-    mOffset = 0;
-    
 //    mTextureSyphon.setName("Mic3d");
     
     setFrameRate(30.0f);
@@ -282,6 +313,7 @@ void VideoAudioVisualizerApp::setup()
     
 //    mCapture = Capture::create( 640, 480 );// mWidth, mHeight );
 //    mCapture->start();
+    mVideo = std::shared_ptr<VideoUploader>( new VideoUploader() );
     
     mTexture = gl::Texture::create( loadImage( loadResource( RES_LANDSCAPE_IMAGE) ) );
     
@@ -289,6 +321,7 @@ void VideoAudioVisualizerApp::setup()
     
     mParams = params::InterfaceGl( "Params", Vec2i( 200, 100 ) );
     mParams.addParam( "Frame rate",	&mFrameRate,"", true);
+    mParams.addParam( "Upload bytes",	&mUploadBytes,"", true);
     mParams.addParam("Time P", &mTimeParam);
     mParams.addParam( "Shader",	&mShaderNum,"min=0 max="+to_string(mShader.size())+" step=1", false);
     mParams.addParam( "Auto switch", &mAutomaticSwitch);
@@ -298,7 +331,7 @@ void VideoAudioVisualizerApp::setup()
 
 void VideoAudioVisualizerApp::shutdown()
 {
-    
+    mAnalyzer->stop();
 }
 
 void VideoAudioVisualizerApp::update()
@@ -306,27 +339,17 @@ void VideoAudioVisualizerApp::update()
     mFrameRate = getAverageFps();
  
     if( mCapture && mCapture->checkNewFrame() ) {
-        mTexture = gl::Texture::create( mCapture->getSurface() );
+        mVideo->submit( mCapture->getSurface() );
     }
+    if( mVideo->update() )
+        mTexture = mVideo->getTexture();
     
-    mMagSpectrum = mMonitorSpectralNode->getMagSpectrum();
+    const AudioFeatures &features = mAnalyzer->acquire();
+    const vector<float> &magSpectrum = features.mMagSpectrum;
     
     // get spectrum for left and right channels and copy it into our channels
-    float* pDataLeft = mChannelLeft.getData() + kBands * mOffset;
-    float* pDataRight = mChannelRight.getData() + kBands * mOffset;
-    
-    std::reverse_copy(mMagSpectrum.begin(), mMagSpectrum.end(), pDataLeft);
-    std::copy(mMagSpectrum.begin(), mMagSpectrum.end(), pDataRight);
-    
-    // increment texture offset
-    mOffset = (mOffset+1) % kHistory;
-    
-    // clear the spectrum for this row to avoid old data from showing up
-    ////NOT SURE THIS IS NEEDED -- the texture will be overwritten completely next time by data
-    //    pDataLeft = mChannelLeft.getData() + kBands * mOffset;
-    //    pDataRight = mChannelRight.getData() + kBands * mOffset;
-    //    memset( pDataLeft, 0, kBands * sizeof(float) );
-    //    memset( pDataRight, 0, kBands * sizeof(float) );
+    mHistoryLeft.pushRow( &magSpectrum[0], magSpectrum.size(), true );
+    mHistoryRight.pushRow( &magSpectrum[0], magSpectrum.size() );
     
     // animate camera if mouse has not been down for more than 30 seconds
     
@@ -348,31 +371,27 @@ void VideoAudioVisualizerApp::update()
         //cout<<interest<< " "<< (eye.lerp(0.995f, mCamera.getEyePoint()))<<endl;
         
         // gradually move to eye position and center of interest
-        float correction = 1.0 - 0.05*mMonitorSpectralNode->getVolume();
+        float correction = 1.0 - 0.05*features.mRms;
         mCamera.setEyePoint( eye.lerp(0.999f*correction, mCamera.getEyePoint()) );
         mCamera.setCenterOfInterestPoint( interest.lerp(0.999f*correction, mCamera.getCenterOfInterestPoint()) );
         
         
-        if (false && mAutomaticSwitch &&  (mMonitorSpectralNode->getVolume() < 0.001f || mMonitorSpectralNode->getVolume() > 0.5f)){
+        if (false && mAutomaticSwitch &&  (features.mRms < 0.001f || features.mRms > 0.5f)){
             mShaderNum = mShaderNum == mShader.size() - 1 ? 0 : mShaderNum + 1;
         }
     }
     
     mPerlinMove++;
     
-    for(size_t h = 0 ; h < kHeight; ++h) {
-        for(size_t w = 0 ; w < kWidth; ++w) {
-            size_t i = h * kWidth + w;
-            if (w < kWidth - 1) {
-                mVertices [i].y = mVertices [i+1].y;
-            } else {
-                float value = 80.0f*mPerlin.fBm(Vec3f(float(h+ mPerlinMove), float(w), 0.f)* 0.005f);
-                mVertices[i].y = value;
-            }
-        }
+    // only the new column is evaluated; it replaces the oldest one and the shader's offset wraps
+    const float origin[3] = { float(mPerlinMove) * 0.005f, float(kWidth - 1) * 0.005f, 0.0f };
+    const float step[3] = { 0.005f, 0.0f, 0.0f };
+    float *column = mHeights.getNextColumn();
+    mNoise.fractalLine( origin, step, column, kHeight );
+    for(int h = 0 ; h < kHeight; ++h) {
+        column[h] *= 80.0f;
     }
-    
-    mMesh.bufferPositions(mVertices);
+    mHeights.pushColumn();
     
     //    gl::VboMesh::VertexIter iter = mMesh.mapVertexBuffer();
     //    int w = 0;
@@ -409,7 +428,7 @@ void VideoAudioVisualizerApp::draw()
         
         // bind shader
         mShader[mShaderNum]->bind();
-        float offSt = mOffset / float(kHistory);
+        float offSt = mHistoryLeft.getTexOffset();
         mShader[mShaderNum]->uniform("uTexOffset", offSt);
         mShader[mShaderNum]->uniform("videoTex",0);
         mShader[mShaderNum]->uniform("uLeftTex", 1);
@@ -417,14 +436,20 @@ void VideoAudioVisualizerApp::draw()
         mShader[mShaderNum]->uniform("time", mTimeParam);
 
         mShader[mShaderNum]->uniform("resolution", 0.5f*(float)kWidth);
+        mShader[mShaderNum]->uniform("uHeightTex", 3);
+        mShader[mShaderNum]->uniform("uHeightOffset", mHeights.getOldestColumn() / float(kWidth));
+        mShader[mShaderNum]->uniform("uHeightSize", Vec2f(float(kWidth), float(kHeight)));
+        
+        // upload the rows written since the last frame and bind the textures
+        mUploadBytes = (int)( spectrogram::uploadDirtyRows( mHistoryLeft, mTextureLeft )
+                             + spectrogram::uploadDirtyRows( mHistoryRight, mTextureRight ) );
         
-        // create textures from our channels and bind them
-        mTextureLeft = gl::Texture::create(mChannelLeft, mTextureFormat);
-        mTextureRight = gl::Texture::create(mChannelRight, mTextureFormat);
+        uploadHeightColumns();
         
         mTexture->enableAndBind();
         mTextureLeft->bind(1);
         mTextureRight->bind(2);
+        mHeightTexture->bind(3);
 
         // draw mesh using additive blending
         gl::enableAdditiveBlending();
@@ -435,6 +460,7 @@ void VideoAudioVisualizerApp::draw()
         gl::disableAlphaBlending();
         
         // unbind textures and shader
+        mHeightTexture->unbind(3);
         mTextureRight->unbind();
         mTextureLeft->unbind();
         mTexture->unbind();
@@ -451,6 +477,20 @@ void VideoAudioVisualizerApp::draw()
     
 }
 
+void VideoAudioVisualizerApp::uploadHeightColumns()
+{
+    // one 1 x kHeight column per scroll step
+    glActiveTexture( GL_TEXTURE3 );
+    glBindTexture( mHeightTexture->getTarget(), mHeightTexture->getId() );
+    for(int i = 0; i < mHeights.getNumDirtyColumns(); ++i) {
+        int slot = mHeights.getDirtySlot( i );
+        glTexSubImage2D( mHeightTexture->getTarget(), 0, slot, 0, 1, kHeight, GL_LUMINANCE, GL_FLOAT, mHeights.getSlotData( slot ) );
+    }
+    glBindTexture( mHeightTexture->getTarget(), 0 );
+    glActiveTexture( GL_TEXTURE0 );
+    mHeights.markClean();
+}
+
 void VideoAudioVisualizerApp::mouseDown( MouseEvent event )
 {
     // handle mouse down
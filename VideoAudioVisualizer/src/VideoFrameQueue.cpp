@@ -0,0 +1,340 @@
+//
+//  VideoFrameQueue.cpp
+//
+
+#include "VideoFrameQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+	// x / 255 for every 8-bit x, as GL normalises it, in each target's type
+	struct Tables {
+		Tables()
+		{
+			for( int i = 0; i < 256; ++i ) {
+				mFloat[i] = i / 255.0f;
+				mHalf[i] = VideoFrameQueue::toHalf( mFloat[i] );
+			}
+		}
+
+		float		mFloat[256];
+		uint16_t	mHalf[256];
+	};
+
+	const Tables& getTables()
+	{
+		static Tables tables;
+		return tables;
+	}
+
+	template<typename T>
+	void convertRowTable( const VideoFrameQueue::Source &source, int y, T *dst, const T *table, T opaque )
+	{
+		const uint8_t *src = source.mData + y * source.mRowBytes;
+		const int inc = source.mPixelInc, w = source.mWidth;
+		const int r = source.mOffsets[0], g = source.mOffsets[1], b = source.mOffsets[2], a = source.mOffsets[3];
+		if( a < 0 ) {
+			for( int x = 0; x < w; ++x, src += inc, dst += 4 ) {
+				dst[0] = table[src[r]];
+				dst[1] = table[src[g]];
+				dst[2] = table[src[b]];
+				dst[3] = opaque;
+			}
+		}
+		else {
+			for( int x = 0; x < w; ++x, src += inc, dst += 4 ) {
+				dst[0] = table[src[r]];
+				dst[1] = table[src[g]];
+				dst[2] = table[src[b]];
+				dst[3] = table[src[a]];
+			}
+		}
+	}
+
+	// the 8-bit case needs no table
+	void convertRow8( const VideoFrameQueue::Source &source, int y, uint8_t *dst )
+	{
+		const uint8_t *src = source.mData + y * source.mRowBytes;
+		const int inc = source.mPixelInc, w = source.mWidth;
+		const int r = source.mOffsets[0], g = source.mOffsets[1], b = source.mOffsets[2], a = source.mOffsets[3];
+		for( int x = 0; x < w; ++x, src += inc, dst += 4 ) {
+			dst[0] = src[r];
+			dst[1] = src[g];
+			dst[2] = src[b];
+			dst[3] = a < 0 ? 255 : src[a];
+		}
+	}
+
+	size_t bytesPerValue( VideoFrameQueue::Target target )
+	{
+		switch( target ) {
+			case VideoFrameQueue::RGBA16F:	return sizeof( uint16_t );
+			case VideoFrameQueue::RGBA32F:	return sizeof( float );
+			default:						return 1;
+		}
+	}
+}
+
+VideoFrameQueue::VideoFrameQueue( Target target, size_t numBuffers, bool threaded )
+	: mTarget( target ), mBuffers( max( numBuffers, (size_t)2 ) ), mSerial( 0 ), mThreaded( threaded ), mQuit( false )
+{
+	getTables();
+	if( mThreaded )
+		mWorker = thread( &VideoFrameQueue::run, this );
+}
+
+VideoFrameQueue::~VideoFrameQueue()
+{
+	if( mThreaded ) {
+		{
+			lock_guard<mutex> lock( mMutex );
+			mQuit = true;
+		}
+		mWake.notify_one();
+		mWorker.join();
+	}
+}
+
+bool VideoFrameQueue::isDirect( const Source &source ) const
+{
+	if( mTarget != RGBA8 || source.mPixelInc != 4 || source.mRowBytes % 4 != 0 || source.mRowBytes < source.mWidth * 4 )
+		return false;
+	const int *o = source.mOffsets;
+	return o[1] == 1 && o[3] == 3 && ( ( o[0] == 0 && o[2] == 2 ) || ( o[0] == 2 && o[2] == 0 ) );
+}
+
+void VideoFrameQueue::submit( const Source &source )
+{
+	Buffer *buffer = 0;
+	{
+		lock_guard<mutex> lock( mMutex );
+		uint64_t serial = ++mSerial;
+		++mStats.mSubmitted;
+
+		// a frame still waiting for the worker is not worth converting any more
+		for( size_t i = 0; i < mBuffers.size(); ++i ) {
+			Buffer &b = mBuffers[i];
+			if( b.mState == PENDING ) {
+				b.mState = FREE;
+				b.mSource = Source();
+				++mStats.mReplaced;
+			}
+		}
+
+		// a free buffer, or else the oldest frame converted and not taken
+		for( size_t i = 0; i < mBuffers.size(); ++i ) {
+			Buffer &b = mBuffers[i];
+			if( b.mState == FREE ) {
+				buffer = &b;
+				break;
+			}
+			if( b.mState == READY && ( ! buffer || b.mSerial < buffer->mSerial ) )
+				buffer = &b;
+		}
+		if( ! buffer ) {
+			// one buffer converting and the rest uploading; this frame would only be late
+			++mStats.mReplaced;
+			return;
+		}
+		if( buffer->mState == READY )
+			++mStats.mSkipped;
+
+		buffer->mSerial = serial;
+		buffer->mSource = source;
+		buffer->mDirect = isDirect( source );
+		if( buffer->mDirect ) {
+			buffer->mState = READY;
+			++mStats.mPassedThrough;
+			return;
+		}
+		buffer->mState = mThreaded ? PENDING : CONVERTING;
+	}
+
+	if( mThreaded ) {
+		mWake.notify_one();
+	}
+	else {
+		convert( *buffer );
+		lock_guard<mutex> lock( mMutex );
+		buffer->mState = READY;
+		buffer->mSource.mOwner.reset();
+		++mStats.mConverted;
+	}
+}
+
+bool VideoFrameQueue::take( Frame *frame )
+{
+	lock_guard<mutex> lock( mMutex );
+	Buffer *newest = 0;
+	for( size_t i = 0; i < mBuffers.size(); ++i ) {
+		Buffer &b = mBuffers[i];
+		if( b.mState == TAKEN ) {
+			// not released; it is done with now anyway
+			b.mState = FREE;
+			b.mSource = Source();
+		}
+		else if( b.mState == READY && ( ! newest || b.mSerial > newest->mSerial ) ) {
+			newest = &b;
+		}
+	}
+	if( ! newest )
+		return false;
+
+	for( size_t i = 0; i < mBuffers.size(); ++i ) {
+		Buffer &b = mBuffers[i];
+		if( b.mState == READY && &b != newest ) {
+			b.mState = FREE;
+			b.mSource = Source();
+			++mStats.mSkipped;
+		}
+	}
+
+	newest->mState = TAKEN;
+	++mStats.mTaken;
+	const Source &s = newest->mSource;
+	frame->mWidth = s.mWidth;
+	frame->mHeight = s.mHeight;
+	frame->mSerial = newest->mSerial;
+	if( newest->mDirect ) {
+		frame->mData = s.mData;
+		frame->mRowPixels = s.mRowBytes / 4;
+		frame->mBgra = s.mOffsets[0] == 2;
+	}
+	else {
+		frame->mData = &newest->mPixels[0];
+		frame->mRowPixels = s.mWidth;
+		frame->mBgra = false;
+	}
+	return true;
+}
+
+void VideoFrameQueue::release()
+{
+	lock_guard<mutex> lock( mMutex );
+	for( size_t i = 0; i < mBuffers.size(); ++i ) {
+		Buffer &b = mBuffers[i];
+		if( b.mState == TAKEN ) {
+			b.mState = FREE;
+			b.mSource = Source();
+		}
+	}
+}
+
+void VideoFrameQueue::wait()
+{
+	unique_lock<mutex> lock( mMutex );
+	for(;;) {
+		bool busy = false;
+		for( size_t i = 0; i < mBuffers.size(); ++i )
+			busy = busy || mBuffers[i].mState == PENDING || mBuffers[i].mState == CONVERTING;
+		if( ! busy )
+			return;
+		mIdle.wait( lock );
+	}
+}
+
+VideoFrameQueue::Stats VideoFrameQueue::getStats()
+{
+	lock_guard<mutex> lock( mMutex );
+	return mStats;
+}
+
+void VideoFrameQueue::convert( Buffer &buffer )
+{
+	const Source &source = buffer.mSource;
+	size_t rowBytes = (size_t)source.mWidth * 4 * bytesPerValue( mTarget );
+	buffer.mPixels.resize( rowBytes * source.mHeight );
+	for( int y = 0; y < source.mHeight; ++y ) {
+		uint8_t *dst = &buffer.mPixels[y * rowBytes];
+		switch( mTarget ) {
+			case RGBA16F:	convertRow( source, y, (uint16_t *)dst );	break;
+			case RGBA32F:	convertRow( source, y, (float *)dst );		break;
+			default:		convertRow( source, y, dst );				break;
+		}
+	}
+}
+
+void VideoFrameQueue::run()
+{
+	for(;;) {
+		Buffer *buffer = 0;
+		{
+			unique_lock<mutex> lock( mMutex );
+			while( ! mQuit ) {
+				for( size_t i = 0; i < mBuffers.size() && ! buffer; ++i )
+					if( mBuffers[i].mState == PENDING )
+						buffer = &mBuffers[i];
+				if( buffer )
+					break;
+				mWake.wait( lock );
+			}
+			if( mQuit )
+				return;
+			buffer->mState = CONVERTING;
+		}
+
+		// submit() leaves a converting buffer alone, so its source stays put
+		convert( *buffer );
+
+		{
+			lock_guard<mutex> lock( mMutex );
+			buffer->mState = READY;
+			buffer->mSource.mOwner.reset();
+			++mStats.mConverted;
+		}
+		mIdle.notify_all();
+	}
+}
+
+void VideoFrameQueue::convertRow( const Source &source, int y, uint8_t *dst )
+{
+	convertRow8( source, y, dst );
+}
+
+void VideoFrameQueue::convertRow( const Source &source, int y, uint16_t *dst )
+{
+	const Tables &tables = getTables();
+	convertRowTable( source, y, dst, tables.mHalf, tables.mHalf[255] );
+}
+
+void VideoFrameQueue::convertRow( const Source &source, int y, float *dst )
+{
+	const Tables &tables = getTables();
+	convertRowTable( source, y, dst, tables.mFloat, 1.0f );
+}
+
+uint16_t VideoFrameQueue::toHalf( float value )
+{
+	uint32_t bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+	uint32_t sign = ( bits >> 16 ) & 0x8000;
+	uint32_t mantissa = bits & 0x7fffff;
+	int exponent = (int)( ( bits >> 23 ) & 0xff ) - 127 + 15;
+
+	if( ( bits & 0x7fffffff ) >= 0x7f800000 )
+		return (uint16_t)( sign | 0x7c00 | ( mantissa ? 0x200 : 0 ) );
+	if( exponent >= 31 )
+		return (uint16_t)( sign | 0x7c00 );
+	if( exponent <= 0 ) {
+		// subnormal: the implicit one joins the mantissa, shifted down to the half's scale
+		if( exponent < -10 )
+			return (uint16_t)sign;
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ( ( 1u << shift ) - 1 ), middle = 1u << ( shift - 1 );
+		if( rest > middle || ( rest == middle && ( half & 1 ) ) )
+			++half;
+		return (uint16_t)( sign | half );
+	}
+
+	// a carry out of the mantissa moves into the exponent, up to infinity, as it should
+	uint32_t half = ( (uint32_t)exponent << 10 ) | ( mantissa >> 13 );
+	uint32_t rest = mantissa & 0x1fff;
+	if( rest > 0x1000 || ( rest == 0x1000 && ( half & 1 ) ) )
+		++half;
+	return (uint16_t)( sign | half );
+}
@@ -0,0 +1,512 @@
+//
+//  ParticleEngine.cpp
+//
+
+#include "ParticleEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+	const int		TILE_ROWS = 8;		// particle rows handed to a thread at a time
+	const int		CHUNK = 256;		// particles whose field samples are gathered before they are updated
+	const char		MAGIC[4] = { 'P', 'T', 'R', 'C' };
+	const int32_t	VERSION = 1;
+	const int32_t	HALF_FLOAT = 1, ROWS_FLIPPED = 2;
+
+	void copyImage( vector<float> &dst, const float *src, int width, int height, size_t rowStride, bool half, bool flip = false )
+	{
+		size_t rowFloats = (size_t)width * 4;
+		for( int y = 0; y < height; ++y ) {
+			float *row = &dst[y * rowFloats];
+			memcpy( row, src + ( flip ? height - 1 - y : y ) * rowStride, rowFloats * sizeof( float ) );
+			if( half ) {
+				for( size_t i = 0; i < rowFloats; ++i )
+					row[i] = ParticleEngine::roundHalf( row[i] );
+			}
+		}
+	}
+
+	// the selects below are done on the bits: compilers will not turn float compares and ternaries into
+	// vector blends under the default ( trapping ) float model, but they will vectorise integer masks
+	inline uint32_t bitsOf( float value )				{ uint32_t bits; memcpy( &bits, &value, sizeof( bits ) ); return bits; }
+	inline float floatOf( uint32_t bits )				{ float value; memcpy( &value, &bits, sizeof( value ) ); return value; }
+	inline uint32_t maskOf( bool condition )			{ return 0u - (uint32_t)condition; }
+	inline float pick( uint32_t mask, float a, float b )	{ return floatOf( ( bitsOf( a ) & mask ) | ( bitsOf( b ) & ~mask ) ); }
+
+	// shdrVelF.glsl for \a count particles, given the texNoise2 samples for each
+	void stepParticles( int count, const float * __restrict samples, float speed, float direction,
+						const float * __restrict pos, const float * __restrict vel, const float * __restrict info,
+						const float * __restrict oPos, const float * __restrict oVel,
+						float * __restrict outPos, float * __restrict outVel, float * __restrict outInfo )
+	{
+		for( int i = 0; i < count; ++i ) {
+			const int j = i * 4;
+			float noiseX = 0.001f * ( ( samples[i * 2] - 0.5f ) * direction );
+			float noiseY = 0.001f * ( samples[i * 2 + 1] - 0.5f );
+			float vx = vel[j] + noiseX * speed;
+			float vy = vel[j + 1] + noiseY * speed;
+			float px = pos[j] + vx;
+			float py = pos[j + 1] + vy;
+			float age = info[j] + 0.01f;
+
+			// age wraps: velocity goes back to its origin, and so does a position that left the unit square
+			uint32_t respawn = maskOf( age >= 1.0f );
+			uint32_t back = respawn & maskOf( ( px > 1.0f ) | ( px < 0.0f ) | ( py > 1.0f ) | ( py < 0.0f ) );
+			float vz = pick( respawn, oVel[j + 2], vel[j + 2] );
+
+			outPos[j] = pick( back, oPos[j], px );
+			outPos[j + 1] = pick( back, oPos[j + 1], py );
+			outPos[j + 2] = pick( back, oPos[j + 2], pos[j + 2] );
+			outPos[j + 3] = pos[j + 3];
+			outVel[j] = pick( respawn, oVel[j], vx );
+			outVel[j + 1] = pick( respawn, oVel[j + 1], vy );
+			outVel[j + 2] = vz;
+			outVel[j + 3] = vel[j + 3];
+			outInfo[j] = pick( respawn, 0.0f, age );
+			outInfo[j + 1] = info[j + 1];
+			outInfo[j + 2] = vz;
+			outInfo[j + 3] = 1.0f;
+		}
+	}
+
+	void roundHalfRow( float * __restrict values, int count )
+	{
+		for( int i = 0; i < count; ++i )
+			values[i] = ParticleEngine::roundHalf( values[i] );
+	}
+}
+
+ParticleEngine::ParticleEngine( int width, int height, int numThreads )
+	: mWidth( width ), mHeight( height ), mHalfFloat( false ), mRowsFlipped( false ), mSpeed( 0.0f ), mDirection( 1.0f ), mCurrent( 0 ),
+	mGeneration( 0 ), mNumBusy( 0 ), mNextTile( 0 ), mQuit( false )
+{
+	size_t count = (size_t)width * height * 4;
+	for( int i = 0; i < 2; ++i ) {
+		mPositions[i].resize( count );
+		mVelocities[i].resize( count );
+		mInformation[i].resize( count );
+	}
+	mOriginPositions.resize( count );
+	mOriginVelocities.resize( count );
+
+	if( numThreads <= 0 )
+		numThreads = max( (int)thread::hardware_concurrency(), 1 );
+	numThreads = min( numThreads, max( ( height + TILE_ROWS - 1 ) / TILE_ROWS, 1 ) );
+	for( int i = 1; i < numThreads; ++i )
+		mWorkers.push_back( thread( &ParticleEngine::run, this ) );
+}
+
+ParticleEngine::~ParticleEngine()
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		mQuit = true;
+	}
+	mWake.notify_all();
+	for( size_t i = 0; i < mWorkers.size(); ++i )
+		mWorkers[i].join();
+}
+
+float ParticleEngine::roundHalf( float value )
+{
+	uint32_t bits = bitsOf( value );
+	uint32_t sign = bits & 0x80000000u, abs = bits & 0x7fffffffu;
+	float magnitude = floatOf( abs );
+	// Veltkamp's split: the high part keeps 24 - 13 = 11 significant bits, rounded to nearest even
+	float split = magnitude * 8193.0f;
+	uint32_t normal = bitsOf( split - ( split - magnitude ) );
+	// below 2^-14 halves are multiples of 2^-24, which is the ulp of 0.5f
+	uint32_t subnormal = bitsOf( ( magnitude + 0.5f ) - 0.5f );
+
+	uint32_t tiny = maskOf( abs < 0x38800000u ), huge = maskOf( abs >= 0x477ff000u ), nan = maskOf( abs > 0x7f800000u );
+	uint32_t result = ( subnormal & tiny ) | ( normal & ~tiny );
+	result = ( 0x7f800000u & huge ) | ( result & ~huge );		// 65520 and up round past 65504, the largest half
+	result = ( abs & nan ) | ( result & ~nan );
+	return floatOf( result | sign );
+}
+
+void ParticleEngine::reset( const float *positions, const float *velocities, const float *information, size_t rowStride )
+{
+	copyImage( mOriginPositions, positions, mWidth, mHeight, rowStride, false );
+	copyImage( mOriginVelocities, velocities, mWidth, mHeight, rowStride, false );
+	copyImage( mPositions[mCurrent], positions, mWidth, mHeight, rowStride, mHalfFloat, mRowsFlipped );
+	copyImage( mVelocities[mCurrent], velocities, mWidth, mHeight, rowStride, mHalfFloat, mRowsFlipped );
+	copyImage( mInformation[mCurrent], information, mWidth, mHeight, rowStride, mHalfFloat, mRowsFlipped );
+}
+
+void ParticleEngine::setState( const float *positions, const float *velocities, const float *information, size_t rowStride )
+{
+	copyImage( mPositions[mCurrent], positions, mWidth, mHeight, rowStride, mHalfFloat );
+	copyImage( mVelocities[mCurrent], velocities, mWidth, mHeight, rowStride, mHalfFloat );
+	copyImage( mInformation[mCurrent], information, mWidth, mHeight, rowStride, mHalfFloat );
+}
+
+void ParticleEngine::setField( const uint8_t *red, const uint8_t *green, int width, int height, ptrdiff_t rowBytes, int increment, Wrap wrap, Filter filter )
+{
+	mField.mData.resize( (size_t)width * height * 2 );
+	for( int y = 0; y < height; ++y ) {
+		const uint8_t *r = red + y * rowBytes, *g = green + y * rowBytes;
+		float *dst = &mField.mData[(size_t)y * width * 2];
+		for( int x = 0; x < width; ++x ) {
+			dst[x * 2] = r[x * increment] / 255.0f;
+			dst[x * 2 + 1] = g[x * increment] / 255.0f;
+		}
+	}
+	mField.mWidth = width;
+	mField.mHeight = height;
+	mField.mWrap = wrap;
+	mField.mFilter = filter;
+	++mField.mVersion;
+}
+
+void ParticleEngine::setField( const float *data, int width, int height, size_t rowStride, int channels, Wrap wrap, Filter filter )
+{
+	mField.mData.resize( (size_t)width * height * 2 );
+	int green = channels > 1 ? 1 : 0;
+	for( int y = 0; y < height; ++y ) {
+		const float *src = data + y * rowStride;
+		float *dst = &mField.mData[(size_t)y * width * 2];
+		for( int x = 0; x < width; ++x ) {
+			dst[x * 2] = src[x * channels];
+			dst[x * 2 + 1] = src[x * channels + green];
+		}
+	}
+	mField.mWidth = width;
+	mField.mHeight = height;
+	mField.mWrap = wrap;
+	mField.mFilter = filter;
+	++mField.mVersion;
+}
+
+void ParticleEngine::sampleField( const float *positions, float *samples, int count ) const
+{
+	const Field &f = mField;
+	if( f.mWidth == 0 || f.mHeight == 0 ) {
+		// an unbound sampler reads black
+		for( int i = 0; i < count * 2; ++i )
+			samples[i] = 0.0f;
+		return;
+	}
+
+	const float *data = &f.mData[0];
+	const int w = f.mWidth, h = f.mHeight;
+	const float fw = (float)w, fh = (float)h;
+	const bool repeat = f.mWrap == REPEAT;
+
+	if( f.mFilter == NEAREST ) {
+		for( int i = 0; i < count; ++i ) {
+			float s = positions[i * 4], t = 1.0f - positions[i * 4 + 1];
+			if( repeat ) {
+				s -= floorf( s );
+				t -= floorf( t );
+			}
+			int x = (int)min( max( s * fw, 0.0f ), fw - 1.0f );
+			int y = (int)min( max( t * fh, 0.0f ), fh - 1.0f );
+			const float *texel = data + ( (size_t)y * w + x ) * 2;
+			samples[i * 2] = texel[0];
+			samples[i * 2 + 1] = texel[1];
+		}
+		return;
+	}
+
+	for( int i = 0; i < count; ++i ) {
+		float s = positions[i * 4], t = 1.0f - positions[i * 4 + 1];
+		if( repeat ) {
+			s -= floorf( s );
+			t -= floorf( t );
+		}
+		// texel centres sit at half coordinates; clamping first keeps the indices small
+		float fx = min( max( s * fw - 0.5f, -1.0f ), fw ), fy = min( max( t * fh - 0.5f, -1.0f ), fh );
+		float x0f = floorf( fx ), y0f = floorf( fy );
+		float a = fx - x0f, b = fy - y0f;
+		int x0 = (int)x0f, y0 = (int)y0f, x1 = x0 + 1, y1 = y0 + 1;
+		if( repeat ) {
+			if( x0 < 0 ) x0 += w;
+			if( y0 < 0 ) y0 += h;
+			if( x1 >= w ) x1 -= w;
+			if( y1 >= h ) y1 -= h;
+		}
+		else {
+			x0 = min( max( x0, 0 ), w - 1 );
+			y0 = min( max( y0, 0 ), h - 1 );
+			x1 = min( x1, w - 1 );
+			y1 = min( y1, h - 1 );
+		}
+		const float *t00 = data + ( (size_t)y0 * w + x0 ) * 2, *t10 = data + ( (size_t)y0 * w + x1 ) * 2;
+		const float *t01 = data + ( (size_t)y1 * w + x0 ) * 2, *t11 = data + ( (size_t)y1 * w + x1 ) * 2;
+		for( int c = 0; c < 2; ++c ) {
+			float top = t00[c] + ( t10[c] - t00[c] ) * a;
+			float bottom = t01[c] + ( t11[c] - t01[c] ) * a;
+			samples[i * 2 + c] = top + ( bottom - top ) * b;
+		}
+	}
+}
+
+void ParticleEngine::stepRows( int begin, int end )
+{
+	const int next = 1 - mCurrent;
+	const size_t rowFloats = (size_t)mWidth * 4;
+	const float speed = mSpeed, direction = mDirection;
+	float samples[CHUNK * 2];
+
+	for( int y = begin; y < end; ++y ) {
+		size_t rowStart = y * rowFloats, sourceStart = ( mRowsFlipped ? mHeight - 1 - y : y ) * rowFloats;
+		for( int x0 = 0; x0 < mWidth; x0 += CHUNK ) {
+			int n = min( CHUNK, mWidth - x0 );
+			size_t offset = rowStart + (size_t)x0 * 4, source = sourceStart + (size_t)x0 * 4;
+			const float *pos = &mPositions[mCurrent][source], *vel = &mVelocities[mCurrent][source], *info = &mInformation[mCurrent][source];
+			const float *oPos = &mOriginPositions[source], *oVel = &mOriginVelocities[source];
+			float *outPos = &mPositions[next][offset], *outVel = &mVelocities[next][offset], *outInfo = &mInformation[next][offset];
+
+			sampleField( pos, samples, n );
+
+			stepParticles( n, samples, speed, direction, pos, vel, info, oPos, oVel, outPos, outVel, outInfo );
+			if( mHalfFloat ) {
+				roundHalfRow( outPos, n * 4 );
+				roundHalfRow( outVel, n * 4 );
+				roundHalfRow( outInfo, n * 4 );
+			}
+		}
+	}
+}
+
+void ParticleEngine::runTiles()
+{
+	for(;;) {
+		int tile;
+		{
+			lock_guard<mutex> lock( mMutex );
+			tile = mNextTile++;
+		}
+		int begin = tile * TILE_ROWS;
+		if( begin >= mHeight )
+			return;
+		stepRows( begin, min( begin + TILE_ROWS, mHeight ) );
+	}
+}
+
+void ParticleEngine::run()
+{
+	uint32_t generation = 0;
+	for(;;) {
+		{
+			unique_lock<mutex> lock( mMutex );
+			while( mGeneration == generation && ! mQuit )
+				mWake.wait( lock );
+			if( mQuit )
+				return;
+			generation = mGeneration;
+		}
+		runTiles();
+		{
+			lock_guard<mutex> lock( mMutex );
+			if( --mNumBusy == 0 )
+				mDone.notify_one();
+		}
+	}
+}
+
+void ParticleEngine::step( float speed, float direction )
+{
+	mSpeed = speed;
+	mDirection = direction;
+
+	if( mWorkers.empty() )
+		stepRows( 0, mHeight );
+	else {
+		{
+			lock_guard<mutex> lock( mMutex );
+			mNextTile = 0;
+			mNumBusy = (int)mWorkers.size();
+			++mGeneration;
+		}
+		mWake.notify_all();
+		runTiles();
+
+		unique_lock<mutex> lock( mMutex );
+		while( mNumBusy > 0 )
+			mDone.wait( lock );
+	}
+	mCurrent = 1 - mCurrent;
+}
+
+ParticleEngine::Difference ParticleEngine::compare( const float *positions, const float *velocities, const float *information, size_t rowStride, float tolerance ) const
+{
+	Difference difference;
+	const float *mine[3] = { getPositions(), getVelocities(), getInformation() };
+	const float *theirs[3] = { positions, velocities, information };
+	const size_t rowFloats = (size_t)mWidth * 4;
+
+	for( int k = 0; k < 3; ++k ) {
+		for( int y = 0; y < mHeight; ++y ) {
+			const float *a = mine[k] + y * rowFloats, *b = theirs[k] + y * rowStride;
+			for( size_t i = 0; i < rowFloats; ++i ) {
+				float error = fabsf( a[i] - b[i] );
+				// a nan on either side counts as over and sticks as the worst
+				if( ! ( error <= tolerance ) )
+					++difference.mNumOver;
+				if( error > difference.mMaxError[k] || ( error != error && difference.mMaxError[k] == difference.mMaxError[k] ) ) {
+					difference.mMaxError[k] = error;
+					difference.mWorst[k] = (size_t)y * mWidth + i / 4;
+				}
+			}
+		}
+	}
+	return difference;
+}
+
+ParticleRecording::ParticleRecording()
+	: mWriting( false ), mWidth( 0 ), mHeight( 0 ), mFlags( 0 ), mFieldWritten( false ), mFieldVersion( 0 )
+{
+}
+
+bool ParticleRecording::writeImage( const float *pixels, size_t rowStride )
+{
+	size_t rowFloats = (size_t)mWidth * 4;
+	for( int y = 0; y < mHeight; ++y )
+		mFile.write( reinterpret_cast<const char*>( pixels + y * rowStride ), rowFloats * sizeof( float ) );
+	return mFile.good();
+}
+
+bool ParticleRecording::readFloats( vector<float> &values, size_t count )
+{
+	values.resize( count );
+	mFile.read( reinterpret_cast<char*>( &values[0] ), count * sizeof( float ) );
+	return mFile.good();
+}
+
+bool ParticleRecording::create( const string &path, const ParticleEngine &engine,
+								const float *positions, const float *velocities, const float *information, size_t rowStride )
+{
+	close();
+	mFile.open( path.c_str(), ios::out | ios::binary | ios::trunc );
+	if( ! mFile.is_open() )
+		return false;
+
+	mWriting = true;
+	mWidth = engine.getWidth();
+	mHeight = engine.getHeight();
+	mFieldWritten = false;
+
+	int32_t flags = ( engine.isHalfFloat() ? HALF_FLOAT : 0 ) | ( engine.isRowsFlipped() ? ROWS_FLIPPED : 0 );
+	int32_t header[4] = { VERSION, mWidth, mHeight, flags };
+	mFile.write( MAGIC, sizeof( MAGIC ) );
+	mFile.write( reinterpret_cast<const char*>( header ), sizeof( header ) );
+	writeImage( engine.getOriginPositions(), (size_t)mWidth * 4 );
+	writeImage( engine.getOriginVelocities(), (size_t)mWidth * 4 );
+	writeImage( positions, rowStride );
+	writeImage( velocities, rowStride );
+	return writeImage( information, rowStride );
+}
+
+bool ParticleRecording::append( float speed, float direction, const ParticleEngine::Field &field,
+								const float *positions, const float *velocities, const float *information, size_t rowStride )
+{
+	if( ! mFile.is_open() || ! mWriting )
+		return false;
+
+	float uniforms[2] = { speed, direction };
+	int32_t hasField = ! mFieldWritten || field.mVersion != mFieldVersion;
+	mFile.write( reinterpret_cast<const char*>( uniforms ), sizeof( uniforms ) );
+	mFile.write( reinterpret_cast<const char*>( &hasField ), sizeof( hasField ) );
+	if( hasField ) {
+		int32_t format[4] = { field.mWidth, field.mHeight, field.mWrap, field.mFilter };
+		mFile.write( reinterpret_cast<const char*>( format ), sizeof( format ) );
+		if( ! field.mData.empty() )
+			mFile.write( reinterpret_cast<const char*>( &field.mData[0] ), field.mData.size() * sizeof( float ) );
+		mFieldWritten = true;
+		mFieldVersion = field.mVersion;
+	}
+	writeImage( positions, rowStride );
+	writeImage( velocities, rowStride );
+	return writeImage( information, rowStride );
+}
+
+bool ParticleRecording::open( const string &path )
+{
+	close();
+	mFile.open( path.c_str(), ios::in | ios::binary );
+	if( ! mFile.is_open() )
+		return false;
+
+	char magic[4];
+	int32_t header[4];
+	mFile.read( magic, sizeof( magic ) );
+	mFile.read( reinterpret_cast<char*>( header ), sizeof( header ) );
+	if( ! mFile.good() || memcmp( magic, MAGIC, sizeof( MAGIC ) ) != 0 || header[0] != VERSION || header[1] <= 0 || header[2] <= 0 ) {
+		close();
+		return false;
+	}
+	mWriting = false;
+	mWidth = header[1];
+	mHeight = header[2];
+	mFlags = header[3];
+	return true;
+}
+
+void ParticleRecording::close()
+{
+	if( mFile.is_open() )
+		mFile.close();
+	mFile.clear();
+	mWriting = false;
+}
+
+bool ParticleRecording::start( ParticleEngine &engine )
+{
+	if( ! mFile.is_open() || mWriting || engine.getWidth() != mWidth || engine.getHeight() != mHeight )
+		return false;
+
+	size_t count = (size_t)mWidth * mHeight * 4;
+	size_t rowStride = (size_t)mWidth * 4;
+	vector<float> originPositions, originVelocities;
+	mFile.clear();
+	mFile.seekg( sizeof( MAGIC ) + 4 * sizeof( int32_t ) );
+	if( ! readFloats( originPositions, count ) || ! readFloats( originVelocities, count )
+		|| ! readFloats( mPositions, count ) || ! readFloats( mVelocities, count ) || ! readFloats( mInformation, count ) )
+		return false;
+
+	engine.setHalfFloat( ( mFlags & HALF_FLOAT ) != 0 );
+	engine.setRowsFlipped( ( mFlags & ROWS_FLIPPED ) != 0 );
+	engine.reset( &originPositions[0], &originVelocities[0], &mInformation[0], rowStride );
+	engine.setState( &mPositions[0], &mVelocities[0], &mInformation[0], rowStride );
+	return true;
+}
+
+bool ParticleRecording::next( ParticleEngine &engine, float tolerance, ParticleEngine::Difference *difference )
+{
+	if( ! mFile.is_open() || mWriting )
+		return false;
+
+	float uniforms[2];
+	int32_t hasField;
+	mFile.read( reinterpret_cast<char*>( uniforms ), sizeof( uniforms ) );
+	mFile.read( reinterpret_cast<char*>( &hasField ), sizeof( hasField ) );
+	if( ! mFile.good() )
+		return false;
+
+	if( hasField ) {
+		int32_t format[4];
+		mFile.read( reinterpret_cast<char*>( format ), sizeof( format ) );
+		if( ! mFile.good() || format[0] < 0 || format[1] < 0 )
+			return false;
+		size_t count = (size_t)format[0] * format[1] * 2;
+		if( count > 0 && ! readFloats( mFieldData, count ) )
+			return false;
+		engine.setField( count > 0 ? &mFieldData[0] : (const float*)0, format[0], format[1], (size_t)format[0] * 2, 2,
+						 (ParticleEngine::Wrap)format[2], (ParticleEngine::Filter)format[3] );
+	}
+
+	size_t count = (size_t)mWidth * mHeight * 4;
+	if( ! readFloats( mPositions, count ) || ! readFloats( mVelocities, count ) || ! readFloats( mInformation, count ) )
+		return false;
+
+	engine.step( uniforms[0], uniforms[1] );
+	if( difference )
+		*difference = engine.compare( &mPositions[0], &mVelocities[0], &mInformation[0], (size_t)mWidth * 4, tolerance );
+	return true;
+}
@@ -18,6 +18,8 @@
 #include "cinderSyphon.h"
 
 #include "Resources.h"
+#include "ParticleEngine.h"
+#include "VideoUploader.h"
 
 #include "CinderFreenect.h"
 
@@ -47,6 +49,9 @@ public:
 	void loadShaders();
     void initCapture();
     void drawVideo();
+	void readAttachments(gl::Fbo &fbo);
+	void writeAttachments(gl::Fbo &fbo);
+	void toggleRecording();
 	
 private:
 	int m_pos;
@@ -91,6 +96,14 @@ private:
 
     CaptureRef			mCapture;
     gl::TextureRef		mTexture;
+    // frames go up into the same couple of textures rather than a new one each
+    std::shared_ptr<VideoUploader>	mVideo;
+	
+	// the same simulation on the CPU; 'c' swaps it in for the shader, 'r' records the shader's frames for it
+	std::shared_ptr<ParticleEngine> m_engine;
+	ParticleRecording m_recording;
+	bool m_cpuParticles;
+	vector<float> m_attachments[3];
 };
 
 void VideoToParticles::initFbo()
@@ -169,6 +182,7 @@ void VideoToParticles::initCapture(){
 	try {
 		mCapture = Capture::create( 640, 480 );
 		mCapture->start();
+		mVideo = std::shared_ptr<VideoUploader>( new VideoUploader() );
 	}
 	catch( ... ) {
 		console() << "Failed to initialize capture" << std::endl;
@@ -237,6 +251,17 @@ void VideoToParticles::setup()
 	
 	GLenum interp = GL_NEAREST;
 	
+	// the quad and initFbo() draw with the window's upper-left origin, so every pass reads the attachments upside down
+	size_t rowStride = posSurf.getRowBytes() / sizeof(float);
+	m_engine = make_shared<ParticleEngine>(PARTICLES, PARTICLES);
+	m_engine->setHalfFloat(true);
+	m_engine->setRowsFlipped(true);
+	m_engine->reset(posSurf.getData(), velSurf.getData(), infoSurf.getData(), rowStride);
+	m_engine->setField(noiseSurf.getData(), PARTICLES, PARTICLES, noiseSurf.getRowBytes() / sizeof(float), 4, ParticleEngine::REPEAT, ParticleEngine::NEAREST);
+	m_cpuParticles = false;
+	for (int i = 0; i < 3; i++)
+		m_attachments[i].resize(PARTICLES * PARTICLES * 4);
+	
 	m_texNoise = gl::Texture(noiseSurf, tFormatSmall);
 	m_texNoise.setWrap(GL_REPEAT, GL_REPEAT);
 	m_texNoise.setMinFilter(interp);
@@ -279,7 +304,8 @@ void VideoToParticles::setup()
 	
 	m_fboSy = gl::Fbo(SYWIDTH, SYHEIGHT, format2);
 	
-	//initFbo();
+	// seeds both FBOs from the textures and sets which one is read first
+	initFbo();
 	
 	vector<Vec2f> texCoords;
 	vector<Vec3f> vertCoords, normCoords;
@@ -352,20 +378,90 @@ void VideoToParticles::keyDown( KeyEvent event)
 	{
 		m_createParticles = true;
 	}
+	else if (event.getChar() == 'c')
+	{
+		// carry on from whatever the shader wrote last
+		if (!m_cpuParticles)
+		{
+			readAttachments(m_fbo[m_bufferOut]);
+			m_engine->setState(&m_attachments[0][0], &m_attachments[1][0], &m_attachments[2][0], PARTICLES * 4);
+		}
+		m_cpuParticles = !m_cpuParticles;
+	}
+	else if (event.getChar() == 'r')
+	{
+		toggleRecording();
+	}
+}
+
+void VideoToParticles::readAttachments(gl::Fbo &fbo)
+{
+	fbo.bindFramebuffer();
+	for (int i = 0; i < 3; i++)
+	{
+		glReadBuffer(GL_COLOR_ATTACHMENT0_EXT + i);
+		glReadPixels(0, 0, PARTICLES, PARTICLES, GL_RGBA, GL_FLOAT, &m_attachments[i][0]);
+	}
+	fbo.unbindFramebuffer();
+}
+
+void VideoToParticles::writeAttachments(gl::Fbo &fbo)
+{
+	const float *data[3] = { m_engine->getPositions(), m_engine->getVelocities(), m_engine->getInformation() };
+	for (int i = 0; i < 3; i++)
+	{
+		gl::Texture &tex = fbo.getTexture(i);
+		tex.bind();
+		glTexSubImage2D(tex.getTarget(), 0, 0, 0, PARTICLES, PARTICLES, GL_RGBA, GL_FLOAT, data[i]);
+		tex.unbind();
+	}
+}
+
+void VideoToParticles::toggleRecording()
+{
+	if (m_recording.isOpen())
+	{
+		m_recording.close();
+		console() << "Stopped recording particles" << std::endl;
+		return;
+	}
+	
+	string path = (getHomeDirectory() / "VideoToParticles.ptrc").string();
+	readAttachments(m_fbo[m_bufferOut]);
+	if (m_recording.create(path, *m_engine, &m_attachments[0][0], &m_attachments[1][0], &m_attachments[2][0], PARTICLES * 4))
+		console() << "Recording particles to " << path << std::endl;
+	else
+		console() << "Unable to record particles to " << path << std::endl;
 }
 
 void VideoToParticles::update()
 {
     if( mCapture && mCapture->checkNewFrame() ) {
-		mTexture = gl::Texture::create( mCapture->getSurface() );
+		Surface8u frame = mCapture->getSurface();
+		mVideo->submit( frame );
+		// kept current even while the shader runs, so 'c' and 'r' pick up the frame it is using
+		m_engine->setField( frame.getDataRed(), frame.getDataGreen(), frame.getWidth(), frame.getHeight(),
+						   frame.getRowBytes(), frame.getPixelInc(), ParticleEngine::CLAMP, ParticleEngine::LINEAR );
 	}
-    return;
+	if( mVideo && mVideo->update() )
+		mTexture = mVideo->getTexture();
+	
 	// we don't need to update the kinect every frame, it doesn't make much difference in appearance
 //	if (getElapsedFrames() % 2 == 0 && m_kinect->checkNewDepthFrame())
 //		m_depthTex = m_kinect->getDepthImage();
 	
 	///////
 	
+	if (m_cpuParticles)
+	{
+		m_engine->step(m_parts_speed, m_parts_direction);
+		writeAttachments(m_fbo[m_bufferIn]);
+		
+		m_bufferIn = (m_bufferIn + 1) % 2;
+		m_bufferOut = (m_bufferIn + 1) % 2;
+		return;
+	}
+	
 	m_fbo[m_bufferIn].bindFramebuffer();
 	
 	gl::setMatricesWindow(m_fbo[0].getSize());
@@ -427,6 +523,13 @@ void VideoToParticles::update()
 //	if (m_depthTex)
 //		m_depthTex.unbind();
 	
+	if (m_recording.isOpen())
+	{
+		readAttachments(m_fbo[m_bufferIn]);
+		m_recording.append(m_parts_speed, m_parts_direction, m_engine->getField(),
+						   &m_attachments[0][0], &m_attachments[1][0], &m_attachments[2][0], PARTICLES * 4);
+	}
+	
 	m_bufferIn = (m_bufferIn + 1) % 2;
 	m_bufferOut = (m_bufferIn + 1) % 2;
 	
@@ -435,6 +538,8 @@ void VideoToParticles::update()
 void VideoToParticles::drawVideo()
 {
 	gl::clear( Color( 0.0f, 0.0f, 0.0f ) );
+	// update() leaves the viewport at the particle FBOs' size
+	gl::setViewport( getWindowBounds() );
 	gl::setMatricesWindow( getWindowWidth(), getWindowHeight() );
 	
 	if( mTexture ) {
@@ -455,46 +560,14 @@ void VideoToParticles::drawVideo()
 
 void VideoToParticles::draw()
 {
-    
-    drawVideo();
-    return;
 	// we need to call this to draw billboards instead of points
 	glEnable(GL_POINT_SPRITE);
 		
-	// just a debug view to see the kinect depth image. press 't' to activate
+	// a debug view of the frame the particles drift over, with the keys. press 't' to activate
 	if (m_drawTextures)
 	{
-		gl::setMatricesWindow(getWindowSize());
-		gl::setViewport(getWindowBounds());
-		gl::enableAlphaBlending();
-		
-		gl::disableDepthRead();
-		gl::clear(ColorA(.0f, .0f, .0f, 1.0f));
-		gl::color(ColorA(1.f, 1.f, 1.f, 1.f));
-		
-		m_clientSyphon.bind();
-		gl::TextureRef sytex;// = m_clientSyphon.getTexture();
-		sytex->bind(0);
-		
-		m_shdrDbg.bind();
-		m_shdrDbg.uniform("dbgSy", 0);
-		
-		gl::pushMatrices();
-		gl::draw(sytex, Rectf(0.0, 0.0, PARTICLES, PARTICLES));
-
-		gl::popMatrices();
-		
-		sytex->unbind();
-		m_clientSyphon.unbind();
-		m_shdrDbg.unbind();
-		
-		// kinect image
-		
-		if (m_depthTex)
-		{
-			gl::draw(m_depthTex);
-		}
-		
+		drawVideo();
+		drawText();
 	}
 	// the actual particle system drawing
 	else
@@ -545,7 +618,9 @@ void VideoToParticles::draw()
 		
 		
 		m_fboSy.unbindFramebuffer();
-		gl::draw(m_fboSy.getTexture());
+		gl::setViewport(getWindowBounds());
+		gl::setMatricesWindow(getWindowSize());
+		gl::draw(m_fboSy.getTexture(), getWindowBounds());
 		
 		
 		*m_texSyRef = m_fboSy.getTexture();
@@ -583,6 +658,8 @@ void VideoToParticles::drawText()
 	
 	layout.addLine("F - switch to fullscreen");
 	layout.addLine("t - draw textures");
+	layout.addLine("c - step on the CPU");
+	layout.addLine("r - record frames");
 	
 	char fps[50];
 	sprintf(fps, "FPS: %.2f", getAverageFps());
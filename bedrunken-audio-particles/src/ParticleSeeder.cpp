@@ -0,0 +1,240 @@
+//
+//  ParticleSeeder.cpp
+//
+
+#include "ParticleSeeder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+ParticleSeeder::ParticleSeeder( const Format &format, uint32_t seed )
+	: mFormat( format ), mRand( seed ), mImageWidth( 0 ), mImageHeight( 0 ), mNumCandidates( 0 )
+{
+}
+
+void ParticleSeeder::setImage( const uint8_t *data, int width, int height, ptrdiff_t rowBytes, int increment )
+{
+	mImageWidth = width;
+	mImageHeight = height;
+	mRowSums.resize( (size_t)width * height );
+	mRowStarts.resize( height + 1 );
+
+	float threshold = mFormat.mThreshold;
+	if( mFormat.mFromMean ) {
+		uint64_t sum = 0;
+		for( int y = 0; y < height; ++y ) {
+			const uint8_t *src = data + y * rowBytes;
+			for( int x = 0; x < width; ++x )
+				sum += src[x * increment];
+		}
+		threshold += sum / (float)max( width * height, 1 );
+	}
+
+	// v > t is v > floor( t ) for whole v, and v < t is v < ceil( t ), so one table covers the threshold
+	uint32_t weights[256];
+	int t = mFormat.mBelow ? (int)ceilf( threshold ) : (int)floorf( threshold );
+	for( int v = 0; v < 256; ++v ) {
+		int past = mFormat.mBelow ? t - v : v - t;
+		weights[v] = past <= 0 ? 0 : ( mFormat.mWeighting == LUMINANCE ? past : 1 );
+	}
+
+	size_t numCandidates = 0;
+	mRowStarts[0] = 0;
+	for( int y = 0; y < height; ++y ) {
+		const uint8_t *src = data + y * rowBytes;
+		uint32_t *sums = &mRowSums[(size_t)y * width];
+		uint32_t sum = 0;
+		for( int x = 0; x < width; ++x ) {
+			uint32_t w = weights[src[x * increment]];
+			numCandidates += w != 0;
+			sum += w;
+			sums[x] = sum;
+		}
+		mRowStarts[y + 1] = mRowStarts[y] + sum;
+	}
+	mNumCandidates = numCandidates;
+
+	if( numCandidates == 0 ) {
+		for( int y = 0; y < height; ++y ) {
+			uint32_t *sums = &mRowSums[(size_t)y * width];
+			for( int x = 0; x < width; ++x )
+				sums[x] = x + 1;
+			mRowStarts[y + 1] = mRowStarts[y] + width;
+		}
+	}
+}
+
+void ParticleSeeder::seed( float *pixels, int width, int height, size_t rowStride )
+{
+	seedRange( pixels, width, height, rowStride, 0, (size_t)width * height );
+}
+
+void ParticleSeeder::seedRange( float *pixels, int width, int height, size_t rowStride, size_t begin, size_t end )
+{
+	size_t count = (size_t)width * height;
+	end = min( end, count );
+	if( begin >= end || mImageWidth == 0 || mImageHeight == 0 )
+		return;
+
+	const uint64_t total = mRowStarts[mImageHeight];
+	const double weightPerParticle = total / (double)count;
+	const Format &f = mFormat;
+	const float xScale = f.mXScale / mImageWidth, yScale = f.mYScale / mImageHeight;
+
+	// the targets only grow with i, so the image row and column only move forward
+	uint64_t first = (uint64_t)( begin * weightPerParticle );
+	int y = (int)( upper_bound( mRowStarts.begin() + 1, mRowStarts.end(), first ) - mRowStarts.begin() ) - 1;
+	int x = 0;
+
+	size_t column = begin % width;
+	float *row = pixels + ( begin / width ) * rowStride;
+	for( size_t i = begin; i < end; ++i ) {
+		uint64_t target = min( (uint64_t)( ( i + (double)mRand.nextFloat() ) * weightPerParticle ), total - 1 );
+		while( mRowStarts[y + 1] <= target ) {
+			++y;
+			x = 0;
+		}
+		const uint32_t *sums = &mRowSums[(size_t)y * mImageWidth];
+		uint32_t offset = (uint32_t)( target - mRowStarts[y] );
+		while( sums[x] <= offset )
+			++x;
+
+		float px = (float)x, py = (float)y;
+		if( f.mPixelJitter ) {
+			px += mRand.nextFloat();
+			py += mRand.nextFloat();
+		}
+
+		float *out = row + column * 4;
+		if( ++column == (size_t)width ) {
+			column = 0;
+			row += rowStride;
+		}
+		out[f.mXChannel] = px * xScale + f.mXOffset;
+		out[f.mYChannel] = py * yScale + f.mYOffset;
+		out[f.mZChannel] = ( mRand.nextFloat() - 0.5f ) * f.mZJitter;
+		out[3] = mRand.nextFloat( f.mMassMin, f.mMassMax );
+	}
+}
+
+ParticleSeedWorker::ParticleSeedWorker( const ParticleSeeder::Format &format, int width, int height )
+	: mSeeder( format ), mWidth( width ), mHeight( height ), mCursor( 0 ), mSeeded( false ),
+	mFrameWidth( 0 ), mFrameHeight( 0 ), mParticlesPerFrame( 0 ), mHasFrame( false ), mBusy( false ), mHasResult( false ), mFresh( false ), mQuit( false )
+{
+	mWork.resize( (size_t)width * height * 4 );
+	mResult.resize( mWork.size() );
+	mThread = thread( &ParticleSeedWorker::run, this );
+}
+
+ParticleSeedWorker::~ParticleSeedWorker()
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		mQuit = true;
+	}
+	mWake.notify_one();
+	mThread.join();
+}
+
+void ParticleSeedWorker::setParticlesPerFrame( size_t count )
+{
+	lock_guard<mutex> lock( mMutex );
+	mParticlesPerFrame = count;
+}
+
+void ParticleSeedWorker::submit( const uint8_t *data, int width, int height, ptrdiff_t rowBytes, int increment )
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		mFrame.resize( (size_t)width * height );
+		for( int y = 0; y < height; ++y ) {
+			const uint8_t *src = data + y * rowBytes;
+			uint8_t *dst = &mFrame[(size_t)y * width];
+			if( increment == 1 )
+				memcpy( dst, src, width );
+			else
+				for( int x = 0; x < width; ++x )
+					dst[x] = src[x * increment];
+		}
+		mFrameWidth = width;
+		mFrameHeight = height;
+		mHasFrame = true;
+	}
+	mWake.notify_one();
+}
+
+bool ParticleSeedWorker::acquire( float *pixels, int width, int height, size_t rowStride )
+{
+	if( width != mWidth || height != mHeight )
+		return false;
+
+	lock_guard<mutex> lock( mMutex );
+	if( ! mHasResult )
+		return false;
+	size_t rowFloats = (size_t)mWidth * 4;
+	for( int y = 0; y < mHeight; ++y )
+		memcpy( pixels + y * rowStride, &mResult[y * rowFloats], rowFloats * sizeof( float ) );
+	mFresh = false;
+	return true;
+}
+
+bool ParticleSeedWorker::isFresh()
+{
+	lock_guard<mutex> lock( mMutex );
+	return mFresh;
+}
+
+void ParticleSeedWorker::wait()
+{
+	unique_lock<mutex> lock( mMutex );
+	while( mHasFrame || mBusy )
+		mIdle.wait( lock );
+}
+
+void ParticleSeedWorker::run()
+{
+	size_t count = (size_t)mWidth * mHeight;
+	size_t rowStride = (size_t)mWidth * 4;
+	for(;;) {
+		int frameWidth, frameHeight;
+		size_t perFrame;
+		{
+			unique_lock<mutex> lock( mMutex );
+			while( ! mHasFrame && ! mQuit )
+				mWake.wait( lock );
+			if( mQuit )
+				return;
+			mWorkFrame.swap( mFrame );
+			frameWidth = mFrameWidth;
+			frameHeight = mFrameHeight;
+			perFrame = mParticlesPerFrame;
+			mHasFrame = false;
+			mBusy = true;
+		}
+
+		mSeeder.setImage( &mWorkFrame[0], frameWidth, frameHeight, frameWidth );
+		if( ! mSeeded || perFrame == 0 || perFrame >= count ) {
+			mSeeder.seed( &mWork[0], mWidth, mHeight, rowStride );
+			mSeeded = true;
+		}
+		else {
+			size_t end = min( mCursor + perFrame, count );
+			mSeeder.seedRange( &mWork[0], mWidth, mHeight, rowStride, mCursor, end );
+			if( end - mCursor < perFrame )
+				mSeeder.seedRange( &mWork[0], mWidth, mHeight, rowStride, 0, perFrame - ( end - mCursor ) );
+			mCursor = ( mCursor + perFrame ) % count;
+		}
+
+		{
+			lock_guard<mutex> lock( mMutex );
+			mResult = mWork;
+			mHasResult = true;
+			mFresh = true;
+			mBusy = false;
+		}
+		mIdle.notify_all();
+	}
+}
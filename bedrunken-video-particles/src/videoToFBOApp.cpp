@@ -20,6 +20,8 @@
 #include "cinder/Easing.h"
 #include "cinder/ip/Resize.h"
 
+#include "ParticleSeeder.h"
+
 #define WIDTH 900
 #define HEIGHT 600
 const float TWEEN_SPEED = 0.08f;
@@ -47,6 +49,7 @@ public:
 	CameraPersp		mCam;
 	Arcball			mArcball;
 	Surface32f		mInitPos, mInitVel;
+	ParticleSeeder	mSeeder;
 	int				mCurrentFBO;
 	int				mOtherFBO;
 	gl::Fbo			mFBO[2];
@@ -111,31 +114,16 @@ void video2Particles::setupTextures(){
 
     Channel imgChannel(mSurface);
     
+	/* Initial particle positions are passed in as R,G,B 
+	 float values ( x, y, 0 ). Alpha is used as particle mass. */
+	mSeeder.setFormat( ParticleSeeder::Format().threshold( isParticleNeg ? 100.0f : 6.0f, isParticleNeg ).zJitter( 0.0f )
+		.xMapping( 1.0f, -0.5f ).yMapping( 1.0f, -0.5f ) );
+	mSeeder.setImage( imgChannel.getData(), imgChannel.getWidth(), imgChannel.getHeight(), imgChannel.getRowBytes(), imgChannel.getIncrement() );
+
 	mInitPos = Surface32f( WIDTH, HEIGHT, true);
-	Surface32f::Iter pixelIter = mInitPos.getIter();
-    std::size_t cnt = 0;
-    float oneOverWidth = 1.0 / (float)imgChannel.getWidth();
-    float oneOverHeight = 1.0 / (float)imgChannel.getHeight();
-    while(cnt<HEIGHT*WIDTH){
-        Channel::Iter imgIter = imgChannel.getIter();
-        while( imgIter.line()) {
-            while( imgIter.pixel()) {
-                /* Initial particle positions are passed in as R,G,B 
-                 float values. Alpha is used as particle mass. */
-                float x, y, z;
-                if ((isParticleNeg && (imgIter.v())<100) || (!isParticleNeg && (imgIter.v())>6)){
-                    x = ((float)imgIter.getPos().x)*oneOverWidth - 0.5f;
-                    y = ((float)imgIter.getPos().y)*oneOverHeight - 0.5f;
-                    z = (Rand::randFloat()-0.5f)*0.001f;
-                    cnt++;
-
-                    mInitPos.setPixel( imgIter.getPos(), ColorAf( x, y, 0.0 , Rand::randFloat(0.2f, 1.0f) ) );
-                }
-            }
-        }
-    }
+	mSeeder.seed( mInitPos.getData(), WIDTH, HEIGHT, mInitPos.getRowBytes() / sizeof( float ) );
     
-    cout <<cnt<<" "  << imgChannel.getSize().x*imgChannel.getSize().y<<endl;
+    cout << mSeeder.getNumCandidates() << " "  << imgChannel.getSize().x*imgChannel.getSize().y<<endl;
     
 	gl::Texture::Format tFormat;
 	tFormat.setInternalFormat(GL_RGBA32F_ARB);
@@ -146,11 +134,12 @@ void video2Particles::setupTextures(){
 	
 	//Velocity 2D texture array
 	mInitVel = Surface32f( WIDTH, HEIGHT, true);
-	pixelIter = mInitVel.getIter();
-	while( pixelIter.line() ) {
-		while( pixelIter.pixel() ) {
+	for( int y = 0; y < HEIGHT; ++y ) {
+		float *vel = mInitVel.getData( Vec2i( 0, y ) );
+		for( int x = 0; x < WIDTH; ++x, vel += 4 ) {
 			/* Initial particle velocities are passed in as R,G,B float values. */
-			mInitVel.setPixel( pixelIter.getPos(), ColorAf( 0.0f, 0.0f, 0.0f, 1.0f ) );
+			vel[0] = vel[1] = vel[2] = 0.0f;
+			vel[3] = 1.0f;
 		}
 	}
 	mVelocities = gl::Texture( mInitVel, tFormat);
@@ -0,0 +1,43 @@
+//
+//  LooseOctree.h
+//  BigBang
+//
+//  Loose octree broadphase for sphere collisions.
+//
+
+#pragma once
+
+#include "cinder/Vector.h"
+#include <vector>
+#include <utility>
+
+class LooseOctree {
+  public:
+	typedef std::pair<int,int> Pair;
+
+	LooseOctree( int maxDepth = 5 );
+
+	void	clear( const ci::Vec3f &minPos, const ci::Vec3f &maxPos );
+	void	insert( int id, const ci::Vec3f &pos, float radius );
+
+	// every pair ( i < j ) whose spheres overlap, sorted by i then j
+	void	findPairs( std::vector<Pair> *pairs ) const;
+
+  private:
+	int		getLevelFor( float radius ) const;
+	int		getCellIndex( int level, int x, int y, int z ) const;
+	int		toCell( float p, float minP, float cellSize, int numCells ) const;
+
+	int					mMaxDepth;
+	ci::Vec3f			mMin;
+	float				mRootSize;
+
+	std::vector<int>	mLevelOffsets;	// first cell of each level
+	std::vector<int>	mLevelCounts;	// spheres filed per level
+	std::vector<int>	mCellHeads;		// first sphere in each cell, -1 if empty
+	std::vector<int>	mTouchedCells;	// cells to reset on the next clear()
+
+	std::vector<int>		mNext;		// per sphere, next in its cell
+	std::vector<ci::Vec3f>	mPositions;
+	std::vector<float>		mRadii;
+};
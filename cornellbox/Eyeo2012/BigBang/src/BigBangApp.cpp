@@ -265,6 +265,7 @@ void BigBangApp::draw()
 		mConfettiShader.uniform( "eyePos", mSpringCam.getEye() );
 		mConfettiShader.uniform( "power", mRoom.getPower() );
 		mConfettiShader.uniform( "roomDims", mRoom.getDims() );
+		mController.mConfettiBatch.setFrustum( mSpringCam.mMvpMatrix );
 		mController.drawConfettis( &mConfettiShader );
 		mConfettiShader.unbind();
 		
@@ -279,6 +280,7 @@ void BigBangApp::draw()
 		mBalloonsShader.uniform( "power", mRoom.getPower() );
 		mBalloonsShader.uniform( "roomDims", mRoom.getDims() );
 		mBalloonsShader.uniform( "att", 1.015f );
+		mController.mBalloonBatch.setFrustum( mSpringCam.mMvpMatrix );
 		mController.drawBalloons( &mBalloonsShader );
 		mBalloonsShader.unbind();
 		gl::disable( GL_CULL_FACE );
@@ -10,12 +10,15 @@
 #include "cinder/Camera.h"
 #include "cinder/gl/GlslProg.h"
 #include "cinder/TriMesh.h"
+#include "cinder/Color.h"
 #include "Room.h"
 #include "Particle.h"
 #include "FieldLine.h"
+#include "FieldSolver.h"
 #include "Glow.h"
 #include "Glob.h"
 #include "Nebula.h"
+#include "VertexArena.h"
 #include <vector>
 #include <list>
 
@@ -25,7 +28,7 @@ class Controller
 	struct VboVertex {
         ci::Vec3f vertex;
 //		ci::Vec3f normal;
-        ci::Vec4f color;
+        ci::ColorA8u color;
     };
 	
 	Controller();
@@ -58,9 +61,10 @@ class Controller
 	Particle				*mDraggedParticle;
 	
 	std::vector<FieldLine>	mFieldLines;
+	FieldSolver				mFieldSolver;
 	int						mTotalVerts;
-    int						mPrevTotalVerts;
-    VboVertex				*mFieldLineVerts;
+	VertexArena<VboVertex>	mFieldLineVerts;
+	VertexArena<ci::Vec3f>	mFieldLineTrails;	// FieldLine::sLen positions per line, in mFieldLines order
 	
 	std::vector<Glow>		mGlows;
 	std::vector<Nebula>		mNebulas;
@@ -19,10 +19,14 @@ public:
 	void update( float dt, bool tick );
 	void draw();
 	
+	// i = 0 is the head, i = sLen-1 the oldest trail position
+	const ci::Vec3f& getPosition( int i ) const { return mPositions[ ( mHead + i ) % sLen ]; };
+	
 	ci::Vec3f	mPos;
 	ci::Vec3f	mVel;
 	
-	std::vector<ci::Vec3f>	mPositions;
+	ci::Vec3f				*mPositions;	// sLen slots in the Controller's trail arena, a ring starting at mHead
+	int						mHead;
 //	std::vector<ci::Vec3f>	mNormals;
 //	std::vector<ci::Vec3f>	mPerps;
 	
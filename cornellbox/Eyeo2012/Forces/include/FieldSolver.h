@@ -0,0 +1,58 @@
+//
+//  FieldSolver.h
+//  Forces
+//
+//  Barnes-Hut octree evaluation of the Coulomb field of the charged particles.
+//
+
+#pragma once
+
+#include "cinder/Vector.h"
+#include "Particle.h"
+#include "FieldLine.h"
+#include <vector>
+
+class FieldSolver {
+  public:
+	struct Node {
+		ci::Vec3f	mCenter;		// geometric center of the cell
+		float		mHalfSize;
+		ci::Vec3f	mPivot;			// |charge| weighted centroid, expansion center
+		float		mCharge;		// monopole
+		ci::Vec3f	mDipole;		// dipole about mPivot
+		int			mFirstChild;	// index of 8 consecutive children, -1 for leaves
+		int			mBegin, mEnd;	// range into mChargePos / mChargeVal
+	};
+
+	FieldSolver();
+
+	void		setTheta( float theta ){ mTheta = theta < 0.0f ? 0.0f : theta; };
+	float		getTheta() const { return mTheta; };
+	void		setNumThreads( int numThreads ){ mNumThreads = numThreads; };
+
+	void		build( const std::vector<Particle> &particles );
+	ci::Vec3f	getField( const ci::Vec3f &pos ) const;
+	ci::Vec3f	getFieldDirect( const ci::Vec3f &pos ) const;
+
+	// adds mCharge * field * strength to every field line velocity
+	void		applyToFieldLines( std::vector<FieldLine> &lines, float strength ) const;
+
+	const std::vector<Node>& getNodes() const { return mNodes; };
+
+	static const int sMaxLeafCharges	= 8;
+	static const int sMaxDepth			= 16;
+
+  private:
+	void		subdivide( int nodeIndex, int depth );
+	void		computeMoments( int nodeIndex );
+	void		applyRange( std::vector<FieldLine> *lines, float strength, size_t begin, size_t end ) const;
+
+	std::vector<Node>		mNodes;
+	std::vector<ci::Vec3f>	mChargePos;
+	std::vector<float>		mChargeVal;
+	std::vector<ci::Vec3f>	mScratchPos;
+	std::vector<float>		mScratchVal;
+
+	float		mTheta;
+	int			mNumThreads;
+};
@@ -0,0 +1,92 @@
+//
+//  VertexArena.h
+//  Forces
+//
+//  Growth-only, optionally double-buffered vertex storage.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+
+template<typename T>
+class VertexArena {
+  public:
+	VertexArena( bool doubleBuffered = false )
+		: mDoubleBuffered( doubleBuffered ), mFront( 0 ), mNumAllocations( 0 )
+	{
+		for( int i=0; i<2; i++ ){
+			mData[i]		= NULL;
+			mCapacity[i]	= 0;
+			mSize[i]		= 0;
+		}
+	}
+
+	~VertexArena()
+	{
+		delete[] mData[0];
+		delete[] mData[1];
+	}
+
+	// returns storage for size vertices in the back buffer
+	T* begin( size_t size )
+	{
+		int back = getBackIndex();
+		if( size > mCapacity[back] ){
+			size_t capacity = std::max( mCapacity[back], (size_t)1024 );
+			while( capacity < size ) capacity *= 2;
+
+			delete[] mData[back];
+			mData[back]		= new T[capacity];
+			mCapacity[back]	= capacity;
+			mNumAllocations++;
+		}
+		mSize[back] = size;
+		return mData[back];
+	}
+
+	// resizes the front buffer and keeps its contents, for storage that lives
+	// across frames; only for an arena that is not double buffered
+	T* resize( size_t size )
+	{
+		if( size > mCapacity[mFront] ){
+			size_t capacity = std::max( mCapacity[mFront], (size_t)1024 );
+			while( capacity < size ) capacity *= 2;
+
+			T *data = new T[capacity];
+			std::copy( mData[mFront], mData[mFront] + mSize[mFront], data );
+			delete[] mData[mFront];
+			mData[mFront]		= data;
+			mCapacity[mFront]	= capacity;
+			mNumAllocations++;
+		}
+		mSize[mFront] = size;
+		return mData[mFront];
+	}
+
+	// publishes the back buffer as the one to draw
+	void end()
+	{
+		if( mDoubleBuffered ) mFront = 1 - mFront;
+	}
+
+	const T*	getData() const { return mData[mFront]; };
+	size_t		getSize() const { return mSize[mFront]; };
+	size_t		getCapacity() const { return mCapacity[mFront]; };
+	int			getNumAllocations() const { return mNumAllocations; };
+	bool		isDoubleBuffered() const { return mDoubleBuffered; };
+
+  private:
+	VertexArena( const VertexArena& );
+	VertexArena& operator=( const VertexArena& );
+
+	int getBackIndex() const { return mDoubleBuffered ? 1 - mFront : mFront; };
+
+	bool		mDoubleBuffered;
+	int			mFront;
+	T			*mData[2];
+	size_t		mCapacity[2];
+	size_t		mSize[2];
+	int			mNumAllocations;
+};
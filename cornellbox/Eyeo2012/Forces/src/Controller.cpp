@@ -16,10 +16,9 @@ using std::vector;
 using std::list;
 
 Controller::Controller()
+	: mFieldLineVerts( true )
 {
-	mPrevTotalVerts		= -1;
 	mTotalVerts			= 0;
-    mFieldLineVerts		= NULL;
 }
 
 void Controller::init( Room *room, int maxParticles )
@@ -56,18 +55,8 @@ void Controller::applyForce()
 //	mLeftParticle->mForce  = q;
 //	mRightParticle->mForce = q;
 	
-	for( vector<Particle>::iterator particle = mParticles.begin(); particle != mParticles.end(); ++particle ){
-		for( vector<FieldLine>::iterator it = mFieldLines.begin(); it != mFieldLines.end(); ++it ){
-			Vec3f dir			= it->mPos - particle->mPos;
-			float totalCharge	= it->mCharge * particle->mCharge;
-			float distSqrd		= dir.lengthSquared();
-			
-			float q			= totalCharge / distSqrd;
-			dir				= dir.normalized() * q;
-			
-			it->mVel		+= dir * 200000.0f;
-		}
-	}
+	mFieldSolver.build( mParticles );
+	mFieldSolver.applyToFieldLines( mFieldLines, 200000.0f );
 }
 
 void Controller::update( const ci::Camera &cam, float dt, bool tick )
@@ -164,40 +153,42 @@ void Controller::update( const ci::Camera &cam, float dt, bool tick )
 void Controller::updateFieldLines( float dt, bool tick )
 {
 	// FIELD LINES
-	for( vector<FieldLine>::iterator it = mFieldLines.begin(); it != mFieldLines.end(); ){
-		if( it->mIsDead ){
-			it = mFieldLines.erase( it );
-		} else {
+	// compact the live lines in place rather than erasing one at a time
+	vector<FieldLine>::iterator alive = mFieldLines.begin();
+	for( vector<FieldLine>::iterator it = mFieldLines.begin(); it != mFieldLines.end(); ++it ){
+		if( !it->mIsDead ){
 			it->update( dt, tick );
-			++ it;
+			if( alive != it ){
+				// the trail moves down with its line, into the slot of the one it replaces
+				Vec3f *trail = alive->mPositions;
+				std::copy( it->mPositions, it->mPositions + FieldLine::sLen, trail );
+				*alive = *it;
+				alive->mPositions = trail;
+			}
+			++ alive;
 		}
 	}
-	mTotalVerts = mFieldLines.size() * ( FieldLine::sLen - 1 ) * 2;
-	
-    if( mTotalVerts != mPrevTotalVerts ){
-        if (mFieldLineVerts != NULL) {
-            delete[] mFieldLineVerts;
-        }
-        mFieldLineVerts = new VboVertex[mTotalVerts];
-        mPrevTotalVerts = mTotalVerts;
-    }
+	mFieldLines.erase( alive, mFieldLines.end() );
+	mFieldLineTrails.resize( mFieldLines.size() * FieldLine::sLen );
+	mTotalVerts = mFieldLines.size() * FieldLine::sNumVerts;
 	
-	int vIndex = 0;
-	for( vector<FieldLine>::iterator it = mFieldLines.begin(); it != mFieldLines.end(); ++it ){
+	VboVertex *verts = mFieldLineVerts.begin( mTotalVerts );
+	for( vector<FieldLine>::const_iterator it = mFieldLines.begin(); it != mFieldLines.end(); ++it ){
+		uint8_t c		= (uint8_t)( constrain( it->mColor, 0.0f, 1.0f ) * 255.0f );
+		float agePer	= constrain( it->mAgePer, 0.0f, 1.0f ) * 0.5f * 255.0f;
 		for( int i=0; i<FieldLine::sLen-1; i++ ){
-			float alpha = ( 1.0f - i*FieldLine::sInvLen ) * it->mAgePer * 0.5f;
-			mFieldLineVerts[vIndex].vertex = it->mPositions[i];
-//			mFieldLineVerts[vIndex].normal = it->mNormals[i];
-			mFieldLineVerts[vIndex].color  = Vec4f( it->mColor, it->mColor, it->mColor, alpha );
-			vIndex++;
+			float alpha = ( 1.0f - i*FieldLine::sInvLen ) * agePer;
+			verts->vertex	= it->getPosition( i );
+			verts->color	= ColorA8u( c, c, c, (uint8_t)alpha );
+			verts++;
 			
-			alpha = ( 1.0f - (i+1)*FieldLine::sInvLen ) * it->mAgePer * 0.5f;
-			mFieldLineVerts[vIndex].vertex = it->mPositions[i+1];
-//			mFieldLineVerts[vIndex].normal = it->mNormals[i+1];
-			mFieldLineVerts[vIndex].color  = Vec4f( it->mColor, it->mColor, it->mColor, alpha );
-			vIndex++;
+			alpha = ( 1.0f - (i+1)*FieldLine::sInvLen ) * agePer;
+			verts->vertex	= it->getPosition( i+1 );
+			verts->color	= ColorA8u( c, c, c, (uint8_t)alpha );
+			verts++;
 		}
 	}
+	mFieldLineVerts.end();
 }
 
 void Controller::draw()
@@ -210,16 +201,17 @@ void Controller::draw()
 void Controller::drawFieldLines( gl::GlslProg *shader )
 {
 	glLineWidth( 1.0f );
-	if( mTotalVerts > 0 ){
+	if( mFieldLineVerts.getSize() > 0 ){
 		glEnableClientState( GL_VERTEX_ARRAY );
 //		glEnableClientState( GL_NORMAL_ARRAY );
 		glEnableClientState( GL_COLOR_ARRAY );
-		glVertexPointer( 3, GL_FLOAT, sizeof(VboVertex), mFieldLineVerts );
-//		glNormalPointer( GL_FLOAT, sizeof(VboVertex), &mFieldLineVerts[0].normal );
-		glColorPointer( 4, GL_FLOAT, sizeof(VboVertex), &mFieldLineVerts[0].color );
+		const VboVertex *verts = mFieldLineVerts.getData();
+		glVertexPointer( 3, GL_FLOAT, sizeof(VboVertex), &verts[0].vertex );
+//		glNormalPointer( GL_FLOAT, sizeof(VboVertex), &verts[0].normal );
+		glColorPointer( 4, GL_UNSIGNED_BYTE, sizeof(VboVertex), &verts[0].color );
 		
 //		shader->uniform( "shadow", 1.0f );
-		glDrawArrays( GL_LINES, 0, mTotalVerts );
+		glDrawArrays( GL_LINES, 0, (GLsizei)mFieldLineVerts.getSize() );
 //		gl::pushModelView();
 //		gl::translate( Vec3f( 0.0f, 0.3f, 0.0f ) );
 //		shader->uniform( "shadow", 0.0f );
@@ -288,6 +280,7 @@ void Controller::addParticle( const Vec3f &pos, float charge )
 
 void Controller::addFieldLines( Particle *p, int amt )
 {
+	size_t numOld = mFieldLines.size();
 	for( int i=0; i<amt; i++ ){
 		Vec3f dir		= Rand::randVec3f();
 		Vec3f pos		= p->mPos + dir * p->mRadius;
@@ -296,6 +289,14 @@ void Controller::addFieldLines( Particle *p, int amt )
 		
 		mFieldLines.push_back( FieldLine( pos, vel, p->mCharge, lifespan ) );
 	}
+	
+	// growing can move the trails, so every line is pointed at its slot again
+	Vec3f *trails = mFieldLineTrails.resize( mFieldLines.size() * FieldLine::sLen );
+	for( size_t i=0; i<mFieldLines.size(); i++ ){
+		FieldLine &line = mFieldLines[i];
+		line.mPositions = trails + i * FieldLine::sLen;
+		if( i >= numOld ) std::fill( line.mPositions, line.mPositions + FieldLine::sLen, line.mPos );
+	}
 }
 
 void Controller::addGlows( Particle *p, int amt )
@@ -19,16 +19,15 @@ int FieldLine::sNumVerts = ( FieldLine::sLen - 1 ) * 2;
 
 FieldLine::FieldLine()
 {
+	mPositions	= NULL;
+	mHead		= 0;
 }
 
 FieldLine::FieldLine( const Vec3f &pos, const Vec3f &vel, float charge, float lifespan )
 {
 	mPos		= pos;
-	for( int i=0; i<sLen; i++ ){
-		mPositions.push_back( mPos );
-//		mNormals.push_back( Vec3f::yAxis() );
-//		mPerps.push_back( Vec3f::xAxis() );
-	}
+	mPositions	= NULL;		// set, and filled with pos, by the Controller
+	mHead		= 0;
 	
 	mVel		= vel;
 	mMaxSpeed	= 8.0f;
@@ -47,11 +46,8 @@ void FieldLine::update( float dt, bool tick )
 	mPos		+= mVel * dt;
 	
 	if( tick ){
-		for( int i=sLen-1; i>0; i-- ){
-			mPositions[i]	= mPositions[i-1];
-//			mNormals[i]		= mNormals[i-1];
-//			mPerps[i]		= mPerps[i-1];
-		}
+		// step the ring back instead of shifting the trail
+		mHead = ( mHead + sLen - 1 ) % sLen;
 	}
 	
 //	Vec3f perp = dir.cross( Vec3f::zAxis() ).normalized();
@@ -60,7 +56,7 @@ void FieldLine::update( float dt, bool tick )
 	
 //	mPerps[0]		= perp;
 //	mNormals[0]		= perp2;
-	mPositions[0]	= mPos;
+	mPositions[mHead]	= mPos;
 	
 	mVel	-= mVel * 0.02 * dt;
 	mAge	+= dt;
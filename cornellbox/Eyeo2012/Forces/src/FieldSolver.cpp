@@ -0,0 +1,224 @@
+//
+//  FieldSolver.cpp
+//  Forces
+//
+
+#include "FieldSolver.h"
+#include "cinder/Thread.h"
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace ci;
+using std::vector;
+
+FieldSolver::FieldSolver()
+{
+	mTheta		= 0.5f;
+	mNumThreads	= std::max( (int)boost::thread::hardware_concurrency(), 1 );
+}
+
+void FieldSolver::build( const vector<Particle> &particles )
+{
+	mNodes.clear();
+	mChargePos.clear();
+	mChargeVal.clear();
+
+	if( particles.empty() ) return;
+
+	Vec3f minPos = particles[0].mPos;
+	Vec3f maxPos = particles[0].mPos;
+	for( vector<Particle>::const_iterator it = particles.begin(); it != particles.end(); ++it ){
+		mChargePos.push_back( it->mPos );
+		mChargeVal.push_back( it->mCharge );
+
+		minPos.x = std::min( minPos.x, it->mPos.x );	maxPos.x = std::max( maxPos.x, it->mPos.x );
+		minPos.y = std::min( minPos.y, it->mPos.y );	maxPos.y = std::max( maxPos.y, it->mPos.y );
+		minPos.z = std::min( minPos.z, it->mPos.z );	maxPos.z = std::max( maxPos.z, it->mPos.z );
+	}
+
+	Vec3f dims		= maxPos - minPos;
+	Node root;
+	root.mCenter	= ( minPos + maxPos ) * 0.5f;
+	root.mHalfSize	= std::max( std::max( dims.x, dims.y ), dims.z ) * 0.5f + 0.001f;
+	root.mFirstChild= -1;
+	root.mBegin		= 0;
+	root.mEnd		= (int)mChargePos.size();
+	mNodes.push_back( root );
+
+	mScratchPos.resize( mChargePos.size() );
+	mScratchVal.resize( mChargeVal.size() );
+
+	subdivide( 0, 0 );
+
+	for( size_t i=0; i<mNodes.size(); i++ ){
+		computeMoments( (int)i );
+	}
+}
+
+void FieldSolver::subdivide( int nodeIndex, int depth )
+{
+	int begin	= mNodes[nodeIndex].mBegin;
+	int end		= mNodes[nodeIndex].mEnd;
+	if( end - begin <= sMaxLeafCharges || depth >= sMaxDepth ) return;
+
+	Vec3f center	= mNodes[nodeIndex].mCenter;
+	float half		= mNodes[nodeIndex].mHalfSize * 0.5f;
+
+	// counting sort of the node's charges into octants
+	int counts[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	for( int i=begin; i<end; i++ ){
+		const Vec3f &p = mChargePos[i];
+		int octant = ( p.x > center.x ? 1 : 0 ) | ( p.y > center.y ? 2 : 0 ) | ( p.z > center.z ? 4 : 0 );
+		counts[octant]++;
+	}
+
+	int offsets[8];
+	int offset = begin;
+	for( int o=0; o<8; o++ ){
+		offsets[o]	= offset;
+		offset		+= counts[o];
+	}
+
+	for( int i=begin; i<end; i++ ){
+		const Vec3f &p = mChargePos[i];
+		int octant = ( p.x > center.x ? 1 : 0 ) | ( p.y > center.y ? 2 : 0 ) | ( p.z > center.z ? 4 : 0 );
+		int dst = offsets[octant]++;
+		mScratchPos[dst] = p;
+		mScratchVal[dst] = mChargeVal[i];
+	}
+	std::copy( mScratchPos.begin() + begin, mScratchPos.begin() + end, mChargePos.begin() + begin );
+	std::copy( mScratchVal.begin() + begin, mScratchVal.begin() + end, mChargeVal.begin() + begin );
+
+	int firstChild = (int)mNodes.size();
+	mNodes[nodeIndex].mFirstChild = firstChild;
+
+	int childBegin = begin;
+	for( int o=0; o<8; o++ ){
+		Node child;
+		child.mCenter		= center + Vec3f( ( o & 1 ) ? half : -half, ( o & 2 ) ? half : -half, ( o & 4 ) ? half : -half );
+		child.mHalfSize		= half;
+		child.mFirstChild	= -1;
+		child.mBegin		= childBegin;
+		child.mEnd			= childBegin + counts[o];
+		childBegin			= child.mEnd;
+		mNodes.push_back( child );
+	}
+
+	for( int o=0; o<8; o++ ){
+		subdivide( firstChild + o, depth + 1 );
+	}
+}
+
+void FieldSolver::computeMoments( int nodeIndex )
+{
+	Node &node		= mNodes[nodeIndex];
+	float absCharge	= 0.0f;
+	node.mCharge	= 0.0f;
+	node.mPivot		= Vec3f::zero();
+	node.mDipole	= Vec3f::zero();
+
+	for( int i=node.mBegin; i<node.mEnd; i++ ){
+		float q			= mChargeVal[i];
+		node.mCharge	+= q;
+		absCharge		+= fabsf( q );
+		node.mPivot		+= mChargePos[i] * fabsf( q );
+	}
+
+	if( absCharge > 0.0f )	node.mPivot /= absCharge;
+	else					node.mPivot = node.mCenter;
+
+	for( int i=node.mBegin; i<node.mEnd; i++ ){
+		node.mDipole += ( mChargePos[i] - node.mPivot ) * mChargeVal[i];
+	}
+}
+
+Vec3f FieldSolver::getField( const Vec3f &pos ) const
+{
+	Vec3f field = Vec3f::zero();
+	if( mNodes.empty() ) return field;
+
+	float thetaSqrd = mTheta * mTheta;
+
+	int stack[8 * sMaxDepth + 8];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while( stackSize > 0 ){
+		const Node &node = mNodes[ stack[--stackSize] ];
+		if( node.mBegin == node.mEnd ) continue;
+
+		if( node.mFirstChild < 0 ){
+			for( int i=node.mBegin; i<node.mEnd; i++ ){
+				Vec3f dir		= pos - mChargePos[i];
+				float distSqrd	= dir.lengthSquared();
+				if( distSqrd > 0.0f ){
+					float invDist = 1.0f / sqrtf( distSqrd );
+					field += dir * ( mChargeVal[i] * invDist * invDist * invDist );
+				}
+			}
+			continue;
+		}
+
+		Vec3f dir		= pos - node.mPivot;
+		float distSqrd	= dir.lengthSquared();
+		float size		= node.mHalfSize * 2.0f;
+
+		if( distSqrd > 0.0f && size * size < thetaSqrd * distSqrd ){
+			float invDist	= 1.0f / sqrtf( distSqrd );
+			float invDist3	= invDist * invDist * invDist;
+			float invDist5	= invDist3 * invDist * invDist;
+			field += dir * ( node.mCharge * invDist3 );
+			field += dir * ( 3.0f * node.mDipole.dot( dir ) * invDist5 ) - node.mDipole * invDist3;
+		} else {
+			for( int o=0; o<8; o++ ){
+				stack[stackSize++] = node.mFirstChild + o;
+			}
+		}
+	}
+
+	return field;
+}
+
+Vec3f FieldSolver::getFieldDirect( const Vec3f &pos ) const
+{
+	Vec3f field = Vec3f::zero();
+	for( size_t i=0; i<mChargePos.size(); i++ ){
+		Vec3f dir		= pos - mChargePos[i];
+		float distSqrd	= dir.lengthSquared();
+		if( distSqrd > 0.0f ){
+			field += dir.normalized() * ( mChargeVal[i] / distSqrd );
+		}
+	}
+	return field;
+}
+
+void FieldSolver::applyRange( vector<FieldLine> *lines, float strength, size_t begin, size_t end ) const
+{
+	for( size_t i=begin; i<end; i++ ){
+		FieldLine &line = (*lines)[i];
+		line.mVel += getField( line.mPos ) * ( line.mCharge * strength );
+	}
+}
+
+void FieldSolver::applyToFieldLines( vector<FieldLine> &lines, float strength ) const
+{
+	if( mNodes.empty() || lines.empty() ) return;
+
+	int numThreads = std::min( mNumThreads, (int)( lines.size() / 512 ) );
+	if( numThreads <= 1 ){
+		applyRange( &lines, strength, 0, lines.size() );
+		return;
+	}
+
+	size_t chunk = ( lines.size() + numThreads - 1 ) / numThreads;
+	boost::thread_group threads;
+	for( int t=1; t<numThreads; t++ ){
+		size_t begin	= t * chunk;
+		size_t end		= std::min( begin + chunk, lines.size() );
+		if( begin < end )
+			threads.create_thread( boost::bind( &FieldSolver::applyRange, this, &lines, strength, begin, end ) );
+	}
+	applyRange( &lines, strength, 0, std::min( chunk, lines.size() ) );
+	threads.join_all();
+}
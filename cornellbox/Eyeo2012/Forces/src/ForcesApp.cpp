@@ -188,6 +188,8 @@ void ForcesApp::keyDown( KeyEvent event )
 	switch( event.getChar() ){
 		case ' ':	mRoom.togglePower();			break;
 		case 'c':	mController.clear();			break;
+		case '[':	mController.mFieldSolver.setTheta( mController.mFieldSolver.getTheta() - 0.1f );	break;
+		case ']':	mController.mFieldSolver.setTheta( mController.mFieldSolver.getTheta() + 0.1f );	break;
 //		case 's':	mSaveFrames = !mSaveFrames;		break;
 		default:									break;
 	}
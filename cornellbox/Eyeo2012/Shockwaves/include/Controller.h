@@ -14,6 +14,7 @@
 #include "Shockwave.h"
 #include "Smoke.h"
 #include "Glow.h"
+#include "InstanceBatch.h"
 #include <vector>
 #include <list>
 
@@ -51,6 +52,9 @@ public:
 	std::vector<Glow>		mGlows;
 	
 	ci::gl::VboMesh			mSphereVbo;
+	ci::gl::VboMesh			mNodeVbo;
+	InstanceBatch			mNodeBatch;
+	InstanceBatch::GlBackend	mNodeBackend;
 	std::vector<ci::Vec3f>	mPosCoords;
 	std::vector<ci::Vec3f>	mNormals;
 };
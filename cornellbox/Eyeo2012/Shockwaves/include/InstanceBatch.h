@@ -0,0 +1,139 @@
+//
+//  InstanceBatch.h
+//  Shockwaves
+//
+//  Per-object matrices and colours drawn as one instanced submission per mesh.
+//
+
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include "cinder/gl/GlslProg.h"
+#include "cinder/gl/Vbo.h"
+#include "cinder/Matrix.h"
+#include "cinder/Vector.h"
+#include "cinder/Thread.h"
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <vector>
+
+struct InstanceData {
+	ci::Matrix44f	mMatrix;
+	ci::Vec4f		mColor;
+};
+
+class InstanceBatch {
+  public:
+	class Backend {
+	  public:
+		virtual ~Backend() {}
+		virtual void submit( const ci::gl::VboMesh &mesh, const InstanceData *instances, size_t count ) = 0;
+	};
+
+	class RecordingBackend : public Backend {
+	  public:
+		struct Submission {
+			const ci::gl::VboMesh		*mMesh;
+			std::vector<InstanceData>	mInstances;
+		};
+
+		void submit( const ci::gl::VboMesh &mesh, const InstanceData *instances, size_t count );
+		void clear(){ mSubmissions.clear(); };
+
+		std::vector<Submission>	mSubmissions;
+	};
+
+	// per instance attributes: "instanceMatrix" (mat4) and "instanceColor" (vec4);
+	// the shader reads them when the "instanced" uniform is true and falls back
+	// to the "matrix" and "color" uniforms otherwise
+	class GlBackend : public Backend {
+	  public:
+		GlBackend();
+		void setShader( ci::gl::GlslProg *shader ){ mShader = shader; };
+		void submit( const ci::gl::VboMesh &mesh, const InstanceData *instances, size_t count );
+
+	  private:
+		ci::gl::GlslProg	*mShader;
+		ci::gl::Vbo			mInstanceVbo;
+		bool				mHasCheckedExtensions;
+		bool				mIsInstancingAvailable;
+	};
+
+	InstanceBatch();
+
+	void		setBackend( Backend *backend ){ mBackend = backend; };
+	void		setNumThreads( int numThreads ){ mNumThreads = numThreads; };
+
+	// culls against the planes of a view-projection matrix; disabled by default
+	void		setFrustum( const ci::Matrix44f &viewProjection );
+	void		disableCulling(){ mIsCulling = false; };
+	bool		isVisible( const InstanceData &instance, float meshRadius ) const;
+
+	// fn writes the matrix and colour for one object; meshRadius bounds the
+	// mesh in model space for culling
+	template<typename T>
+	void		fill( const std::vector<T> &objects, void (*fn)( const T &, InstanceData * ), float meshRadius );
+	void		draw( const ci::gl::VboMesh &mesh );
+
+	// shared meshes; getBoundingRadius gives fill()'s meshRadius for positions about the origin
+	static ci::gl::VboMesh	createCube( float size );
+	static float			getBoundingRadius( const std::vector<ci::Vec3f> &positions );
+
+	const InstanceData*	getInstances() const { return mInstances.empty() ? NULL : &mInstances[0]; };
+	size_t		getNumInstances() const { return mNumInstances; };
+
+  private:
+	template<typename T>
+	void		fillRange( const std::vector<T> *objects, void (*fn)( const T &, InstanceData * ), float meshRadius, size_t begin, size_t end, size_t *numKept );
+
+	Backend						*mBackend;
+	std::vector<InstanceData>	mInstances;		// grows only
+	size_t						mNumInstances;
+	std::vector<size_t>			mChunkCounts;
+
+	bool						mIsCulling;
+	ci::Vec4f					mPlanes[6];
+	int							mNumThreads;
+};
+
+template<typename T>
+void InstanceBatch::fill( const std::vector<T> &objects, void (*fn)( const T &, InstanceData * ), float meshRadius )
+{
+	size_t count = objects.size();
+	if( mInstances.size() < count ) mInstances.resize( count );
+
+	int numThreads = std::max( std::min( mNumThreads, (int)( count / 1024 ) ), 1 );
+	size_t chunk = ( count + numThreads - 1 ) / numThreads;
+	mChunkCounts.assign( numThreads, 0 );
+
+	boost::thread_group threads;
+	for( int t=1; t<numThreads; t++ ){
+		size_t begin	= std::min( t * chunk, count );
+		size_t end		= std::min( begin + chunk, count );
+		threads.create_thread( boost::bind( &InstanceBatch::fillRange<T>, this, &objects, fn, meshRadius, begin, end, &mChunkCounts[t] ) );
+	}
+	fillRange( &objects, fn, meshRadius, 0, std::min( chunk, count ), &mChunkCounts[0] );
+	threads.join_all();
+
+	// close the gaps left by culled instances
+	mNumInstances = mChunkCounts[0];
+	for( int t=1; t<numThreads; t++ ){
+		size_t begin = std::min( t * chunk, count );
+		if( mNumInstances != begin ){
+			std::copy( mInstances.begin() + begin, mInstances.begin() + begin + mChunkCounts[t], mInstances.begin() + mNumInstances );
+		}
+		mNumInstances += mChunkCounts[t];
+	}
+}
+
+template<typename T>
+void InstanceBatch::fillRange( const std::vector<T> *objects, void (*fn)( const T &, InstanceData * ), float meshRadius, size_t begin, size_t end, size_t *numKept )
+{
+	size_t kept = begin;
+	for( size_t i=begin; i<end; i++ ){
+		InstanceData *instance = &mInstances[kept];
+		fn( (*objects)[i], instance );
+		if( !mIsCulling || isVisible( *instance, meshRadius ) ) kept++;
+	}
+	*numKept = kept - begin;
+}
@@ -1,15 +1,23 @@
 uniform vec3 eyePos;
 uniform mat4 matrix;
+uniform vec3 color;
 uniform mat4 mvpMatrix;
+uniform bool instanced;
+
+attribute mat4 instanceMatrix;
+attribute vec4 instanceColor;
 
 varying vec3 vEyeDir;
 varying vec4 vVertex;
 varying vec3 vNormal;
+varying vec3 vColor;
 
 void main()
 {
 	vNormal			= normalize( gl_Normal );
-	vVertex			= matrix * vec4( gl_Vertex );
+	mat4 m			= instanced ? instanceMatrix : matrix;
+	vColor			= instanced ? instanceColor.rgb : color;
+	vVertex			= m * vec4( gl_Vertex );
 	
 	vEyeDir			= normalize( eyePos - vVertex.xyz );
 	
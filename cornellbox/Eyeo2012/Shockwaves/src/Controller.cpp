@@ -15,8 +15,17 @@ using namespace ci;
 using std::vector;
 using std::list;
 
+namespace {
+	void nodeToInstance( const Node &node, InstanceData *instance )
+	{
+		instance->mMatrix	= node.mMatrix;
+		instance->mColor	= Vec4f( node.mColor.r, node.mColor.g, node.mColor.b, 1.0f );
+	}
+}
+
 Controller::Controller()
 {
+	mNodeBatch.setBackend( &mNodeBackend );
 }
 
 void Controller::init( Room *room, int gridDim )
@@ -29,6 +38,7 @@ void Controller::init( Room *room, int gridDim )
 	createNodes( gridDim );
 	
 	createSphere( mSphereVbo, 3 );
+	mNodeVbo = InstanceBatch::createCube( 2.0f );
 }
 
 void Controller::createNodes( int gridDim )
@@ -180,11 +190,10 @@ void Controller::draw()
 
 void Controller::drawNodes( ci::gl::GlslProg *shader )
 {
-	for( vector<Node>::iterator it = mNodes.begin(); it != mNodes.end(); ++it ){
-		shader->uniform( "matrix", it->mMatrix );
-		shader->uniform( "color", it->mColor );
-		it->draw();
-	}
+	// one instanced draw for every node; the cube spans -1..1, so sqrt(3) bounds it
+	mNodeBackend.setShader( shader );
+	mNodeBatch.fill( mNodes, nodeToInstance, 1.7320508f );
+	mNodeBatch.draw( mNodeVbo );
 }
 
 void Controller::drawConnections()
@@ -0,0 +1,182 @@
+//
+//  InstanceBatch.cpp
+//  Shockwaves
+//
+
+#include "InstanceBatch.h"
+#include <cmath>
+#include <cstddef>
+
+using namespace ci;
+using std::vector;
+
+void InstanceBatch::RecordingBackend::submit( const gl::VboMesh &mesh, const InstanceData *instances, size_t count )
+{
+	Submission submission;
+	submission.mMesh = &mesh;
+	submission.mInstances.assign( instances, instances + count );
+	mSubmissions.push_back( submission );
+}
+
+InstanceBatch::GlBackend::GlBackend()
+{
+	mShader					= NULL;
+	mHasCheckedExtensions	= false;
+	mIsInstancingAvailable	= false;
+}
+
+void InstanceBatch::GlBackend::submit( const gl::VboMesh &mesh, const InstanceData *instances, size_t count )
+{
+	if( mShader == NULL || count == 0 ) return;
+
+	// needs a current context, so it can't happen in the constructor
+	if( !mHasCheckedExtensions ){
+		mIsInstancingAvailable	= gl::isExtensionAvailable( "GL_ARB_instanced_arrays" ) && gl::isExtensionAvailable( "GL_ARB_draw_instanced" );
+		mHasCheckedExtensions	= true;
+	}
+
+	if( !mIsInstancingAvailable ){
+		mShader->uniform( "instanced", 0 );
+		for( size_t i=0; i<count; i++ ){
+			mShader->uniform( "matrix", instances[i].mMatrix );
+			mShader->uniform( "color", instances[i].mColor.xyz() );
+			gl::draw( mesh );
+		}
+		return;
+	}
+
+	if( !mInstanceVbo )
+		mInstanceVbo = gl::Vbo( GL_ARRAY_BUFFER );
+
+	GLint matrixLoc	= glGetAttribLocation( mShader->getHandle(), "instanceMatrix" );
+	GLint colorLoc	= glGetAttribLocation( mShader->getHandle(), "instanceColor" );
+	GLsizei stride	= sizeof( InstanceData );
+
+	mInstanceVbo.bind();
+	mInstanceVbo.bufferData( count * stride, instances, GL_STREAM_DRAW );
+
+	// a mat4 attribute takes four consecutive locations, one per column
+	for( int c=0; matrixLoc >= 0 && c<4; c++ ){
+		glEnableVertexAttribArray( matrixLoc + c );
+		glVertexAttribPointer( matrixLoc + c, 4, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)( offsetof( InstanceData, mMatrix ) + c * 4 * sizeof(float) ) );
+		glVertexAttribDivisorARB( matrixLoc + c, 1 );
+	}
+	if( colorLoc >= 0 ){
+		glEnableVertexAttribArray( colorLoc );
+		glVertexAttribPointer( colorLoc, 4, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof( InstanceData, mColor ) );
+		glVertexAttribDivisorARB( colorLoc, 1 );
+	}
+	mInstanceVbo.unbind();
+
+	mShader->uniform( "instanced", 1 );
+	mesh.enableClientStates();
+	mesh.bindAllData();
+	glDrawArraysInstancedARB( mesh.getPrimitiveType(), 0, mesh.getNumVertices(), (GLsizei)count );
+	gl::VboMesh::unbindBuffers();
+	mesh.disableClientStates();
+
+	for( int c=0; matrixLoc >= 0 && c<4; c++ ){
+		glVertexAttribDivisorARB( matrixLoc + c, 0 );
+		glDisableVertexAttribArray( matrixLoc + c );
+	}
+	if( colorLoc >= 0 ){
+		glVertexAttribDivisorARB( colorLoc, 0 );
+		glDisableVertexAttribArray( colorLoc );
+	}
+	mShader->uniform( "instanced", 0 );
+}
+
+InstanceBatch::InstanceBatch()
+{
+	mBackend		= NULL;
+	mNumInstances	= 0;
+	mIsCulling		= false;
+	mNumThreads		= std::max( (int)boost::thread::hardware_concurrency(), 1 );
+}
+
+void InstanceBatch::setFrustum( const Matrix44f &m )
+{
+	// Gribb / Hartmann: each plane is the last row of the matrix plus or minus one of the others
+	Vec4f rows[4];
+	for( int r=0; r<4; r++ ){
+		rows[r] = Vec4f( m.m[r], m.m[4 + r], m.m[8 + r], m.m[12 + r] );
+	}
+
+	for( int i=0; i<3; i++ ){
+		mPlanes[i*2]	= Vec4f( rows[3].x + rows[i].x, rows[3].y + rows[i].y, rows[3].z + rows[i].z, rows[3].w + rows[i].w );
+		mPlanes[i*2+1]	= Vec4f( rows[3].x - rows[i].x, rows[3].y - rows[i].y, rows[3].z - rows[i].z, rows[3].w - rows[i].w );
+	}
+
+	for( int i=0; i<6; i++ ){
+		float len = sqrtf( mPlanes[i].x * mPlanes[i].x + mPlanes[i].y * mPlanes[i].y + mPlanes[i].z * mPlanes[i].z );
+		if( len > 0.0f ){
+			mPlanes[i].x /= len;
+			mPlanes[i].y /= len;
+			mPlanes[i].z /= len;
+			mPlanes[i].w /= len;
+		}
+	}
+
+	mIsCulling = true;
+}
+
+bool InstanceBatch::isVisible( const InstanceData &instance, float meshRadius ) const
+{
+	const float *m = instance.mMatrix.m;
+	float scaleSqrd = std::max( m[0]*m[0] + m[1]*m[1] + m[2]*m[2],
+					  std::max( m[4]*m[4] + m[5]*m[5] + m[6]*m[6], m[8]*m[8] + m[9]*m[9] + m[10]*m[10] ) );
+	float radius	= meshRadius * sqrtf( scaleSqrd );
+
+	for( int i=0; i<6; i++ ){
+		const Vec4f &p = mPlanes[i];
+		if( p.x * m[12] + p.y * m[13] + p.z * m[14] + p.w < -radius ) return false;
+	}
+	return true;
+}
+
+// same geometry as gl::drawCube( Vec3f::zero(), Vec3f( size, size, size ) )
+gl::VboMesh InstanceBatch::createCube( float size )
+{
+	static const float faceNormals[6][3] = {
+		{ 1, 0, 0 }, {-1, 0, 0 }, { 0, 1, 0 }, { 0,-1, 0 }, { 0, 0, 1 }, { 0, 0,-1 } };
+	
+	float h = size * 0.5f;
+	vector<Vec3f> positions;
+	vector<Vec3f> normals;
+	for( int f=0; f<6; f++ ){
+		Vec3f n( faceNormals[f][0], faceNormals[f][1], faceNormals[f][2] );
+		Vec3f u( n.y, n.z, n.x );
+		Vec3f v = n.cross( u );
+		Vec3f c = n * h;
+		Vec3f corners[4] = { c - u*h - v*h, c + u*h - v*h, c + u*h + v*h, c - u*h + v*h };
+		int tris[6] = { 0, 1, 2, 0, 2, 3 };
+		for( int i=0; i<6; i++ ){
+			positions.push_back( corners[tris[i]] );
+			normals.push_back( n );
+		}
+	}
+	
+	gl::VboMesh::Layout layout;
+	layout.setStaticPositions();
+	layout.setStaticNormals();
+	gl::VboMesh vbo( positions.size(), 0, layout, GL_TRIANGLES );
+	vbo.bufferPositions( positions );
+	vbo.bufferNormals( normals );
+	return vbo;
+}
+
+float InstanceBatch::getBoundingRadius( const vector<Vec3f> &positions )
+{
+	float radiusSqrd = 0.0f;
+	for( vector<Vec3f>::const_iterator it = positions.begin(); it != positions.end(); ++it ){
+		radiusSqrd = std::max( radiusSqrd, it->lengthSquared() );
+	}
+	return sqrtf( radiusSqrd );
+}
+
+void InstanceBatch::draw( const gl::VboMesh &mesh )
+{
+	if( mBackend != NULL && mNumInstances > 0 ){
+		mBackend->submit( mesh, &mInstances[0], mNumInstances );
+	}
+}
@@ -401,6 +401,7 @@ void ShockwavesApp::draw()
 	mNodeShader.uniform( "eyePos", mSpringCam.getEye() );
 	mNodeShader.uniform( "power", mRoom.getPower() );
 	mNodeShader.uniform( "roomDims", mRoom.getDims() );
+	mController.mNodeBatch.setFrustum( mSpringCam.mMvpMatrix );
 	mController.drawNodes( &mNodeShader );
 	mNodeShader.unbind();
 	
@@ -0,0 +1,67 @@
+//
+//  RDiffusionCpu.h
+//  RDTerrain
+//
+//  CPU version of RDiffusion, with its heights and normals passes.
+//
+
+#pragma once
+
+#include "cinder/Vector.h"
+#include "cinder/Surface.h"
+#include <vector>
+
+class RDiffusionCpu {
+  public:
+	RDiffusionCpu();
+	RDiffusionCpu( int width, int height, uint32_t seed = 0 );
+	void			reset( uint32_t seed = 0 );
+	void			update( float dt, const ci::Vec2f &spherePos, float zoom );
+	void			updateHeights();
+	void			updateNormals();
+	void			setMode( int index );
+	void			setNumThreads( int numThreads ){ mNumThreads = numThreads; };
+
+	// rg = u, v as in RDiffusion::getTexture()
+	ci::Surface32f	getSurface() const;
+	// rg = texture coordinate, b = height
+	ci::Surface32f	getHeightsSurface() const;
+	ci::Surface32f	getNormalsSurface() const;
+	// write into an RGBA surface of the same size, for callers that keep theirs from frame to frame
+	void			copyHeightsTo( ci::Surface32f *surface ) const;
+	void			copyNormalsTo( ci::Surface32f *surface ) const;
+
+	int					mWidth, mHeight;
+
+	float				mKernel[9];
+
+	float				mParamU;
+	float				mParamV;
+	float				mParamK;
+	float				mParamF;
+	float				mParamN;
+	float				mParamWind;
+
+	static const int	sTileSize	= 64;
+	static const int	sIterations	= 7;
+
+  private:
+	typedef void (RDiffusionCpu::*TileFn)( int x0, int y0, int x1, int y1 );
+
+	void			forEachTile( TileFn fn );
+	void			runTiles( TileFn fn, int first, int stride );
+	void			stepTile( int x0, int y0, int x1, int y1 );
+	void			heightsTile( int x0, int y0, int x1, int y1 );
+	void			normalsTile( int x0, int y0, int x1, int y1 );
+	void			stamp( const ci::Vec2f &center, float radius, float alpha );
+	void			sampleNormal( float x, float y, float *nx, float *ny ) const;
+
+	int				mThis, mPrev;
+	float			mStepDt;
+
+	std::vector<float>	mU[2], mV[2];
+	std::vector<float>	mHeights;
+	std::vector<float>	mNormalsX, mNormalsY, mNormalsZ;
+
+	int				mNumThreads;
+};
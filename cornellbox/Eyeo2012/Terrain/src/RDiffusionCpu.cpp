@@ -0,0 +1,442 @@
+//
+//  RDiffusionCpu.cpp
+//  RDTerrain
+//
+
+#include "RDiffusionCpu.h"
+#include "cinder/CinderMath.h"
+#include "cinder/Rand.h"
+#include "cinder/Thread.h"
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace ci;
+using std::vector;
+
+namespace {
+
+inline float clamp01( float x )
+{
+	return x < 0.0f ? 0.0f : ( x > 1.0f ? 1.0f : x );
+}
+
+// 3x3 weighted sum, kernel rows are t - 1, t and t + 1 as in rd.frag
+inline float convolve( const float *rm, const float *r0, const float *rp, int xm, int x, int xp, const float *k )
+{
+	return rm[xm] * k[0] + rm[x] * k[1] + rm[xp] * k[2]
+		 + r0[xm] * k[3] + r0[x] * k[4] + r0[xp] * k[5]
+		 + rp[xm] * k[6] + rp[x] * k[7] + rp[xp] * k[8];
+}
+
+} // anonymous namespace
+
+RDiffusionCpu::RDiffusionCpu()
+{
+	mWidth		= 0;
+	mHeight		= 0;
+
+	mParamU		= 0.1335f;
+	mParamV		= 0.0360f;
+	mParamF		= 0.0003f;
+	mParamK		= 0.0250f;
+	mParamN		= 0.03f;
+	mParamWind	= 1.0f;
+
+	for( int i = 0; i < 9; i++ ){
+		mKernel[i] = 0.0f;
+	}
+
+	mThis		= 0;
+	mPrev		= 1;
+	mStepDt		= 0.0f;
+	mNumThreads	= 1;
+}
+
+RDiffusionCpu::RDiffusionCpu( int w, int h, uint32_t seed )
+{
+	mWidth			= w;
+	mHeight			= h;
+
+	mParamU			= 0.1335f;
+	mParamV			= 0.0360f;
+	mParamF			= 0.0003f;
+	mParamK			= 0.0250f;
+	mParamN			= 0.03f;
+	mParamWind		= 1.0f;
+
+	mNumThreads		= std::max( (int)boost::thread::hardware_concurrency(), 1 );
+
+	float diag		= 0.707106781186f;
+	float side		= 1.0f;
+	float center	= -6.828427124746f;
+	mKernel[0]		= diag;
+	mKernel[1]		= side;
+	mKernel[2]		= diag;
+	mKernel[3]		= side;
+	mKernel[4]		= center;
+	mKernel[5]		= side;
+	mKernel[6]		= diag;
+	mKernel[7]		= side;
+	mKernel[8]		= diag;
+
+	int size		= w * h;
+	for( int i = 0; i < 2; i++ ){
+		mU[i].resize( size );
+		mV[i].resize( size );
+	}
+	mHeights.resize( size );
+	mNormalsX.resize( size );
+	mNormalsY.resize( size );
+	mNormalsZ.resize( size );
+
+	reset( seed );
+}
+
+void RDiffusionCpu::reset( uint32_t seed )
+{
+	mThis		= 0;
+	mPrev		= 1;
+	mStepDt		= 0.0f;
+
+	for( int i = 0; i < 2; i++ ){
+		std::fill( mU[i].begin(), mU[i].end(), 0.0f );
+		std::fill( mV[i].begin(), mV[i].end(), 0.0f );
+	}
+	std::fill( mHeights.begin(), mHeights.end(), 0.0f );
+	std::fill( mNormalsX.begin(), mNormalsX.end(), 0.0f );
+	std::fill( mNormalsY.begin(), mNormalsY.end(), 0.0f );
+	std::fill( mNormalsZ.begin(), mNormalsZ.end(), 0.0f );
+
+	// a seed of 0 starts blank, like the cleared FBOs
+	if( seed != 0 ){
+		Rand rnd( seed );
+		int numSpots = std::max( ( mWidth * mHeight ) / ( 128 * 128 ), 1 );
+		for( int i = 0; i < numSpots; i++ ){
+			Vec2f pos( rnd.nextFloat( (float)mWidth ), rnd.nextFloat( (float)mHeight ) );
+			stamp( pos, rnd.nextFloat( 8.0f, 20.0f ), 1.0f );
+		}
+	}
+}
+
+void RDiffusionCpu::update( float dt, const Vec2f &spherePos, float zoom )
+{
+	// same sphere driven kernel skew as RDiffusion::update()
+	Vec2f sphereNorm = ( spherePos + Vec2f( 300.0f, 300.0f ) )/Vec2f( 600.0f, 600.0f );
+	float xo	= ( sphereNorm.x - 0.5f ) * 2.0f;
+	float yo	= ( ( 1.0f - sphereNorm.y ) - 0.5f ) * 2.0f;
+
+	sphereNorm	= ( sphereNorm - Vec2f( 0.5f, 0.5f ) ) * ( zoom * 0.96f + 0.04f ) + Vec2f( 0.5f, 0.5f );
+	Vec2f newSpherePos( sphereNorm.x * mWidth, sphereNorm.y * mHeight );
+
+	float diag	= 0.707106781186f;
+	float side	= 1.0f;
+	float center= -6.828427124746f;
+
+	mKernel[0]	= diag - xo - yo;
+	mKernel[1]	= side - yo;
+	mKernel[2]	= diag + xo - yo;
+	mKernel[3]	= side - xo;
+	mKernel[4]	= center;
+	mKernel[5]	= side + xo;
+	mKernel[6]	= diag - xo + yo;
+	mKernel[7]	= side + yo;
+	mKernel[8]	= diag + xo + yo;
+
+	mStepDt		= dt * 0.25f;
+	float r		= 20.0f - ( 1.0f - zoom ) * 12.0f;
+
+	for( int i = 0; i < sIterations; i++ ){
+		mThis	= ( mThis + 1 ) % 2;
+		mPrev	= ( mThis + 1 ) % 2;
+
+		forEachTile( &RDiffusionCpu::stepTile );
+		stamp( newSpherePos, r, zoom * 0.97f + 0.03f );
+	}
+}
+
+void RDiffusionCpu::updateHeights()
+{
+	forEachTile( &RDiffusionCpu::heightsTile );
+}
+
+void RDiffusionCpu::updateNormals()
+{
+	forEachTile( &RDiffusionCpu::normalsTile );
+}
+
+void RDiffusionCpu::forEachTile( TileFn fn )
+{
+	int numTiles	= ( ( mWidth + sTileSize - 1 ) / sTileSize ) * ( ( mHeight + sTileSize - 1 ) / sTileSize );
+	int numThreads	= std::min( mNumThreads, numTiles );
+
+	boost::thread_group threads;
+	for( int t = 1; t < numThreads; t++ ){
+		threads.create_thread( boost::bind( &RDiffusionCpu::runTiles, this, fn, t, numThreads ) );
+	}
+	runTiles( fn, 0, std::max( numThreads, 1 ) );
+	threads.join_all();
+}
+
+void RDiffusionCpu::runTiles( TileFn fn, int first, int stride )
+{
+	int tilesX		= ( mWidth + sTileSize - 1 ) / sTileSize;
+	int tilesY		= ( mHeight + sTileSize - 1 ) / sTileSize;
+
+	for( int tile = first; tile < tilesX * tilesY; tile += stride ){
+		int x0 = ( tile % tilesX ) * sTileSize;
+		int y0 = ( tile / tilesX ) * sTileSize;
+		(this->*fn)( x0, y0, std::min( x0 + sTileSize, mWidth ), std::min( y0 + sTileSize, mHeight ) );
+	}
+}
+
+void RDiffusionCpu::stepTile( int x0, int y0, int x1, int y1 )
+{
+	const float *u	= &mU[mPrev][0];
+	const float *v	= &mV[mPrev][0];
+	float *uOut		= &mU[mThis][0];
+	float *vOut		= &mV[mThis][0];
+	const float *k	= mKernel;
+
+	float lapU[sTileSize];
+	float lapV[sTileSize];
+
+	float dt		= mStepDt;
+	float windDrift	= 0.0025f * mParamWind * dt;
+	float nScaleX	= mParamN * mWidth;
+	float nScaleY	= mParamN * mHeight;
+
+	int xBegin		= std::max( x0, 1 );
+	int xEnd		= std::min( x1, mWidth - 1 );
+
+	for( int y = y0; y < y1; y++ ){
+		int ym = ( y == 0 ) ? mHeight - 1 : y - 1;
+		int yp = ( y == mHeight - 1 ) ? 0 : y + 1;
+
+		const float *um = u + ym * mWidth;
+		const float *u0 = u + y * mWidth;
+		const float *up = u + yp * mWidth;
+		const float *vm = v + ym * mWidth;
+		const float *v0 = v + y * mWidth;
+		const float *vp = v + yp * mWidth;
+
+		// interior columns are branch free so the compiler can vectorise them
+		for( int x = xBegin; x < xEnd; x++ ){
+			lapU[x - x0] = convolve( um, u0, up, x - 1, x, x + 1, k );
+			lapV[x - x0] = convolve( vm, v0, vp, x - 1, x, x + 1, k );
+		}
+		if( x0 == 0 ){
+			lapU[0] = convolve( um, u0, up, mWidth - 1, 0, 1 % mWidth, k );
+			lapV[0] = convolve( vm, v0, vp, mWidth - 1, 0, 1 % mWidth, k );
+		}
+		if( x1 == mWidth && mWidth > 1 ){
+			lapU[x1 - 1 - x0] = convolve( um, u0, up, mWidth - 2, mWidth - 1, 0, k );
+			lapV[x1 - 1 - x0] = convolve( vm, v0, vp, mWidth - 2, mWidth - 1, 0, k );
+		}
+
+		for( int x = x0; x < x1; x++ ){
+			int i = y * mWidth + x;
+
+			// normals are looked up twice, the second time displaced by the first
+			float nr, ng;
+			sampleNormal( x + mNormalsX[i] * nScaleX, y + mNormalsY[i] * nScaleY, &nr, &ng );
+
+			float uu	= u[i];
+			float vv	= v[i] - ng * windDrift;
+			float uvv	= uu * vv * vv;
+
+			float K		= mParamK - nr * 0.1f;
+			float F		= mParamF - ng * 0.1f;
+
+			float du	= mParamU * lapU[x - x0] - uvv + F * ( 1.0f - uu );
+			float dv	= mParamV * lapV[x - x0] + uvv - ( F + K ) * vv;
+
+			uOut[i]		= clamp01( uu + du * dt );
+			vOut[i]		= clamp01( vv + dv * dt );
+		}
+	}
+}
+
+void RDiffusionCpu::heightsTile( int x0, int y0, int x1, int y1 )
+{
+	const float *u	= &mU[mThis][0];
+	const float *v	= &mV[mThis][0];
+	float *h		= &mHeights[0];
+
+	for( int y = y0; y < y1; y++ ){
+		int row = y * mWidth;
+		for( int x = row + x0; x < row + x1; x++ ){
+			float newHeight = h[x] + ( u[x] * 1.20f + v[x] * 0.25f );
+			h[x] = newHeight - newHeight * 0.1f;
+		}
+	}
+}
+
+void RDiffusionCpu::normalsTile( int x0, int y0, int x1, int y1 )
+{
+	const float *h = &mHeights[0];
+
+	for( int y = y0; y < y1; y++ ){
+		int yp = ( y == mHeight - 1 ) ? 0 : y + 1;
+		const float *h0Row = h + y * mWidth;
+		const float *h1Row = h + yp * mWidth;
+
+		for( int x = x0; x < x1; x++ ){
+			int xp		= ( x == mWidth - 1 ) ? 0 : x + 1;
+			float h0	= h0Row[x];
+			float dx	= h0 - h0Row[xp];
+			float dy	= h0 - h1Row[x];
+			float invLen= 1.0f / sqrtf( dx * dx + dy * dy + 1.0f );
+
+			int i = y * mWidth + x;
+			mNormalsX[i] = dx * invLen;
+			mNormalsY[i] = dy * invLen;
+			mNormalsZ[i] = invLen;
+		}
+	}
+}
+
+// blends u and v towards 1 under a soft disc, standing in for the glow sprite
+void RDiffusionCpu::stamp( const Vec2f &center, float radius, float alpha )
+{
+	if( radius <= 0.0f || mU[mThis].empty() ) return;
+
+	float *u	= &mU[mThis][0];
+	float *v	= &mV[mThis][0];
+
+	int xMin	= std::max( (int)floorf( center.x - radius ), 0 );
+	int xMax	= std::min( (int)ceilf( center.x + radius ), mWidth - 1 );
+	int yMin	= std::max( (int)floorf( center.y - radius ), 0 );
+	int yMax	= std::min( (int)ceilf( center.y + radius ), mHeight - 1 );
+	float invR	= 1.0f / radius;
+
+	for( int y = yMin; y <= yMax; y++ ){
+		for( int x = xMin; x <= xMax; x++ ){
+			float dx	= ( x + 0.5f - center.x ) * invR;
+			float dy	= ( y + 0.5f - center.y ) * invR;
+			float falloff = 1.0f - sqrtf( dx * dx + dy * dy );
+			if( falloff <= 0.0f ) continue;
+
+			float a	= alpha * falloff * falloff;
+			int i	= y * mWidth + x;
+			u[i]	+= ( 1.0f - u[i] ) * a;
+			v[i]	+= ( 1.0f - v[i] ) * a;
+		}
+	}
+}
+
+// bilinear, wrapping lookup of the normal xy, matching GL_LINEAR / GL_REPEAT
+void RDiffusionCpu::sampleNormal( float x, float y, float *nx, float *ny ) const
+{
+	float fx	= floorf( x );
+	float fy	= floorf( y );
+	float tx	= x - fx;
+	float ty	= y - fy;
+
+	int x0		= (int)fx % mWidth;		if( x0 < 0 ) x0 += mWidth;
+	int y0		= (int)fy % mHeight;	if( y0 < 0 ) y0 += mHeight;
+	int x1		= ( x0 + 1 == mWidth ) ? 0 : x0 + 1;
+	int y1		= ( y0 + 1 == mHeight ) ? 0 : y0 + 1;
+
+	int i00		= y0 * mWidth + x0;
+	int i10		= y0 * mWidth + x1;
+	int i01		= y1 * mWidth + x0;
+	int i11		= y1 * mWidth + x1;
+
+	float w00	= ( 1.0f - tx ) * ( 1.0f - ty );
+	float w10	= tx * ( 1.0f - ty );
+	float w01	= ( 1.0f - tx ) * ty;
+	float w11	= tx * ty;
+
+	*nx = mNormalsX[i00] * w00 + mNormalsX[i10] * w10 + mNormalsX[i01] * w01 + mNormalsX[i11] * w11;
+	*ny = mNormalsY[i00] * w00 + mNormalsY[i10] * w10 + mNormalsY[i01] * w01 + mNormalsY[i11] * w11;
+}
+
+void RDiffusionCpu::setMode( int index )
+{
+	if( index == 1 ){
+		mParamU	= 0.1335f;
+		mParamV	= 0.0360f;
+		mParamF	= 0.0003f;
+		mParamK	= 0.0250f;
+		mParamN = 0.09850f;
+		mParamWind = 1.0f;
+	} else if( index == 2 ){
+		mParamU = 0.1335f;
+		mParamV = 0.0451f;
+		mParamF	= 0.0100f;
+		mParamK	= 0.0368f;
+		mParamN	= 0.01f;
+		mParamWind = 0.0f;
+	} else if( index == 3 ){
+		mParamU = 0.1335f;
+		mParamV = 0.0400f;
+		mParamF	= 0.0006f;
+		mParamK	= 0.0368f;
+		mParamN	= 0.4150f;
+		mParamWind = 1.0f;
+	}
+}
+
+Surface32f RDiffusionCpu::getSurface() const
+{
+	Surface32f surface( mWidth, mHeight, true, SurfaceChannelOrder::RGBA );
+	const float *u = &mU[mThis][0];
+	const float *v = &mV[mThis][0];
+
+	for( int y = 0; y < mHeight; y++ ){
+		float *p = surface.getData() + y * ( surface.getRowBytes() / sizeof(float) );
+		for( int x = 0; x < mWidth; x++ ){
+			int i	= y * mWidth + x;
+			p[0]	= u[i];
+			p[1]	= v[i];
+			p[2]	= 0.0f;
+			p[3]	= 1.0f;
+			p		+= 4;
+		}
+	}
+	return surface;
+}
+
+Surface32f RDiffusionCpu::getHeightsSurface() const
+{
+	Surface32f surface( mWidth, mHeight, true, SurfaceChannelOrder::RGBA );
+	copyHeightsTo( &surface );
+	return surface;
+}
+
+void RDiffusionCpu::copyHeightsTo( Surface32f *surface ) const
+{
+	for( int y = 0; y < mHeight; y++ ){
+		float *p = surface->getData() + y * ( surface->getRowBytes() / sizeof(float) );
+		for( int x = 0; x < mWidth; x++ ){
+			p[0]	= ( x + 0.5f ) / (float)mWidth;
+			p[1]	= ( y + 0.5f ) / (float)mHeight;
+			p[2]	= mHeights[y * mWidth + x];
+			p[3]	= 1.0f;
+			p		+= 4;
+		}
+	}
+}
+
+Surface32f RDiffusionCpu::getNormalsSurface() const
+{
+	Surface32f surface( mWidth, mHeight, true, SurfaceChannelOrder::RGBA );
+	copyNormalsTo( &surface );
+	return surface;
+}
+
+void RDiffusionCpu::copyNormalsTo( Surface32f *surface ) const
+{
+	for( int y = 0; y < mHeight; y++ ){
+		float *p = surface->getData() + y * ( surface->getRowBytes() / sizeof(float) );
+		for( int x = 0; x < mWidth; x++ ){
+			int i	= y * mWidth + x;
+			p[0]	= mNormalsX[i];
+			p[1]	= mNormalsY[i];
+			p[2]	= mNormalsZ[i];
+			p[3]	= 1.0f;
+			p		+= 4;
+		}
+	}
+}
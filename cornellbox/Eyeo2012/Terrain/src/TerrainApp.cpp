@@ -16,6 +16,7 @@
 #include "SpringCam.h"
 #include "Terrain.h"
 #include "RDiffusion.h"
+#include "RDiffusionCpu.h"
 
 using namespace ci;
 using namespace ci::app;
@@ -44,6 +45,8 @@ class TerrainApp : public AppBasic {
 	void			drawNodes();
 	void			drawTerrain();
 	void			drawInfoPanel();
+	void			updateRdCpu();
+	void			bindRdTextures( int heightsUnit, int normalsUnit );
 	
 	// CAMERA
 	SpringCam			mSpringCam;
@@ -86,6 +89,12 @@ class TerrainApp : public AppBasic {
 	RDiffusion			mRd;
 	gl::GlslProg		mRdShader, mHeightsShader, mNormalsShader, mTerrainShader;
 	gl::Texture			mGlowTex;
+	
+	// REACTION DIFFUSION ON THE CPU, TOGGLED WITH 'g'
+	RDiffusionCpu		mRdCpu;
+	Surface32f			mRdCpuHeights, mRdCpuNormals;
+	gl::Texture			mRdCpuHeightsTex, mRdCpuNormalsTex;
+	bool				mRdOnCpu;
 
 	// SPHERE
 	Sphere				mSphere;
@@ -172,6 +181,7 @@ void TerrainApp::setup()
 	
 	// REACTION DIFFUSION
 	mRd				= RDiffusion( FBO_SIZE, FBO_SIZE );
+	mRdOnCpu		= false;
 
 	// SPHERE
 	mSpherePos		= Vec3f::zero();
@@ -265,6 +275,8 @@ void TerrainApp::keyDown( KeyEvent event )
 		case '3':	mRd.setMode(3);				break;
 		case 'c':	mSpringCam.setPreset( 0 );	break;
 		case 'C':	mSpringCam.setPreset( 2 );	break;
+		case 'g':	mRdOnCpu = !mRdOnCpu;
+					console() << "Reaction diffusion on the " << ( mRdOnCpu ? "CPU" : "GPU" ) << std::endl;	break;
 		default:								break;
 	}
 	
@@ -302,9 +314,13 @@ void TerrainApp::update()
 	gl::disableAlphaBlending();
 	
 	// REACTION DIFFUSION
-	mRd.update( mRoom.getTimeDelta(), &mRdShader, mGlowTex, mMouseRightDown, mSphere.getCenter().xz(), mZoomMulti );
-	mRd.drawIntoHeightsFbo( &mHeightsShader, mTerrainScale );
-	mRd.drawIntoNormalsFbo( &mNormalsShader );
+	if( mRdOnCpu ){
+		updateRdCpu();
+	} else {
+		mRd.update( mRoom.getTimeDelta(), &mRdShader, mGlowTex, mMouseRightDown, mSphere.getCenter().xz(), mZoomMulti );
+		mRd.drawIntoHeightsFbo( &mHeightsShader, mTerrainScale );
+		mRd.drawIntoNormalsFbo( &mNormalsShader );
+	}
 	
 	// ROOM
 	drawIntoRoomFbo();
@@ -315,6 +331,50 @@ void TerrainApp::update()
 	mSpringCam.update( mRoom.getPower(), 0.5f );
 }
 
+// steps RDiffusionCpu with the GPU engine's parameters, so the keys and modes apply to both, and
+// uploads its heights and normals in place of the FBOs
+void TerrainApp::updateRdCpu()
+{
+	if( mRdCpu.mWidth != FBO_SIZE ){
+		mRdCpu = RDiffusionCpu( FBO_SIZE, FBO_SIZE );
+		
+		gl::Texture::Format format;
+		format.setInternalFormat( GL_RGBA32F_ARB );
+		format.setWrap( GL_REPEAT, GL_REPEAT );
+		mRdCpuHeightsTex = gl::Texture( FBO_SIZE, FBO_SIZE, format );
+		mRdCpuNormalsTex = gl::Texture( FBO_SIZE, FBO_SIZE, format );
+		mRdCpuHeights	= Surface32f( FBO_SIZE, FBO_SIZE, true, SurfaceChannelOrder::RGBA );
+		mRdCpuNormals	= Surface32f( FBO_SIZE, FBO_SIZE, true, SurfaceChannelOrder::RGBA );
+	}
+	
+	mRdCpu.mParamU		= mRd.mParamU;
+	mRdCpu.mParamV		= mRd.mParamV;
+	mRdCpu.mParamK		= mRd.mParamK;
+	mRdCpu.mParamF		= mRd.mParamF;
+	mRdCpu.mParamN		= mRd.mParamN;
+	mRdCpu.mParamWind	= mRd.mParamWind;
+	
+	mRdCpu.update( mRoom.getTimeDelta(), mSphere.getCenter().xz(), mZoomMulti );
+	mRdCpu.updateHeights();
+	mRdCpu.updateNormals();
+	
+	mRdCpu.copyHeightsTo( &mRdCpuHeights );
+	mRdCpu.copyNormalsTo( &mRdCpuNormals );
+	mRdCpuHeightsTex.update( mRdCpuHeights );
+	mRdCpuNormalsTex.update( mRdCpuNormals );
+}
+
+void TerrainApp::bindRdTextures( int heightsUnit, int normalsUnit )
+{
+	if( mRdOnCpu ){
+		mRdCpuHeightsTex.bind( heightsUnit );
+		mRdCpuNormalsTex.bind( normalsUnit );
+	} else {
+		mRd.getHeightsTexture().bind( heightsUnit );
+		mRd.getNormalsTexture().bind( normalsUnit );
+	}
+}
+
 void TerrainApp::drawIntoRoomFbo()
 {
 	mRoomFbo.bindFramebuffer();
@@ -401,8 +461,7 @@ void TerrainApp::drawSphere()
 	Vec2f texCoord = Vec2f( x, y );
 	
 	mCubeMap.bind();
-	mRd.getHeightsTexture().bind( 1 );
-	mRd.getNormalsTexture().bind( 2 );
+	bindRdTextures( 1, 2 );
 	mSphereShader.bind();
 	mSphereShader.uniform( "cubeMap", 0 );
 	mSphereShader.uniform( "heightsTex", 1 );
@@ -424,8 +483,7 @@ void TerrainApp::drawSphere()
 
 void TerrainApp::drawTerrain()
 {
-	mRd.getHeightsTexture().bind( 0 );
-	mRd.getNormalsTexture().bind( 1 );
+	bindRdTextures( 0, 1 );
 	mGradientTex.bind( 2 );
 	mSandNormalTex.bind( 3 );
 	mTerrainShader.bind();
@@ -0,0 +1,120 @@
+//
+//  ParticleSeeder.h
+//
+//  Particle positions seeded from a luminance image, in one pass over it.
+//
+
+#pragma once
+
+#include "cinder/Rand.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ParticleSeeder {
+  public:
+	enum Weighting {
+		MASK,		// every pixel past the threshold is equally likely, as the setupTextures() loops picked them
+		LUMINANCE	// pixels are picked in proportion to how far past the threshold they are
+	};
+
+	class Format {
+	  public:
+		Format() : mThreshold( 100.0f ), mBelow( false ), mFromMean( false ), mWeighting( MASK ),
+			mXChannel( 0 ), mYChannel( 1 ), mZChannel( 2 ), mXScale( 1.0f ), mXOffset( 0.0f ), mYScale( 1.0f ), mYOffset( 0.0f ),
+			mZJitter( 0.001f ), mMassMin( 0.2f ), mMassMax( 1.0f ), mPixelJitter( true ) {}
+
+		//! pixels brighter than \a threshold are candidates, or darker when \a below is set
+		Format&	threshold( float threshold, bool below = false )	{ mThreshold = threshold; mBelow = below; mFromMean = false; return *this; }
+		//! the threshold is the mean of each image plus \a offset, as areaAverage() + offset was
+		Format&	thresholdFromMean( float offset, bool below = false )	{ mThreshold = offset; mBelow = below; mFromMean = true; return *this; }
+		Format&	weighting( Weighting weighting )					{ mWeighting = weighting; return *this; }
+		//! RGBA channel that receives x, y and z; alpha always holds the mass
+		Format&	channels( int x, int y, int z )						{ mXChannel = x; mYChannel = y; mZChannel = z; return *this; }
+		//! x = u * scale + offset, where u is the position across the image from 0 to 1; likewise for y
+		Format&	xMapping( float scale, float offset )				{ mXScale = scale; mXOffset = offset; return *this; }
+		Format&	yMapping( float scale, float offset )				{ mYScale = scale; mYOffset = offset; return *this; }
+		//! z = ( rand - 0.5 ) * jitter
+		Format&	zJitter( float jitter )								{ mZJitter = jitter; return *this; }
+		Format&	mass( float min, float max )						{ mMassMin = min; mMassMax = max; return *this; }
+		//! off puts every particle on its pixel's corner, like the old loops did
+		Format&	pixelJitter( bool jitter )							{ mPixelJitter = jitter; return *this; }
+
+		float		mThreshold;
+		bool		mBelow, mFromMean;
+		Weighting	mWeighting;
+		int			mXChannel, mYChannel, mZChannel;
+		float		mXScale, mXOffset, mYScale, mYOffset;
+		float		mZJitter, mMassMin, mMassMax;
+		bool		mPixelJitter;
+	};
+
+	ParticleSeeder( const Format &format = Format(), uint32_t seed = 214 );
+
+	void			setFormat( const Format &format )	{ mFormat = format; }
+	const Format&	getFormat() const					{ return mFormat; }
+	void			setSeed( uint32_t seed )			{ mRand.seed( seed ); }
+
+	//! Weighs \a data, \a increment bytes between pixels and \a rowBytes between rows, as ci::Channel8u stores it.
+	void		setImage( const uint8_t *data, int width, int height, ptrdiff_t rowBytes, int increment = 1 );
+	//! Pixels with a nonzero weight in the last image; when 0, seeding is uniform.
+	size_t		getNumCandidates() const	{ return mNumCandidates; }
+
+	//! Seeds all \a width x \a height particles of an RGBA float image, \a rowStride floats between rows.
+	void		seed( float *pixels, int width, int height, size_t rowStride );
+	//! Seeds particles [ \a begin, \a end ) of the same image, row-major, and leaves the rest alone.
+	void		seedRange( float *pixels, int width, int height, size_t rowStride, size_t begin, size_t end );
+
+  private:
+	Format					mFormat;
+	ci::Rand				mRand;
+
+	int						mImageWidth, mImageHeight;
+	size_t					mNumCandidates;
+	std::vector<uint32_t>	mRowSums;		// inclusive prefix sum of the weights within each row
+	std::vector<uint64_t>	mRowStarts;		// weight before each row, one extra entry for the total
+};
+
+class ParticleSeedWorker {
+  public:
+	//! Particles are kept for a \a width x \a height RGBA float image.
+	ParticleSeedWorker( const ParticleSeeder::Format &format, int width, int height );
+	~ParticleSeedWorker();
+
+	//! Particles reseeded per submitted frame, walking through the image; 0 reseeds all of them every frame.
+	void		setParticlesPerFrame( size_t count );
+
+	//! Copies the frame and wakes the worker. A frame still waiting is replaced, never queued.
+	void		submit( const uint8_t *data, int width, int height, ptrdiff_t rowBytes, int increment = 1 );
+	//! Copies the latest particles into the \a width x \a height \a pixels; false until the first frame
+	//! is seeded, or when the size is not the one the worker was made for.
+	bool		acquire( float *pixels, int width, int height, size_t rowStride );
+	//! A frame finished since the last acquire().
+	bool		isFresh();
+	//! Blocks until every submitted frame is seeded.
+	void		wait();
+
+  private:
+	void		run();
+
+	// worker only
+	ParticleSeeder				mSeeder;
+	int							mWidth, mHeight;
+	size_t						mCursor;			// next particle to reseed
+	bool						mSeeded;			// every particle has been seeded at least once
+	std::vector<float>			mWork;
+	std::vector<uint8_t>		mWorkFrame;
+
+	std::mutex					mMutex;
+	std::condition_variable		mWake, mIdle;
+	std::vector<uint8_t>		mFrame;				// tightly packed copy of the last submitted frame
+	int							mFrameWidth, mFrameHeight;
+	size_t						mParticlesPerFrame;
+	bool						mHasFrame, mBusy, mHasResult, mFresh, mQuit;
+	std::vector<float>			mResult;
+	std::thread					mThread;
+};
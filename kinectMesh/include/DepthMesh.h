@@ -0,0 +1,58 @@
+//
+//  DepthMesh.h
+//
+//  The Kinect depth image as a grid mesh whose buffers persist across frames.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class DepthMesh {
+  public:
+	DepthMesh();
+
+	//! One vertex for every \a step pixels across and down a \a depthWidth by \a depthHeight depth
+	//! image, spread over x from -400 to 400 and y from 300 to -300, two triangles to a cell. Does
+	//! nothing when the resolution is what it was.
+	void			setResolution( int step, int depthWidth, int depthHeight );
+	//! Texture coordinates run from 0 to 1 over the grid; for the colour camera they are moved by
+	//! \a offsetX and \a offsetY to line it up with the depth camera, but not for the infrared image.
+	void			setTexCoords( bool infrared, float offsetX, float offsetY );
+
+	//! Sets z from \a depth, the full image: depth / 75 * \a depthScale, or that of \a minDepth where the
+	//! depth is outside \a minDepth to \a maxDepth. With \a colors, r, g and b for every depth value,
+	//! each vertex takes the colour of its raw depth. Triangles whose corners differ by more than
+	//! \a maxDepthStep in depth are cut out; 0 keeps them all.
+	void			update( const uint16_t *depth, int minDepth, int maxDepth, float depthScale, const float *colors = 0, int maxDepthStep = 0 );
+
+	int				getNumColumns() const	{ return mNumColumns; }
+	int				getNumRows() const		{ return mNumRows; }
+	size_t			getNumVertices() const	{ return (size_t)mNumColumns * mNumRows; }
+	size_t			getNumIndices() const	{ return mIndices.size(); }
+	size_t			getNumCut() const		{ return mNumCut; }
+
+	//! x, y and z per vertex, row after row.
+	const float*	getPositions() const	{ return mPositions.empty() ? 0 : &mPositions[0]; }
+	//! u and v per vertex.
+	const float*	getTexCoords() const	{ return mTexCoords.empty() ? 0 : &mTexCoords[0]; }
+	//! r, g and b per vertex, as of the last update() given colours.
+	const float*	getColors() const		{ return mColors.empty() ? 0 : &mColors[0]; }
+	const uint32_t*	getIndices() const		{ return mIndices.empty() ? 0 : &mIndices[0]; }
+
+  private:
+	void			cutSteps( int maxDepthStep );
+
+	int						mStep, mDepthWidth, mDepthHeight, mNumColumns, mNumRows;
+	bool					mInfrared;
+	float					mOffsetX, mOffsetY;
+
+	std::vector<float>		mPositions, mTexCoords, mColors;
+	std::vector<uint16_t>	mDepths;		// per vertex, as it went into z
+	std::vector<uint32_t>	mTriangles;		// the grid's triangles, as laid out
+	std::vector<uint32_t>	mIndices;		// as drawn, with those cut out
+	std::vector<uint8_t>	mCells;			// per cell, whether its first and second triangles are cut
+	size_t					mNumCut;
+};
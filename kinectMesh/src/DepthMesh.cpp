@@ -0,0 +1,140 @@
+//
+//  DepthMesh.cpp
+//
+
+#include "DepthMesh.h"
+
+#include <algorithm>
+
+using namespace std;
+
+DepthMesh::DepthMesh()
+	: mStep( 0 ), mDepthWidth( 0 ), mDepthHeight( 0 ), mNumColumns( 0 ), mNumRows( 0 ), mInfrared( false ), mOffsetX( 0.0f ), mOffsetY( 0.0f ),
+	  mNumCut( 0 )
+{
+}
+
+void DepthMesh::setResolution( int step, int depthWidth, int depthHeight )
+{
+	step = max( step, 1 );
+	if( step == mStep && depthWidth == mDepthWidth && depthHeight == mDepthHeight )
+		return;
+	mStep = step;
+	mDepthWidth = depthWidth;
+	mDepthHeight = depthHeight;
+	mNumColumns = depthWidth / step;
+	mNumRows = depthHeight / step;
+	size_t numVertices = getNumVertices();
+
+	mPositions.resize( numVertices * 3 );
+	for( int y = 0; y < mNumRows; ++y ) {
+		float *p = &mPositions[(size_t)y * mNumColumns * 3];
+		float py = 300.0f - (float)y / (float)mNumRows * 600.0f;
+		for( int x = 0; x < mNumColumns; ++x, p += 3 ) {
+			p[0] = (float)x / (float)mNumColumns * 800.0f - 400.0f;
+			p[1] = py;
+			p[2] = 0.0f;
+		}
+	}
+	mDepths.assign( numVertices, 0 );
+	mColors.clear();
+
+	// two triangles to a cell, off the cell's far corner, as the mesh was always built
+	mTriangles.clear();
+	mTriangles.reserve( (size_t)max( mNumColumns - 1, 0 ) * max( mNumRows - 1, 0 ) * 6 );
+	for( int y = 1; y < mNumRows; ++y ) {
+		for( int x = 1; x < mNumColumns; ++x ) {
+			uint32_t i = (uint32_t)( y * mNumColumns + x );
+			uint32_t triangles[6] = { i - 1 - mNumColumns, i - mNumColumns, i, i - 1 - mNumColumns, i - 1, i };
+			mTriangles.insert( mTriangles.end(), triangles, triangles + 6 );
+		}
+	}
+	mIndices = mTriangles;
+	mCells.assign( mTriangles.size() / 6, 0 );
+	mNumCut = 0;
+
+	mTexCoords.clear();
+	setTexCoords( mInfrared, mOffsetX, mOffsetY );
+}
+
+void DepthMesh::setTexCoords( bool infrared, float offsetX, float offsetY )
+{
+	if( infrared == mInfrared && offsetX == mOffsetX && offsetY == mOffsetY && mTexCoords.size() == getNumVertices() * 2 )
+		return;
+	mInfrared = infrared;
+	mOffsetX = offsetX;
+	mOffsetY = offsetY;
+
+	float dx = infrared ? 0.0f : offsetX, dy = infrared ? 0.0f : offsetY;
+	mTexCoords.resize( getNumVertices() * 2 );
+	float *t = mTexCoords.empty() ? 0 : &mTexCoords[0];
+	for( int y = 0; y < mNumRows; ++y ) {
+		for( int x = 0; x < mNumColumns; ++x, t += 2 ) {
+			t[0] = (float)x / (float)mNumColumns + dx;
+			t[1] = (float)y / (float)mNumRows + dy;
+		}
+	}
+}
+
+void DepthMesh::update( const uint16_t *depth, int minDepth, int maxDepth, float depthScale, const float *colors, int maxDepthStep )
+{
+	uint16_t outside = (uint16_t)min( max( minDepth, 0 ), 0xffff );
+	if( colors )
+		mColors.resize( getNumVertices() * 3 );
+
+	// the row's samples, then z from them with no branch, so the loop vectorizes
+	for( int y = 0; y < mNumRows; ++y ) {
+		const uint16_t *src = depth + (size_t)y * mStep * mDepthWidth;
+		uint16_t *d = &mDepths[(size_t)y * mNumColumns];
+		float *p = &mPositions[(size_t)y * mNumColumns * 3];
+		for( int x = 0; x < mNumColumns; ++x ) {
+			int raw = src[x * mStep];
+			d[x] = minDepth <= raw && raw <= maxDepth ? (uint16_t)raw : outside;
+		}
+		for( int x = 0; x < mNumColumns; ++x )
+			p[x * 3 + 2] = (float)d[x] / 75 * depthScale;
+
+		if( colors ) {
+			float *c = &mColors[(size_t)y * mNumColumns * 3];
+			for( int x = 0; x < mNumColumns; ++x, c += 3 )
+				copy( colors + src[x * mStep] * 3, colors + src[x * mStep] * 3 + 3, c );
+		}
+	}
+
+	cutSteps( maxDepthStep );
+}
+
+void DepthMesh::cutSteps( int maxDepthStep )
+{
+	if( maxDepthStep <= 0 ) {
+		if( mNumCut ) {
+			copy( mTriangles.begin(), mTriangles.end(), mIndices.begin() );
+			fill( mCells.begin(), mCells.end(), 0 );
+			mNumCut = 0;
+		}
+		return;
+	}
+
+	// cell by cell, with each cell's four corners at hand; only triangles cut or put back are written
+	mNumCut = 0;
+	uint8_t *cells = mCells.empty() ? 0 : &mCells[0];
+	for( int y = 1; y < mNumRows; ++y ) {
+		const uint16_t *above = &mDepths[(size_t)( y - 1 ) * mNumColumns], *row = above + mNumColumns;
+		for( int x = 1; x < mNumColumns; ++x, ++cells ) {
+			int topLeft = above[x - 1], topRight = above[x], bottomLeft = row[x - 1], bottomRight = row[x];
+			int cutRight = max( topLeft, max( topRight, bottomRight ) ) - min( topLeft, min( topRight, bottomRight ) ) > maxDepthStep;
+			int cutLeft = max( topLeft, max( bottomLeft, bottomRight ) ) - min( topLeft, min( bottomLeft, bottomRight ) ) > maxDepthStep;
+			uint8_t cell = (uint8_t)( cutRight | cutLeft << 1 );
+			mNumCut += cutRight + cutLeft;
+			if( cell == *cells )
+				continue;
+			*cells = cell;
+			size_t i = ( (size_t)( y - 1 ) * ( mNumColumns - 1 ) + x - 1 ) * 6;
+			uint32_t first = mTriangles[i];
+			mIndices[i + 1] = cutRight ? first : mTriangles[i + 1];
+			mIndices[i + 2] = cutRight ? first : mTriangles[i + 2];
+			mIndices[i + 4] = cutLeft ? first : mTriangles[i + 4];
+			mIndices[i + 5] = cutLeft ? first : mTriangles[i + 5];
+		}
+	}
+}
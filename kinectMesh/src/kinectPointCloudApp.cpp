@@ -1,6 +1,5 @@
 #include "cinder/app/AppBasic.h"
 //#include "cinder/gl/GlslProg.h"
-#include "cinder/TriMesh.h"
 #include "cinder/gl/Texture.h"
 #include "cinder/gl/gl.h"
 #include "cinder/Camera.h"
@@ -8,7 +7,9 @@
 #include "cinder/Utilities.h"
 #include "cinder/ImageIo.h"
 #include "cinder/Rand.h"
+#include "DepthMesh.h"
 #include "Kinect.h"
+#include "MeshNormals.h"
 #include "Resources.h"
 
 static const int KINECT_X_RES = 640;
@@ -22,11 +23,9 @@ class kinectMesh : public AppBasic {
 public:
     void prepareSettings( Settings* settings );
     void setup();
-    void updateMesh();
     void update();
     void draw();
-    void setupMeshRes();
-    void setupDepthScale();
+    void drawMesh();
     
     // PARAMS
     params::InterfaceGl	mParams;
@@ -38,6 +37,8 @@ public:
     bool      showTexture;
     bool      showInfrared, setShowInfrared;
     bool      showWireframe, setShowWireframe;
+    bool      showLighting;
+    int       mMaxDepthStep;
     
     // CAMERA
     CameraPersp mCam;
@@ -53,12 +54,6 @@ public:
     
     int       MESH_DIV;
     int       setMeshDiv;
-    int       MESH_X_RES;
-    int       MESH_Y_RES;
-    float*    xValues;
-    float*    yValues;
-    
-    float*    zValues;
     float     depthScale;
     float     setDepthScale;
     
@@ -66,7 +61,8 @@ public:
     
     // VBO AND SHADER
     //gl::GlslProg	mShader;
-    TriMesh   mMesh;	
+    DepthMesh     mMesh;
+    vector<float> mNormals;
     
 };
 
@@ -91,6 +87,8 @@ void kinectMesh::setup()
     mParams.addParam( "Show Wireframe", &setShowWireframe, "" );
     mParams.addParam( "Show Texture", &showTexture, "" );
     mParams.addParam( "Show Infrared", &setShowInfrared, "" );
+    mParams.addParam( "Show Lighting", &showLighting, "" );
+    mParams.addParam( "Max Depth Step", &mMaxDepthStep, "min=0 max=65000 step=100" );
     mParams.addParam( "RGB Offset X", &mTexOffsetX, "min=-.5 max=.5 step=.001 keyIncr=i keyDecr=k" );
     mParams.addParam( "RGB Offset Y", &mTexOffsetY, "min=-.5 max=.5 step=.001 keyIncr=o keyDecr=l" );
     
@@ -118,14 +116,15 @@ void kinectMesh::setup()
     setShowInfrared = false;
     showWireframe = false;
     setShowWireframe = false;
+    showLighting = false;
+    mMaxDepthStep = 0;
     
     MESH_DIV = 3;
     setMeshDiv = MESH_DIV;
-    setupMeshRes();
+    mMesh.setResolution( MESH_DIV, KINECT_X_RES, KINECT_Y_RES );
     
     depthScale  = 1;
     setDepthScale = depthScale;
-    setupDepthScale();
     
     depthColors = new Color[66000];
     for (int i=0; i<66000; ++i) {
@@ -144,66 +143,6 @@ void kinectMesh::setup()
     
 }
 
-void kinectMesh::setupMeshRes()
-{
-    MESH_X_RES = KINECT_X_RES/MESH_DIV;
-    MESH_Y_RES = KINECT_Y_RES/MESH_DIV;
-    
-    // X and Y lookup table
-    xValues = new float[MESH_X_RES];
-    for (int i=0; i<MESH_X_RES; ++i) {
-        xValues[i] = (float)i / (float)MESH_X_RES * 800.0f - 400.0f;
-    }
-    yValues = new float[MESH_Y_RES];
-    for (int i=0; i<MESH_Y_RES; ++i) {
-        yValues[i] = 300.0f - (float)i / (float)MESH_Y_RES * 600.0f;
-    }
-}
-
-void kinectMesh::setupDepthScale()
-{
-    // Depth lookup table
-    zValues = new float[66000];
-    for (int i=0; i<66000; ++i) {
-        zValues[i] = (float)i / 75 * depthScale;
-    }
-}
-
-void kinectMesh::updateMesh()
-{
-    
-    for (int y=0; y<MESH_Y_RES; ++y) {
-        for (int x=0; x<MESH_X_RES; ++x) {
-            
-            int depth = mDepthData.get()[(y*MESH_DIV)*KINECT_X_RES+(x*MESH_DIV)];
-            
-            float zPos = zValues[mMinDepth];
-            if (mMinDepth <= depth && depth <= mMaxDepth ) {
-                zPos = zValues[depth];
-            }
-            mMesh.appendVertex( Vec3f(xValues[x], yValues[y], zPos) );
-            if (showTexture) {
-                if (showInfrared)
-                    mMesh.appendTexCoord( Vec2f((float)x/(float)MESH_X_RES, (float)y/(float)MESH_Y_RES) );
-                else
-                    mMesh.appendTexCoord( Vec2f((float)x/(float)MESH_X_RES+mTexOffsetX, (float)y/(float)MESH_Y_RES+mTexOffsetY) );
-            } else {
-                // Rainbow mesh
-                mMesh.appendColorRGB(depthColors[depth]);
-            }
-            
-            if (x>0 && y>0) {
-                // Two triangles per square
-                int idx = mMesh.getNumVertices() - 1;
-                mMesh.appendTriangle( idx-1-MESH_X_RES, idx-MESH_X_RES, idx ); // \|.
-                mMesh.appendTriangle( idx-1-MESH_X_RES, idx-1,          idx ); // |\.
-            }
-            
-        }
-    }
-    
-}
-
 void kinectMesh::update()
 {
     if( mKinectTilt != mKinect.getTilt() )
@@ -214,13 +153,10 @@ void kinectMesh::update()
     
     if (MESH_DIV != setMeshDiv) {
         MESH_DIV = setMeshDiv;
-        setupMeshRes();
+        mMesh.setResolution( MESH_DIV, KINECT_X_RES, KINECT_Y_RES );
     }
     
-    if (depthScale != setDepthScale) {
-        depthScale = setDepthScale;
-        setupDepthScale();
-    }
+    depthScale = setDepthScale;
     
     //  mDepthSurface = mKinect.getDepthImage();
     mDepthData = mKinect.getDepthData();
@@ -241,9 +177,16 @@ void kinectMesh::update()
     if( showTexture && mKinect.checkNewVideoFrame() )
         mImageTexture = gl::Texture(mKinect.getVideoImage());
     
-    // Update mesh with new webcam capture frame
-    mMesh.clear();
-    updateMesh();
+    // Update mesh with new webcam capture frame; only z and the colours change
+    if (showTexture)
+        mMesh.setTexCoords( showInfrared, mTexOffsetX, mTexOffsetY );
+    mMesh.update( mDepthData.get(), mMinDepth, mMaxDepth, depthScale, showTexture ? 0 : &depthColors[0].r, mMaxDepthStep );
+    
+    // The mesh is a grid of rows, so normals come from each vertex's neighbours
+    if (showLighting) {
+        mNormals.resize( mMesh.getNumVertices() * 3 );
+        MeshNormals::computeGrid( mMesh.getPositions(), mMesh.getNumColumns(), mMesh.getNumRows(), &mNormals[0] );
+    }
     
     // update camera information
     mEye = Vec3f( 0.0f, 0.0f, mCameraDistance );
@@ -255,17 +198,57 @@ void kinectMesh::update()
 void kinectMesh::draw()
 {
     gl::clear( Color( 0.0f, 0.0f, 0.0f ), true );
-    if (showTexture && mImageTexture) {
-        mImageTexture.enableAndBind();
-        gl::draw(mMesh);
-        mImageTexture.unbind();
-    } else {
-        gl::draw(mMesh);
+    if (showLighting) {
+        // a light straight ahead of the scene, lighting the rainbow colours as well
+        GLfloat lightDirection[] = { 0.0f, 0.0f, 1.0f, 0.0f };
+        glLightfv( GL_LIGHT0, GL_POSITION, lightDirection );
+        gl::enable( GL_LIGHT0 );
+        gl::enable( GL_LIGHTING );
+        gl::enable( GL_COLOR_MATERIAL );
+    }
+    if (mDepthData) {
+        if (showTexture && mImageTexture) {
+            mImageTexture.enableAndBind();
+            drawMesh();
+            mImageTexture.unbind();
+        } else {
+            drawMesh();
+        }
+    }
+    if (showLighting) {
+        gl::disable( GL_COLOR_MATERIAL );
+        gl::disable( GL_LIGHTING );
+        gl::disable( GL_LIGHT0 );
     }
     
     avgFramerate = getAverageFps();
     params::InterfaceGl::draw();
 }
 
+void kinectMesh::drawMesh()
+{
+    // Straight from the mesh's own buffers, which stay put from frame to frame
+    glEnableClientState( GL_VERTEX_ARRAY );
+    glVertexPointer( 3, GL_FLOAT, 0, mMesh.getPositions() );
+    // until the next depth frame there may be no normals or colours yet
+    if (showLighting && mNormals.size() == mMesh.getNumVertices() * 3) {
+        glEnableClientState( GL_NORMAL_ARRAY );
+        glNormalPointer( GL_FLOAT, 0, &mNormals[0] );
+    }
+    if (showTexture) {
+        glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+        glTexCoordPointer( 2, GL_FLOAT, 0, mMesh.getTexCoords() );
+    } else if (mMesh.getColors()) {
+        glEnableClientState( GL_COLOR_ARRAY );
+        glColorPointer( 3, GL_FLOAT, 0, mMesh.getColors() );
+    }
+    
+    glDrawElements( GL_TRIANGLES, (GLsizei)mMesh.getNumIndices(), GL_UNSIGNED_INT, mMesh.getIndices() );
+    
+    glDisableClientState( GL_VERTEX_ARRAY );
+    glDisableClientState( GL_NORMAL_ARRAY );
+    glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+    glDisableClientState( GL_COLOR_ARRAY );
+}
 
 CINDER_APP_BASIC( kinectMesh, RendererGl )
\ No newline at end of file
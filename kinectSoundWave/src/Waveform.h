@@ -0,0 +1,50 @@
+//
+//  Waveform.h
+//
+//  PCM samples or FFT bands into the line strip and image rows the sound apps draw.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class WaveformLine {
+  public:
+	WaveformLine();
+
+	//! Vertex i sits at x = i * width / count, y = ( samples[i] + bias ) * gain,
+	//! decimated to min/max pairs per pixel column when count > 2 * width.
+	void			update( const float *samples, size_t count, float width, float bias, float gain );
+
+	//! Interleaved x, y pairs, getNumVertices() of them.
+	const float*	getVertices() const		{ return mVertices.empty() ? 0 : &mVertices[0]; }
+	size_t			getNumVertices() const	{ return mNumVertices; }
+
+  private:
+	std::vector<float>	mVertices;		// grows, never shrinks
+	size_t				mNumVertices;
+};
+
+class WaveformRows {
+  public:
+	WaveformRows();
+
+	//! Writes \a values into \a pixels ( RGBA floats, \a rowStride floats apart ).
+	//! Column x reads values[x] when \a stretch is false, as the apps always did,
+	//! and values[x * count / width] when it is true, which fits a spectrum of any
+	//! band count to the width. Columns past the end of \a values are 0.
+	void			update( const float *values, size_t count, float *pixels, int width, int height, size_t rowStride,
+							int rowStep, float bias, float gain, bool stretch = false );
+
+	//! Forces the background rows to be written on the next update().
+	void			invalidate()	{ mPixels = 0; }
+
+  private:
+	void			fillRow( float *row, const float *values, size_t count, int width, float bias, float gain, bool stretch );
+
+	std::vector<float>	mRow;			// one wave row, copied into the image
+	float*				mPixels;		// image the background was written to
+	int					mWidth, mHeight, mRowStep;
+	size_t				mRowStride;
+};
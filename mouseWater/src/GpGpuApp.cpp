@@ -37,8 +37,11 @@
 
 #include "cinder/Color.h"
 #include "cinder/ImageIo.h"
+#include "cinder/Timer.h"
 #include "cinder/Utilities.h"
 
+#include <sstream>
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
@@ -52,47 +55,87 @@ void GpGpuApp::draw()
 	///////////////////////////////////////////////////////////////
 	// GPGPU pass
 
-	// Enable textures
-	gl::enable( GL_TEXTURE_2D );
-	gl::color( Colorf::white() );
-
-	// Bind the other FBO to draw onto it
 	size_t pong = ( mFboIndex + 1 ) % 2;
-	mFbo[ pong ].bindFramebuffer();
 
-	// Set up the window to match the FBO
-	gl::setViewport( mFbo[ mFboIndex ].getBounds() );
-	gl::setMatricesWindow( mFbo[ mFboIndex ].getSize(), false );
-	gl::clear();
+	if ( mCpu ) {
 
-	// Bind the texture from the FBO on which we last 
-	// wrote data
-	mFbo[ mFboIndex ].bindTexture();
+		// Step on the CPU and hand the result to the refraction
+		// pass as though the shader had written it
+		mSolver->step();
+		if ( mMouseDown ) {
+			mSolver->impulse( (float)mMouse.x, (float)mMouse.y );
+		}
+		mSolver->getState( &mState[ 0 ], kWindowSize.x * 4 );
+		writeState( mFbo[ pong ] );
+	} else {
 
-	// Bind and configure the GPGPU shader
-	mShaderGpGpu.bind();
-	mShaderGpGpu.uniform( "buffer", 0 ); 
-	mShaderGpGpu.uniform( "pixel", kPixel );
+		// Start the CPU solver from the state the shader reads
+		if ( mVerify ) {
+			readState( mFbo[ mFboIndex ] );
+			mSolver->setState( &mState[ 0 ], kWindowSize.x * 4 );
+		}
 
-	// Draw a fullscreen rectangle to process data
-	drawFullScreenRect();
+		// Enable textures
+		gl::enable( GL_TEXTURE_2D );
+		gl::color( Colorf::white() );
 
-	// End shader output
-	mShaderGpGpu.unbind();
+		// Bind the other FBO to draw onto it
+		mFbo[ pong ].bindFramebuffer();
 
-	// Unbind and disable textures
-	mFbo[ mFboIndex ].unbindTexture();
-	gl::disable( GL_TEXTURE_2D );
+		// Set up the window to match the FBO
+		gl::setViewport( mFbo[ mFboIndex ].getBounds() );
+		gl::setMatricesWindow( mFbo[ mFboIndex ].getSize(), false );
+		gl::clear();
 
-	// Draw mouse input into red channel
-	if ( mMouseDown ) {
-		gl::color( ColorAf( 1.0f, 0.0f, 0.0f, 1.0f ) );
-		gl::drawSolidCircle( Vec2f( mMouse ), 5.0f, 32 );
-		gl::color( Color::white() );
-	}
+		// Bind the texture from the FBO on which we last 
+		// wrote data
+		mFbo[ mFboIndex ].bindTexture();
+
+		// Bind and configure the GPGPU shader
+		mShaderGpGpu.bind();
+		mShaderGpGpu.uniform( "buffer", 0 ); 
+		mShaderGpGpu.uniform( "pixel", kPixel );
+
+		// Draw a fullscreen rectangle to process data
+		drawFullScreenRect();
+
+		// End shader output
+		mShaderGpGpu.unbind();
+
+		// Unbind and disable textures
+		mFbo[ mFboIndex ].unbindTexture();
+		gl::disable( GL_TEXTURE_2D );
 
-	// Stop drawing to FBO
-	mFbo[ pong ].unbindFramebuffer();
+		// Draw mouse input into red channel
+		if ( mMouseDown ) {
+			gl::color( ColorAf( 1.0f, 0.0f, 0.0f, 1.0f ) );
+			gl::drawSolidCircle( Vec2f( mMouse ), 5.0f, 32 );
+			gl::color( Color::white() );
+		}
+
+		// Stop drawing to FBO
+		mFbo[ pong ].unbindFramebuffer();
+
+		// Run the same pass on the CPU and report how far the
+		// shader's result is from it
+		if ( mVerify ) {
+			mSolver->step();
+			if ( mMouseDown ) {
+				mSolver->impulse( (float)mMouse.x, (float)mMouse.y );
+			}
+			readState( mFbo[ pong ] );
+			float maxHeight = 0.0f;
+			float maxVelocity = 0.0f;
+			for ( int32_t y = 0; y < kWindowSize.y; ++y ) {
+				for ( int32_t x = 0; x < kWindowSize.x; ++x ) {
+					const float* pixel = &mState[ ( y * kWindowSize.x + x ) * 4 ];
+					maxHeight = math<float>::max( maxHeight, math<float>::abs( pixel[ 0 ] - mSolver->getHeight( x, y ) ) );
+					maxVelocity = math<float>::max( maxVelocity, math<float>::abs( pixel[ 1 ] - mSolver->getVelocity( x, y ) ) );
+				}
+			}
+			console() << "Frame " << getElapsedFrames() << ": height error " << maxHeight << ", velocity error " << maxVelocity << "\n";
+		}
+	}
 
 	// Swap FBOs
 	mFboIndex = pong;
@@ -172,6 +215,51 @@ void GpGpuApp::drawFullScreenRect()
 	gl::end();
 }
 
+void GpGpuApp::readState( gl::Fbo &fbo )
+{
+	fbo.bindFramebuffer();
+	glReadPixels( 0, 0, kWindowSize.x, kWindowSize.y, GL_RGBA, GL_FLOAT, &mState[ 0 ] );
+	fbo.unbindFramebuffer();
+}
+
+void GpGpuApp::writeState( gl::Fbo &fbo )
+{
+	fbo.getTexture().bind();
+	glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, kWindowSize.x, kWindowSize.y, GL_RGBA, GL_FLOAT, &mState[ 0 ] );
+	fbo.getTexture().unbind();
+}
+
+string GpGpuApp::benchmark()
+{
+	ostringstream report;
+	const int32_t sizes[] = { 1024, 4096 };
+	for ( size_t i = 0; i < 2; ++i ) {
+		int32_t size = sizes[ i ];
+		int32_t count = 4096 / size * 4;
+
+		WaveSolver solver( size, size );
+		solver.impulse( size * 0.5f, size * 0.5f );
+		Timer tiledTimer( true );
+		for ( int32_t j = 0; j < count; ++j ) {
+			solver.step();
+		}
+		double tiled = count / tiledTimer.getSeconds();
+
+		vector<float> state( size * size * 4 );
+		vector<float> next( state.size() );
+		solver.getState( &state[ 0 ], size * 4 );
+		Timer naiveTimer( true );
+		for ( int32_t j = 0; j < count; ++j ) {
+			WaveSolver::stepNaive( &state[ 0 ], &next[ 0 ], size, size );
+			state.swap( next );
+		}
+		double naive = count / naiveTimer.getSeconds();
+
+		report << size << "x" << size << ": " << tiled << " steps/s on " << solver.getNumThreads() << " threads, " << naive << " steps/s naive\n";
+	}
+	return report.str();
+}
+
 // Handles key press
 void GpGpuApp::keyDown( KeyEvent event )
 {
@@ -182,6 +270,32 @@ void GpGpuApp::keyDown( KeyEvent event )
 		case KeyEvent::KEY_i:
 			mShowInput = !mShowInput;
 		break;
+		case KeyEvent::KEY_c:
+			// Pick up where the shader left off
+			mCpu = !mCpu;
+			if ( mCpu ) {
+				readState( mFbo[ mFboIndex ] );
+				mSolver->setState( &mState[ 0 ], kWindowSize.x * 4 );
+			}
+		break;
+		case KeyEvent::KEY_v:
+			mVerify = !mVerify;
+		break;
+		case KeyEvent::KEY_b:
+			// One at a time; update() joins the thread once it
+			// is done
+			if ( mBenchmarkThread ) {
+				console() << "Benchmark already running\n";
+				break;
+			}
+			console() << "Benchmarking...\n";
+			mBenchmarkThread = shared_ptr<boost::thread>( new boost::thread( [ this ]() {
+				string report = benchmark();
+				boost::lock_guard<boost::mutex> lock( mBenchmarkMutex );
+				mBenchmarkReport = report;
+				mBenchmarkDone = true;
+			} ) );
+		break;
 	}
 }
 
@@ -216,6 +330,13 @@ void GpGpuApp::setup()
 	mMouse		= Vec2i::zero();
 	mMouseDown	= false;
 	mShowInput	= false;
+	mCpu		= false;
+	mVerify		= false;
+	mBenchmarkDone	= false;
+
+	// CPU solver
+	mSolver = shared_ptr<WaveSolver>( new WaveSolver( kWindowSize.x, kWindowSize.y ) );
+	mState.resize( kWindowSize.x * kWindowSize.y * 4 );
 
 	// Load shaders
 	try {
@@ -260,4 +381,24 @@ void GpGpuApp::setup()
 	}
 }
 
+// Waits for a running benchmark
+void GpGpuApp::shutdown()
+{
+	if ( mBenchmarkThread ) {
+		mBenchmarkThread->join();
+	}
+}
+
+// Reports a finished benchmark
+void GpGpuApp::update()
+{
+	boost::lock_guard<boost::mutex> lock( mBenchmarkMutex );
+	if ( mBenchmarkDone ) {
+		mBenchmarkThread->join();
+		mBenchmarkThread.reset();
+		mBenchmarkDone = false;
+		console() << mBenchmarkReport;
+	}
+}
+
 CINDER_APP_BASIC( GpGpuApp, RendererGl( RendererGl::AA_MSAA_32 ) )
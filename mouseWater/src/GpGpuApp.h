@@ -39,6 +39,11 @@
 #include "cinder/gl/Fbo.h"
 #include "cinder/gl/GlslProg.h"
 #include "Resources.h"
+#include "WaveSolver.h"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <string>
 
 /* 
  * This application demonstrates how to use the FBO
@@ -59,11 +64,21 @@ public:
 	void				mouseUp( ci::app::MouseEvent event );
 	void				prepareSettings( ci::app::AppBasic::Settings *settings );
 	void				setup();
+	void				shutdown();
+	void				update();
 private:
 	// Convenience method for drawing fullscreeen rectangle
 	// with texture coordinates
 	void				drawFullScreenRect();
 
+	// Copies the state between an FBO and mState
+	void				readState( ci::gl::Fbo &fbo );
+	void				writeState( ci::gl::Fbo &fbo );
+
+	// Times steps per second of the CPU solver against a
+	// pixel-at-a-time loop, on mBenchmarkThread
+	std::string			benchmark();
+
 	// Frame buffer objects to ping pong
 	ci::gl::Fbo			mFbo[ 2 ];
 	size_t				mFboIndex;
@@ -81,4 +96,19 @@ private:
 
 	// True renders input to screen
 	bool				mShowInput;
+
+	// CPU solver, stepping in place of the shader when
+	// mCpu is on, and checked against the shader's next
+	// pass when mVerify is
+	std::shared_ptr<WaveSolver>	mSolver;
+	std::vector<float>	mState;
+	bool				mCpu;
+	bool				mVerify;
+
+	// The benchmark runs off the main thread; update()
+	// logs mBenchmarkReport once mBenchmarkDone is set
+	std::shared_ptr<boost::thread>	mBenchmarkThread;
+	boost::mutex		mBenchmarkMutex;
+	bool				mBenchmarkDone;
+	std::string			mBenchmarkReport;
 };
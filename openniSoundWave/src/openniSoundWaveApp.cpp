@@ -11,6 +11,7 @@
 #include "Resources.h"
 #include "cinder/audio/Input.h"
 #include "cinder/audio/FftProcessor.h"
+#include "Waveform.h"
 #include "VOpenNIHeaders.h"
 #include "KinectTextures.h"
 #include "cinderSyphon.h"
@@ -62,6 +63,7 @@ class openniSoundWave : public AppBasic, V::UserListener {
     void setupAudio();
     Surface32f	    audioSurface;
     gl::Texture		audioTexture;
+    WaveformRows    audioRows;
     
     Font mFont;
     
@@ -119,41 +121,10 @@ void openniSoundWave::updateWave()
 	
 	uint32_t bufferLength = mPcmBuffer->getSampleCount();
 	audio::Buffer32fRef leftBuffer = mPcmBuffer->getChannelData( audio::CHANNEL_FRONT_LEFT );
-	audio::Buffer32fRef rightBuffer = mPcmBuffer->getChannelData( audio::CHANNEL_FRONT_RIGHT );
     
-	int displaySize = getWindowWidth();
-	float scale = displaySize / (float)bufferLength;
-	
-	PolyLine<Vec2f>	leftBufferLine;
-	PolyLine<Vec2f>	rightBufferLine;
-	
-	for( int i = 0; i < bufferLength; i++ ) {
-		float x = ( i * scale );
-        
-		//get the PCM value from the left channel buffer
-		float y = ( ( leftBuffer->mData[i] - 1 ) * - 100 );
-		leftBufferLine.push_back( Vec2f( x , y) );
-		
-		y = ( ( rightBuffer->mData[i] - 1 ) * - 100 );
-		rightBufferLine.push_back( Vec2f( x , y) );
-	}
-//	gl::color( Color( 1.0f, 0.5f, 0.25f ) );
-//	gl::draw( leftBufferLine );
-//	gl::draw( rightBufferLine );
-
-    
-    Surface32f::Iter pixelIter = audioSurface.getIter();
-    int i = 0;
-    int ln = 0;
-	while( pixelIter.line() ) {
-        i = 0;
-		while( pixelIter.pixel() ) {
-		    float y = (ln % (int)waveStep == 0)? ( ( leftBuffer->mData[i] - 1 ) * - 100 ): 0.0;//;
-			audioSurface.setPixel( pixelIter.getPos(), ColorAf(y, 0.0f, 0.0f, 1.0f ) );
-            i++;
-		}
-        ln ++;
-	}
+	// only the rows that carry the wave are rewritten; the rest keep the ( 0, 0, 0, 1 ) written when the surface or step changed
+	audioRows.update( leftBuffer->mData, bufferLength, audioSurface.getData(), audioSurface.getWidth(), audioSurface.getHeight(),
+					  audioSurface.getRowBytes() / sizeof( float ), (int)waveStep, -1.0f, -100.0f );
     
     audioTexture.update(audioSurface);
 }
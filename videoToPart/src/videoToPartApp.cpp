@@ -15,6 +15,7 @@
 #include "cinder/audio/Input.h"
 #include "cinder/audio/FftProcessor.h"
 #include "cinderSyphon.h"
+#include "ParticleSeeder.h"
 
 #include "cinder/params/Params.h"
 #include "cinder/Easing.h"
@@ -48,6 +49,8 @@ public:
 	CameraPersp		mCam;
 	Arcball			mArcball;
 	Surface32f		mInitPos, mInitVel;
+	ParticleSeeder	mSeeder;
+	std::shared_ptr<ParticleSeedWorker>	mSeedWorker;	// keeps particles seeded from the latest captured frames
 	int				mCurrentFBO;
 	int				mOtherFBO;
 	gl::Fbo			mFBO[2];
@@ -119,45 +122,18 @@ void videoToPartApp::audioUpdate()
 
 void videoToPartApp::setupTextures(){
     
-    Surface imgSurface;
-
-	if( mCapture.isCapturing() && mSurface) {
-        Area srcArea(0,0,mSurface.getWidth(), mSurface.getHeight());
-
-        imgSurface = ip::resizeCopy(mSurface, srcArea, getWindowSize(), FilterBox() );
-	} else {
-        Area srcArea(0,0,imgSurfaceRef.get()->getWidth(), imgSurfaceRef.get()->getHeight());
-        Surface srcSur(imgSurfaceRef);
-       imgSurface = ip::resizeCopy(srcSur, srcArea, getWindowSize(), FilterBox() );
-    }
-
-    Channel imgChannel(imgSurface);
-    float intns1 = imgChannel.areaAverage(Area(0,0,imgChannel.getWidth(),imgChannel.getHeight()));
-    
+    /* Initial particle positions are passed in as R,G,B 
+     float values. Alpha is used as particle mass. */
 	mInitPos = Surface32f( getWindowWidth(), getWindowHeight(), true);
-	Surface32f::Iter pixelIter = mInitPos.getIter();
-    std::size_t cnt = 0;
-    float max = 0;
-    while(cnt<getWindowWidth()*getWindowHeight()){
-        Channel::Iter imgIter = imgChannel.getIter();
-        while( imgIter.line()) {
-            while( imgIter.pixel()) {
-                /* Initial particle positions are passed in as R,G,B 
-                 float values. Alpha is used as particle mass. */
-                float x, y, z;
-                max = imgIter.v()>max?imgIter.v():max;
-                if ((imgIter.v())>(intns1+10)){
-                    x = ((float)imgIter.getPos().x)/(float)getWindowWidth()-0.5f;
-                    y = ((float)imgIter.getPos().y)/(float)getWindowHeight()-0.5f;
-                    z = (Rand::randFloat()-0.5f)*0.001f;
-                    cnt++;
-                    mInitPos.setPixel( imgIter.getPos(), ColorAf( z, x, y , Rand::randFloat(0.2f, 1.0f) ) );
-                }
-            }
-        }
-    }
+    float *positions = mInitPos.getData();
+    size_t rowStride = mInitPos.getRowBytes() / sizeof( float );
     
-    std::cout<<max<<" "<<std::endl;
+    bool fromCapture = mCapture.isCapturing() && mSurface;
+    if( ! fromCapture || ! mSeedWorker->acquire( positions, mInitPos.getWidth(), mInitPos.getHeight(), rowStride ) ) {
+        Channel imgChannel = fromCapture ? Channel( mSurface ) : Channel( imgSurfaceRef );
+        mSeeder.setImage( imgChannel.getData(), imgChannel.getWidth(), imgChannel.getHeight(), imgChannel.getRowBytes(), imgChannel.getIncrement() );
+        mSeeder.seed( positions, mInitPos.getWidth(), mInitPos.getHeight(), rowStride );
+    }
     
 	gl::Texture::Format tFormat;
 	tFormat.setInternalFormat(GL_RGBA32F_ARB);
@@ -168,12 +144,13 @@ void videoToPartApp::setupTextures(){
 	
 	//Velocity 2D texture array
 	mInitVel = Surface32f( WIDTH, HEIGHT, true);
-	pixelIter = mInitVel.getIter();
-	while( pixelIter.line() ) {
-		while( pixelIter.pixel() ) {
+	for( int y = 0; y < HEIGHT; ++y ) {
+		float *vel = mInitVel.getData( Vec2i( 0, y ) );
+		for( int x = 0; x < WIDTH; ++x, vel += 4 ) {
 			/* Initial particle velocities are
 			 passed in as R,G,B float values. */
-			mInitVel.setPixel( pixelIter.getPos(), ColorAf( 0.0f, 0.0f, 0.0f, 1.0f ) );
+			vel[0] = vel[1] = vel[2] = 0.0f;
+			vel[3] = 1.0f;
 		}
 	}
 	mVelocities = gl::Texture( mInitVel, tFormat);
@@ -287,6 +264,11 @@ void videoToPartApp::setup()
 	catch( ... ) {
 		std::cout << "Unable to load shader" << endl;
 	}
+	// particles go to pixels brighter than the image average + 10, at positions from -0.5 to 0.5, stored as z, x, y
+	mSeeder.setFormat( ParticleSeeder::Format().thresholdFromMean( 10.0f ).channels( 1, 2, 0 ).xMapping( 1.0f, -0.5f ).yMapping( 1.0f, -0.5f ) );
+	mSeedWorker = std::make_shared<ParticleSeedWorker>( mSeeder.getFormat(), getWindowWidth(), getWindowHeight() );
+	// a captured frame reseeds an eighth of the particles, so the worker stays well under a frame's time
+	mSeedWorker->setParticlesPerFrame( getWindowWidth() * getWindowHeight() / 8 );
 	setupTextures();
 	gl::Fbo::Format format;
 	format.enableDepthBuffer(false);
@@ -317,6 +299,8 @@ void videoToPartApp::resetView(){
 void videoToPartApp::updateCapture(){
 	if( mCapture && mCapture.checkNewFrame() ) {
 		mSurface = mCapture.getSurface();
+        Channel lum( mSurface );
+        mSeedWorker->submit( lum.getData(), lum.getWidth(), lum.getHeight(), lum.getRowBytes(), lum.getIncrement() );
 	}
 }
 